@@ -0,0 +1,193 @@
+################################################################################
+#  aisnmea - NumPy binding over batch parsing                                  #
+#                                                                              #
+#  Copyright (c) 2017 Inkblot Software Limited.                                #
+#                                                                              #
+#  This Source Code Form is subject to the terms of the Mozilla Public         #
+#  License, v. 2.0. If a copy of the MPL was not distributed with this         #
+#  file, You can obtain one at http://mozilla.org/MPL/2.0/.                    #
+################################################################################
+"""Parse whole buffers of AIS NMEA lines into NumPy arrays.
+
+A buffer goes to aisnmea_batch in one native call, and each column comes
+back as one NumPy array, so there's no per-line call into the library.
+Payloads and tag block values aren't copied out; their offsets and sizes
+in the original buffer are returned instead, which strings() turns into
+a fixed-width bytes array when wanted.
+
+    >>> import aisnmea
+    >>> data = open("day.nmea", "rb").read()
+    >>> cols = aisnmea.parse(data, keys=("s",))
+    >>> cols["msgtype"]            # int8, -1 where there's no valid type
+    >>> aisnmea.strings(data, cols["payload_offset"], cols["payload_size"])
+
+The shared library is found with ctypes.util.find_library, or can be
+given as a path in the AISNMEA_LIBRARY environment variable.
+"""
+
+import ctypes
+import ctypes.util
+import os
+
+import numpy as np
+
+__all__ = ["Batch", "parse", "strings"]
+
+
+def _load():
+    path = os.environ.get("AISNMEA_LIBRARY") \
+        or ctypes.util.find_library("aisnmea") \
+        or "libaisnmea.so.0"
+    return ctypes.CDLL(path)
+
+
+lib = _load()
+
+lib.aisnmea_batch_new.restype = ctypes.c_void_p
+lib.aisnmea_batch_new.argtypes = []
+lib.aisnmea_batch_destroy.restype = None
+lib.aisnmea_batch_destroy.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+lib.aisnmea_batch_add_key.restype = ctypes.c_size_t
+lib.aisnmea_batch_add_key.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+lib.aisnmea_batch_add.restype = ctypes.c_size_t
+lib.aisnmea_batch_add.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t]
+lib.aisnmea_batch_clear.restype = None
+lib.aisnmea_batch_clear.argtypes = [ctypes.c_void_p]
+lib.aisnmea_batch_size.restype = ctypes.c_size_t
+lib.aisnmea_batch_size.argtypes = [ctypes.c_void_p]
+lib.aisnmea_batch_errors.restype = ctypes.c_uint64
+lib.aisnmea_batch_errors.argtypes = [ctypes.c_void_p]
+lib.aisnmea_batch_column.restype = ctypes.c_void_p
+lib.aisnmea_batch_column.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+lib.aisnmea_batch_key_column.restype = ctypes.c_void_p
+lib.aisnmea_batch_key_column.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+lib.aisnmea_batch_unarmour.restype = ctypes.c_size_t
+lib.aisnmea_batch_unarmour.argtypes = [ctypes.c_void_p]
+
+# Columns of one value per row, and their types in the batch
+_VALUES = (
+    ("head", np.uint32),
+    ("fragcount", np.uint8),
+    ("fragnum", np.uint8),
+    ("messageid", np.int8),
+    ("channel", np.uint8),
+    ("fillbits", np.uint8),
+    ("msgtype", np.int8),
+    ("timestamp", np.uint64),
+)
+
+# Columns of (offset, size) pairs
+_SPANS = ("line", "payload")
+
+# The batch holds offsets as uint32_t
+_MAX_BUFFER = 2 ** 32 - 2
+
+
+def _copy(address, dtype, shape):
+    array = np.empty(shape, dtype)
+    if array.nbytes:
+        ctypes.memmove(array.ctypes.data, address, array.nbytes)
+    return array
+
+
+class Batch(object):
+    """A parser to use again and again, keeping its buffers between calls.
+
+    'keys' names the tag block keys (such as "s" or "g") whose values are
+    wanted; each gets KEY_offset and KEY_size columns, with a size of 0
+    where a line didn't have the key.
+    """
+
+    def __init__(self, keys=()):
+        self._handle = ctypes.c_void_p(lib.aisnmea_batch_new())
+        self.keys = tuple(keys)
+        for key in self.keys:
+            lib.aisnmea_batch_add_key(self._handle, key.encode("ascii"))
+        self.errors = 0
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            lib.aisnmea_batch_destroy(ctypes.byref(self._handle))
+
+    def parse(self, buf, unarmour=False):
+        """Parse every line in 'buf', anything supporting the buffer protocol
+        (bytes, bytearray, memoryview, mmap, a NumPy uint8 array), which
+        must be contiguous. Returns a dict of NumPy arrays, one entry per row
+        for each line that parsed:
+
+          fragcount, fragnum, fillbits     uint8
+          messageid, msgtype               int8, -1 where missing
+          channel                          bytes (S1), empty where missing
+          timestamp                        uint64 tag block "c" seconds, 0 if none
+          head_offset                      uint32, of the six-char head
+          line_offset, line_size           uint32
+          payload_offset, payload_size     uint32
+          KEY_offset, KEY_size             uint32, for each of 'keys'
+
+        Offsets are into 'buf'. Lines that didn't parse are counted in
+        self.errors.
+
+        With 'unarmour', every payload is also turned into bits in one
+        call, and there are three more entries: bits, a uint8 array with
+        each row's bits starting on a byte boundary, most significant
+        first; and bits_offset and bits_size (in bits, 0 if the payload
+        had a bad character), uint32 for each row.
+        """
+        data = np.frombuffer(buf, dtype=np.uint8)
+        if data.nbytes > _MAX_BUFFER:
+            raise ValueError("buffer over 4 GiB; parse it in pieces")
+        lib.aisnmea_batch_clear(self._handle)
+        lib.aisnmea_batch_add(self._handle, data.ctypes.data, data.nbytes)
+        rows = lib.aisnmea_batch_size(self._handle)
+        self.errors = lib.aisnmea_batch_errors(self._handle)
+
+        columns = {}
+        for name, dtype in _VALUES:
+            address = lib.aisnmea_batch_column(self._handle, name.encode("ascii"))
+            columns[name] = _copy(address, dtype, rows)
+        columns["head_offset"] = columns.pop("head")
+        channel = columns["channel"]
+        channel[channel == 0xFF] = 0
+        columns["channel"] = channel.view("S1")
+
+        spans = [(name, lib.aisnmea_batch_column(self._handle, name.encode("ascii")))
+                 for name in _SPANS]
+        spans += [(key, lib.aisnmea_batch_key_column(self._handle, index))
+                  for index, key in enumerate(self.keys)]
+        for name, address in spans:
+            pairs = _copy(address, np.uint32, (rows, 2))
+            columns[name + "_offset"] = np.ascontiguousarray(pairs[:, 0])
+            columns[name + "_size"] = np.ascontiguousarray(pairs[:, 1])
+
+        if unarmour:
+            lib.aisnmea_batch_unarmour(self._handle)
+            pairs = _copy(lib.aisnmea_batch_column(self._handle, b"bitspan"),
+                          np.uint32, (rows, 2))
+            size = 0
+            if rows:
+                size = int(pairs[-1, 0]) + (int(columns["payload_size"][-1]) * 6 + 7) // 8
+            columns["bits"] = _copy(lib.aisnmea_batch_column(self._handle, b"bits"),
+                                    np.uint8, size)
+            columns["bits_offset"] = np.ascontiguousarray(pairs[:, 0])
+            columns["bits_size"] = np.ascontiguousarray(pairs[:, 1])
+        return columns
+
+
+def parse(buf, keys=(), unarmour=False):
+    """Parse every line in 'buf' in one go; see Batch.parse."""
+    return Batch(keys).parse(buf, unarmour)
+
+
+def strings(buf, offsets, sizes):
+    """Gather the byte strings at 'offsets' and 'sizes' in 'buf' into a
+    fixed-width NumPy bytes array, as wide as the longest one.
+    """
+    data = np.frombuffer(buf, dtype=np.uint8)
+    offsets = np.asarray(offsets, dtype=np.int64)
+    sizes = np.asarray(sizes, dtype=np.int64)
+    width = max(int(sizes.max()) if len(sizes) else 0, 1)
+    steps = np.arange(width)
+    wanted = steps < sizes[:, None]
+    out = np.zeros((len(offsets), width), np.uint8)
+    out[wanted] = data[(offsets[:, None] + steps)[wanted]]
+    return out.view("S%d" % width).ravel()
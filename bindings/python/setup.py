@@ -0,0 +1,21 @@
+################################################################################
+#  aisnmea - NumPy binding over batch parsing                                  #
+#                                                                              #
+#  Copyright (c) 2017 Inkblot Software Limited.                                #
+#                                                                              #
+#  This Source Code Form is subject to the terms of the Mozilla Public         #
+#  License, v. 2.0. If a copy of the MPL was not distributed with this         #
+#  file, You can obtain one at http://mozilla.org/MPL/2.0/.                    #
+################################################################################
+
+from setuptools import setup
+
+setup(
+    name="aisnmea",
+    version="1.0.0",
+    license="mplv2",
+    description="NumPy binding over aisnmea batch parsing",
+    url="https://github.com/InkblotSoftware/aisnmea",
+    packages=["aisnmea"],
+    install_requires=["numpy"],
+)
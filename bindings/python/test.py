@@ -0,0 +1,100 @@
+################################################################################
+#  aisnmea - NumPy binding over batch parsing                                  #
+#                                                                              #
+#  Copyright (c) 2017 Inkblot Software Limited.                                #
+#                                                                              #
+#  This Source Code Form is subject to the terms of the Mozilla Public         #
+#  License, v. 2.0. If a copy of the MPL was not distributed with this         #
+#  file, You can obtain one at http://mozilla.org/MPL/2.0/.                    #
+################################################################################
+
+import mmap
+import tempfile
+import unittest
+
+import numpy as np
+
+import aisnmea
+
+LINES = [
+    b"\\g:1-2-73874,n:157036,s:r003669945,c:1241544035*4A"
+    b"\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13",
+    b"!AIVDM,2,1,3,B,55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53,0*3E",
+    b"!AIVDM,2,2,3,B,1@0000000000000,2*55",
+    b"!AIVDO,1,1,,,177KQJ5000G?tO`K>RA1wUbN0TKH,0*1C",
+]
+
+# CRLF and LF endings, a GPS sentence, junk, a blank line and an
+# unterminated last line
+TEXT = (LINES[0] + b"\r\n" + LINES[1] + b"\n$GPGGA,1*00\r\n\r\n"
+        + LINES[2] + b"\nnoise\n" + LINES[3])
+
+
+class TestParse(unittest.TestCase):
+
+    def test_columns(self):
+        batch = aisnmea.Batch(keys=("s", "g", "x"))
+        cols = batch.parse(TEXT)
+        self.assertEqual(batch.errors, 2)
+        self.assertEqual(cols["fragcount"].dtype, np.uint8)
+        self.assertEqual(cols["fragcount"].tolist(), [1, 2, 2, 1])
+        self.assertEqual(cols["fragnum"].tolist(), [1, 1, 2, 1])
+        self.assertEqual(cols["messageid"].tolist(), [-1, 3, 3, -1])
+        self.assertEqual(cols["channel"].tolist(), [b"B", b"B", b"B", b""])
+        self.assertEqual(cols["fillbits"].tolist(), [0, 0, 2, 0])
+        self.assertEqual(cols["msgtype"].tolist(), [1, 5, 1, 1])
+        self.assertEqual(cols["timestamp"].tolist(), [1241544035, 0, 0, 0])
+
+        # Offsets are into the buffer given
+        for row, line in enumerate(LINES):
+            start = cols["line_offset"][row]
+            self.assertEqual(TEXT[start:start + cols["line_size"][row]], line)
+            head = cols["head_offset"][row]
+            self.assertIn(TEXT[head:head + 6], (b"!AIVDM", b"!AIVDO"))
+        payloads = aisnmea.strings(TEXT, cols["payload_offset"], cols["payload_size"])
+        self.assertEqual(payloads[2], b"1@0000000000000")
+        self.assertEqual(payloads[3], b"177KQJ5000G?tO`K>RA1wUbN0TKH")
+        sources = aisnmea.strings(TEXT, cols["s_offset"], cols["s_size"])
+        self.assertEqual(sources.tolist(), [b"r003669945", b"", b"", b""])
+        self.assertEqual(cols["g_size"].tolist(), [9, 0, 0, 0])
+        self.assertEqual(cols["x_size"].tolist(), [0, 0, 0, 0])
+
+    def test_unarmour(self):
+        cols = aisnmea.parse(TEXT, unarmour=True)
+        self.assertEqual(cols["bits_offset"].tolist(), [0, 21, 63, 75])
+        self.assertEqual(cols["bits_size"].tolist(), [168, 336, 88, 168])
+        self.assertEqual(len(cols["bits"]), 96)
+        # Type 1 from MMSI 477553000, in the last row
+        bits = np.unpackbits(cols["bits"][75:96])
+        self.assertEqual(int("".join(map(str, bits[0:6])), 2), 1)
+        self.assertEqual(int("".join(map(str, bits[8:38])), 2), 477553000)
+        self.assertNotIn("bits", aisnmea.parse(TEXT))
+        self.assertEqual(len(aisnmea.parse(b"", unarmour=True)["bits"]), 0)
+
+    def test_buffers(self):
+        # Any contiguous buffer will do, and a batch can be used again
+        batch = aisnmea.Batch()
+        for buf in (bytearray(TEXT), memoryview(TEXT),
+                    np.frombuffer(TEXT, dtype=np.uint8)):
+            self.assertEqual(len(batch.parse(buf)["msgtype"]), 4)
+        with tempfile.TemporaryFile() as f:
+            f.write((TEXT + b"\n") * 1000)
+            f.flush()
+            with mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mapped:
+                cols = batch.parse(mapped)
+                self.assertEqual(len(cols["payload_offset"]), 4000)
+                self.assertEqual(batch.errors, 2000)
+                del cols
+        with self.assertRaises(BufferError):
+            batch.parse(memoryview(TEXT)[::2])
+
+    def test_empty(self):
+        cols = aisnmea.parse(b"", keys=("s",))
+        self.assertEqual(len(cols["msgtype"]), 0)
+        self.assertEqual(len(cols["s_offset"]), 0)
+        self.assertEqual(len(aisnmea.strings(b"", cols["s_offset"], cols["s_size"])), 0)
+        self.assertEqual(len(aisnmea.parse(b"noise\n")["line_size"]), 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -24,6 +24,13 @@ extern "C" {
 //  @interface
 //  This API is a draft, and may change without notice.
 #ifdef AISNMEA_BUILD_DRAFT_API
+#define AISNMEA_KIND_EMPTY 0                 // Blank or whitespace-only (keep-alive) line
+#define AISNMEA_KIND_AIS 1                   // AIS sentence from another station, e.g. !AIVDM
+#define AISNMEA_KIND_AIS_OWN 2               // AIS own-ship sentence, e.g. !AIVDO
+#define AISNMEA_KIND_NMEA 3                  // Other standard NMEA sentence, e.g. $GPRMC
+#define AISNMEA_KIND_PROPRIETARY 4           // Proprietary sentence, e.g. $PGHP
+#define AISNMEA_KIND_UNKNOWN 5               // Anything else, including malformed tag blocks
+
 //  *** Draft method, for development use, may change without warning ***
 //  Parse an NMEA string and return the results, or NULL if the parse failed.
 //  Pass NULL for string argument to construct in default state.
@@ -42,21 +49,93 @@ AISNMEA_EXPORT void
 AISNMEA_EXPORT aisnmea_t *
     aisnmea_dup (aisnmea_t *self);
 
+//  *** Draft method, for development use, may change without warning ***
+//  Make a copy of the object in 'arena', packed together with its head,
+//  payload and tagblock strings. The copy belongs to the arena and goes
+//  when it is reset or destroyed; destroying the copy itself does
+//  nothing. It can be read with all the accessors, and duplicated, but
+//  not parsed into or given new tagblock values.
+AISNMEA_EXPORT aisnmea_t *
+    aisnmea_dup_into (aisnmea_t *self, aisnmea_arena_t *arena);
+
 //  *** Draft method, for development use, may change without warning ***
 //  Parse an NMEA string, reusing the current parser, replacing its contents
 //  with the new parsed data.
 //
-//  Returns 0 on success, or -1 on parse failure. Object state after a failed
-//  parse is undefined.
+//  Returns 0 on success, -1 on parse failure, or 1 if the filter given to
+//  set_filter turned the line away. Object state after a failed or
+//  filtered parse is undefined.
 AISNMEA_EXPORT int
     aisnmea_parse (aisnmea_t *self, const char *nmea);
 
+//  *** Draft method, for development use, may change without warning ***
+//  Have parse check lines against 'filter' before parsing them, turning
+//  away those it doesn't pass without doing any of the work of parsing.
+//  Pass NULL to parse everything again. The filter isn't copied, so must
+//  outlive its use here; it may be shared by any number of parsers.
+AISNMEA_EXPORT void
+    aisnmea_set_filter (aisnmea_t *self, aisnmea_filter_t *filter);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Cheaply work out what kind of sentence a line holds, looking only at
+//  its first few bytes (after any tag block). Doesn't validate the rest
+//  of the line or its checksums, so use it to skip or route lines before
+//  paying for a full parse.
+//  Returns one of the AISNMEA_KIND_* constants.
+AISNMEA_EXPORT int
+    aisnmea_classify (const char *nmea);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Check that a line is an AIS sentence whose checksums (and its tag
+//  block's, if it has one) are right, without splitting it into fields
+//  or allocating anything. A fast filter for relaying lines untouched.
+AISNMEA_EXPORT bool
+    aisnmea_validate (const char *nmea);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Write the sentence back out as text into 'buffer', with checksums
+//  worked out afresh, preceded by a tagblock holding 'tagblock' ("k:v,..."
+//  pairs, without checksum) unless that's NULL. Doesn't allocate. Returns
+//  the length written, not counting the terminating null, or -1 if it
+//  wouldn't fit in 'size' bytes.
+AISNMEA_EXPORT int
+    aisnmea_encode (aisnmea_t *self, const char *tagblock, char *buffer, size_t size);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Armour a binary AIS message of 'bit_count' bits (most significant bit
+//  of each byte first) and write it into 'buffer' as as many sentences as
+//  it needs, each within the 82 char NMEA limit and ending in a newline.
+//  'head' is e.g. "!AIVDM", 'channel' may be 0 for none, and 'messageid'
+//  is 0 to 9, or -1 for none. Sentences get the right fragment numbers
+//  and the last one the fill bits; the first is preceded by a tagblock
+//  holding 'tagblock' ("k:v,..." pairs) unless that's NULL. Doesn't
+//  allocate. Returns the length written, not counting the terminating
+//  null, or -1 if it wouldn't fit in 'size' bytes or needs more than
+//  nine sentences.
+AISNMEA_EXPORT int
+    aisnmea_encode_payload (const char *head, char channel, int messageid, const char *tagblock, const byte *bits, size_t bit_count, char *buffer, size_t size);
+
 //  *** Draft method, for development use, may change without warning ***
 //  Get the string in the tagblock with given key.
 //  Returns NULL if key not found or if there was no tagblockl.
 AISNMEA_EXPORT const char *
     aisnmea_tagblockval (aisnmea_t *self, const char *key);
 
+//  *** Draft method, for development use, may change without warning ***
+//  Set the tagblock value for 'key', replacing any already there, or
+//  remove it if 'value' is NULL. Gives the sentence a tagblock if it had
+//  none. Lets tags known from elsewhere (e.g. from the first line of a
+//  sentence group) be attached to a sentence.
+AISNMEA_EXPORT void
+    aisnmea_set_tagblockval (aisnmea_t *self, const char *key, const char *value);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Receive time from the tagblock "c" key, in seconds since the UNIX epoch.
+//  Values given in milliseconds (as some receivers do) are scaled down.
+//  Returns 0 if there was no tagblock, no "c" key, or it wasn't a number.
+AISNMEA_EXPORT uint64_t
+    aisnmea_timestamp (aisnmea_t *self);
+
 //  *** Draft method, for development use, may change without warning ***
 //  Sentence identifier, e.g. "!AIVDM"
 //  TODO consider stripping the leading '!'; depends on what clients want.
@@ -109,11 +188,18 @@ AISNMEA_EXPORT size_t
 
 //  *** Draft method, for development use, may change without warning ***
 //  Returns the AIS message type of the message, or -1 if the message
-//  doesn't exhibit a valid AIS messgae type.
+//  doesn't exhibit a valid AIS messgae type (or has an empty payload).
 //  (This is worked out from the first character of the payload.)
 AISNMEA_EXPORT int
     aisnmea_aismsgtype (aisnmea_t *self);
 
+//  *** Draft method, for development use, may change without warning ***
+//  Returns the MMSI of the transmitting station, or -1 if this isn't the
+//  first fragment of a message or the payload is too short to hold it.
+//  (Only the first seven payload characters are decoded.)
+AISNMEA_EXPORT int
+    aisnmea_mmsi (aisnmea_t *self);
+
 //  *** Draft method, for development use, may change without warning ***
 //  Self test of this class.
 AISNMEA_EXPORT void
@@ -0,0 +1,69 @@
+/*  =========================================================================
+    aisnmea_arena - Bump allocator for records with a shared lifetime
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_ARENA_H_INCLUDED
+#define AISNMEA_ARENA_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_arena.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create an arena taking memory 'slab_size' bytes at a time; pass 0
+//  for the default of 1 MiB.
+AISNMEA_EXPORT aisnmea_arena_t *
+    aisnmea_arena_new (size_t slab_size);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the arena, freeing everything ever allocated from it.
+AISNMEA_EXPORT void
+    aisnmea_arena_destroy (aisnmea_arena_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Allocate 'size' bytes, aligned for any type. The memory stays valid
+//  until the arena is reset or destroyed, and can't be freed on its own.
+AISNMEA_EXPORT void *
+    aisnmea_arena_alloc (aisnmea_arena_t *self, size_t size);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Free everything allocated so far, keeping one slab for reuse.
+AISNMEA_EXPORT void
+    aisnmea_arena_reset (aisnmea_arena_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of bytes allocated since creation or the last reset, counting
+//  padding for alignment.
+AISNMEA_EXPORT size_t
+    aisnmea_arena_used (aisnmea_arena_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of bytes the arena currently holds in slabs.
+AISNMEA_EXPORT size_t
+    aisnmea_arena_reserved (aisnmea_arena_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_arena_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
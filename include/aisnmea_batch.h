@@ -0,0 +1,246 @@
+/*  =========================================================================
+    aisnmea_batch - Columnar parse results for many sentences at once
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_BATCH_H_INCLUDED
+#define AISNMEA_BATCH_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  Apache Arrow C Data Interface, as given in its specification, so that
+//  batches can be exported without depending on Arrow itself
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    // Array type description
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+
+    // Release callback
+    void (*release) (struct ArrowSchema *);
+    // Opaque producer-specific data
+    void *private_data;
+};
+
+struct ArrowArray {
+    // Array data description
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+
+    // Release callback
+    void (*release) (struct ArrowArray *);
+    // Opaque producer-specific data
+    void *private_data;
+};
+
+#endif // ARROW_C_DATA_INTERFACE
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_batch.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create a new, empty batch.
+AISNMEA_EXPORT aisnmea_batch_t *
+    aisnmea_batch_new (void);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_batch.
+AISNMEA_EXPORT void
+    aisnmea_batch_destroy (aisnmea_batch_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Also extract the value of tagblock key 'key' for every row. Must be
+//  called before any rows are added. Returns the key's column number
+//  for tagblockval ().
+AISNMEA_EXPORT size_t
+    aisnmea_batch_add_key (aisnmea_batch_t *self, const char *key);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Parse the 'len' bytes at 'buf' as whole lines (CR/LF or LF separated;
+//  the last needn't be terminated) and add a row for each AIS sentence.
+//  The bytes are copied, so 'buf' can be reused straight away. Returns
+//  the number of rows added.
+AISNMEA_EXPORT size_t
+    aisnmea_batch_add (aisnmea_batch_t *self, const char *buf, size_t len);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Remove all rows and text, keeping allocated memory and key columns.
+AISNMEA_EXPORT void
+    aisnmea_batch_clear (aisnmea_batch_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of rows.
+AISNMEA_EXPORT size_t
+    aisnmea_batch_size (aisnmea_batch_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of non-empty lines that failed to parse since the last clear.
+AISNMEA_EXPORT uint64_t
+    aisnmea_batch_errors (aisnmea_batch_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  The complete line a row was parsed from, not NUL-terminated.
+AISNMEA_EXPORT const char *
+    aisnmea_batch_line (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Length of the line a row was parsed from.
+AISNMEA_EXPORT size_t
+    aisnmea_batch_line_size (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Sentence identifier, e.g. "!AIVDM"; always six chars, not NUL-terminated.
+AISNMEA_EXPORT const char *
+    aisnmea_batch_head (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  How many fragments in the message sentence containing this one?
+AISNMEA_EXPORT size_t
+    aisnmea_batch_fragcount (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Which fragment number of the whole message is this one?
+AISNMEA_EXPORT size_t
+    aisnmea_batch_fragnum (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Multi-sentence message ID, or -1 if the column was empty.
+AISNMEA_EXPORT int
+    aisnmea_batch_messageid (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Radio channel the message was received on, or -1 if not given.
+AISNMEA_EXPORT char
+    aisnmea_batch_channel (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  The AIS payload, not NUL-terminated.
+AISNMEA_EXPORT const char *
+    aisnmea_batch_payload (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Length of the AIS payload.
+AISNMEA_EXPORT size_t
+    aisnmea_batch_payload_size (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of bits to ignore at the end of the payload.
+AISNMEA_EXPORT size_t
+    aisnmea_batch_fillbits (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  AIS message type, or -1 if the payload doesn't start with a valid one.
+AISNMEA_EXPORT int
+    aisnmea_batch_aismsgtype (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Receive time from the tagblock "c" key, as aisnmea_timestamp ().
+AISNMEA_EXPORT uint64_t
+    aisnmea_batch_timestamp (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Value of the tagblock key in column 'key' (see add_key), not
+//  NUL-terminated, or NULL if the row's line didn't have it.
+AISNMEA_EXPORT const char *
+    aisnmea_batch_tagblockval (aisnmea_batch_t *self, size_t row, size_t key);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Length of the tagblock value in column 'key', or 0 if not present.
+AISNMEA_EXPORT size_t
+    aisnmea_batch_tagblockval_size (aisnmea_batch_t *self, size_t row, size_t key);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Turn every row's payload into bits, most significant first, each row's
+//  starting on a byte boundary, in one contiguous buffer. Uses SSSE3 or
+//  AVX2 where the CPU has them. Returns the number of rows whose payloads
+//  had characters that aren't six-bit ASCII; they get no bits. Must be
+//  called again after adding more rows.
+AISNMEA_EXPORT size_t
+    aisnmea_batch_unarmour (aisnmea_batch_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  The bits of the row's payload, as unarmour () left them; the last
+//  byte is padded with zero bits. Rows follow one another in the one
+//  buffer, so bits (self, 0) is its start.
+AISNMEA_EXPORT const byte *
+    aisnmea_batch_bits (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of bits in the row's payload, less its fill bits, or 0 if it
+//  had characters that aren't six-bit ASCII.
+AISNMEA_EXPORT size_t
+    aisnmea_batch_bits_size (aisnmea_batch_t *self, size_t row);
+
+//  *** Draft method, for development use, may change without warning ***
+//  The array behind column 'name', for bindings that copy whole columns
+//  at once: fragcount, fragnum and fillbits hold uint8_t; messageid and
+//  msgtype int8_t (-1 where missing); channel char (-1 where missing);
+//  timestamp uint64_t; head uint32_t offsets; line and payload pairs of
+//  uint32_t, offset then size. Offsets count from the start of what was
+//  added since the batch was last cleared. Once unarmour has been
+//  called, bits is its buffer of bytes and bitspan pairs of uint32_t,
+//  offset into bits then size in bits. Valid until the next add, clear
+//  or destroy. Returns NULL for an unknown name or an empty batch.
+AISNMEA_EXPORT void *
+    aisnmea_batch_column (aisnmea_batch_t *self, const char *name);
+
+//  *** Draft method, for development use, may change without warning ***
+//  The pairs of uint32_t behind tagblock key column 'key' (see add_key),
+//  laid out as the payload column; both are 0 where a row's line didn't
+//  have the key. Returns NULL for an empty batch.
+AISNMEA_EXPORT void *
+    aisnmea_batch_key_column (aisnmea_batch_t *self, size_t key);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Describe the batch as an Apache Arrow struct array, one row per row,
+//  filling in 'array' and 'schema' (Arrow C Data Interface) for a
+//  consumer such as pyarrow, polars or DuckDB to import. Columns are
+//  head, fragcount, fragnum, messageid, channel, payload, fillbits,
+//  msgtype, timestamp (seconds, UTC), then one per add_key column named
+//  after its key; messageid, channel, msgtype, timestamp and the key
+//  columns are null where missing. Numeric columns and the string data
+//  are not copied, so the batch must not be added to, cleared or
+//  destroyed until the consumer has released both structs. Returns 0.
+AISNMEA_EXPORT int
+    aisnmea_batch_export (aisnmea_batch_t *self, struct ArrowArray *array, struct ArrowSchema *schema);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_batch_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+/*  =========================================================================
+    aisnmea_blockindex - Per-block message type and MMSI summary for skipping archive blocks
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_BLOCKINDEX_H_INCLUDED
+#define AISNMEA_BLOCKINDEX_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_blockindex.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Scan the NMEA file at 'path' in blocks of 'block_size' bytes.
+//  Returns NULL if the file can't be read.
+AISNMEA_EXPORT aisnmea_blockindex_t *
+    aisnmea_blockindex_build (const char *path, size_t block_size);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Load an index previously written by save. Returns NULL if the file
+//  can't be read or isn't a block index.
+AISNMEA_EXPORT aisnmea_blockindex_t *
+    aisnmea_blockindex_load (const char *path);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_blockindex.
+AISNMEA_EXPORT void
+    aisnmea_blockindex_destroy (aisnmea_blockindex_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Write the index to a sidecar file. Returns 0 on success, -1 on error.
+AISNMEA_EXPORT int
+    aisnmea_blockindex_save (aisnmea_blockindex_t *self, const char *path);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of blocks in the index.
+AISNMEA_EXPORT size_t
+    aisnmea_blockindex_size (aisnmea_blockindex_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Index of the first block at or after 'from' that may hold a message
+//  whose type has its bit set in 'types' (bit N for type N) and, unless
+//  'mmsi' is -1, that MMSI. Returns size () if there is none.
+AISNMEA_EXPORT size_t
+    aisnmea_blockindex_next (aisnmea_blockindex_t *self, size_t from, uint32_t types, int mmsi);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Byte offset of the first line starting in a block.
+AISNMEA_EXPORT uint64_t
+    aisnmea_blockindex_offset (aisnmea_blockindex_t *self, size_t block);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Length in bytes of the lines starting in a block. The last fragments
+//  of a message that starts near the end may be in the next block.
+AISNMEA_EXPORT uint64_t
+    aisnmea_blockindex_length (aisnmea_blockindex_t *self, size_t block);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Bitmap of the message types of first fragments in a block, bit N for
+//  type N. Bit 0 marks lines that didn't parse or had no valid type.
+AISNMEA_EXPORT uint32_t
+    aisnmea_blockindex_types (aisnmea_blockindex_t *self, size_t block);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Lowest MMSI in a block, or -1 if there were none.
+AISNMEA_EXPORT int
+    aisnmea_blockindex_mmsi_min (aisnmea_blockindex_t *self, size_t block);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Highest MMSI in a block, or -1 if there were none.
+AISNMEA_EXPORT int
+    aisnmea_blockindex_mmsi_max (aisnmea_blockindex_t *self, size_t block);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_blockindex_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+/*  =========================================================================
+    aisnmea_decimate - Per-vessel position report decimation
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_DECIMATE_H_INCLUDED
+#define AISNMEA_DECIMATE_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_decimate.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create a new decimator for up to 'capacity' vessels reporting at once,
+//  letting through at most one position per vessel every 'interval'
+//  seconds.
+AISNMEA_EXPORT aisnmea_decimate_t *
+    aisnmea_decimate_new (size_t capacity, uint32_t interval);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_decimate.
+AISNMEA_EXPORT void
+    aisnmea_decimate_destroy (aisnmea_decimate_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Returns true if msg is a position report less than 'interval' seconds
+//  after the last one let through for the same vessel, in which case
+//  callers should drop it. Otherwise returns false, and if msg is a
+//  position report records it as the vessel's latest.
+AISNMEA_EXPORT bool
+    aisnmea_decimate_check (aisnmea_decimate_t *self, aisnmea_t *msg);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of times check has said to drop a report.
+AISNMEA_EXPORT uint64_t
+    aisnmea_decimate_dropped (aisnmea_decimate_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Forget all vessels, and zero the dropped count.
+AISNMEA_EXPORT void
+    aisnmea_decimate_reset (aisnmea_decimate_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_decimate_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
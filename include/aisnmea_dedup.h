@@ -0,0 +1,65 @@
+/*  =========================================================================
+    aisnmea_dedup - Duplicate sentence suppression across redundant receivers
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_DEDUP_H_INCLUDED
+#define AISNMEA_DEDUP_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_dedup.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create a new deduplicator tracking up to 'capacity' distinct sentences
+//  at once, each remembered for 'window' time units (the same units as
+//  the timestamps later passed to check, e.g. seconds from tag block c:).
+AISNMEA_EXPORT aisnmea_dedup_t *
+    aisnmea_dedup_new (size_t capacity, uint64_t window);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_dedup.
+AISNMEA_EXPORT void
+    aisnmea_dedup_destroy (aisnmea_dedup_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Returns true if msg repeats a sentence already seen less than 'window'
+//  before 'timestamp', in which case callers should drop it. Otherwise
+//  records msg as seen at 'timestamp' and returns false.
+AISNMEA_EXPORT bool
+    aisnmea_dedup_check (aisnmea_dedup_t *self, aisnmea_t *msg, uint64_t timestamp);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of times check has reported a duplicate.
+AISNMEA_EXPORT uint64_t
+    aisnmea_dedup_dropped (aisnmea_dedup_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Forget all sentences seen, and zero the dropped count.
+AISNMEA_EXPORT void
+    aisnmea_dedup_reset (aisnmea_dedup_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_dedup_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
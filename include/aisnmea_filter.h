@@ -0,0 +1,86 @@
+/*  =========================================================================
+    aisnmea_filter - Compiled sentence filter checked before parsing
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_FILTER_H_INCLUDED
+#define AISNMEA_FILTER_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_filter.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create a filter that passes everything.
+AISNMEA_EXPORT aisnmea_filter_t *
+    aisnmea_filter_new (void);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_filter.
+AISNMEA_EXPORT void
+    aisnmea_filter_destroy (aisnmea_filter_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Pass messages of AIS message type 'type'.
+AISNMEA_EXPORT void
+    aisnmea_filter_add_type (aisnmea_filter_t *self, int type);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Pass sentences sent on radio channel 'channel', e.g. 'A'.
+AISNMEA_EXPORT void
+    aisnmea_filter_add_channel (aisnmea_filter_t *self, char channel);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Pass sentences whose head (talker and sentence) is 'head', e.g.
+//  "!AIVDM".
+AISNMEA_EXPORT void
+    aisnmea_filter_add_head (aisnmea_filter_t *self, const char *head);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Pass sentences whose tag block "s" (source) value is 'source'. Those
+//  with no source in their tag block don't pass.
+AISNMEA_EXPORT void
+    aisnmea_filter_add_source (aisnmea_filter_t *self, const char *source);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Pass messages from the vessel or station 'mmsi'.
+AISNMEA_EXPORT void
+    aisnmea_filter_add_mmsi (aisnmea_filter_t *self, uint32_t mmsi);
+
+//  *** Draft method, for development use, may change without warning ***
+//  If 'first_only' is true, pass only the first sentence of each message.
+AISNMEA_EXPORT void
+    aisnmea_filter_set_first_only (aisnmea_filter_t *self, bool first_only);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Returns true if the line passes the filter. Looks only at the fields
+//  the filter tests, without validating anything else or allocating;
+//  lines too malformed to find those fields in pass, to be turned away
+//  by the parser.
+AISNMEA_EXPORT bool
+    aisnmea_filter_check (aisnmea_filter_t *self, const char *nmea);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_filter_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,92 @@
+/*  =========================================================================
+    aisnmea_grid - Spatial grid index of vessel positions
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_GRID_H_INCLUDED
+#define AISNMEA_GRID_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_grid.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create a grid for up to 'capacity' vessels, with cells 'cell_size'
+//  degrees square. Queries are quickest when cells are about the size
+//  of a typical query area.
+AISNMEA_EXPORT aisnmea_grid_t *
+    aisnmea_grid_new (size_t capacity, double cell_size);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_grid.
+AISNMEA_EXPORT void
+    aisnmea_grid_destroy (aisnmea_grid_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Take in a message, given as its armoured payload, and if it is a
+//  position report (types 1, 2, 3, 18, 19, 27) move its vessel to the
+//  position given. Returns the message type if it moved a vessel, or -1
+//  if the message wasn't a position report, had no position, or was
+//  from a new vessel when the grid was full.
+AISNMEA_EXPORT int
+    aisnmea_grid_update (aisnmea_grid_t *self, const char *payload);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Put vessel 'mmsi' at 'lat', 'lon' (degrees), for positions from
+//  elsewhere. Returns 0, or -1 if the position is out of range or the
+//  grid is full.
+AISNMEA_EXPORT int
+    aisnmea_grid_set (aisnmea_grid_t *self, uint32_t mmsi, double lat, double lon);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Take vessel 'mmsi' out of the grid, if it is in it.
+AISNMEA_EXPORT void
+    aisnmea_grid_remove (aisnmea_grid_t *self, uint32_t mmsi);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Find the vessels inside a box, inclusive of its edges. If 'min_lon'
+//  is greater than 'max_lon' the box is taken to cross the 180th
+//  meridian. Returns the number found; get them with found ().
+AISNMEA_EXPORT size_t
+    aisnmea_grid_within (aisnmea_grid_t *self, double min_lat, double min_lon, double max_lat, double max_lon);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Find the vessels within 'radius' metres of 'lat', 'lon', by great
+//  circle distance. Returns the number found; get them with found ().
+AISNMEA_EXPORT size_t
+    aisnmea_grid_near (aisnmea_grid_t *self, double lat, double lon, double radius);
+
+//  *** Draft method, for development use, may change without warning ***
+//  MMSI of the 'index'th vessel found by the last query.
+AISNMEA_EXPORT uint32_t
+    aisnmea_grid_found (aisnmea_grid_t *self, size_t index);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of vessels in the grid.
+AISNMEA_EXPORT size_t
+    aisnmea_grid_size (aisnmea_grid_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_grid_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+/*  =========================================================================
+    aisnmea_groups - Reassembles tag block sentence groups and shares their tags
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_GROUPS_H_INCLUDED
+#define AISNMEA_GROUPS_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_groups.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create an assembler with room for 'slots' unfinished groups, each
+//  given up to 'max_age' lines to finish.
+AISNMEA_EXPORT aisnmea_groups_t *
+    aisnmea_groups_new (size_t slots, size_t max_age);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_groups.
+AISNMEA_EXPORT void
+    aisnmea_groups_destroy (aisnmea_groups_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Parse a line and take it in. Returns 0 if OK, -1 if the line isn't a
+//  valid AIS sentence, in which case it's dropped.
+AISNMEA_EXPORT int
+    aisnmea_groups_push (aisnmea_groups_t *self, const char *line);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Return the next sentence ready to go out, or NULL if there are none
+//  for now. Members of a group come out one after another. The sentence
+//  is owned by the assembler and is valid until the next call.
+AISNMEA_EXPORT aisnmea_t *
+    aisnmea_groups_next (aisnmea_groups_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Make every unfinished group ready to go out as it is, e.g. at the end
+//  of the input.
+AISNMEA_EXPORT void
+    aisnmea_groups_flush (aisnmea_groups_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of groups handed out before all their members came in.
+AISNMEA_EXPORT uint64_t
+    aisnmea_groups_incomplete (aisnmea_groups_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_groups_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,124 @@
+/*  =========================================================================
+    aisnmea_hist - Log-bucketed latency histogram for timing pipeline stages
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_HIST_H_INCLUDED
+#define AISNMEA_HIST_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_hist.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create a new, empty histogram. The name labels this histogram's rows
+//  when printed, e.g. "parse".
+AISNMEA_EXPORT aisnmea_hist_t *
+    aisnmea_hist_new (const char *name);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_hist.
+AISNMEA_EXPORT void
+    aisnmea_hist_destroy (aisnmea_hist_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Only time one in every 'every' events passed to start(); the rest cost
+//  a counter increment. Defaults to 1, i.e. time everything.
+AISNMEA_EXPORT void
+    aisnmea_hist_set_sampling (aisnmea_hist_t *self, size_t every);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Begin timing an event. Returns a start stamp to pass to stop(), or 0
+//  if this event was not picked by the sampler.
+AISNMEA_EXPORT uint64_t
+    aisnmea_hist_start (aisnmea_hist_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Finish timing an event started with start(), recording the elapsed
+//  time. Does nothing if start was 0.
+AISNMEA_EXPORT void
+    aisnmea_hist_stop (aisnmea_hist_t *self, uint64_t start);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Record a single latency value, in nanoseconds.
+AISNMEA_EXPORT void
+    aisnmea_hist_record (aisnmea_hist_t *self, uint64_t nanos);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Monotonic clock reading in nanoseconds, for callers doing their own
+//  timing. Never returns 0.
+AISNMEA_EXPORT uint64_t
+    aisnmea_hist_clock (void);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Forget all recorded values. The sampling rate is kept.
+AISNMEA_EXPORT void
+    aisnmea_hist_reset (aisnmea_hist_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  The name given at construction.
+AISNMEA_EXPORT const char *
+    aisnmea_hist_name (aisnmea_hist_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of values recorded.
+AISNMEA_EXPORT uint64_t
+    aisnmea_hist_count (aisnmea_hist_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Smallest value recorded, or 0 if none.
+AISNMEA_EXPORT uint64_t
+    aisnmea_hist_min (aisnmea_hist_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Largest value recorded, or 0 if none.
+AISNMEA_EXPORT uint64_t
+    aisnmea_hist_max (aisnmea_hist_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Mean of the values recorded, or 0 if none.
+AISNMEA_EXPORT double
+    aisnmea_hist_mean (aisnmea_hist_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Value at or below which the given fraction (0.0 - 1.0) of recorded
+//  values lie, e.g. 0.99 for P99. Reports the top of the bucket holding
+//  that value, so errs on the high side. Returns 0 if nothing recorded.
+AISNMEA_EXPORT uint64_t
+    aisnmea_hist_percentile (aisnmea_hist_t *self, double fraction);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Print one CSV summary row (name, count, min, p50, p90, p99, p999, max,
+//  mean) to the given file. If header is true, print a header row first.
+AISNMEA_EXPORT void
+    aisnmea_hist_print_csv (aisnmea_hist_t *self, FILE *file, bool header);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Print the same summary as print_csv as a single-line JSON object.
+AISNMEA_EXPORT void
+    aisnmea_hist_print_json (aisnmea_hist_t *self, FILE *file);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_hist_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,72 @@
+/*  =========================================================================
+    aisnmea_index - Sparse receive-time index for seeking into NMEA archives
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_INDEX_H_INCLUDED
+#define AISNMEA_INDEX_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_index.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Scan the NMEA file at 'path', recording an entry every 'every' lines.
+//  Returns NULL if the file can't be read.
+AISNMEA_EXPORT aisnmea_index_t *
+    aisnmea_index_build (const char *path, size_t every);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Load an index previously written by save. Returns NULL if the file
+//  can't be read or isn't an index.
+AISNMEA_EXPORT aisnmea_index_t *
+    aisnmea_index_load (const char *path);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_index.
+AISNMEA_EXPORT void
+    aisnmea_index_destroy (aisnmea_index_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Write the index to a sidecar file. Returns 0 on success, -1 on error.
+AISNMEA_EXPORT int
+    aisnmea_index_save (aisnmea_index_t *self, const char *path);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Byte offset in the archive at which to start reading to find every
+//  sentence received at or after 'time'. Nothing before the offset is
+//  that late, but lines after it may still be earlier (the archive is
+//  only roughly ordered), so readers should skip those.
+//  If nothing in the archive is that late, returns the archive size.
+AISNMEA_EXPORT uint64_t
+    aisnmea_index_seek (aisnmea_index_t *self, uint64_t time);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of entries in the index.
+AISNMEA_EXPORT size_t
+    aisnmea_index_size (aisnmea_index_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_index_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -66,10 +66,69 @@
 #ifdef AISNMEA_BUILD_DRAFT_API
 typedef struct _aisnmea_t aisnmea_t;
 #define AISNMEA_T_DEFINED
+typedef struct _aisnmea_hist_t aisnmea_hist_t;
+#define AISNMEA_HIST_T_DEFINED
+typedef struct _aisnmea_dedup_t aisnmea_dedup_t;
+#define AISNMEA_DEDUP_T_DEFINED
+typedef struct _aisnmea_merge_t aisnmea_merge_t;
+#define AISNMEA_MERGE_T_DEFINED
+typedef struct _aisnmea_index_t aisnmea_index_t;
+#define AISNMEA_INDEX_T_DEFINED
+typedef struct _aisnmea_blockindex_t aisnmea_blockindex_t;
+#define AISNMEA_BLOCKINDEX_T_DEFINED
+typedef struct _aisnmea_stream_t aisnmea_stream_t;
+#define AISNMEA_STREAM_T_DEFINED
+typedef struct _aisnmea_batch_t aisnmea_batch_t;
+#define AISNMEA_BATCH_T_DEFINED
+typedef struct _aisnmea_udp_t aisnmea_udp_t;
+#define AISNMEA_UDP_T_DEFINED
+typedef struct _aisnmea_server_t aisnmea_server_t;
+#define AISNMEA_SERVER_T_DEFINED
+typedef struct _aisnmea_reader_t aisnmea_reader_t;
+#define AISNMEA_READER_T_DEFINED
+typedef struct _aisnmea_groups_t aisnmea_groups_t;
+#define AISNMEA_GROUPS_T_DEFINED
+typedef struct _aisnmea_decimate_t aisnmea_decimate_t;
+#define AISNMEA_DECIMATE_T_DEFINED
+typedef struct _aisnmea_vessel_t aisnmea_vessel_t;
+#define AISNMEA_VESSEL_T_DEFINED
+typedef struct _aisnmea_vessels_t aisnmea_vessels_t;
+#define AISNMEA_VESSELS_T_DEFINED
+typedef struct _aisnmea_grid_t aisnmea_grid_t;
+#define AISNMEA_GRID_T_DEFINED
+typedef struct _aisnmea_filter_t aisnmea_filter_t;
+#define AISNMEA_FILTER_T_DEFINED
+typedef struct _aisnmea_partition_t aisnmea_partition_t;
+#define AISNMEA_PARTITION_T_DEFINED
+typedef struct _aisnmea_arena_t aisnmea_arena_t;
+#define AISNMEA_ARENA_T_DEFINED
+typedef struct _aisnmea_statics_t aisnmea_statics_t;
+#define AISNMEA_STATICS_T_DEFINED
 #endif // AISNMEA_BUILD_DRAFT_API
 
 
 //  Public classes, each with its own header file
+#ifdef AISNMEA_BUILD_DRAFT_API
+#include "aisnmea_hist.h"
+#include "aisnmea_dedup.h"
+#include "aisnmea_merge.h"
+#include "aisnmea_index.h"
+#include "aisnmea_blockindex.h"
+#include "aisnmea_stream.h"
+#include "aisnmea_batch.h"
+#include "aisnmea_udp.h"
+#include "aisnmea_server.h"
+#include "aisnmea_reader.h"
+#include "aisnmea_groups.h"
+#include "aisnmea_decimate.h"
+#include "aisnmea_vessel.h"
+#include "aisnmea_vessels.h"
+#include "aisnmea_grid.h"
+#include "aisnmea_filter.h"
+#include "aisnmea_partition.h"
+#include "aisnmea_arena.h"
+#include "aisnmea_statics.h"
+#endif // AISNMEA_BUILD_DRAFT_API
 
 #ifdef AISNMEA_BUILD_DRAFT_API
 //  Self test for private classes
@@ -0,0 +1,71 @@
+/*  =========================================================================
+    aisnmea_merge - Time-ordered merge of several NMEA archives
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_MERGE_H_INCLUDED
+#define AISNMEA_MERGE_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_merge.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create a new, empty merge, tolerating up to 'window' seconds of
+//  disorder within each input.
+AISNMEA_EXPORT aisnmea_merge_t *
+    aisnmea_merge_new (uint64_t window);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_merge.
+AISNMEA_EXPORT void
+    aisnmea_merge_destroy (aisnmea_merge_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Add an input file. Must be called before the first call to next.
+//  Returns 0 on success, or -1 if the file could not be opened.
+AISNMEA_EXPORT int
+    aisnmea_merge_add_file (aisnmea_merge_t *self, const char *path);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Return the next line in time order, or NULL when every input is
+//  exhausted. The line is owned by the merge, and is valid until the
+//  next call.
+AISNMEA_EXPORT const char *
+    aisnmea_merge_next (aisnmea_merge_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Time (in seconds) the last line returned by next was ordered by.
+AISNMEA_EXPORT uint64_t
+    aisnmea_merge_timestamp (aisnmea_merge_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Index (in order of add_file calls) of the input the last line
+//  returned by next came from.
+AISNMEA_EXPORT size_t
+    aisnmea_merge_source (aisnmea_merge_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_merge_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,94 @@
+/*  =========================================================================
+    aisnmea_partition - Writes lines out to files partitioned by a key
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_PARTITION_H_INCLUDED
+#define AISNMEA_PARTITION_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_partition.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+#define AISNMEA_PARTITION_TYPE 0             // By AIS message type, to "type-N.nmea"
+#define AISNMEA_PARTITION_SOURCE 1           // By tag block "s" source, to "source-S.nmea"
+#define AISNMEA_PARTITION_MMSI 2             // By MMSI hashed into 'buckets' buckets, to "mmsi-N.nmea"
+#define AISNMEA_PARTITION_HOUR 3             // By hour of the tag block "c" time, to "YYYY-MM-DDTHH.nmea"
+
+//  *** Draft method, for development use, may change without warning ***
+//  Create a partitioner writing into 'directory', which is created if
+//  need be, partitioning by 'scheme', one of the AISNMEA_PARTITION_*
+//  constants. 'buckets' is the number of MMSI buckets, and is only used
+//  by AISNMEA_PARTITION_MMSI. Files already there are overwritten when
+//  their partition is first written. Returns NULL if the directory
+//  can't be made.
+AISNMEA_EXPORT aisnmea_partition_t *
+    aisnmea_partition_new (const char *directory, int scheme, uint32_t buckets);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the partitioner, writing out everything still buffered first.
+AISNMEA_EXPORT void
+    aisnmea_partition_destroy (aisnmea_partition_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Hold at most 'max_open' files open at once. Defaults to 64. Must be
+//  set before the first write.
+AISNMEA_EXPORT void
+    aisnmea_partition_set_max_open (aisnmea_partition_t *self, size_t max_open);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Buffer up to 'size' bytes for each partition before handing it to the
+//  writer thread. Defaults to 256 KiB. Must be set before the first
+//  write.
+AISNMEA_EXPORT void
+    aisnmea_partition_set_buffer_size (aisnmea_partition_t *self, size_t size);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Add 'line', which 'msg' was parsed from, to its partition; a newline
+//  is added unless it ends in one. Lines whose key can't be found, or
+//  with a NULL 'msg' because they didn't parse, go to "unknown.nmea".
+//  Returns 0, or -1 if a write to any file has failed.
+AISNMEA_EXPORT int
+    aisnmea_partition_write (aisnmea_partition_t *self, aisnmea_t *msg, const char *line);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Hand every partition's buffer to the writer thread and wait until all
+//  of them are written. Returns 0, or -1 if a write to any file has
+//  failed.
+AISNMEA_EXPORT int
+    aisnmea_partition_flush (aisnmea_partition_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of partitions written to so far.
+AISNMEA_EXPORT size_t
+    aisnmea_partition_partitions (aisnmea_partition_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of lines written so far.
+AISNMEA_EXPORT uint64_t
+    aisnmea_partition_lines (aisnmea_partition_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_partition_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,84 @@
+/*  =========================================================================
+    aisnmea_reader - Reads archives in large line-aligned chunks with many reads in flight
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_READER_H_INCLUDED
+#define AISNMEA_READER_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_reader.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create a reader which reads 'chunk_size' bytes at a time, with up to
+//  'depth' chunks either in flight or held by the caller.
+AISNMEA_EXPORT aisnmea_reader_t *
+    aisnmea_reader_new (size_t chunk_size, size_t depth);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_reader.
+AISNMEA_EXPORT void
+    aisnmea_reader_destroy (aisnmea_reader_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Queue a file to be read after any added before it. Returns 0 if OK,
+//  -1 if the file can't be opened.
+AISNMEA_EXPORT int
+    aisnmea_reader_add (aisnmea_reader_t *self, const char *path);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Wait for the next chunk. A chunk ends just after a newline, unless it
+//  is the last of its file, and is followed by a null, so can be handled
+//  as a string. It stays valid until passed back to release, which the
+//  caller must do before 'depth' chunks are out at once. Returns NULL at
+//  the end of the input or on a read error; failed tells them apart.
+AISNMEA_EXPORT const char *
+    aisnmea_reader_next (aisnmea_reader_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  True if a read has failed, in which case next has returned or will
+//  return NULL before the end of the input.
+AISNMEA_EXPORT bool
+    aisnmea_reader_failed (aisnmea_reader_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Length of the chunk most recently returned by next.
+AISNMEA_EXPORT size_t
+    aisnmea_reader_size (aisnmea_reader_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Give a chunk back to the reader so its buffer can be reused. May be
+//  called in any order.
+AISNMEA_EXPORT void
+    aisnmea_reader_release (aisnmea_reader_t *self, const char *chunk);
+
+//  *** Draft method, for development use, may change without warning ***
+//  True if reads go through io_uring, false if they fell back to pread.
+AISNMEA_EXPORT bool
+    aisnmea_reader_uring (aisnmea_reader_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_reader_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,112 @@
+/*  =========================================================================
+    aisnmea_server - Event-driven TCP server for NMEA feeds from many receivers
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_SERVER_H_INCLUDED
+#define AISNMEA_SERVER_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_server.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  Called with each good line, without its line ending. 'source' is the
+//  index of the sending address, as used by the source accessors.
+typedef void (aisnmea_server_line_fn) (
+    const char *line, size_t source, void *arg);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Listen on 'address' (NULL for all interfaces) and 'port' (0 for any
+//  free port). Set 'reuseport' to let other servers listen on the same
+//  port. Returns NULL if the socket can't be set up.
+AISNMEA_EXPORT aisnmea_server_t *
+    aisnmea_server_new (const char *address, int port, bool reuseport);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_server.
+AISNMEA_EXPORT void
+    aisnmea_server_destroy (aisnmea_server_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  The port actually bound, useful after asking for port 0.
+AISNMEA_EXPORT int
+    aisnmea_server_port (aisnmea_server_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Set the function called with each good line.
+AISNMEA_EXPORT void
+    aisnmea_server_set_handler (aisnmea_server_t *self, aisnmea_server_line_fn *handler, void *arg);
+
+//  *** Draft method, for development use, may change without warning ***
+//  If true, lines are only checked with aisnmea_validate () rather than
+//  fully parsed. Defaults to false.
+AISNMEA_EXPORT void
+    aisnmea_server_set_fastpath (aisnmea_server_t *self, bool fastpath);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Wait up to 'timeout' msecs (-1 for ever) for activity, then deal with
+//  all of it: new connections, incoming data and hang-ups. Returns the
+//  number of good lines handled, or -1 on error.
+AISNMEA_EXPORT int
+    aisnmea_server_run (aisnmea_server_t *self, int timeout);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of currently open connections.
+AISNMEA_EXPORT size_t
+    aisnmea_server_connections (aisnmea_server_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of distinct source addresses seen.
+AISNMEA_EXPORT size_t
+    aisnmea_server_sources (aisnmea_server_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Address of a source, e.g. "192.0.2.1".
+AISNMEA_EXPORT const char *
+    aisnmea_server_source_name (aisnmea_server_t *self, size_t source);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Good lines received from a source.
+AISNMEA_EXPORT uint64_t
+    aisnmea_server_source_lines (aisnmea_server_t *self, size_t source);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Bad or overlong lines received from a source.
+AISNMEA_EXPORT uint64_t
+    aisnmea_server_source_errors (aisnmea_server_t *self, size_t source);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Add another server's per-source counters into this one's, matching
+//  sources by address.
+AISNMEA_EXPORT void
+    aisnmea_server_merge_sources (aisnmea_server_t *self, aisnmea_server_t *other);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Write the per-source counters as CSV, with a header row.
+AISNMEA_EXPORT void
+    aisnmea_server_print_sources (aisnmea_server_t *self, FILE *file);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_server_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,81 @@
+/*  =========================================================================
+    aisnmea_statics - Change detection for vessels' static and voyage messages
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_STATICS_H_INCLUDED
+#define AISNMEA_STATICS_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_statics.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create a cache for up to 'capacity' vessels. All memory is allocated
+//  up front.
+AISNMEA_EXPORT aisnmea_statics_t *
+    aisnmea_statics_new (size_t capacity);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_statics.
+AISNMEA_EXPORT void
+    aisnmea_statics_destroy (aisnmea_statics_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Check a message, given as its whole armoured payload (for type 5,
+//  the payloads of its fragments joined up). Returns 1 if it is a type
+//  5 or 24 message whose content differs from the last of its kind from
+//  the same vessel, or is the first; 0 if it is the same; or -1 if it
+//  isn't a static message or is too short to hold all its fields. The
+//  repeat indicator is ignored, so a copy relayed by a repeater is the
+//  same. A message from a new vessel when the cache is full is reported
+//  as changed, but not remembered.
+AISNMEA_EXPORT int
+    aisnmea_statics_check (aisnmea_statics_t *self, const char *payload);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Forget what vessel 'mmsi' last sent, so its next message of each kind
+//  is reported as changed; for instance when storing the last one failed.
+AISNMEA_EXPORT void
+    aisnmea_statics_forget (aisnmea_statics_t *self, uint32_t mmsi);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of vessels in the cache.
+AISNMEA_EXPORT size_t
+    aisnmea_statics_size (aisnmea_statics_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of messages check has found to be the same as last time.
+AISNMEA_EXPORT uint64_t
+    aisnmea_statics_unchanged (aisnmea_statics_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of messages from new vessels not remembered as the cache was
+//  full.
+AISNMEA_EXPORT uint64_t
+    aisnmea_statics_rejected (aisnmea_statics_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_statics_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+/*  =========================================================================
+    aisnmea_stream - Incremental AIS NMEA parser for unframed byte streams
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_STREAM_H_INCLUDED
+#define AISNMEA_STREAM_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_stream.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  Called with each complete sentence. 'msg' belongs to the stream and
+//  is overwritten by the next sentence, so dup it to keep it.
+typedef void (aisnmea_stream_handler_fn) (
+    aisnmea_t *msg, void *arg);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Create a new stream parser.
+AISNMEA_EXPORT aisnmea_stream_t *
+    aisnmea_stream_new (void);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_stream.
+AISNMEA_EXPORT void
+    aisnmea_stream_destroy (aisnmea_stream_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Parse the next 'len' bytes of the stream, calling 'handler' with
+//  'arg' for each AIS sentence completed. A sentence may be split over
+//  any number of calls. Returns the number of sentences handled.
+AISNMEA_EXPORT size_t
+    aisnmea_stream_feed (aisnmea_stream_t *self, const char *buf, size_t len, aisnmea_stream_handler_fn *handler, void *arg);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Drop any partial sentence, e.g. after reopening the port.
+AISNMEA_EXPORT void
+    aisnmea_stream_reset (aisnmea_stream_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of AIS sentences handled so far.
+AISNMEA_EXPORT uint64_t
+    aisnmea_stream_sentences (aisnmea_stream_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of malformed or badly checksummed sentences thrown away.
+AISNMEA_EXPORT uint64_t
+    aisnmea_stream_errors (aisnmea_stream_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of well-formed but non-AIS sentences (e.g. GPS) passed over.
+AISNMEA_EXPORT uint64_t
+    aisnmea_stream_skipped (aisnmea_stream_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_stream_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+/*  =========================================================================
+    aisnmea_udp - Batched UDP ingestion of NMEA datagrams
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_UDP_H_INCLUDED
+#define AISNMEA_UDP_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_udp.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Bind a UDP socket to 'address' (NULL for all interfaces) and 'port'
+//  (0 for any free port), with room to take in up to 'slots' datagrams
+//  per call. Returns NULL if the socket can't be set up.
+AISNMEA_EXPORT aisnmea_udp_t *
+    aisnmea_udp_new (const char *address, int port, size_t slots);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_udp.
+AISNMEA_EXPORT void
+    aisnmea_udp_destroy (aisnmea_udp_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  The port actually bound, useful after asking for port 0.
+AISNMEA_EXPORT int
+    aisnmea_udp_port (aisnmea_udp_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Wait up to 'timeout' msecs (-1 for ever) for datagrams, then take in
+//  every one waiting, up to the slot count, and add their lines to
+//  'batch'. Returns the number of datagrams received, 0 on timeout or
+//  -1 on error.
+AISNMEA_EXPORT int
+    aisnmea_udp_recv (aisnmea_udp_t *self, aisnmea_batch_t *batch, int timeout);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of datagrams received so far.
+AISNMEA_EXPORT uint64_t
+    aisnmea_udp_datagrams (aisnmea_udp_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of datagrams too big for a slot, whose tails were lost.
+AISNMEA_EXPORT uint64_t
+    aisnmea_udp_truncated (aisnmea_udp_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_udp_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
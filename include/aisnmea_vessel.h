@@ -0,0 +1,129 @@
+/*  =========================================================================
+    aisnmea_vessel - Snapshot of one vessel's latest state
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_VESSEL_H_INCLUDED
+#define AISNMEA_VESSEL_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_vessel.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create an empty snapshot.
+AISNMEA_EXPORT aisnmea_vessel_t *
+    aisnmea_vessel_new (void);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_vessel.
+AISNMEA_EXPORT void
+    aisnmea_vessel_destroy (aisnmea_vessel_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  The vessel's MMSI.
+AISNMEA_EXPORT uint32_t
+    aisnmea_vessel_mmsi (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Receive time of the latest position report, in seconds since the
+//  UNIX epoch, or 0 if there hasn't been one.
+AISNMEA_EXPORT uint64_t
+    aisnmea_vessel_position_time (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Latitude in degrees, north positive, or 91 if not known.
+AISNMEA_EXPORT double
+    aisnmea_vessel_lat (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Longitude in degrees, east positive, or 181 if not known.
+AISNMEA_EXPORT double
+    aisnmea_vessel_lon (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Speed over ground in knots, or -1 if not known.
+AISNMEA_EXPORT double
+    aisnmea_vessel_sog (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Course over ground in degrees, or -1 if not known.
+AISNMEA_EXPORT double
+    aisnmea_vessel_cog (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  True heading in degrees, or -1 if not known.
+AISNMEA_EXPORT int
+    aisnmea_vessel_heading (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Navigational status (0 under way using engine, 1 at anchor, ...), or
+//  15 if not known or not sent (class B).
+AISNMEA_EXPORT int
+    aisnmea_vessel_status (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Receive time of the latest static data (type 5, 19 or 24), or 0 if
+//  there hasn't been any.
+AISNMEA_EXPORT uint64_t
+    aisnmea_vessel_static_time (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Vessel name, or "" if not known.
+AISNMEA_EXPORT const char *
+    aisnmea_vessel_name (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Radio call sign, or "" if not known.
+AISNMEA_EXPORT const char *
+    aisnmea_vessel_callsign (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destination as entered by the crew, or "" if not known.
+AISNMEA_EXPORT const char *
+    aisnmea_vessel_destination (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Ship and cargo type code, or 0 if not known.
+AISNMEA_EXPORT int
+    aisnmea_vessel_shiptype (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  IMO number, or 0 if not known.
+AISNMEA_EXPORT uint32_t
+    aisnmea_vessel_imo (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Length overall in metres, or 0 if not known.
+AISNMEA_EXPORT int
+    aisnmea_vessel_length (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Beam in metres, or 0 if not known.
+AISNMEA_EXPORT int
+    aisnmea_vessel_beam (aisnmea_vessel_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_vessel_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
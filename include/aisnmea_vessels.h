@@ -0,0 +1,74 @@
+/*  =========================================================================
+    aisnmea_vessels - Latest-state cache of vessels keyed by MMSI, with lock-free reads
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+#ifndef AISNMEA_VESSELS_H_INCLUDED
+#define AISNMEA_VESSELS_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @warning THE FOLLOWING @INTERFACE BLOCK IS AUTO-GENERATED BY ZPROJECT
+//  @warning Please edit the model at "api/aisnmea_vessels.xml" to make changes.
+//  @interface
+//  This API is a draft, and may change without notice.
+#ifdef AISNMEA_BUILD_DRAFT_API
+//  *** Draft method, for development use, may change without warning ***
+//  Create a cache for up to 'capacity' vessels. All memory is allocated
+//  up front.
+AISNMEA_EXPORT aisnmea_vessels_t *
+    aisnmea_vessels_new (size_t capacity);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Destroy the aisnmea_vessels.
+AISNMEA_EXPORT void
+    aisnmea_vessels_destroy (aisnmea_vessels_t **self_p);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Take in a message, given as its whole armoured payload (for messages
+//  sent in several sentences, such as type 5, the payloads of all the
+//  fragments joined up) received at 'time'. Must only be called from
+//  one thread at a time. Returns the message type if it updated a
+//  vessel, or -1 if the message wasn't one we keep, was too short, or
+//  was from a new vessel when the cache was full.
+AISNMEA_EXPORT int
+    aisnmea_vessels_update (aisnmea_vessels_t *self, const char *payload, uint64_t time);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Copy what's known of vessel 'mmsi' into 'vessel'. Safe to call from
+//  any thread, concurrently with update. Returns false if the vessel
+//  hasn't been heard from.
+AISNMEA_EXPORT bool
+    aisnmea_vessels_lookup (aisnmea_vessels_t *self, uint32_t mmsi, aisnmea_vessel_t *vessel);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of vessels in the cache.
+AISNMEA_EXPORT size_t
+    aisnmea_vessels_size (aisnmea_vessels_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Number of messages from new vessels turned away as the cache was full.
+AISNMEA_EXPORT uint64_t
+    aisnmea_vessels_rejected (aisnmea_vessels_t *self);
+
+//  *** Draft method, for development use, may change without warning ***
+//  Self test of this class.
+AISNMEA_EXPORT void
+    aisnmea_vessels_test (bool verbose);
+
+#endif // AISNMEA_BUILD_DRAFT_API
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -33,6 +33,14 @@ struct _aisnmea_t {
     char *payload;
     size_t fillbits;
     size_t checksum;
+
+    // Lines it turns away aren't parsed; not owned, NULL for none
+    aisnmea_filter_t *filter;
+
+    // Set for copies made by dup_into, which live in an arena along with
+    // their strings, and hold the tagblock as "key\0val\0...\0" instead
+    bool in_arena;
+    const char *tagblock_packed;
 };
 
 
@@ -105,6 +113,12 @@ aisnmea_destroy (aisnmea_t **self_p)
     if (*self_p) {
         aisnmea_t *self = *self_p;
 
+        // The arena frees it along with everything else
+        if (self->in_arena) {
+            *self_p = NULL;
+            return;
+        }
+
         zstr_free (&self->head);
         zstr_free (&self->payload);
         
@@ -143,6 +157,20 @@ aisnmea_dup (aisnmea_t *self) {
             tb_val = (char *) zhash_next (self->tagblock_data);
         }
     }
+    else
+    if (self->tagblock_packed) {
+        res->tagblock_data = zhash_new();
+        assert (res->tagblock_data);
+        zhash_autofree (res->tagblock_data);
+
+        const char *tb_key = self->tagblock_packed;
+        while (*tb_key) {
+            const char *tb_val = tb_key + strlen (tb_key) + 1;
+            int rc = zhash_insert (res->tagblock_data, tb_key, (void *) tb_val);
+            assert (!rc);
+            tb_key = tb_val + strlen (tb_val) + 1;
+        }
+    }
 
     res->head      = strdup (self->head);
     res->fragcount = self->fragcount;
@@ -152,6 +180,75 @@ aisnmea_dup (aisnmea_t *self) {
     res->payload   = strdup (self->payload);
     res->fillbits  = self->fillbits;
     res->checksum  = self->checksum;
+    res->filter    = self->filter;
+
+    return res;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Copy into an arena, packing the struct and its strings together
+
+aisnmea_t *
+aisnmea_dup_into (aisnmea_t *self, aisnmea_arena_t *arena)
+{
+    assert (self);
+    assert (arena);
+    assert (self->head && self->payload);   // must hold a parsed sentence
+
+    size_t head_size = strlen (self->head) + 1;
+    size_t payload_size = strlen (self->payload) + 1;
+    size_t tagblock_size = 0;
+    if (self->tagblock_data) {
+        const char *tb_val = (const char *) zhash_first (self->tagblock_data);
+        while (tb_val) {
+            const char *tb_key = zhash_cursor (self->tagblock_data);
+            tagblock_size += strlen (tb_key) + strlen (tb_val) + 2;
+            tb_val = (const char *) zhash_next (self->tagblock_data);
+        }
+        tagblock_size++;    // closing empty key
+    }
+    else
+    if (self->tagblock_packed) {
+        const char *end = self->tagblock_packed;
+        while (*end) {
+            end += strlen (end) + 1;
+            end += strlen (end) + 1;
+        }
+        tagblock_size = end - self->tagblock_packed + 1;
+    }
+
+    aisnmea_t *res = (aisnmea_t *) aisnmea_arena_alloc (arena,
+        sizeof (aisnmea_t) + head_size + payload_size + tagblock_size);
+    assert (res);
+    *res = *self;
+    res->tagblock_data = NULL;
+    res->in_arena = true;
+
+    char *cur = (char *) (res + 1);
+    res->head = (char *) memcpy (cur, self->head, head_size);
+    cur += head_size;
+    res->payload = (char *) memcpy (cur, self->payload, payload_size);
+    cur += payload_size;
+
+    res->tagblock_packed = NULL;
+    if (self->tagblock_data) {
+        res->tagblock_packed = cur;
+        const char *tb_val = (const char *) zhash_first (self->tagblock_data);
+        while (tb_val) {
+            const char *tb_key = zhash_cursor (self->tagblock_data);
+            size_t key_size = strlen (tb_key) + 1;
+            size_t val_size = strlen (tb_val) + 1;
+            memcpy (cur, tb_key, key_size);
+            memcpy (cur + key_size, tb_val, val_size);
+            cur += key_size + val_size;
+            tb_val = (const char *) zhash_next (self->tagblock_data);
+        }
+        *cur = 0;
+    }
+    else
+    if (self->tagblock_packed)
+        res->tagblock_packed = (const char *) memcpy (cur, self->tagblock_packed, tagblock_size);
 
     return res;
 }
@@ -159,15 +256,25 @@ aisnmea_dup (aisnmea_t *self) {
 
 //  --------------------------------------------------------------------------
 //  Parse a full AIS NMEA line, and store its data in self.
-//  Returns 0 on succes, -1 on failure
+//  Returns 0 on succes, -1 on failure, 1 if the filter turned it away
 
 int
 aisnmea_parse (aisnmea_t *self, const char *nmea)
 {
     assert (self);
     assert (nmea);
+    assert (!self->in_arena);
     zhash_destroy (&self->tagblock_data);
 
+    // Turn away non-AIS lines before we start splitting and copying
+    int kind = aisnmea_classify (nmea);
+    if (kind != AISNMEA_KIND_AIS && kind != AISNMEA_KIND_AIS_OWN)
+        return -1;
+
+    // And those the caller doesn't want
+    if (self->filter && !aisnmea_filter_check (self->filter, nmea))
+        return 1;
+
     int ret = -1;  // assume failed unless succeeded
 
     zlist_t *outercols = s_delimstring_split (nmea, '\\');
@@ -183,6 +290,355 @@ aisnmea_parse (aisnmea_t *self, const char *nmea)
     return ret;
 }
 
+
+//  --------------------------------------------------------------------------
+//  Check lines against a filter before parsing them
+
+void
+aisnmea_set_filter (aisnmea_t *self, aisnmea_filter_t *filter)
+{
+    assert (self);
+    self->filter = filter;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Set self from the parts of a sentence that have already been split out
+//  and checksummed, e.g. by aisnmea_stream. 'tagblock' is the tagblock's
+//  "k:v,..." pairs without the checksum, or NULL if there wasn't one.
+//  Returns 0 on success, -1 if the tagblock pairs are malformed.
+
+int
+aisnmea_set_parsed (aisnmea_t *self, const char *tagblock, const char *head,
+                    size_t fragcount, size_t fragnum, int messageid, char channel,
+                    const char *payload, size_t fillbits, size_t checksum)
+{
+    assert (self);
+    assert (head);
+    assert (payload);
+    assert (!self->in_arena);
+    zhash_destroy (&self->tagblock_data);
+
+    if (tagblock) {
+        self->tagblock_data = zhash_new ();
+        assert (self->tagblock_data);
+        zhash_autofree (self->tagblock_data);
+
+        // Split a copy in place: each pair is "key:val", neither empty
+        char *pairs = strdup (tagblock);
+        assert (pairs);
+        char *pair = pairs;
+        int rc = 0;
+        while (pair && rc == 0) {
+            char *next = strchr (pair, ',');
+            if (next)
+                *next++ = 0;
+            char *colon = strchr (pair, ':');
+            if (!colon || colon == pair || !colon [1] || strchr (colon + 1, ':'))
+                rc = -1;
+            else {
+                *colon = 0;
+                rc = zhash_insert (self->tagblock_data, pair, colon + 1);
+            }
+            pair = next;
+        }
+        free (pairs);
+        if (rc) {
+            zhash_destroy (&self->tagblock_data);
+            return -1;
+        }
+    }
+
+    zstr_free (&self->head);
+    self->head = strdup (head);
+    self->fragcount = fragcount;
+    self->fragnum = fragnum;
+    self->messageid = messageid;
+    self->channel = channel;
+    zstr_free (&self->payload);
+    self->payload = strdup (payload);
+    self->fillbits = fillbits;
+    self->checksum = checksum;
+    return 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Classify a line from the first few bytes of its sentence.
+//    Standard sentences have a five-char address (talker + formatter),
+//    proprietary ones start "$P" and have a manufacturer-specific address.
+
+static bool
+s_is_addresschar (char ch)
+{
+    return ('A' <= ch && ch <= 'Z') || ('0' <= ch && ch <= '9');
+}
+
+int
+aisnmea_classify (const char *nmea)
+{
+    assert (nmea);
+    const char *cur = nmea;
+
+    // Skip any tagblock; an unterminated one is junk
+    if (*cur == '\\') {
+        cur = strchr (cur + 1, '\\');
+        if (!cur)
+            return AISNMEA_KIND_UNKNOWN;
+        ++cur;
+    }
+    else {
+        const char *ws = cur;
+        while (*ws == ' ' || *ws == '\t' || *ws == '\r' || *ws == '\n')
+            ++ws;
+        if (*ws == 0)
+            return AISNMEA_KIND_EMPTY;
+    }
+
+    if (*cur != '!' && *cur != '$')
+        return AISNMEA_KIND_UNKNOWN;
+
+    if (cur [1] == 'P' && s_is_addresschar (cur [2]))
+        return AISNMEA_KIND_PROPRIETARY;
+
+    // Stops at the terminating NUL on short lines
+    for (int i = 1; i <= 5; ++i)
+        if (!s_is_addresschar (cur [i]))
+            return AISNMEA_KIND_UNKNOWN;
+    if (cur [6] != ',' && cur [6] != '*')
+        return AISNMEA_KIND_UNKNOWN;
+
+    if (cur [3] == 'V' && cur [4] == 'D') {
+        if (cur [5] == 'M')
+            return AISNMEA_KIND_AIS;
+        if (cur [5] == 'O')
+            return AISNMEA_KIND_AIS_OWN;
+    }
+    return AISNMEA_KIND_NMEA;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Checksum-only validation
+
+//  Two hex digits as a number, or -1 if they aren't
+static int
+s_hexpair (const char *str)
+{
+    int res = 0;
+    for (int i = 0; i < 2; ++i) {
+        char ch = str [i];
+        res <<= 4;
+        if ('0' <= ch && ch <= '9')
+            res |= ch - '0';
+        else
+        if ('A' <= ch && ch <= 'F')
+            res |= ch - 'A' + 10;
+        else
+        if ('a' <= ch && ch <= 'f')
+            res |= ch - 'a' + 10;
+        else
+            return -1;   // including the terminating NUL
+    }
+    return res;
+}
+
+bool
+aisnmea_validate (const char *nmea)
+{
+    assert (nmea);
+    int kind = aisnmea_classify (nmea);
+    if (kind != AISNMEA_KIND_AIS && kind != AISNMEA_KIND_AIS_OWN)
+        return false;
+
+    // classify () has checked the tagblock is closed and the sentence
+    // starts straight after it
+    const char *cur = nmea;
+    int sum = 0;
+    if (*cur == '\\') {
+        for (++cur; *cur != '*' && *cur != '\\'; ++cur)
+            sum ^= *cur;
+        if (*cur != '*' || s_hexpair (cur + 1) != sum || cur [3] != '\\')
+            return false;
+        cur += 4;
+        sum = 0;
+    }
+
+    for (++cur; *cur && *cur != '*'; ++cur)
+        sum ^= *cur;
+    if (*cur != '*' || s_hexpair (cur + 1) != sum)
+        return false;
+    return cur [3] == 0 || cur [3] == '\r' || cur [3] == '\n';
+}
+
+
+
+//  --------------------------------------------------------------------------
+//  Encoding back to text
+
+//  Output cursor for encode (). Writes stop at the end of the buffer but
+//  the length keeps counting, so running out of room is checked once.
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t length;
+    int sum;        // of everything put since it was last zeroed
+} s_writer_t;
+
+static inline void
+s_put_char (s_writer_t *w, char ch)
+{
+    if (w->length < w->size)
+        w->buffer [w->length] = ch;
+    w->length += 1;
+    w->sum ^= ch;
+}
+
+static inline void
+s_put_str (s_writer_t *w, const char *str)
+{
+    while (*str)
+        s_put_char (w, *str++);
+}
+
+static inline void
+s_put_uint (s_writer_t *w, size_t value)
+{
+    char digits [24];
+    size_t count = 0;
+    do {
+        digits [count++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (count)
+        s_put_char (w, digits [--count]);
+}
+
+//  '*' and the checksum so far, as two hex digits
+static inline void
+s_put_checksum (s_writer_t *w)
+{
+    static const char hex [] = "0123456789ABCDEF";
+    int sum = w->sum;
+    s_put_char (w, '*');
+    s_put_char (w, hex [(sum >> 4) & 0xF]);
+    s_put_char (w, hex [sum & 0xF]);
+}
+
+int
+aisnmea_encode (aisnmea_t *self, const char *tagblock, char *buffer, size_t size)
+{
+    assert (self);
+    assert (self->head && self->payload);   // must hold a parsed sentence
+    assert (buffer);
+
+    s_writer_t w = { buffer, size, 0, 0 };
+    if (tagblock) {
+        s_put_char (&w, '\\');
+        w.sum = 0;
+        s_put_str (&w, tagblock);
+        s_put_checksum (&w);
+        s_put_char (&w, '\\');
+    }
+
+    // The checksum covers everything between the '!' and the '*'
+    s_put_char (&w, self->head [0]);
+    w.sum = 0;
+    s_put_str (&w, self->head + 1);
+    s_put_char (&w, ',');
+    s_put_uint (&w, self->fragcount);
+    s_put_char (&w, ',');
+    s_put_uint (&w, self->fragnum);
+    s_put_char (&w, ',');
+    if (self->messageid >= 0)
+        s_put_uint (&w, (size_t) self->messageid);
+    s_put_char (&w, ',');
+    if (self->channel != -1 && self->channel)
+        s_put_char (&w, self->channel);
+    s_put_char (&w, ',');
+    s_put_str (&w, self->payload);
+    s_put_char (&w, ',');
+    s_put_uint (&w, self->fillbits);
+    s_put_checksum (&w);
+
+    if (w.length >= size)
+        return -1;      // no room for the NUL
+    buffer [w.length] = 0;
+    return (int) w.length;
+}
+
+
+//  Payload characters per sentence: 82 chars, less the framing of a
+//  "!AIVDM,n,m,s,c," sentence with ",f*hh\r\n" on the end
+#define MAX_PAYLOAD_CHARS 60
+
+int
+aisnmea_encode_payload (const char *head, char channel, int messageid,
+                        const char *tagblock, const byte *bits, size_t bit_count,
+                        char *buffer, size_t size)
+{
+    assert (head && head [0]);
+    assert (messageid >= -1 && messageid <= 9);
+    assert (bits || !bit_count);
+    assert (buffer);
+
+    size_t chars = (bit_count + 5) / 6;
+    size_t fragcount = chars ? (chars + MAX_PAYLOAD_CHARS - 1) / MAX_PAYLOAD_CHARS : 1;
+    if (fragcount > 9)
+        return -1;      // fragment numbers are a single digit
+
+    s_writer_t w = { buffer, size, 0, 0 };
+    size_t bit = 0;
+    for (size_t fragnum = 1; fragnum <= fragcount; ++fragnum) {
+        if (tagblock && fragnum == 1) {
+            s_put_char (&w, '\\');
+            w.sum = 0;
+            s_put_str (&w, tagblock);
+            s_put_checksum (&w);
+            s_put_char (&w, '\\');
+        }
+        s_put_char (&w, head [0]);
+        w.sum = 0;
+        s_put_str (&w, head + 1);
+        s_put_char (&w, ',');
+        s_put_char (&w, (char) ('0' + fragcount));
+        s_put_char (&w, ',');
+        s_put_char (&w, (char) ('0' + fragnum));
+        s_put_char (&w, ',');
+        if (messageid >= 0)
+            s_put_char (&w, (char) ('0' + messageid));
+        s_put_char (&w, ',');
+        if (channel)
+            s_put_char (&w, channel);
+        s_put_char (&w, ',');
+
+        // Armour six bits at a time, padding the very last with zeros
+        size_t end = bit + MAX_PAYLOAD_CHARS * 6;
+        if (end > bit_count)
+            end = bit_count;
+        for (; bit < end; bit += 6) {
+            int value = 0;
+            for (size_t i = bit; i < bit + 6; ++i) {
+                value <<= 1;
+                if (i < bit_count)
+                    value |= (bits [i >> 3] >> (7 - (i & 7))) & 1;
+            }
+            s_put_char (&w, (char) (value < 40 ? value + 48 : value + 56));
+        }
+        size_t fillbits = fragnum == fragcount ? (6 - bit_count % 6) % 6 : 0;
+        bit = end;
+
+        s_put_char (&w, ',');
+        s_put_char (&w, (char) ('0' + fillbits));
+        s_put_checksum (&w);
+        s_put_char (&w, '\n');
+    }
+
+    if (w.length >= size)
+        return -1;
+    buffer [w.length] = 0;
+    return (int) w.length;
+}
     
 //  --------------------------------------------------------------------------
 //  AIS message type mapping to first payload character
@@ -553,19 +1009,135 @@ int
 aisnmea_aismsgtype (aisnmea_t *self)
 {
     assert (self);
-    assert (strlen (self->payload));
+    // An empty payload gives its terminating null, which maps to no type
     return s_ais_msgtype_fromchar (self->payload[0]);
 }
 
+//  De-armour one payload character to its six bits, or -1 if it's invalid
+static int
+s_sixbit_fromchar (int ch)
+{
+    if (ch < '0' || ch > 'w' || (ch > 'W' && ch < '`'))
+        return -1;
+    ch -= '0';
+    return ch > 40 ? ch - 8 : ch;
+}
+
+int
+aisnmea_mmsi (aisnmea_t *self)
+{
+    assert (self);
+    // Only the first fragment carries the message header
+    if (self->fragnum != 1)
+        return -1;
+
+    // MMSI is bits 8-37, i.e. the low 4 bits of char 1 up to char 6
+    uint64_t res = 0;
+    for (int i = 0; i < 7; ++i) {
+        int bits = s_sixbit_fromchar (self->payload [i]);   // stops at '\0'
+        if (bits < 0)
+            return -1;
+        res = (res << 6) | bits;
+    }
+    // 42 bits read; drop the trailing 4 and the leading 8
+    return (int) ((res >> 4) & 0x3FFFFFFF);
+}
+
+//  Read 'width' bits (at most 59) from 'start' bits into a payload of
+//  'size' chars. Returns -1 if they run off the end or into a bad char.
+//  Any wider, and a field starting late in a char can span enough chars
+//  to push its own top bits out of the 64-bit accumulator.
+
+int64_t
+aisnmea_payload_bits (const char *payload, size_t size, size_t start, size_t width)
+{
+    assert (payload);
+    assert (width && width <= 59);
+    size_t end = start + width;
+    if (end > size * 6)
+        return -1;
+
+    uint64_t res = 0;
+    size_t first = start / 6;
+    size_t last = (end - 1) / 6;
+    for (size_t i = first; i <= last; ++i) {
+        int bits = s_sixbit_fromchar (payload [i]);
+        if (bits < 0)
+            return -1;
+        res = (res << 6) | (uint64_t) bits;
+    }
+    // Drop the bits past the end of the field, then those before it
+    res >>= (last + 1) * 6 - end;
+    return (int64_t) (res & ((1ULL << width) - 1));
+}
+
 const char *
 aisnmea_tagblockval (aisnmea_t *self, const char *key)
 {
     assert (self);
+    if (self->tagblock_packed) {
+        const char *tb_key = self->tagblock_packed;
+        while (*tb_key) {
+            const char *tb_val = tb_key + strlen (tb_key) + 1;
+            if (streq (tb_key, key))
+                return tb_val;
+            tb_key = tb_val + strlen (tb_val) + 1;
+        }
+        return NULL;
+    }
     if (!self->tagblock_data)
         return NULL;
     return (const char *) zhash_lookup (self->tagblock_data, key);
 }
 
+void
+aisnmea_set_tagblockval (aisnmea_t *self, const char *key, const char *value)
+{
+    assert (self);
+    assert (key);
+    assert (!self->in_arena);
+    if (!value) {
+        if (self->tagblock_data)
+            zhash_delete (self->tagblock_data, key);
+        return;
+    }
+    if (!self->tagblock_data) {
+        self->tagblock_data = zhash_new ();
+        assert (self->tagblock_data);
+        zhash_autofree (self->tagblock_data);
+    }
+    // NB autofree means the value is copied
+    zhash_update (self->tagblock_data, key, (void *) value);
+}
+
+zhash_t *
+aisnmea_tagblock (aisnmea_t *self)
+{
+    assert (self);
+    return self->tagblock_data;
+}
+
+//  Anything past this must be in milliseconds (it's the year 5138 in seconds)
+#define MAX_SECONDS_TIMESTAMP 100000000000ULL
+
+uint64_t
+aisnmea_timestamp (aisnmea_t *self)
+{
+    assert (self);
+    const char *c_str = aisnmea_tagblockval (self, "c");
+    if (!c_str)
+        return 0;
+
+    char *end;
+    errno = 0;
+    uint64_t res = strtoull (c_str, &end, 10);
+    if (errno || *end)
+        return 0;
+    if (res > MAX_SECONDS_TIMESTAMP)
+        res /= 1000;
+    return res;
+}
+
 
 //  --------------------------------------------------------------------------
 //  Self test of this class
@@ -678,6 +1250,50 @@ aisnmea_test (bool verbose)
         log ("### DID s_parse_tagblocks () tests");
 
     
+    // -- sentence classification
+
+    assert (aisnmea_classify ("") == AISNMEA_KIND_EMPTY);
+    assert (aisnmea_classify (" \t\r") == AISNMEA_KIND_EMPTY);
+    assert (aisnmea_classify ("!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13")
+            == AISNMEA_KIND_AIS);
+    assert (aisnmea_classify ("!BSVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13")
+            == AISNMEA_KIND_AIS);
+    assert (aisnmea_classify ("\\g:1-2-73874,n:157036,s:r003669945,c:1241544035*4A"
+                              "\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13")
+            == AISNMEA_KIND_AIS);
+    assert (aisnmea_classify ("!AIVDO,1,1,,,B39i>1000nTu;gQAlBj:wwS5kP06,0*5D")
+            == AISNMEA_KIND_AIS_OWN);
+    assert (aisnmea_classify ("$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A")
+            == AISNMEA_KIND_NMEA);
+    assert (aisnmea_classify ("\\c:1241544035*7A\\$GPZDA,201530.00,04,07,2002,00,00*60")
+            == AISNMEA_KIND_NMEA);
+    assert (aisnmea_classify ("$PGHP,1,2017,3,1,9,52,26,450,219,,2190047,'1,0*2A")
+            == AISNMEA_KIND_PROPRIETARY);
+    assert (aisnmea_classify ("!AIVD") == AISNMEA_KIND_UNKNOWN);
+    assert (aisnmea_classify ("!AIVDMX,1") == AISNMEA_KIND_UNKNOWN);
+    assert (aisnmea_classify ("\\g:1-2-73874!AIVDM,1,1") == AISNMEA_KIND_UNKNOWN);
+    assert (aisnmea_classify ("asdfasdfasdf") == AISNMEA_KIND_UNKNOWN);
+
+    // -- checksum-only validation
+
+    assert ( aisnmea_validate ("!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13"));
+    assert ( aisnmea_validate ("!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13\r\n"));
+    assert ( aisnmea_validate ("\\g:1-2-73874,n:157036,s:r003669945,c:1241544035*4A"
+                               "\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13"));
+    assert (!aisnmea_validate ("!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*14"));
+    assert (!aisnmea_validate ("!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*1"));
+    assert (!aisnmea_validate ("!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13x"));
+    assert (!aisnmea_validate ("!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0"));
+    assert (!aisnmea_validate ("\\g:1-2-73874,n:157036,s:r003669945,c:1241544035*4B"
+                               "\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13"));
+    assert (!aisnmea_validate ("\\g:1-2-73874\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13"));
+    assert (!aisnmea_validate ("$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A"));
+    assert (!aisnmea_validate (""));
+
+    if (verbose)
+        log ("### DID CLASSIFY TESTS");
+
+
     // -- nmea with tagblock
 
     const char *nmea_example_1 =
@@ -701,6 +1317,7 @@ aisnmea_test (bool verbose)
                    
     assert (streq (aisnmea_tagblockval (msg1, "c"),
                    "1241544035"));
+    assert (aisnmea_timestamp (msg1) == 1241544035);
     
     // core
     
@@ -713,6 +1330,7 @@ aisnmea_test (bool verbose)
     assert (   0 == aisnmea_fillbits (msg1));
     assert (0x13 == aisnmea_checksum (msg1));
     assert (   1 == aisnmea_aismsgtype (msg1));
+    assert (367078250 == aisnmea_mmsi (msg1));
     
     aisnmea_destroy (&msg1);
 
@@ -742,12 +1360,177 @@ aisnmea_test (bool verbose)
     assert (0 == aisnmea_fillbits (msg2));
     assert (0x3E == aisnmea_checksum (msg2));
     assert (5 == aisnmea_aismsgtype (msg2));
+    assert (369190000 == aisnmea_mmsi (msg2));
+    assert (0 == aisnmea_timestamp (msg2));  // no tagblock
+
+    // MMSI needs a first fragment with enough payload
+    errm2 = aisnmea_parse (msg2, "!AIVDM,2,2,3,B,1@0000000000000,2*55");
+    assert (!errm2);
+    assert (aisnmea_mmsi (msg2) == -1);
+    errm2 = aisnmea_parse (msg2, "!AIVDM,1,1,,A,E>jHC6,0*0A");
+    assert (!errm2);
+    assert (aisnmea_mmsi (msg2) == -1);
+    errm2 = aisnmea_parse (msg2, "!AIVDM,1,1,,A,E>jHC6000000,0*0A");
+    assert (!errm2);
+    assert (aisnmea_mmsi (msg2) == 992351000);
+
+    // A sentence can parse with nothing in its payload field
+    errm2 = aisnmea_parse (msg2, "!AIVDM,1,1,,A,,0*26");
+    assert (!errm2);
+    assert (aisnmea_aismsgtype (msg2) == -1);
+    assert (aisnmea_mmsi (msg2) == -1);
+
+    // Raw payload bits, as used to decode message bodies
+    const char *payload = "177KQJ5000G?tO`K>RA1wUbN0TKH";
+    assert (aisnmea_payload_bits (payload, strlen (payload), 0, 6) == 1);
+    assert (aisnmea_payload_bits (payload, strlen (payload), 8, 30) == 477553000);
+    assert (aisnmea_payload_bits (payload, strlen (payload), 162, 6) == 24);
+    assert (aisnmea_payload_bits (payload, strlen (payload), 163, 6) == -1);
+    assert (aisnmea_payload_bits ("1 ", 2, 0, 12) == -1);
+    // The widest field, starting as late in a char as one can
+    assert (aisnmea_payload_bits (payload, strlen (payload), 5, 59)
+        == (aisnmea_payload_bits (payload, strlen (payload), 5, 29) << 30
+            | aisnmea_payload_bits (payload, strlen (payload), 34, 30)));
+
+    // Millisecond and junk receive times
+    errm2 = aisnmea_parse (msg2, "\\c:1241544035123*6C"
+                                 "\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13");
+    assert (!errm2);
+    assert (aisnmea_timestamp (msg2) == 1241544035);
+    errm2 = aisnmea_parse (msg2, "\\c:12415x*12"
+                                 "\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13");
+    assert (!errm2);
+    assert (aisnmea_timestamp (msg2) == 0);
+
+    // Setting tags, with and without a tagblock to start with
+    aisnmea_set_tagblockval (msg2, "c", "1241544035");
+    assert (aisnmea_timestamp (msg2) == 1241544035);
+    aisnmea_set_tagblockval (msg2, "c", NULL);
+    assert (aisnmea_tagblockval (msg2, "c") == NULL);
+    errm2 = aisnmea_parse (msg2, "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13");
+    assert (!errm2);
+    aisnmea_set_tagblockval (msg2, "s", NULL);
+    aisnmea_set_tagblockval (msg2, "s", "r003669945");
+    assert (streq (aisnmea_tagblockval (msg2, "s"), "r003669945"));
 
     aisnmea_destroy (&msg2);
 
     if (verbose)
         log ("### DID FULL PARSE WITHOUT TAGBLOCK TESTS");
 
+
+    // -- encoding
+
+    const char *encode_examples [] = {
+        "\\g:1-2-73874,n:157036,s:r003669945,c:1241544035*4A"
+        "\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13",
+        "!AIVDM,2,1,3,B,55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53,0*3E",
+        "!AIVDM,2,2,3,B,1@0000000000000,2*55",
+        "!AIVDO,1,1,,,B5N4cJ`005Jrek0H@9n`DW5608EP,0*20",
+    };
+    const char *encode_tagblocks [] = {
+        "g:1-2-73874,n:157036,s:r003669945,c:1241544035", NULL, NULL, NULL
+    };
+    char encoded [128];
+    aisnmea_t *enc = aisnmea_new (NULL);
+    assert (enc);
+    for (size_t i = 0; i < sizeof (encode_examples) / sizeof (encode_examples [0]); ++i) {
+        int rc = aisnmea_parse (enc, encode_examples [i]);
+        assert (!rc);
+        int length = aisnmea_encode (enc, encode_tagblocks [i], encoded, sizeof (encoded));
+        assert (length == (int) strlen (encode_examples [i]));
+        assert (streq (encoded, encode_examples [i]));
+
+        // Too small by any amount, including just the NUL
+        for (size_t size = 0; size <= (size_t) length; ++size)
+            assert (aisnmea_encode (enc, encode_tagblocks [i], encoded, size) == -1);
+    }
+
+    // New tags get their own checksum, and the result parses
+    int rc = aisnmea_parse (enc, encode_examples [2]);
+    assert (!rc);
+    int length = aisnmea_encode (enc, "s:fwd1,c:1241544035", encoded, sizeof (encoded));
+    assert (length > 0);
+    assert (aisnmea_validate (encoded));
+    rc = aisnmea_parse (enc, encoded);
+    assert (!rc);
+    assert (streq (aisnmea_tagblockval (enc, "s"), "fwd1"));
+    assert (aisnmea_timestamp (enc) == 1241544035);
+    assert (aisnmea_fragnum (enc) == 2);
+    assert (aisnmea_messageid (enc) == 3);
+    assert (aisnmea_fillbits (enc) == 2);
+
+    // Payload encoding: de-armour a known payload to bits, and check it
+    // comes back as the same sentence
+    const char *armoured = "177KQJ5000G?tO`K>RA1wUbN0TKH";
+    byte bits [64];
+    memset (bits, 0, sizeof (bits));
+    size_t bit_count = 0;
+    for (const char *ch = armoured; *ch; ++ch) {
+        int value = s_sixbit_fromchar (*ch);
+        assert (value >= 0);
+        for (int i = 5; i >= 0; --i, ++bit_count)
+            if (value & (1 << i))
+                bits [bit_count >> 3] |= 0x80 >> (bit_count & 7);
+    }
+    length = aisnmea_encode_payload ("!AIVDM", 'B', -1, NULL, bits, bit_count,
+                                     encoded, sizeof (encoded));
+    assert (length > 0);
+    assert (streq (encoded, "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C\n"));
+    assert (aisnmea_encode_payload ("!AIVDM", 'B', -1, NULL, bits, bit_count,
+                                    encoded, (size_t) length) == -1);
+
+    // Odd bit counts get fill bits
+    length = aisnmea_encode_payload ("!AIVDM", 'A', -1, "c:1241544035", bits, 38,
+                                     encoded, sizeof (encoded));
+    assert (length > 0);
+    assert (encoded [length - 1] == '\n');
+    encoded [length - 1] = 0;
+    rc = aisnmea_parse (enc, encoded);
+    assert (!rc);
+    assert (streq (aisnmea_payload (enc), "177KQJ0"));
+    assert (aisnmea_fillbits (enc) == 4);
+    assert (aisnmea_timestamp (enc) == 1241544035);
+
+    // A long message splits into several sentences, none over 82 chars
+    byte long_bits [512];
+    for (size_t i = 0; i < sizeof (long_bits); ++i)
+        long_bits [i] = (byte) (i * 37);
+    char sentences [512];
+    length = aisnmea_encode_payload ("!AIVDM", 'B', 7, "s:test", long_bits, 1000,
+                                     sentences, sizeof (sentences));
+    assert (length > 0 && (size_t) length == strlen (sentences));
+    size_t payload_chars = 0;
+    size_t fragnum = 0;
+    char *line = sentences;
+    while (*line) {
+        char *eol = strchr (line, '\n');
+        assert (eol);
+        *eol = 0;
+        rc = aisnmea_parse (enc, line);
+        assert (!rc);
+        ++fragnum;
+        assert (aisnmea_fragcount (enc) == 3);
+        assert (aisnmea_fragnum (enc) == fragnum);
+        assert (aisnmea_messageid (enc) == 7);
+        assert (aisnmea_channel (enc) == 'B');
+        assert (aisnmea_fillbits (enc) == (fragnum == 3 ? 2 : 0));
+        assert ((aisnmea_tagblockval (enc, "s") != NULL) == (fragnum == 1));
+        const char *sentence = strchr (line + 1, '\\') ? strchr (line + 1, '\\') + 1 : line;
+        assert (strlen (sentence) + 2 <= 82);
+        payload_chars += strlen (aisnmea_payload (enc));
+        line = eol + 1;
+    }
+    assert (fragnum == 3);
+    assert (payload_chars == 167);
+    // Ten sentences' worth is too many
+    assert (aisnmea_encode_payload ("!AIVDM", 'B', 7, NULL, long_bits, 9 * 360 + 1,
+                                    sentences, sizeof (sentences)) == -1);
+    aisnmea_destroy (&enc);
+
+    if (verbose)
+        log ("### DID ENCODING TESTS");
+
     
     // -- duff nmea
 
@@ -786,6 +1569,10 @@ aisnmea_test (bool verbose)
                           "PDhh000000001S;AJ::4A80?4i@E53,0*8E");
     assert (!badtry);
 
+    // Parser turns non-AIS sentences away even with good checksums
+    badtry = aisnmea_new ("$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A");
+    assert (!badtry);
+
 
     // -- dup ctr
     {
@@ -850,7 +1637,41 @@ aisnmea_test (bool verbose)
         aisnmea_destroy (&m4);
     }
 
-    
+
+    // -- Filtered parsing
+
+    {
+        aisnmea_filter_t *filter = aisnmea_filter_new ();
+        aisnmea_filter_add_type (filter, 18);
+        aisnmea_t *m5 = aisnmea_new (NULL);
+        aisnmea_set_filter (m5, filter);
+
+        // Turned away, told apart from parse failures
+        int rc = aisnmea_parse (m5, "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C");
+        assert (rc == 1);
+        rc = aisnmea_parse (m5, "!AIVDO,1,1,,,B5N4cJ`005Jrek0H@9n`DW5608EP,0*21");
+        assert (rc == -1);
+        rc = aisnmea_parse (m5, "$GPGGA,1,2*00");
+        assert (rc == -1);
+
+        rc = aisnmea_parse (m5, "!AIVDO,1,1,,,B5N4cJ`005Jrek0H@9n`DW5608EP,0*20");
+        assert (rc == 0);
+        assert (aisnmea_aismsgtype (m5) == 18);
+
+        // Copies share the filter
+        aisnmea_t *m6 = aisnmea_dup (m5);
+        rc = aisnmea_parse (m6, "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C");
+        assert (rc == 1);
+
+        aisnmea_set_filter (m5, NULL);
+        rc = aisnmea_parse (m5, "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C");
+        assert (rc == 0);
+
+        aisnmea_destroy (&m6);
+        aisnmea_destroy (&m5);
+        aisnmea_filter_destroy (&filter);
+    }
+
 
     if (verbose)
         log ("### DID FULL PARSE OF BROKEN NMEA TESTS");
@@ -0,0 +1,289 @@
+/*  =========================================================================
+    aisnmea_arena - Bump allocator for records with a shared lifetime
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_arena - Bump allocator for records with a shared lifetime
+@discuss
+    Slabs are kept on a list, newest first, and allocations are carved
+    off the front slab. When it can't fit the next one a new slab is
+    made; anything bigger than a quarter of a slab gets a slab of its
+    own, placed behind the front one so the front one's space isn't
+    wasted. The arena is not thread safe; give each thread its own.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+#define DEFAULT_SLAB_SIZE (1 << 20)
+
+//  Everything handed out is aligned to this
+#define ALIGNMENT 16
+
+typedef struct _slab_t slab_t;
+
+struct _slab_t {
+    slab_t *next;
+    size_t size;            // bytes of data
+    size_t used;
+    //  Followed by the data, ALIGNMENT aligned
+};
+
+//  Header size, rounded up so the data that follows is aligned
+#define SLAB_HEADER ((sizeof (slab_t) + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1))
+
+//  Structure of our class
+
+struct _aisnmea_arena_t {
+    slab_t *slabs;          // front slab is being carved up
+    size_t slab_size;
+    size_t used;
+    size_t reserved;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_arena
+
+aisnmea_arena_t *
+aisnmea_arena_new (size_t slab_size)
+{
+    aisnmea_arena_t *self = (aisnmea_arena_t *) zmalloc (sizeof (aisnmea_arena_t));
+    assert (self);
+    self->slab_size = slab_size ? slab_size : DEFAULT_SLAB_SIZE;
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_arena
+
+void
+aisnmea_arena_destroy (aisnmea_arena_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_arena_t *self = *self_p;
+        aisnmea_arena_reset (self);
+        free (self->slabs);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Allocate 'size' bytes, aligned for any type
+
+static slab_t *
+s_slab_new (size_t size)
+{
+    // malloc's alignment is at least ALIGNMENT on the platforms we build on
+    slab_t *slab = (slab_t *) malloc (SLAB_HEADER + size);
+    assert (slab);
+    assert (((uintptr_t) slab & (ALIGNMENT - 1)) == 0);
+    slab->next = NULL;
+    slab->size = size;
+    slab->used = 0;
+    return slab;
+}
+
+void *
+aisnmea_arena_alloc (aisnmea_arena_t *self, size_t size)
+{
+    assert (self);
+    size = (size + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+    if (!size)
+        size = ALIGNMENT;
+
+    slab_t *slab = self->slabs;
+    if (!slab || slab->size - slab->used < size) {
+        if (size > self->slab_size / 4) {
+            // Big enough to have a slab of its own
+            slab = s_slab_new (size);
+            if (self->slabs) {
+                slab->next = self->slabs->next;
+                self->slabs->next = slab;
+            }
+            else
+                self->slabs = slab;
+        }
+        else {
+            slab = s_slab_new (self->slab_size);
+            slab->next = self->slabs;
+            self->slabs = slab;
+        }
+        self->reserved += slab->size;
+    }
+    void *data = (byte *) slab + SLAB_HEADER + slab->used;
+    slab->used += size;
+    self->used += size;
+    return data;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Free everything allocated so far, keeping one slab for reuse
+
+void
+aisnmea_arena_reset (aisnmea_arena_t *self)
+{
+    assert (self);
+    slab_t *keep = NULL;
+    slab_t *slab = self->slabs;
+    while (slab) {
+        slab_t *next = slab->next;
+        if (!keep && slab->size == self->slab_size)
+            keep = slab;
+        else
+            free (slab);
+        slab = next;
+    }
+    if (keep) {
+        keep->next = NULL;
+        keep->used = 0;
+    }
+    self->slabs = keep;
+    self->reserved = keep ? keep->size : 0;
+    self->used = 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Bytes allocated since creation or the last reset
+
+size_t
+aisnmea_arena_used (aisnmea_arena_t *self)
+{
+    assert (self);
+    return self->used;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Bytes held in slabs
+
+size_t
+aisnmea_arena_reserved (aisnmea_arena_t *self)
+{
+    assert (self);
+    return self->reserved;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_arena_test (bool verbose)
+{
+    printf (" * aisnmea_arena: ");
+
+    //  @selftest
+    aisnmea_arena_t *arena = aisnmea_arena_new (1024);
+    assert (arena);
+    assert (aisnmea_arena_used (arena) == 0);
+    assert (aisnmea_arena_reserved (arena) == 0);
+
+    // Small allocations are aligned, packed together, and don't overlap
+    char *first = (char *) aisnmea_arena_alloc (arena, 5);
+    char *second = (char *) aisnmea_arena_alloc (arena, 1);
+    assert (first && second);
+    assert (((uintptr_t) first & 15) == 0);
+    assert (((uintptr_t) second & 15) == 0);
+    assert (second == first + 16);
+    memset (first, 'a', 5);
+    memset (second, 'b', 1);
+    assert (first [4] == 'a');
+    assert (aisnmea_arena_used (arena) == 32);
+    assert (aisnmea_arena_reserved (arena) == 1024);
+
+    // A big one gets its own slab, and the front slab carries on
+    char *big = (char *) aisnmea_arena_alloc (arena, 4000);
+    assert (big);
+    memset (big, 'c', 4000);
+    char *third = (char *) aisnmea_arena_alloc (arena, 16);
+    assert (third == first + 32);
+    assert (aisnmea_arena_reserved (arena) == 1024 + 4000);
+
+    // Filling the front slab starts another
+    for (int i = 0; i < 100; ++i) {
+        char *data = (char *) aisnmea_arena_alloc (arena, 100);
+        assert (data);
+        memset (data, i, 100);
+    }
+    assert (aisnmea_arena_reserved (arena) > 1024 * 5);
+
+    // Reset keeps one slab, and starts handing it out again
+    aisnmea_arena_reset (arena);
+    assert (aisnmea_arena_used (arena) == 0);
+    assert (aisnmea_arena_reserved (arena) == 1024);
+    assert (aisnmea_arena_alloc (arena, 0));
+    assert (aisnmea_arena_used (arena) == 16);
+
+    aisnmea_arena_destroy (&arena);
+    assert (!arena);
+
+    // Records copied in keep all their fields, tag block included
+    arena = aisnmea_arena_new (0);
+    assert (arena);
+    aisnmea_t *msg = aisnmea_new ("\\g:1-2-73874,n:157036,s:r003669945,c:1241544035*4A"
+                                  "\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13");
+    assert (msg);
+    aisnmea_t *copy = aisnmea_dup_into (msg, arena);
+    assert (copy);
+    assert (aisnmea_arena_used (arena) > 0);
+    aisnmea_destroy (&msg);
+    assert (streq (aisnmea_head (copy), "!AIVDM"));
+    assert (streq (aisnmea_payload (copy), "15N4cJ`005Jrek0H@9n`DW5608EP"));
+    assert (aisnmea_fragcount (copy) == 1);
+    assert (aisnmea_fragnum (copy) == 1);
+    assert (aisnmea_messageid (copy) == -1);
+    assert (aisnmea_channel (copy) == 'B');
+    assert (aisnmea_fillbits (copy) == 0);
+    assert (aisnmea_checksum (copy) == 0x13);
+    assert (aisnmea_aismsgtype (copy) == 1);
+    assert (streq (aisnmea_tagblockval (copy, "g"), "1-2-73874"));
+    assert (streq (aisnmea_tagblockval (copy, "n"), "157036"));
+    assert (streq (aisnmea_tagblockval (copy, "s"), "r003669945"));
+    assert (aisnmea_tagblockval (copy, "x") == NULL);
+    assert (aisnmea_tagblockval (copy, "") == NULL);
+    assert (aisnmea_timestamp (copy) == 1241544035);
+
+    // A heap copy of an arena record has its tag block too
+    aisnmea_t *heap = aisnmea_dup (copy);
+    assert (heap);
+    assert (streq (aisnmea_tagblockval (heap, "s"), "r003669945"));
+    assert (aisnmea_aismsgtype (heap) == 1);
+    aisnmea_destroy (&heap);
+
+    // Destroying a record in an arena just lets go of it
+    aisnmea_t *alias = copy;
+    aisnmea_destroy (&alias);
+    assert (!alias);
+    assert (streq (aisnmea_head (copy), "!AIVDM"));
+
+    // As does a copy of a copy; and records without tag blocks
+    msg = aisnmea_new ("!AIVDM,1,1,,A,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5F");
+    assert (msg);
+    aisnmea_t *plain = aisnmea_dup_into (msg, arena);
+    aisnmea_destroy (&msg);
+    assert (aisnmea_tagblockval (plain, "c") == NULL);
+    assert (aisnmea_timestamp (plain) == 0);
+    assert (aisnmea_mmsi (plain) == 477553000);
+    aisnmea_t *again = aisnmea_dup_into (copy, arena);
+    assert (streq (aisnmea_tagblockval (again, "c"), "1241544035"));
+
+    aisnmea_arena_destroy (&arena);
+    //  @end
+
+    printf ("OK\n");
+}
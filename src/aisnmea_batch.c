@@ -0,0 +1,1191 @@
+/*  =========================================================================
+    aisnmea_batch - Columnar parse results for many sentences at once
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_batch - Columnar parse results for many sentences at once
+@discuss
+    Each line is checked with aisnmea_parse () on one reused parser, so
+    there's no per-line setup, and the small numeric fields go into
+    arrays of their own. Strings stay where they are in the batch's copy
+    of the text and are stored as offset and length, so adding a row
+    copies nothing per field.
+
+    Offsets are 32-bit, so one batch holds at most 4 GiB of text; clear
+    it, or use another, well before then.
+
+    unarmour() turns every payload into bits in one pass. On x86 with GCC
+    or Clang it uses SSSE3 or AVX2 where the CPU has them, converting 16
+    or 32 characters a step; one load covers a whole position report, as
+    the text is kept with TEXT_SLACK zero bytes after it, so loads can
+    run past the last payload. Stores run up to 32 bytes past a row's
+    bits, into the next row's space (written after) or the slack at the
+    end of the buffer.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#   define UNARMOUR_X86
+#   include <immintrin.h>
+#endif
+
+//  Most tagblock key columns one batch will extract
+#define MAX_KEYS 16
+
+//  Zero bytes kept after the text and the bits, for vector loads and
+//  stores that run past the end
+#define TEXT_SLACK 32
+
+//  A string within the batch text; length 0 means absent
+typedef struct {
+    uint32_t offset;
+    uint32_t size;
+} span_t;
+
+//  Structure of our class
+
+struct _aisnmea_batch_t {
+    aisnmea_t *parser;
+
+    // Verbatim copy of everything added
+    char *text;
+    size_t text_size;
+    size_t text_capacity;
+
+    // Columns, one entry per row
+    size_t rows;
+    size_t capacity;
+    span_t *lines;
+    uint32_t *heads;        // head is always six chars
+    uint8_t *fragcounts;
+    uint8_t *fragnums;
+    int8_t *messageids;
+    char *channels;
+    span_t *payloads;
+    uint8_t *fillbits;
+    int8_t *msgtypes;
+    uint64_t *timestamps;
+
+    // Optional tagblock key columns
+    char *keys [MAX_KEYS];
+    span_t *keyvals [MAX_KEYS];
+    size_t key_count;
+
+    // Unarmoured payloads, once unarmour () is called
+    bool unarmoured;
+    byte *bits;
+    size_t bits_capacity;
+    span_t *bitspans;       // byte offset into bits, size in bits
+    size_t bitspans_capacity;
+
+    uint64_t errors;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_batch
+
+aisnmea_batch_t *
+aisnmea_batch_new (void)
+{
+    aisnmea_batch_t *self = (aisnmea_batch_t *) zmalloc (sizeof (aisnmea_batch_t));
+    assert (self);
+    self->parser = aisnmea_new (NULL);
+    assert (self->parser);
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_batch
+
+void
+aisnmea_batch_destroy (aisnmea_batch_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_batch_t *self = *self_p;
+        aisnmea_destroy (&self->parser);
+        free (self->text);
+        free (self->lines);
+        free (self->heads);
+        free (self->fragcounts);
+        free (self->fragnums);
+        free (self->messageids);
+        free (self->channels);
+        free (self->payloads);
+        free (self->fillbits);
+        free (self->msgtypes);
+        free (self->timestamps);
+        free (self->bits);
+        free (self->bitspans);
+        for (size_t i = 0; i < self->key_count; ++i) {
+            zstr_free (&self->keys [i]);
+            free (self->keyvals [i]);
+        }
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Storage growth
+
+static void *
+s_grow (void *array, size_t capacity, size_t width)
+{
+    array = realloc (array, capacity * width);
+    assert (array);
+    return array;
+}
+
+static void
+s_reserve_rows (aisnmea_batch_t *self, size_t rows)
+{
+    if (rows <= self->capacity)
+        return;
+    size_t capacity = self->capacity ? self->capacity : 1024;
+    while (capacity < rows)
+        capacity *= 2;
+
+    self->lines      = (span_t *)   s_grow (self->lines,      capacity, sizeof (span_t));
+    self->heads      = (uint32_t *) s_grow (self->heads,      capacity, sizeof (uint32_t));
+    self->fragcounts = (uint8_t *)  s_grow (self->fragcounts, capacity, sizeof (uint8_t));
+    self->fragnums   = (uint8_t *)  s_grow (self->fragnums,   capacity, sizeof (uint8_t));
+    self->messageids = (int8_t *)   s_grow (self->messageids, capacity, sizeof (int8_t));
+    self->channels   = (char *)     s_grow (self->channels,   capacity, sizeof (char));
+    self->payloads   = (span_t *)   s_grow (self->payloads,   capacity, sizeof (span_t));
+    self->fillbits   = (uint8_t *)  s_grow (self->fillbits,   capacity, sizeof (uint8_t));
+    self->msgtypes   = (int8_t *)   s_grow (self->msgtypes,   capacity, sizeof (int8_t));
+    self->timestamps = (uint64_t *) s_grow (self->timestamps, capacity, sizeof (uint64_t));
+    for (size_t i = 0; i < self->key_count; ++i)
+        self->keyvals [i] = (span_t *) s_grow (self->keyvals [i], capacity, sizeof (span_t));
+    self->capacity = capacity;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Key columns
+
+size_t
+aisnmea_batch_add_key (aisnmea_batch_t *self, const char *key)
+{
+    assert (self);
+    assert (key);
+    assert (self->rows == 0);
+    assert (self->key_count < MAX_KEYS);
+
+    size_t index = self->key_count++;
+    self->keys [index] = strdup (key);
+    assert (self->keys [index]);
+    self->keyvals [index] = NULL;
+    if (self->capacity)
+        self->keyvals [index] = (span_t *) s_grow (NULL, self->capacity, sizeof (span_t));
+    return index;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Add one NUL-terminated line at 'offset' in the text. Returns 1 if it
+//  became a row, 0 if it didn't.
+
+static size_t
+s_add_line (aisnmea_batch_t *self, uint32_t offset, uint32_t size)
+{
+    const char *line = self->text + offset;
+    if (aisnmea_parse (self->parser, line))
+        return 0;
+
+    aisnmea_t *msg = self->parser;
+    size_t fragcount = aisnmea_fragcount (msg);
+    size_t fragnum = aisnmea_fragnum (msg);
+    int messageid = aisnmea_messageid (msg);
+    size_t fillbits = aisnmea_fillbits (msg);
+    if (fragcount > UINT8_MAX || fragnum > UINT8_MAX
+    ||  messageid > INT8_MAX || fillbits > UINT8_MAX)
+        return 0;
+
+    // The parse succeeded, so the line is well formed: the body starts
+    // after any tagblock and the payload is its sixth column
+    const char *body = line;
+    if (*body == '\\')
+        body = strchr (body + 1, '\\') + 1;
+    const char *payload = body;
+    for (int commas = 0; commas < 5; ++commas)
+        payload = strchr (payload, ',') + 1;
+    const char *payload_end = strchr (payload, ',');
+
+    s_reserve_rows (self, self->rows + 1);
+    size_t row = self->rows;
+    self->lines [row].offset = offset;
+    self->lines [row].size = size;
+    self->heads [row] = (uint32_t) (body - self->text);
+    self->fragcounts [row] = (uint8_t) fragcount;
+    self->fragnums [row] = (uint8_t) fragnum;
+    self->messageids [row] = (int8_t) messageid;
+    self->channels [row] = aisnmea_channel (msg);
+    self->payloads [row].offset = (uint32_t) (payload - self->text);
+    self->payloads [row].size = (uint32_t) (payload_end - payload);
+    self->fillbits [row] = (uint8_t) fillbits;
+    self->msgtypes [row] = (int8_t) aisnmea_aismsgtype (msg);
+    self->timestamps [row] = aisnmea_timestamp (msg);
+
+    // Find wanted tagblock values in place, between the '\' and the '*'
+    for (size_t k = 0; k < self->key_count; ++k) {
+        self->keyvals [k][row].offset = 0;
+        self->keyvals [k][row].size = 0;
+    }
+    if (self->key_count && body != line) {
+        const char *pair = line + 1;
+        const char *tagblock_end = strchr (pair, '*');
+        while (pair < tagblock_end) {
+            const char *pair_end = pair;
+            while (pair_end < tagblock_end && *pair_end != ',')
+                ++pair_end;
+            const char *colon = (const char *) memchr (pair, ':', pair_end - pair);
+            for (size_t k = 0; colon && k < self->key_count; ++k) {
+                size_t key_size = strlen (self->keys [k]);
+                if ((size_t) (colon - pair) == key_size
+                &&  memcmp (pair, self->keys [k], key_size) == 0) {
+                    self->keyvals [k][row].offset = (uint32_t) (colon + 1 - self->text);
+                    self->keyvals [k][row].size = (uint32_t) (pair_end - colon - 1);
+                }
+            }
+            pair = pair_end + 1;
+        }
+    }
+
+    self->rows += 1;
+    return 1;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Add a buffer of lines
+
+size_t
+aisnmea_batch_add (aisnmea_batch_t *self, const char *buf, size_t len)
+{
+    assert (self);
+    assert (buf || !len);
+    assert (self->text_size + len < UINT32_MAX);
+
+    // Copy in, with room for a terminator after an unterminated last
+    // line, and the slack
+    if (self->text_size + len + TEXT_SLACK > self->text_capacity) {
+        size_t capacity = self->text_capacity ? self->text_capacity : 65536;
+        while (capacity < self->text_size + len + TEXT_SLACK)
+            capacity *= 2;
+        self->text = (char *) s_grow (self->text, capacity, 1);
+        self->text_capacity = capacity;
+    }
+    size_t start = self->text_size;
+    memcpy (self->text + start, buf, len);
+    self->text_size += len;
+    memset (self->text + self->text_size, 0, TEXT_SLACK);
+    self->unarmoured = false;
+
+    size_t added = 0;
+    size_t pos = start;
+    while (pos < self->text_size) {
+        char *eol = (char *) memchr (self->text + pos, '\n', self->text_size - pos);
+        size_t end = eol ? (size_t) (eol - self->text) : self->text_size;
+        size_t line_end = end;
+        if (line_end > pos && self->text [line_end - 1] == '\r')
+            --line_end;
+
+        if (line_end > pos) {
+            // Terminate in place for the parser, then put the text back
+            char saved = self->text [line_end];
+            self->text [line_end] = 0;
+            size_t rc = s_add_line (self, (uint32_t) pos, (uint32_t) (line_end - pos));
+            self->text [line_end] = saved;
+            if (rc)
+                added += 1;
+            else
+                self->errors += 1;
+        }
+        pos = end + 1;
+    }
+    return added;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Accessors
+
+void
+aisnmea_batch_clear (aisnmea_batch_t *self)
+{
+    assert (self);
+    self->text_size = 0;
+    self->rows = 0;
+    self->errors = 0;
+    self->unarmoured = false;
+}
+
+size_t
+aisnmea_batch_size (aisnmea_batch_t *self)
+{
+    assert (self);
+    return self->rows;
+}
+
+uint64_t
+aisnmea_batch_errors (aisnmea_batch_t *self)
+{
+    assert (self);
+    return self->errors;
+}
+
+const char *
+aisnmea_batch_line (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (row < self->rows);
+    return self->text + self->lines [row].offset;
+}
+
+size_t
+aisnmea_batch_line_size (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (row < self->rows);
+    return self->lines [row].size;
+}
+
+const char *
+aisnmea_batch_head (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (row < self->rows);
+    return self->text + self->heads [row];
+}
+
+size_t
+aisnmea_batch_fragcount (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (row < self->rows);
+    return self->fragcounts [row];
+}
+
+size_t
+aisnmea_batch_fragnum (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (row < self->rows);
+    return self->fragnums [row];
+}
+
+int
+aisnmea_batch_messageid (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (row < self->rows);
+    return self->messageids [row];
+}
+
+char
+aisnmea_batch_channel (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (row < self->rows);
+    return self->channels [row];
+}
+
+const char *
+aisnmea_batch_payload (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (row < self->rows);
+    return self->text + self->payloads [row].offset;
+}
+
+size_t
+aisnmea_batch_payload_size (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (row < self->rows);
+    return self->payloads [row].size;
+}
+
+size_t
+aisnmea_batch_fillbits (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (row < self->rows);
+    return self->fillbits [row];
+}
+
+int
+aisnmea_batch_aismsgtype (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (row < self->rows);
+    return self->msgtypes [row];
+}
+
+uint64_t
+aisnmea_batch_timestamp (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (row < self->rows);
+    return self->timestamps [row];
+}
+
+const char *
+aisnmea_batch_tagblockval (aisnmea_batch_t *self, size_t row, size_t key)
+{
+    assert (self);
+    assert (row < self->rows);
+    assert (key < self->key_count);
+    span_t *val = &self->keyvals [key][row];
+    return val->size ? self->text + val->offset : NULL;
+}
+
+size_t
+aisnmea_batch_tagblockval_size (aisnmea_batch_t *self, size_t row, size_t key)
+{
+    assert (self);
+    assert (row < self->rows);
+    assert (key < self->key_count);
+    return self->keyvals [key][row].size;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Unarmouring kernels: each turns one payload of 'size' chars into bits,
+//  most significant first, with the bits past the last char zero, and
+//  returns false if any char isn't six-bit ASCII
+
+static bool
+s_unarmour_scalar (const char *payload, size_t size, byte *out)
+{
+    bool valid = true;
+    uint32_t pending = 0;
+    int pending_bits = 0;
+    for (size_t i = 0; i < size; ++i) {
+        int ch = (unsigned char) payload [i];
+        if (ch < '0' || ch > 'w' || (ch > 'W' && ch < '`')) {
+            valid = false;
+            ch = '0';
+        }
+        ch -= '0';
+        pending = (pending << 6) | (uint32_t) (ch > 40 ? ch - 8 : ch);
+        pending_bits += 6;
+        if (pending_bits >= 8) {
+            pending_bits -= 8;
+            *out++ = (byte) (pending >> pending_bits);
+            pending &= (1U << pending_bits) - 1;
+        }
+    }
+    if (pending_bits)
+        *out = (byte) (pending << (8 - pending_bits));
+    return valid;
+}
+
+#ifdef UNARMOUR_X86
+//  Packs four six-bit values a byte into three bytes, as in base64
+//  decoders: a and b, then c and d, into 12 bits a word, then those into
+//  24 bits a double word, then shuffles out three of its bytes, high first
+
+__attribute__ ((target ("ssse3")))
+static bool
+s_unarmour_ssse3 (const char *payload, size_t size, byte *out)
+{
+    const __m128i lane = _mm_setr_epi8 (0, 1, 2, 3, 4, 5, 6, 7,
+                                        8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i order = _mm_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9,
+                                         8, 14, 13, 12, -1, -1, -1, -1);
+    __m128i bad = _mm_setzero_si128 ();
+    for (size_t i = 0; i < size; i += 16) {
+        size_t left = size - i < 16 ? size - i : 16;
+        __m128i live = _mm_cmpgt_epi8 (_mm_set1_epi8 ((char) left), lane);
+        __m128i chars = _mm_loadu_si128 ((const __m128i *) (payload + i));
+        // Chars past 127 are negative, so in neither range
+        __m128i lower = _mm_and_si128 (_mm_cmpgt_epi8 (chars, _mm_set1_epi8 ('0' - 1)),
+                                       _mm_cmpgt_epi8 (_mm_set1_epi8 ('W' + 1), chars));
+        __m128i upper = _mm_and_si128 (_mm_cmpgt_epi8 (chars, _mm_set1_epi8 ('`' - 1)),
+                                       _mm_cmpgt_epi8 (_mm_set1_epi8 ('w' + 1), chars));
+        bad = _mm_or_si128 (bad, _mm_andnot_si128 (_mm_or_si128 (lower, upper), live));
+        __m128i values = _mm_sub_epi8 (chars, _mm_set1_epi8 ('0'));
+        values = _mm_sub_epi8 (values, _mm_and_si128 (upper, _mm_set1_epi8 (8)));
+        values = _mm_and_si128 (values, _mm_and_si128 (live, _mm_or_si128 (lower, upper)));
+
+        __m128i pairs = _mm_maddubs_epi16 (values, _mm_set1_epi32 (0x01400140));
+        __m128i quads = _mm_madd_epi16 (pairs, _mm_set1_epi32 (0x00011000));
+        _mm_storeu_si128 ((__m128i *) (out + i / 4 * 3), _mm_shuffle_epi8 (quads, order));
+    }
+    return _mm_movemask_epi8 (bad) == 0;
+}
+
+__attribute__ ((target ("avx2")))
+static bool
+s_unarmour_avx2 (const char *payload, size_t size, byte *out)
+{
+    const __m256i lane = _mm256_setr_epi8 (0, 1, 2, 3, 4, 5, 6, 7,
+                                           8, 9, 10, 11, 12, 13, 14, 15,
+                                           16, 17, 18, 19, 20, 21, 22, 23,
+                                           24, 25, 26, 27, 28, 29, 30, 31);
+    const __m256i order = _mm256_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9,
+                                            8, 14, 13, 12, -1, -1, -1, -1,
+                                            2, 1, 0, 6, 5, 4, 10, 9,
+                                            8, 14, 13, 12, -1, -1, -1, -1);
+    // Shuffles work within 16-byte halves, so close the gap between them
+    const __m256i join = _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 7, 7);
+    __m256i bad = _mm256_setzero_si256 ();
+    for (size_t i = 0; i < size; i += 32) {
+        size_t left = size - i < 32 ? size - i : 32;
+        __m256i live = _mm256_cmpgt_epi8 (_mm256_set1_epi8 ((char) left), lane);
+        __m256i chars = _mm256_loadu_si256 ((const __m256i *) (payload + i));
+        __m256i lower = _mm256_and_si256 (_mm256_cmpgt_epi8 (chars, _mm256_set1_epi8 ('0' - 1)),
+                                          _mm256_cmpgt_epi8 (_mm256_set1_epi8 ('W' + 1), chars));
+        __m256i upper = _mm256_and_si256 (_mm256_cmpgt_epi8 (chars, _mm256_set1_epi8 ('`' - 1)),
+                                          _mm256_cmpgt_epi8 (_mm256_set1_epi8 ('w' + 1), chars));
+        bad = _mm256_or_si256 (bad, _mm256_andnot_si256 (_mm256_or_si256 (lower, upper), live));
+        __m256i values = _mm256_sub_epi8 (chars, _mm256_set1_epi8 ('0'));
+        values = _mm256_sub_epi8 (values, _mm256_and_si256 (upper, _mm256_set1_epi8 (8)));
+        values = _mm256_and_si256 (values, _mm256_and_si256 (live, _mm256_or_si256 (lower, upper)));
+
+        __m256i pairs = _mm256_maddubs_epi16 (values, _mm256_set1_epi32 (0x01400140));
+        __m256i quads = _mm256_madd_epi16 (pairs, _mm256_set1_epi32 (0x00011000));
+        __m256i bytes = _mm256_permutevar8x32_epi32 (_mm256_shuffle_epi8 (quads, order), join);
+        _mm256_storeu_si256 ((__m256i *) (out + i / 4 * 3), bytes);
+    }
+    return _mm256_movemask_epi8 (bad) == 0;
+}
+#endif
+
+typedef bool (unarmour_fn) (const char *payload, size_t size, byte *out);
+
+static unarmour_fn *
+s_unarmour_kernel (void)
+{
+#ifdef UNARMOUR_X86
+    if (__builtin_cpu_supports ("avx2"))
+        return s_unarmour_avx2;
+    if (__builtin_cpu_supports ("ssse3"))
+        return s_unarmour_ssse3;
+#endif
+    return s_unarmour_scalar;
+}
+
+static size_t
+s_unarmour (aisnmea_batch_t *self, unarmour_fn *kernel)
+{
+    if (self->bitspans_capacity < self->rows) {
+        self->bitspans = (span_t *) s_grow (self->bitspans, self->capacity, sizeof (span_t));
+        self->bitspans_capacity = self->capacity;
+    }
+    size_t bytes = 0;
+    for (size_t row = 0; row < self->rows; ++row) {
+        size_t bits = (size_t) self->payloads [row].size * 6;
+        self->bitspans [row].offset = (uint32_t) bytes;
+        self->bitspans [row].size = 0;
+        if (bits > self->fillbits [row])
+            self->bitspans [row].size = (uint32_t) (bits - self->fillbits [row]);
+        bytes += (bits + 7) / 8;
+    }
+    if (self->bits_capacity < bytes + TEXT_SLACK) {
+        size_t capacity = self->bits_capacity ? self->bits_capacity : 65536;
+        while (capacity < bytes + TEXT_SLACK)
+            capacity *= 2;
+        self->bits = (byte *) s_grow (self->bits, capacity, 1);
+        self->bits_capacity = capacity;
+    }
+
+    size_t invalid = 0;
+    for (size_t row = 0; row < self->rows; ++row) {
+        const span_t *payload = &self->payloads [row];
+        byte *out = self->bits + self->bitspans [row].offset;
+        if (!kernel (self->text + payload->offset, payload->size, out)) {
+            self->bitspans [row].size = 0;
+            invalid += 1;
+        }
+    }
+    memset (self->bits + bytes, 0, TEXT_SLACK);
+    self->unarmoured = true;
+    return invalid;
+}
+
+size_t
+aisnmea_batch_unarmour (aisnmea_batch_t *self)
+{
+    assert (self);
+    return s_unarmour (self, s_unarmour_kernel ());
+}
+
+const byte *
+aisnmea_batch_bits (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (self->unarmoured);
+    assert (row < self->rows);
+    return self->bits + self->bitspans [row].offset;
+}
+
+size_t
+aisnmea_batch_bits_size (aisnmea_batch_t *self, size_t row)
+{
+    assert (self);
+    assert (self->unarmoured);
+    assert (row < self->rows);
+    return self->bitspans [row].size;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Whole columns
+
+void *
+aisnmea_batch_column (aisnmea_batch_t *self, const char *name)
+{
+    assert (self);
+    assert (name);
+    if (!self->rows)
+        return NULL;
+    if (streq (name, "line"))
+        return self->lines;
+    if (streq (name, "head"))
+        return self->heads;
+    if (streq (name, "fragcount"))
+        return self->fragcounts;
+    if (streq (name, "fragnum"))
+        return self->fragnums;
+    if (streq (name, "messageid"))
+        return self->messageids;
+    if (streq (name, "channel"))
+        return self->channels;
+    if (streq (name, "payload"))
+        return self->payloads;
+    if (streq (name, "fillbits"))
+        return self->fillbits;
+    if (streq (name, "msgtype"))
+        return self->msgtypes;
+    if (streq (name, "timestamp"))
+        return self->timestamps;
+    if (streq (name, "bits") && self->unarmoured)
+        return self->bits;
+    if (streq (name, "bitspan") && self->unarmoured)
+        return self->bitspans;
+    return NULL;
+}
+
+void *
+aisnmea_batch_key_column (aisnmea_batch_t *self, size_t key)
+{
+    assert (self);
+    assert (key < self->key_count);
+    return self->rows ? self->keyvals [key] : NULL;
+}
+
+//  --------------------------------------------------------------------------
+//  Arrow export. Each column is its own ArrowArray, with the buffers it
+//  made for itself (validity bitmaps and string views) in its private
+//  data, so consumers can release columns they've moved out on their own.
+
+//  Columns before the tagblock key ones
+#define FIXED_COLUMNS 9
+
+//  String views point into windows of the text this far apart, each
+//  twice as big, so view offsets (int32) always fit
+#define VIEW_WINDOW (1 << 30)
+
+//  Strings this long or shorter are held inside their views
+#define VIEW_INLINE 12
+
+typedef struct {
+    const void *buffers [3];
+    const void **variadic;      // for views: more buffers than fit above
+    byte *validity;
+    byte *views;
+    int64_t *sizes;
+} column_t;
+
+typedef struct {
+    struct ArrowArray *arrays;
+    struct ArrowArray **children;
+} batch_array_t;
+
+typedef struct {
+    struct ArrowSchema *schemas;
+    struct ArrowSchema **children;
+    char **names;
+    int64_t count;
+} batch_schema_t;
+
+//  Zero-length columns still need non-NULL data buffers
+static const uint64_t s_empty [2] = { 0, 0 };
+
+static void
+s_column_release (struct ArrowArray *array)
+{
+    column_t *column = (column_t *) array->private_data;
+    free (column->variadic);
+    free (column->validity);
+    free (column->views);
+    free (column->sizes);
+    free (column);
+    array->release = NULL;
+}
+
+static void
+s_array_release (struct ArrowArray *array)
+{
+    batch_array_t *batch_array = (batch_array_t *) array->private_data;
+    for (int64_t i = 0; i < array->n_children; ++i)
+        if (batch_array->arrays [i].release)
+            batch_array->arrays [i].release (&batch_array->arrays [i]);
+    free (batch_array->arrays);
+    free (batch_array->children);
+    free (batch_array);
+    array->release = NULL;
+}
+
+static void
+s_schema_child_release (struct ArrowSchema *schema)
+{
+    schema->release = NULL;
+}
+
+static void
+s_schema_release (struct ArrowSchema *schema)
+{
+    batch_schema_t *batch_schema = (batch_schema_t *) schema->private_data;
+    for (int64_t i = 0; i < batch_schema->count; ++i) {
+        if (batch_schema->schemas [i].release)
+            batch_schema->schemas [i].release (&batch_schema->schemas [i]);
+        free (batch_schema->names [i]);
+    }
+    free (batch_schema->schemas);
+    free (batch_schema->children);
+    free (batch_schema->names);
+    free (batch_schema);
+    schema->release = NULL;
+}
+
+//  A column of fixed width values straight out of one of our arrays,
+//  null where 'valid' says so (if not NULL)
+static void
+s_fixed_column (aisnmea_batch_t *self, struct ArrowArray *array,
+                const void *values, bool (*valid) (aisnmea_batch_t *, size_t))
+{
+    column_t *column = (column_t *) zmalloc (sizeof (column_t));
+    assert (column);
+    array->length = (int64_t) self->rows;
+    array->n_buffers = 2;
+    array->buffers = column->buffers;
+    array->release = s_column_release;
+    array->private_data = column;
+    column->buffers [1] = values ? values : s_empty;
+
+    if (valid) {
+        column->validity = (byte *) zmalloc (self->rows / 8 + 1);
+        assert (column->validity);
+        for (size_t row = 0; row < self->rows; ++row) {
+            if (valid (self, row))
+                column->validity [row / 8] |= (byte) (1 << (row % 8));
+            else
+                array->null_count++;
+        }
+        column->buffers [0] = column->validity;
+    }
+}
+
+//  A string view column; 'spans' gives each row's string within the
+//  text, where size 0 means null
+static void
+s_view_column (aisnmea_batch_t *self, struct ArrowArray *array, const span_t *spans)
+{
+    column_t *column = (column_t *) zmalloc (sizeof (column_t));
+    assert (column);
+    size_t windows = self->text_size ? (self->text_size - 1) / VIEW_WINDOW + 1 : 0;
+    array->length = (int64_t) self->rows;
+    array->n_buffers = 3 + (int64_t) windows;
+    column->variadic = (const void **) zmalloc ((3 + windows) * sizeof (void *));
+    assert (column->variadic);
+    array->buffers = column->variadic;
+    array->release = s_column_release;
+    array->private_data = column;
+
+    column->validity = (byte *) zmalloc (self->rows / 8 + 1);
+    column->views = (byte *) zmalloc (self->rows * 16 + 16);
+    column->sizes = (int64_t *) zmalloc ((windows + 1) * sizeof (int64_t));
+    assert (column->validity && column->views && column->sizes);
+    for (size_t window = 0; window < windows; ++window) {
+        size_t start = window * (size_t) VIEW_WINDOW;
+        size_t size = self->text_size - start;
+        if (size > 2 * (size_t) VIEW_WINDOW)
+            size = 2 * (size_t) VIEW_WINDOW;
+        column->variadic [2 + window] = self->text + start;
+        column->sizes [window] = (int64_t) size;
+    }
+    column->variadic [0] = column->validity;
+    column->variadic [1] = column->views;
+    column->variadic [2 + windows] = column->sizes;
+
+    for (size_t row = 0; row < self->rows; ++row) {
+        byte *view = column->views + row * 16;
+        const span_t *span = &spans [row];
+        if (!span->size) {
+            array->null_count++;
+            continue;
+        }
+        column->validity [row / 8] |= (byte) (1 << (row % 8));
+        int32_t length = (int32_t) span->size;
+        memcpy (view, &length, 4);
+        if (span->size <= VIEW_INLINE)
+            memcpy (view + 4, self->text + span->offset, span->size);
+        else {
+            int32_t window = (int32_t) (span->offset / VIEW_WINDOW);
+            int32_t offset = (int32_t) (span->offset % VIEW_WINDOW);
+            memcpy (view + 4, self->text + span->offset, 4);
+            memcpy (view + 8, &window, 4);
+            memcpy (view + 12, &offset, 4);
+        }
+    }
+}
+
+static bool
+s_has_messageid (aisnmea_batch_t *self, size_t row)
+{
+    return self->messageids [row] >= 0;
+}
+
+static bool
+s_has_msgtype (aisnmea_batch_t *self, size_t row)
+{
+    return self->msgtypes [row] >= 0;
+}
+
+static bool
+s_has_timestamp (aisnmea_batch_t *self, size_t row)
+{
+    return self->timestamps [row] != 0;
+}
+
+int
+aisnmea_batch_export (aisnmea_batch_t *self, struct ArrowArray *array, struct ArrowSchema *schema)
+{
+    assert (self);
+    assert (array);
+    assert (schema);
+    int64_t count = FIXED_COLUMNS + (int64_t) self->key_count;
+
+    // Heads and channels as spans, so they can go out as views too
+    span_t *heads = (span_t *) zmalloc ((self->rows + 1) * sizeof (span_t));
+    span_t *channels = (span_t *) zmalloc ((self->rows + 1) * sizeof (span_t));
+    assert (heads && channels);
+    for (size_t row = 0; row < self->rows; ++row) {
+        heads [row].offset = self->heads [row];
+        heads [row].size = 6;
+        // The channel char is in the line just before the payload's comma
+        if (self->channels [row] != -1) {
+            channels [row].offset = self->payloads [row].offset - 2;
+            channels [row].size = 1;
+        }
+    }
+
+    batch_array_t *batch_array = (batch_array_t *) zmalloc (sizeof (batch_array_t));
+    assert (batch_array);
+    batch_array->arrays = (struct ArrowArray *) zmalloc (count * sizeof (struct ArrowArray));
+    batch_array->children = (struct ArrowArray **) zmalloc (count * sizeof (struct ArrowArray *));
+    assert (batch_array->arrays && batch_array->children);
+    struct ArrowArray *arrays = batch_array->arrays;
+    s_view_column  (self, &arrays [0], heads);
+    s_fixed_column (self, &arrays [1], self->fragcounts, NULL);
+    s_fixed_column (self, &arrays [2], self->fragnums, NULL);
+    s_fixed_column (self, &arrays [3], self->messageids, s_has_messageid);
+    s_view_column  (self, &arrays [4], channels);
+    s_view_column  (self, &arrays [5], self->payloads);
+    s_fixed_column (self, &arrays [6], self->fillbits, NULL);
+    s_fixed_column (self, &arrays [7], self->msgtypes, s_has_msgtype);
+    s_fixed_column (self, &arrays [8], self->timestamps, s_has_timestamp);
+    for (size_t k = 0; k < self->key_count; ++k)
+        s_view_column (self, &arrays [FIXED_COLUMNS + k], self->keyvals [k]);
+    for (int64_t i = 0; i < count; ++i)
+        batch_array->children [i] = &arrays [i];
+    free (heads);
+    free (channels);
+
+    // A struct array has just a validity buffer, and no nulls
+    static const void *struct_buffers [1] = { NULL };
+    memset (array, 0, sizeof (struct ArrowArray));
+    array->length = (int64_t) self->rows;
+    array->n_buffers = 1;
+    array->buffers = struct_buffers;
+    array->n_children = count;
+    array->children = batch_array->children;
+    array->release = s_array_release;
+    array->private_data = batch_array;
+
+    static const char *names [FIXED_COLUMNS] = {
+        "head", "fragcount", "fragnum", "messageid", "channel",
+        "payload", "fillbits", "msgtype", "timestamp"
+    };
+    static const char *formats [FIXED_COLUMNS] = {
+        "vu", "C", "C", "c", "vu", "vu", "C", "c", "tss:UTC"
+    };
+    batch_schema_t *batch_schema = (batch_schema_t *) zmalloc (sizeof (batch_schema_t));
+    assert (batch_schema);
+    batch_schema->count = count;
+    batch_schema->schemas = (struct ArrowSchema *) zmalloc (count * sizeof (struct ArrowSchema));
+    batch_schema->children = (struct ArrowSchema **) zmalloc (count * sizeof (struct ArrowSchema *));
+    batch_schema->names = (char **) zmalloc (count * sizeof (char *));
+    assert (batch_schema->schemas && batch_schema->children && batch_schema->names);
+    for (int64_t i = 0; i < count; ++i) {
+        struct ArrowSchema *child = &batch_schema->schemas [i];
+        batch_schema->names [i] = strdup (i < FIXED_COLUMNS ? names [i] : self->keys [i - FIXED_COLUMNS]);
+        assert (batch_schema->names [i]);
+        child->format = i < FIXED_COLUMNS ? formats [i] : "vu";
+        child->name = batch_schema->names [i];
+        child->flags = ARROW_FLAG_NULLABLE;
+        child->release = s_schema_child_release;
+        batch_schema->children [i] = child;
+    }
+    memset (schema, 0, sizeof (struct ArrowSchema));
+    schema->format = "+s";
+    schema->name = "";
+    schema->n_children = count;
+    schema->children = batch_schema->children;
+    schema->release = s_schema_release;
+    schema->private_data = batch_schema;
+    return 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_batch_test (bool verbose)
+{
+    printf (" * aisnmea_batch: ");
+
+    //  @selftest
+
+    const char *lines [] = {
+        "\\g:1-2-73874,n:157036,s:r003669945,c:1241544035*4A"
+        "\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13",
+        "!AIVDM,2,1,3,B,55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53,0*3E",
+        "!AIVDM,2,2,3,B,1@0000000000000,2*55",
+        "!AIVDO,1,1,,,177KQJ5000G?tO`K>RA1wUbN0TKH,0*1C",
+    };
+    const size_t line_count = sizeof (lines) / sizeof (lines [0]);
+
+    aisnmea_batch_t *batch = aisnmea_batch_new ();
+    assert (batch);
+    size_t key_s = aisnmea_batch_add_key (batch, "s");
+    size_t key_g = aisnmea_batch_add_key (batch, "g");
+    size_t key_x = aisnmea_batch_add_key (batch, "x");
+
+    // CRLF and LF endings, a GPS sentence, junk, a blank line and an
+    // unterminated last line
+    char *text = zsys_sprintf ("%s\r\n%s\n$GPGGA,1*00\r\n\r\n%s\nnoise\n%s",
+                               lines [0], lines [1], lines [2], lines [3]);
+    size_t added = aisnmea_batch_add (batch, text, strlen (text));
+    assert (added == line_count);
+    assert (aisnmea_batch_size (batch) == line_count);
+    assert (aisnmea_batch_errors (batch) == 2);
+
+    // Every row matches what aisnmea_parse makes of its line
+    aisnmea_t *ref = aisnmea_new (NULL);
+    for (size_t row = 0; row < line_count; ++row) {
+        int rc = aisnmea_parse (ref, lines [row]);
+        assert (!rc);
+        assert (aisnmea_batch_line_size (batch, row) == strlen (lines [row]));
+        assert (memcmp (aisnmea_batch_line (batch, row), lines [row],
+                        strlen (lines [row])) == 0);
+        assert (memcmp (aisnmea_batch_head (batch, row), aisnmea_head (ref), 6) == 0);
+        assert (aisnmea_batch_fragcount (batch, row) == aisnmea_fragcount (ref));
+        assert (aisnmea_batch_fragnum (batch, row) == aisnmea_fragnum (ref));
+        assert (aisnmea_batch_messageid (batch, row) == aisnmea_messageid (ref));
+        assert (aisnmea_batch_channel (batch, row) == aisnmea_channel (ref));
+        assert (aisnmea_batch_payload_size (batch, row) == strlen (aisnmea_payload (ref)));
+        assert (memcmp (aisnmea_batch_payload (batch, row), aisnmea_payload (ref),
+                        strlen (aisnmea_payload (ref))) == 0);
+        assert (aisnmea_batch_fillbits (batch, row) == aisnmea_fillbits (ref));
+        assert (aisnmea_batch_aismsgtype (batch, row) == aisnmea_aismsgtype (ref));
+        assert (aisnmea_batch_timestamp (batch, row) == aisnmea_timestamp (ref));
+        assert (aisnmea_batch_tagblockval (batch, row, key_x) == NULL);
+    }
+    aisnmea_destroy (&ref);
+
+    assert (aisnmea_batch_tagblockval_size (batch, 0, key_s) == 10);
+    assert (memcmp (aisnmea_batch_tagblockval (batch, 0, key_s), "r003669945", 10) == 0);
+    assert (aisnmea_batch_tagblockval_size (batch, 0, key_g) == 9);
+    assert (memcmp (aisnmea_batch_tagblockval (batch, 0, key_g), "1-2-73874", 9) == 0);
+    assert (aisnmea_batch_tagblockval (batch, 1, key_s) == NULL);
+    assert (aisnmea_batch_tagblockval_size (batch, 1, key_s) == 0);
+
+    // Whole columns are the arrays behind the accessors
+    assert (aisnmea_batch_column (batch, "nonesuch") == NULL);
+    const uint8_t *fragnum_column = (const uint8_t *) aisnmea_batch_column (batch, "fragnum");
+    const int8_t *msgtype_column = (const int8_t *) aisnmea_batch_column (batch, "msgtype");
+    const uint32_t *payload_column = (const uint32_t *) aisnmea_batch_column (batch, "payload");
+    const uint32_t *key_column = (const uint32_t *) aisnmea_batch_key_column (batch, key_s);
+    for (size_t row = 0; row < line_count; ++row) {
+        assert (fragnum_column [row] == aisnmea_batch_fragnum (batch, row));
+        assert (msgtype_column [row] == aisnmea_batch_aismsgtype (batch, row));
+        assert (payload_column [row * 2 + 1] == aisnmea_batch_payload_size (batch, row));
+        assert (memcmp (text + payload_column [row * 2], aisnmea_batch_payload (batch, row),
+                        payload_column [row * 2 + 1]) == 0);
+        assert (key_column [row * 2 + 1] == aisnmea_batch_tagblockval_size (batch, row, key_s));
+    }
+    assert (memcmp (text + key_column [0], "r003669945", 10) == 0);
+
+    // Payloads unarmoured together match aisnmea_payload_bits
+    assert (aisnmea_batch_column (batch, "bits") == NULL);
+    assert (aisnmea_batch_unarmour (batch) == 0);
+    assert (aisnmea_batch_column (batch, "bits") == aisnmea_batch_bits (batch, 0));
+    for (size_t row = 0; row < line_count; ++row) {
+        const char *payload = aisnmea_batch_payload (batch, row);
+        size_t payload_size = aisnmea_batch_payload_size (batch, row);
+        size_t bits_size = aisnmea_batch_bits_size (batch, row);
+        assert (bits_size == payload_size * 6 - aisnmea_batch_fillbits (batch, row));
+        const byte *bits = aisnmea_batch_bits (batch, row);
+        for (size_t bit = 0; bit + 8 <= payload_size * 6; bit += 8)
+            assert (bits [bit / 8] == aisnmea_payload_bits (payload, payload_size, bit, 8));
+    }
+    const uint32_t *bitspans = (const uint32_t *) aisnmea_batch_column (batch, "bitspan");
+    assert (bitspans [0] == 0);
+    assert (bitspans [1] == 168);
+    assert (bitspans [2] == 21);
+    assert (bitspans [6] == 21 + 42 + 12);
+    assert (aisnmea_batch_bits (batch, 1) == aisnmea_batch_bits (batch, 0) + 21);
+
+    // Each kernel the CPU has agrees with the scalar one, at every length
+    // and with bad chars anywhere
+    unarmour_fn *kernels [3] = { s_unarmour_scalar, NULL, NULL };
+#ifdef UNARMOUR_X86
+    if (__builtin_cpu_supports ("ssse3"))
+        kernels [1] = s_unarmour_ssse3;
+    if (__builtin_cpu_supports ("avx2"))
+        kernels [2] = s_unarmour_avx2;
+#endif
+    const char *sixbit = "0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVW`abcdefghijklmnopqrstuvw";
+    const char *badchars = "X_x/,\x80\xff";
+    uint32_t seed = 1;
+    for (int trial = 0; trial < 2000; ++trial) {
+        char payload [100 + TEXT_SLACK];
+        size_t size = (size_t) trial % 100;
+        for (size_t i = 0; i < sizeof (payload); ++i) {
+            seed = seed * 1103515245 + 12345;
+            payload [i] = sixbit [(seed >> 16) % 64];
+        }
+        bool bad = trial % 3 == 0 && size > 0;
+        if (bad)
+            payload [(seed >> 8) % size] = badchars [trial % 7];
+        byte expected [75 + TEXT_SLACK];
+        byte actual [75 + TEXT_SLACK];
+        size_t bytes = (size * 6 + 7) / 8;
+        assert (s_unarmour_scalar (payload, size, expected) == !bad);
+        for (int k = 1; k < 3; ++k) {
+            if (!kernels [k])
+                continue;
+            memset (actual, 0xAA, sizeof (actual));
+            assert (kernels [k] (payload, size, actual) == !bad);
+            if (!bad)
+                assert (memcmp (actual, expected, bytes) == 0);
+        }
+    }
+    if (verbose)
+        zsys_debug ("unarmour kernels: ssse3 %s, avx2 %s",
+                    kernels [1]? "yes": "no", kernels [2]? "yes": "no");
+
+    // Exported to Arrow, numbers are shared and strings are views
+    struct ArrowArray array;
+    struct ArrowSchema schema;
+    assert (aisnmea_batch_export (batch, &array, &schema) == 0);
+    assert (streq (schema.format, "+s"));
+    assert (schema.n_children == 12);
+    assert (array.length == (int64_t) line_count);
+    assert (array.n_children == 12);
+    assert (streq (schema.children [0]->name, "head"));
+    assert (streq (schema.children [0]->format, "vu"));
+    assert (streq (schema.children [8]->format, "tss:UTC"));
+    assert (streq (schema.children [9]->name, "s"));
+    assert (streq (schema.children [10]->name, "g"));
+    assert (streq (schema.children [11]->name, "x"));
+
+    struct ArrowArray *fragnums = array.children [2];
+    assert (fragnums->length == (int64_t) line_count);
+    assert (fragnums->null_count == 0);
+    assert (((const uint8_t *) fragnums->buffers [1]) [2] == 2);
+    struct ArrowArray *messageids = array.children [3];
+    assert (messageids->null_count == 2);
+    assert (((const byte *) messageids->buffers [0]) [0] == 0x06);
+    assert (array.children [4]->null_count == 1);
+    assert (array.children [8]->null_count == 3);
+    assert (((const uint64_t *) array.children [8]->buffers [1]) [0] == 1241544035);
+    assert (array.children [11]->null_count == (int64_t) line_count);
+
+    // Short strings are held in their views, longer ones point at the text
+    const byte *views = (const byte *) array.children [0]->buffers [1];
+    assert (memcmp (views + 4, "!AIVDM", 6) == 0);
+    assert (memcmp (views + 3 * 16 + 4, "!AIVDO", 6) == 0);
+    struct ArrowArray *payloads = array.children [5];
+    views = (const byte *) payloads->buffers [1];
+    int32_t length, window, offset;
+    memcpy (&length, views + 16, 4);
+    memcpy (&window, views + 16 + 8, 4);
+    memcpy (&offset, views + 16 + 12, 4);
+    assert (length == 56);
+    assert (window == 0);
+    assert (memcmp (views + 16 + 4, "55P5", 4) == 0);
+    assert (memcmp ((const char *) payloads->buffers [2 + window] + offset,
+                    aisnmea_batch_payload (batch, 1), 56) == 0);
+    assert (payloads->n_buffers == 4);
+    assert (((const int64_t *) payloads->buffers [3]) [0] > 0);
+
+    // Columns can be released on their own, before the rest
+    payloads->release (payloads);
+    assert (!payloads->release);
+    array.release (&array);
+    assert (!array.release);
+    schema.release (&schema);
+    assert (!schema.release);
+
+    // The caller's buffer is free to reuse, and more adds append
+    memset (text, 'x', strlen (text));
+    assert (aisnmea_batch_payload (batch, 3) [0] == '1');
+    assert (aisnmea_batch_add (batch, lines [2], strlen (lines [2])) == 1);
+    assert (aisnmea_batch_size (batch) == line_count + 1);
+    assert (aisnmea_batch_fragnum (batch, line_count) == 2);
+    zstr_free (&text);
+
+    // Enough rows to make the columns grow
+    aisnmea_batch_clear (batch);
+    assert (aisnmea_batch_size (batch) == 0);
+    assert (aisnmea_batch_errors (batch) == 0);
+    assert (aisnmea_batch_column (batch, "line") == NULL);
+    assert (aisnmea_batch_column (batch, "bits") == NULL);
+    for (int i = 0; i < 5000; ++i)
+        aisnmea_batch_add (batch, lines [0], strlen (lines [0]));
+    assert (aisnmea_batch_size (batch) == 5000);
+    assert (aisnmea_batch_timestamp (batch, 4999) == 1241544035);
+    assert (memcmp (aisnmea_batch_tagblockval (batch, 4999, key_s), "r003669945", 10) == 0);
+    assert (aisnmea_batch_unarmour (batch) == 0);
+    assert (aisnmea_batch_bits (batch, 4999) == aisnmea_batch_bits (batch, 0) + 4999 * 21);
+    assert (memcmp (aisnmea_batch_bits (batch, 4999), aisnmea_batch_bits (batch, 0), 21) == 0);
+    if (verbose)
+        zsys_debug ("%zu rows", aisnmea_batch_size (batch));
+
+    aisnmea_batch_destroy (&batch);
+    assert (!batch);
+
+    //  @end
+    printf ("OK\n");
+}
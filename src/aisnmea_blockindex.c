@@ -0,0 +1,457 @@
+/*  =========================================================================
+    aisnmea_blockindex - Per-block message type and MMSI summary for skipping archive blocks
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_blockindex - Per-block message type and MMSI summary for skipping archive blocks
+@discuss
+    Each line belongs to the block its first byte falls in, so blocks
+    always start on a line boundary. Blocks in which no line starts (a
+    single line longer than the block size) get no entry.
+
+    Only first fragments carry a message type and MMSI; the rest of a
+    multipart message may spill into the next block, so a reader that
+    finds a wanted message near the end of a block should read on until
+    it is complete.
+
+    The sidecar is plain text: a header line, then one line per block
+    giving its offset, type bitmap in hex, and MMSI range.
+
+        aisnmea_blockindex 1 <block size> <archive size>
+        0 00200022 2320001 477553000
+        65536 00000002 211000000 636000000
+        ...
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+#define BLOCKINDEX_MAGIC   "aisnmea_blockindex"
+#define BLOCKINDEX_VERSION 1
+
+typedef struct {
+    uint64_t offset;     // byte offset of the block's first line
+    uint32_t types;      // bit N set if type N seen; bit 0 for bad lines
+    int mmsi_min;        // -1 if no MMSI seen
+    int mmsi_max;
+} block_t;
+
+//  Structure of our class
+
+struct _aisnmea_blockindex_t {
+    size_t block_size;
+    uint64_t file_size;
+    block_t *blocks;
+    size_t count;
+    size_t capacity;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Internal constructor and block append
+
+static aisnmea_blockindex_t *
+s_blockindex_new (size_t block_size)
+{
+    aisnmea_blockindex_t *self =
+        (aisnmea_blockindex_t *) zmalloc (sizeof (aisnmea_blockindex_t));
+    assert (self);
+    self->block_size = block_size;
+    return self;
+}
+
+static block_t *
+s_blockindex_append (aisnmea_blockindex_t *self, uint64_t offset)
+{
+    if (self->count == self->capacity) {
+        self->capacity = self->capacity ? self->capacity * 2 : 256;
+        self->blocks = (block_t *) realloc (self->blocks,
+                                            self->capacity * sizeof (block_t));
+        assert (self->blocks);
+    }
+    block_t *block = &self->blocks [self->count++];
+    block->offset = offset;
+    block->types = 0;
+    block->mmsi_min = -1;
+    block->mmsi_max = -1;
+    return block;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Build an index by scanning an archive
+
+aisnmea_blockindex_t *
+aisnmea_blockindex_build (const char *path, size_t block_size)
+{
+    assert (path);
+    assert (block_size);
+
+    zfile_t *file = zfile_new (NULL, path);
+    if (!file)
+        return NULL;
+    if (zfile_input (file)) {
+        zfile_destroy (&file);
+        return NULL;
+    }
+    FILE *handle = zfile_handle (file);
+    assert (handle);
+
+    aisnmea_blockindex_t *self = s_blockindex_new (block_size);
+    aisnmea_t *parser = aisnmea_new (NULL);
+    assert (parser);
+
+    block_t *block = NULL;
+    uint64_t block_number = 0;
+    while (true) {
+        long offset = ftell (handle);
+        assert (offset >= 0);
+        const char *line = zfile_readln (file);
+        if (!line)
+            break;
+
+        if (!block || (uint64_t) offset / block_size != block_number) {
+            block_number = (uint64_t) offset / block_size;
+            block = s_blockindex_append (self, (uint64_t) offset);
+        }
+
+        if (aisnmea_parse (parser, line)) {
+            block->types |= 1;
+            continue;
+        }
+        if (aisnmea_fragnum (parser) != 1)
+            continue;
+
+        int msgtype = aisnmea_aismsgtype (parser);
+        block->types |= (uint32_t) 1 << (msgtype > 0 ? msgtype : 0);
+
+        int mmsi = aisnmea_mmsi (parser);
+        if (mmsi >= 0) {
+            if (block->mmsi_min < 0 || mmsi < block->mmsi_min)
+                block->mmsi_min = mmsi;
+            if (mmsi > block->mmsi_max)
+                block->mmsi_max = mmsi;
+        }
+    }
+    long size = ftell (handle);
+    assert (size >= 0);
+    self->file_size = (uint64_t) size;
+
+    aisnmea_destroy (&parser);
+    zfile_destroy (&file);
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Load a block index sidecar
+
+aisnmea_blockindex_t *
+aisnmea_blockindex_load (const char *path)
+{
+    assert (path);
+    FILE *file = fopen (path, "r");
+    if (!file)
+        return NULL;
+
+    aisnmea_blockindex_t *self = NULL;
+    char magic [32];
+    int version;
+    size_t block_size;
+    uint64_t file_size;
+    if (fscanf (file, "%31s %d %zu %" SCNu64,
+                magic, &version, &block_size, &file_size) != 4
+    ||  !streq (magic, BLOCKINDEX_MAGIC)
+    ||  version != BLOCKINDEX_VERSION
+    ||  block_size == 0)
+        goto die;
+
+    self = s_blockindex_new (block_size);
+    self->file_size = file_size;
+
+    uint64_t offset;
+    uint32_t types;
+    int mmsi_min, mmsi_max;
+    int rc;
+    while ((rc = fscanf (file, "%" SCNu64 " %" SCNx32 " %d %d",
+                         &offset, &types, &mmsi_min, &mmsi_max)) == 4) {
+        if ((self->count && offset <= self->blocks [self->count - 1].offset)
+        ||  offset > file_size
+        ||  mmsi_min > mmsi_max)
+            goto die;
+        block_t *block = s_blockindex_append (self, offset);
+        block->types = types;
+        block->mmsi_min = mmsi_min;
+        block->mmsi_max = mmsi_max;
+    }
+    if (rc != EOF)
+        goto die;
+
+    fclose (file);
+    return self;
+
+ die:
+    aisnmea_blockindex_destroy (&self);
+    fclose (file);
+    return NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_blockindex
+
+void
+aisnmea_blockindex_destroy (aisnmea_blockindex_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_blockindex_t *self = *self_p;
+        free (self->blocks);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Write the block index sidecar
+
+int
+aisnmea_blockindex_save (aisnmea_blockindex_t *self, const char *path)
+{
+    assert (self);
+    assert (path);
+    FILE *file = fopen (path, "w");
+    if (!file)
+        return -1;
+
+    fprintf (file, "%s %d %zu %" PRIu64 "\n",
+             BLOCKINDEX_MAGIC, BLOCKINDEX_VERSION, self->block_size, self->file_size);
+    for (size_t i = 0; i < self->count; ++i) {
+        block_t *block = &self->blocks [i];
+        fprintf (file, "%" PRIu64 " %08" PRIx32 " %d %d\n",
+                 block->offset, block->types, block->mmsi_min, block->mmsi_max);
+    }
+
+    int rc = ferror (file) ? -1 : 0;
+    if (fclose (file))
+        rc = -1;
+    return rc;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Queries
+
+size_t
+aisnmea_blockindex_size (aisnmea_blockindex_t *self)
+{
+    assert (self);
+    return self->count;
+}
+
+size_t
+aisnmea_blockindex_next (aisnmea_blockindex_t *self, size_t from, uint32_t types, int mmsi)
+{
+    assert (self);
+    for (size_t i = from; i < self->count; ++i) {
+        block_t *block = &self->blocks [i];
+        if (!(block->types & types))
+            continue;
+        if (mmsi >= 0
+        && (block->mmsi_min < 0 || mmsi < block->mmsi_min || mmsi > block->mmsi_max))
+            continue;
+        return i;
+    }
+    return self->count;
+}
+
+uint64_t
+aisnmea_blockindex_offset (aisnmea_blockindex_t *self, size_t block)
+{
+    assert (self);
+    assert (block < self->count);
+    return self->blocks [block].offset;
+}
+
+uint64_t
+aisnmea_blockindex_length (aisnmea_blockindex_t *self, size_t block)
+{
+    assert (self);
+    assert (block < self->count);
+    uint64_t end = block + 1 < self->count ? self->blocks [block + 1].offset
+                                           : self->file_size;
+    return end - self->blocks [block].offset;
+}
+
+uint32_t
+aisnmea_blockindex_types (aisnmea_blockindex_t *self, size_t block)
+{
+    assert (self);
+    assert (block < self->count);
+    return self->blocks [block].types;
+}
+
+int
+aisnmea_blockindex_mmsi_min (aisnmea_blockindex_t *self, size_t block)
+{
+    assert (self);
+    assert (block < self->count);
+    return self->blocks [block].mmsi_min;
+}
+
+int
+aisnmea_blockindex_mmsi_max (aisnmea_blockindex_t *self, size_t block)
+{
+    assert (self);
+    assert (block < self->count);
+    return self->blocks [block].mmsi_max;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_blockindex_test (bool verbose)
+{
+    printf (" * aisnmea_blockindex: ");
+
+    //  @selftest
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw.
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    char *archive = zsys_sprintf ("%s/blockindex.nmea", SELFTEST_DIR_RW);
+    char *sidecar = zsys_sprintf ("%s/blockindex.nmea.bidx", SELFTEST_DIR_RW);
+
+    // Lines with the type bit and MMSI each should contribute
+    struct {
+        const char *line;
+        uint32_t types;
+        int mmsi;
+    } lines [] = {
+        { "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13", 1 << 1, 367078250 },
+        { "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C", 1 << 1, 477553000 },
+        { "!AIVDM,1,1,,A,402=VP@00000,0*5B", 1 << 4, 2320001 },
+        { "garbage", 1, -1 },
+        { "!AIVDM,2,1,3,B,55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53,0*3E",
+          1 << 5, 369190000 },
+        { "!AIVDM,2,2,3,B,1@0000000000000,2*55", 0, -1 },
+        { "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13", 1 << 1, 367078250 },
+        { "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13", 1 << 1, 367078250 },
+        { "!AIVDM,1,1,,A,E>jHC6000000,0*0A", 1 << 21, 992351000 },
+        { "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C", 1 << 1, 477553000 },
+    };
+    const size_t line_count = sizeof (lines) / sizeof (lines [0]);
+    const size_t block_size = 100;
+    long starts [sizeof (lines) / sizeof (lines [0])];
+
+    FILE *out = fopen (archive, "w");
+    assert (out);
+    for (size_t i = 0; i < line_count; ++i) {
+        starts [i] = ftell (out);
+        fprintf (out, "%s\n", lines [i].line);
+    }
+    long archive_size = ftell (out);
+    fclose (out);
+
+    assert (aisnmea_blockindex_build ("src/selftest-rw/no_such_file", 100) == NULL);
+    aisnmea_blockindex_t *index = aisnmea_blockindex_build (archive, block_size);
+    assert (index);
+
+    // Work out what each block should hold from the line offsets
+    size_t block = 0;
+    uint32_t want_types = 0;
+    int want_min = -1, want_max = -1;
+    uint64_t length_sum = 0;
+    for (size_t i = 0; i <= line_count; ++i) {
+        bool block_done = i == line_count
+                       || (i > 0 && starts [i] / block_size != starts [i - 1] / block_size);
+        if (block_done) {
+            assert (aisnmea_blockindex_types (index, block) == want_types);
+            assert (aisnmea_blockindex_mmsi_min (index, block) == want_min);
+            assert (aisnmea_blockindex_mmsi_max (index, block) == want_max);
+            length_sum += aisnmea_blockindex_length (index, block);
+            if (verbose)
+                zsys_debug ("block %zu at %" PRIu64 ": %08x %d-%d", block,
+                            aisnmea_blockindex_offset (index, block),
+                            want_types, want_min, want_max);
+            ++block;
+            want_types = 0;
+            want_min = want_max = -1;
+        }
+        if (i == line_count)
+            break;
+        if (block_done || i == 0)
+            assert (aisnmea_blockindex_offset (index, block) == (uint64_t) starts [i]);
+        want_types |= lines [i].types;
+        if (lines [i].mmsi >= 0) {
+            if (want_min < 0 || lines [i].mmsi < want_min)
+                want_min = lines [i].mmsi;
+            if (lines [i].mmsi > want_max)
+                want_max = lines [i].mmsi;
+        }
+    }
+    assert (aisnmea_blockindex_size (index) == block);
+    assert (length_sum == (uint64_t) archive_size);
+
+    // Type 21 appears once, near the end
+    size_t found = aisnmea_blockindex_next (index, 0, 1 << 21, -1);
+    assert (found < aisnmea_blockindex_size (index));
+    assert (aisnmea_blockindex_offset (index, found) <= (uint64_t) starts [8]);
+    assert (aisnmea_blockindex_offset (index, found)
+            + aisnmea_blockindex_length (index, found) > (uint64_t) starts [8]);
+    assert (aisnmea_blockindex_next (index, found + 1, 1 << 21, -1)
+            == aisnmea_blockindex_size (index));
+
+    // Nothing of type 24, and MMSI has to match too
+    assert (aisnmea_blockindex_next (index, 0, 1 << 24, -1)
+            == aisnmea_blockindex_size (index));
+    assert (aisnmea_blockindex_next (index, 0, 1 << 21, 367078250)
+            == aisnmea_blockindex_size (index));
+    assert (aisnmea_blockindex_next (index, 0, 1 << 5, 369190000)
+            < aisnmea_blockindex_size (index));
+
+    // Round trip through a sidecar
+    int rc = aisnmea_blockindex_save (index, sidecar);
+    assert (rc == 0);
+    aisnmea_blockindex_t *loaded = aisnmea_blockindex_load (sidecar);
+    assert (loaded);
+    assert (aisnmea_blockindex_size (loaded) == aisnmea_blockindex_size (index));
+    for (size_t i = 0; i < aisnmea_blockindex_size (index); ++i) {
+        assert (aisnmea_blockindex_offset (loaded, i) == aisnmea_blockindex_offset (index, i));
+        assert (aisnmea_blockindex_length (loaded, i) == aisnmea_blockindex_length (index, i));
+        assert (aisnmea_blockindex_types (loaded, i) == aisnmea_blockindex_types (index, i));
+        assert (aisnmea_blockindex_mmsi_min (loaded, i) == aisnmea_blockindex_mmsi_min (index, i));
+        assert (aisnmea_blockindex_mmsi_max (loaded, i) == aisnmea_blockindex_mmsi_max (index, i));
+    }
+    aisnmea_blockindex_destroy (&loaded);
+
+    // Reject things that aren't block indexes
+    assert (aisnmea_blockindex_load ("src/selftest-rw/no_such_file") == NULL);
+    assert (aisnmea_blockindex_load (archive) == NULL);
+    out = fopen (sidecar, "w");
+    assert (out);
+    fprintf (out, "aisnmea_blockindex 1 100 500\n0 00000002 5 4\n");
+    fclose (out);
+    assert (aisnmea_blockindex_load (sidecar) == NULL);
+
+    aisnmea_blockindex_destroy (&index);
+    assert (!index);
+    zsys_file_delete (archive);
+    zsys_file_delete (sidecar);
+    zstr_free (&archive);
+    zstr_free (&sidecar);
+
+    //  @end
+    printf ("OK\n");
+}
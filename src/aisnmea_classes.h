@@ -28,6 +28,62 @@
 
 //  Internal API
 
+//  Set an aisnmea from the already split and checksummed parts of a
+//  sentence. 'tagblock' is the "k:v,..." pairs without checksum, or NULL.
+//  Returns 0 on success, -1 if the tagblock pairs are malformed.
+AISNMEA_PRIVATE int
+    aisnmea_set_parsed (aisnmea_t *self, const char *tagblock, const char *head,
+                        size_t fragcount, size_t fragnum, int messageid, char channel,
+                        const char *payload, size_t fillbits, size_t checksum);
+
+//  The tagblock's key/value pairs, or NULL if there was no tagblock or
+//  the aisnmea is a copy in an arena. Owned by the aisnmea; don't modify
+//  it.
+AISNMEA_PRIVATE zhash_t *
+    aisnmea_tagblock (aisnmea_t *self);
+
+//  Read 'width' bits (at most 59) from 'start' bits into an armoured
+//  payload of 'size' chars. Returns -1 if they run off the end or into a
+//  bad char.
+AISNMEA_PRIVATE int64_t
+    aisnmea_payload_bits (const char *payload, size_t size, size_t start, size_t width);
+
+//  Home slot for a key made from an MMSI, in an open-addressed table of
+//  2^'bits' slots. Takes the top bits of a multiplicative hash; the low
+//  bits of the product depend only on the key's low bits, so masking
+//  them would mix nothing in.
+static inline size_t
+aisnmea_mmsi_slot (uint32_t key, unsigned bits)
+{
+    assert (bits > 0 && bits <= 32);
+    return (size_t) ((uint32_t) (key * 2654435761U) >> (32 - bits));
+}
+
+//  One vessel's state, as kept by aisnmea_vessels and copied out into
+//  aisnmea_vessel snapshots. Fields hold the values as sent.
+struct _aisnmea_vessel_t {
+    uint32_t mmsi;
+    uint64_t position_time;     // 0 until a position report comes in
+    int32_t lat;                // 1/10000 minute; 91 degrees if not known
+    int32_t lon;                // 1/10000 minute; 181 degrees if not known
+    uint16_t sog;               // 1/10 knot; 1023 if not known
+    uint16_t cog;               // 1/10 degree; 3600 if not known
+    uint16_t heading;           // degrees; 511 if not known
+    uint8_t status;             // 15 if not known
+    uint8_t shiptype;
+    uint64_t static_time;       // 0 until static data comes in
+    uint32_t imo;
+    uint16_t length;            // metres, bow + stern
+    uint16_t beam;              // metres, port + starboard
+    char callsign [8];
+    char name [21];
+    char destination [21];
+};
+
+//  Set a vessel to "nothing known" for the given MMSI
+AISNMEA_PRIVATE void
+    aisnmea_vessel_reset (aisnmea_vessel_t *self, uint32_t mmsi);
+
 
 //  *** To avoid double-definitions, only define if building without draft ***
 #ifndef AISNMEA_BUILD_DRAFT_API
@@ -0,0 +1,286 @@
+/*  =========================================================================
+    aisnmea_decimate - Per-vessel position report decimation
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_decimate - Per-vessel position report decimation
+@discuss
+    Class A ships report every few seconds, far more often than a map or
+    track store needs. Call check() straight after aisnmea_parse () and
+    drop the line if it returns true.
+
+    Each slot is 8 bytes (MMSI and 32-bit time, good until 2106), and the
+    table holds twice 'capacity' slots, so 200k vessels take 4 MiB. Slots
+    are probed linearly for at most MAX_PROBE slots. Slots whose time is
+    more than an interval old behave just as if empty, so are reused in
+    place with no expiry sweep; if a probe run is full of live vessels
+    the one heard from longest ago is evicted.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+//  Longest run of slots we'll look at for one vessel
+#define MAX_PROBE 32
+
+typedef struct {
+    uint32_t key;       // MMSI + 1; 0 means never used
+    uint32_t time;      // when a report last went through
+} slot_t;
+
+//  Structure of our class
+
+struct _aisnmea_decimate_t {
+    slot_t *slots;
+    size_t mask;        // slot count - 1, slot count is a power of two
+    unsigned bits;      // log2 of slot count
+    uint32_t interval;
+    uint64_t dropped;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_decimate
+
+aisnmea_decimate_t *
+aisnmea_decimate_new (size_t capacity, uint32_t interval)
+{
+    aisnmea_decimate_t *self = (aisnmea_decimate_t *) zmalloc (sizeof (aisnmea_decimate_t));
+    assert (self);
+
+    // At most half full keeps probe runs short
+    size_t slot_count = 16;
+    self->bits = 4;
+    while (slot_count < capacity * 2) {
+        slot_count *= 2;
+        self->bits += 1;
+    }
+
+    self->slots = (slot_t *) zmalloc (slot_count * sizeof (slot_t));
+    assert (self->slots);
+    self->mask = slot_count - 1;
+    self->interval = interval;
+
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_decimate
+
+void
+aisnmea_decimate_destroy (aisnmea_decimate_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_decimate_t *self = *self_p;
+        free (self->slots);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Check for and record a position report
+
+bool
+aisnmea_decimate_check (aisnmea_decimate_t *self, aisnmea_t *msg)
+{
+    assert (self);
+    assert (msg);
+
+    switch (aisnmea_aismsgtype (msg)) {
+        case 1: case 2: case 3: case 18: case 19: case 27:
+            break;
+        default:
+            return false;
+    }
+    int mmsi = aisnmea_mmsi (msg);
+    uint64_t timestamp = aisnmea_timestamp (msg);
+    if (mmsi < 0 || !timestamp || timestamp > UINT32_MAX)
+        return false;
+
+    uint32_t key = (uint32_t) mmsi + 1;
+    uint32_t time = (uint32_t) timestamp;
+    slot_t *target = NULL;   // where we'll record the vessel if it's let through
+    slot_t *oldest = NULL;   // fallback if every slot in the run is live
+
+    size_t hash = aisnmea_mmsi_slot (key, self->bits);
+    for (size_t i = 0; i < MAX_PROBE; ++i) {
+        slot_t *slot = &self->slots [(hash + i) & self->mask];
+
+        // End of the run; vessel can't be further on
+        if (!slot->key) {
+            if (!target)
+                target = slot;
+            break;
+        }
+
+        // Merged feeds can run backwards, so compare without subtracting;
+        // anything earlier than the last report let through is dropped
+        bool live = (uint64_t) time < (uint64_t) slot->time + self->interval;
+
+        if (slot->key == key) {
+            if (live) {
+                self->dropped += 1;
+                return true;
+            }
+            target = slot;
+            break;
+        }
+
+        if (!live && !target)
+            target = slot;
+        if (!oldest || slot->time < oldest->time)
+            oldest = slot;
+    }
+
+    if (!target)
+        target = oldest;
+    target->key = key;
+    target->time = time;
+    return false;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Accessors
+
+uint64_t
+aisnmea_decimate_dropped (aisnmea_decimate_t *self)
+{
+    assert (self);
+    return self->dropped;
+}
+
+void
+aisnmea_decimate_reset (aisnmea_decimate_t *self)
+{
+    assert (self);
+    memset (self->slots, 0, (self->mask + 1) * sizeof (slot_t));
+    self->dropped = 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Selftest helper: make msg a report of 'type' from 'mmsi' at 'time'
+
+static void
+s_make_report (aisnmea_t *msg, int type, uint32_t mmsi, uint64_t time)
+{
+    byte bits [21];
+    memset (bits, 0, sizeof (bits));
+    // 6 bits type, 2 bits repeat indicator, 30 bits MMSI
+    bits [0] = (byte) (type << 2);
+    for (int i = 0; i < 30; ++i)
+        if (mmsi & (1U << (29 - i)))
+            bits [(8 + i) >> 3] |= 0x80 >> ((8 + i) & 7);
+
+    char line [128];
+    int length = aisnmea_encode_payload ("!AIVDM", 'A', -1, NULL, bits, 168,
+                                         line, sizeof (line));
+    assert (length > 0);
+    line [length - 1] = 0;
+    int rc = aisnmea_parse (msg, line);
+    assert (!rc);
+    char time_str [24];
+    snprintf (time_str, sizeof (time_str), "%" PRIu64, time);
+    aisnmea_set_tagblockval (msg, "c", time_str);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_decimate_test (bool verbose)
+{
+    printf (" * aisnmea_decimate: ");
+
+    //  @selftest
+
+    aisnmea_t *msg = aisnmea_new (NULL);
+    assert (msg);
+    aisnmea_decimate_t *decimate = aisnmea_decimate_new (1000, 60);
+    assert (decimate);
+
+    // One ship every 10 seconds for five minutes: one a minute goes through
+    uint64_t start = 1241544000;
+    size_t passed = 0;
+    for (uint64_t t = start; t < start + 300; t += 10) {
+        s_make_report (msg, 1, 235001234, t);
+        assert (aisnmea_mmsi (msg) == 235001234);
+        assert (aisnmea_timestamp (msg) == t);
+        if (!aisnmea_decimate_check (decimate, msg))
+            ++passed;
+    }
+    assert (passed == 5);
+    assert (aisnmea_decimate_dropped (decimate) == 25);
+
+    // Another ship is tracked separately, whatever type its reports are
+    s_make_report (msg, 18, 235009999, start + 5);
+    assert (!aisnmea_decimate_check (decimate, msg));
+    s_make_report (msg, 3, 235009999, start + 30);
+    assert (aisnmea_decimate_check (decimate, msg));
+
+    // Earlier than the last report let through is dropped too
+    s_make_report (msg, 1, 235009999, start);
+    assert (aisnmea_decimate_check (decimate, msg));
+
+    // Static data, and reports with no time, always go through
+    s_make_report (msg, 5, 235001234, start + 301);
+    assert (!aisnmea_decimate_check (decimate, msg));
+    assert (!aisnmea_decimate_check (decimate, msg));
+    s_make_report (msg, 1, 235001234, start + 301);
+    aisnmea_set_tagblockval (msg, "c", NULL);
+    assert (!aisnmea_decimate_check (decimate, msg));
+    assert (!aisnmea_decimate_check (decimate, msg));
+
+    // Second fragments carry no MMSI
+    int rc = aisnmea_parse (msg, "\\c:1241544035*5C\\!AIVDM,2,2,3,B,1@0000000000000,2*55");
+    assert (!rc);
+    assert (!aisnmea_decimate_check (decimate, msg));
+
+    // Nor do sentences with empty payloads
+    rc = aisnmea_parse (msg, "\\c:1241544035*5C\\!AIVDM,1,1,,A,,0*26");
+    assert (!rc);
+    assert (!aisnmea_decimate_check (decimate, msg));
+
+    aisnmea_decimate_reset (decimate);
+    assert (aisnmea_decimate_dropped (decimate) == 0);
+    s_make_report (msg, 1, 235001234, start + 299);
+    assert (!aisnmea_decimate_check (decimate, msg));
+
+    // Far more vessels than it was sized for: still one each at a time,
+    // and each vessel's reports within the interval are mostly caught
+    aisnmea_decimate_destroy (&decimate);
+    decimate = aisnmea_decimate_new (100, 60);
+    assert (decimate);
+    for (uint32_t mmsi = 1; mmsi <= 1000; ++mmsi) {
+        s_make_report (msg, 1, mmsi, start);
+        assert (!aisnmea_decimate_check (decimate, msg));
+    }
+    for (uint32_t mmsi = 991; mmsi <= 1000; ++mmsi) {
+        s_make_report (msg, 1, mmsi, start + 1);
+        aisnmea_decimate_check (decimate, msg);
+    }
+    if (verbose)
+        zsys_debug ("dropped %" PRIu64 " of the last 10", aisnmea_decimate_dropped (decimate));
+    assert (aisnmea_decimate_dropped (decimate) >= 5);
+
+    aisnmea_decimate_destroy (&decimate);
+    assert (!decimate);
+    aisnmea_destroy (&msg);
+
+    //  @end
+    printf ("OK\n");
+}
@@ -0,0 +1,257 @@
+/*  =========================================================================
+    aisnmea_dedup - Duplicate sentence suppression across redundant receivers
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_dedup - Duplicate sentence suppression across redundant receivers
+@discuss
+    Overlapping base stations hear the same VHF transmission, so feeds
+    merged from them carry each sentence several times, differing only
+    in tag block. Call check() straight after aisnmea_parse () and drop
+    the line if it returns true.
+
+    The table holds twice 'capacity' slots, probed linearly for at most
+    MAX_PROBE slots. Slots older than the window are reused in place, so
+    there is no separate expiry sweep; if a probe run is full of live
+    entries the oldest of them is evicted.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+//  Longest run of slots we'll look at for one key
+#define MAX_PROBE 32
+
+typedef struct {
+    uint64_t hash;       // 0 means never used
+    uint64_t timestamp;  // when first seen
+} slot_t;
+
+//  Structure of our class
+
+struct _aisnmea_dedup_t {
+    slot_t *slots;
+    size_t mask;         // slot count - 1, slot count is a power of two
+    uint64_t window;
+    uint64_t dropped;
+};
+
+
+//  --------------------------------------------------------------------------
+//  FNV-1a over the fields that identify a transmission
+
+static uint64_t
+s_sentence_hash (aisnmea_t *msg)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char *cur = (const unsigned char *) aisnmea_payload (msg);
+    while (*cur) {
+        hash ^= *cur++;
+        hash *= 1099511628211ULL;
+    }
+    size_t extras [3] = { aisnmea_fillbits (msg),
+                          aisnmea_fragnum (msg),
+                          aisnmea_fragcount (msg) };
+    for (int i = 0; i < 3; ++i) {
+        hash ^= (uint64_t) extras [i];
+        hash *= 1099511628211ULL;
+    }
+    // Keep 0 free to mark empty slots
+    return hash ? hash : 1;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_dedup
+
+aisnmea_dedup_t *
+aisnmea_dedup_new (size_t capacity, uint64_t window)
+{
+    aisnmea_dedup_t *self = (aisnmea_dedup_t *) zmalloc (sizeof (aisnmea_dedup_t));
+    assert (self);
+
+    // At most half full keeps probe runs short
+    size_t slot_count = 16;
+    while (slot_count < capacity * 2)
+        slot_count *= 2;
+
+    self->slots = (slot_t *) zmalloc (slot_count * sizeof (slot_t));
+    assert (self->slots);
+    self->mask = slot_count - 1;
+    self->window = window;
+
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_dedup
+
+void
+aisnmea_dedup_destroy (aisnmea_dedup_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_dedup_t *self = *self_p;
+        free (self->slots);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Check for and record a sentence
+
+bool
+aisnmea_dedup_check (aisnmea_dedup_t *self, aisnmea_t *msg, uint64_t timestamp)
+{
+    assert (self);
+    assert (msg);
+
+    uint64_t hash = s_sentence_hash (msg);
+    slot_t *target = NULL;   // where we'll record msg if it's new
+    slot_t *oldest = NULL;   // fallback if every slot in the run is live
+
+    for (size_t i = 0; i < MAX_PROBE; ++i) {
+        slot_t *slot = &self->slots [(hash + i) & self->mask];
+
+        // End of the run; key can't be further on
+        if (!slot->hash) {
+            if (!target)
+                target = slot;
+            break;
+        }
+
+        // Timestamps from merged feeds can run backwards, so compare
+        // without subtracting
+        bool live = timestamp < slot->timestamp + self->window;
+
+        if (slot->hash == hash) {
+            if (live) {
+                self->dropped += 1;
+                return true;
+            }
+            target = slot;
+            break;
+        }
+
+        if (!live && !target)
+            target = slot;
+        if (!oldest || slot->timestamp < oldest->timestamp)
+            oldest = slot;
+    }
+
+    if (!target)
+        target = oldest;
+    target->hash = hash;
+    target->timestamp = timestamp;
+    return false;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Accessors
+
+uint64_t
+aisnmea_dedup_dropped (aisnmea_dedup_t *self)
+{
+    assert (self);
+    return self->dropped;
+}
+
+void
+aisnmea_dedup_reset (aisnmea_dedup_t *self)
+{
+    assert (self);
+    memset (self->slots, 0, (self->mask + 1) * sizeof (slot_t));
+    self->dropped = 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_dedup_test (bool verbose)
+{
+    printf (" * aisnmea_dedup: ");
+
+    //  @selftest
+
+    // Same transmission via two receivers, plus a different message
+    aisnmea_t *rx1 = aisnmea_new (
+        "\\g:1-2-73874,n:157036,s:r003669945,c:1241544035*4A"
+        "\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13");
+    aisnmea_t *rx2 = aisnmea_new (
+        "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13");
+    aisnmea_t *other = aisnmea_new (
+        "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C");
+    assert (rx1 && rx2 && other);
+
+    aisnmea_dedup_t *dedup = aisnmea_dedup_new (1000, 10);
+    assert (dedup);
+
+    assert (!aisnmea_dedup_check (dedup, rx1, 100));
+    assert ( aisnmea_dedup_check (dedup, rx2, 101));
+    assert (!aisnmea_dedup_check (dedup, other, 101));
+    assert ( aisnmea_dedup_check (dedup, rx1, 109));
+    assert (aisnmea_dedup_dropped (dedup) == 2);
+
+    // Out of the window counts as a fresh transmission, and restarts it
+    assert (!aisnmea_dedup_check (dedup, rx2, 110));
+    assert ( aisnmea_dedup_check (dedup, rx1, 115));
+
+    // Late arrivals from a lagging receiver still match
+    assert ( aisnmea_dedup_check (dedup, rx2, 105));
+
+    aisnmea_dedup_reset (dedup);
+    assert (aisnmea_dedup_dropped (dedup) == 0);
+    assert (!aisnmea_dedup_check (dedup, rx1, 115));
+
+    // Fragment position is part of the key
+    aisnmea_t *frag = aisnmea_new (
+        "!AIVDM,2,1,3,B,55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53,0*3E");
+    assert (frag);
+    assert (!aisnmea_dedup_check (dedup, frag, 0));
+    assert ( aisnmea_dedup_check (dedup, frag, 1));
+    aisnmea_destroy (&frag);
+
+    // Memory stays bounded: flood a small table with distinct payloads,
+    // then check it still works
+    aisnmea_dedup_destroy (&dedup);
+    dedup = aisnmea_dedup_new (8, 1000);
+    aisnmea_t *msg = aisnmea_new (NULL);
+    for (int i = 0; i < 500; ++i) {
+        char *line = zsys_sprintf ("!AIVDM,1,1,,A,1%05d,0", i);
+        int checksum = 0;
+        for (const char *cur = line + 1; *cur; ++cur)
+            checksum ^= *cur;
+        char *full = zsys_sprintf ("%s*%02X", line, checksum);
+        int rc = aisnmea_parse (msg, full);
+        assert (!rc);
+        assert (!aisnmea_dedup_check (dedup, msg, 0));
+        zstr_free (&line);
+        zstr_free (&full);
+    }
+    assert (!aisnmea_dedup_check (dedup, other, 0));
+    assert ( aisnmea_dedup_check (dedup, other, 1));
+    aisnmea_destroy (&msg);
+
+    aisnmea_dedup_destroy (&dedup);
+    assert (!dedup);
+    aisnmea_destroy (&rx1);
+    aisnmea_destroy (&rx2);
+    aisnmea_destroy (&other);
+
+    //  @end
+    printf ("OK\n");
+}
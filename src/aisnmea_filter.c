@@ -0,0 +1,377 @@
+/*  =========================================================================
+    aisnmea_filter - Compiled sentence filter checked before parsing
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_filter - Compiled sentence filter checked before parsing
+@discuss
+    Most jobs want a small part of a feed, and a full parse splits and
+    copies every field and tag of every line. check() instead walks the
+    raw line once, finding just the fields the filter tests, and stops at
+    the first test that fails: a line from the wrong source is turned
+    away inside its tag block, one of the wrong type on its first payload
+    character. Give the filter to aisnmea_set_filter () and parse does
+    this for you.
+
+    Each test is a table lookup: message types are a bit mask, channels a
+    byte table, MMSIs an open-addressed hash set, and sources a zhash.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+//  Heads are few and short, e.g. "!AIVDM", "!AIVDO", "!BSVDM"
+#define MAX_HEADS 8
+#define MAX_HEAD_SIZE 16
+
+//  Longest tag block source we'll look up
+#define MAX_SOURCE_SIZE 64
+
+//  Structure of our class
+
+struct _aisnmea_filter_t {
+    uint64_t types;                 // bit per message type; 0 to pass all
+    bool channel_test;
+    bool channels [256];
+    size_t head_count;              // 0 to pass all
+    char heads [MAX_HEADS][MAX_HEAD_SIZE];
+    zhash_t *sources;               // NULL to pass all
+    uint32_t *mmsis;                // MMSI + 1 per slot, 0 for empty; NULL to pass all
+    size_t mmsi_mask;               // slot count - 1, slot count is a power of two
+    unsigned mmsi_bits;             // log2 of slot count
+    size_t mmsi_count;
+    bool first_only;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_filter
+
+aisnmea_filter_t *
+aisnmea_filter_new (void)
+{
+    aisnmea_filter_t *self = (aisnmea_filter_t *) zmalloc (sizeof (aisnmea_filter_t));
+    assert (self);
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_filter
+
+void
+aisnmea_filter_destroy (aisnmea_filter_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_filter_t *self = *self_p;
+        zhash_destroy (&self->sources);
+        free (self->mmsis);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Adding tests
+
+void
+aisnmea_filter_add_type (aisnmea_filter_t *self, int type)
+{
+    assert (self);
+    assert (type >= 0 && type < 64);
+    self->types |= 1ULL << type;
+}
+
+void
+aisnmea_filter_add_channel (aisnmea_filter_t *self, char channel)
+{
+    assert (self);
+    self->channel_test = true;
+    self->channels [(byte) channel] = true;
+}
+
+void
+aisnmea_filter_add_head (aisnmea_filter_t *self, const char *head)
+{
+    assert (self);
+    assert (head);
+    assert (strlen (head) < MAX_HEAD_SIZE);
+    assert (self->head_count < MAX_HEADS);
+    strcpy (self->heads [self->head_count++], head);
+}
+
+void
+aisnmea_filter_add_source (aisnmea_filter_t *self, const char *source)
+{
+    assert (self);
+    assert (source);
+    if (!self->sources) {
+        self->sources = zhash_new ();
+        assert (self->sources);
+    }
+    // Values aren't used, only keys
+    zhash_update (self->sources, source, self);
+}
+
+static size_t
+s_mmsi_slot (aisnmea_filter_t *self, uint32_t key)
+{
+    return aisnmea_mmsi_slot (key, self->mmsi_bits);
+}
+
+static void
+s_mmsi_insert (aisnmea_filter_t *self, uint32_t key)
+{
+    size_t slot = s_mmsi_slot (self, key);
+    while (self->mmsis [slot] && self->mmsis [slot] != key)
+        slot = (slot + 1) & self->mmsi_mask;
+    if (!self->mmsis [slot]) {
+        self->mmsis [slot] = key;
+        self->mmsi_count += 1;
+    }
+}
+
+void
+aisnmea_filter_add_mmsi (aisnmea_filter_t *self, uint32_t mmsi)
+{
+    assert (self);
+    assert (mmsi < 0x40000000);   // 30 bits
+
+    // Keep at most half full, so probe runs stay short
+    if (!self->mmsis || (self->mmsi_count + 1) * 2 > self->mmsi_mask + 1) {
+        uint32_t *old = self->mmsis;
+        size_t old_size = old ? self->mmsi_mask + 1 : 0;
+        size_t size = old ? old_size * 2 : 64;
+        self->mmsis = (uint32_t *) zmalloc (size * sizeof (uint32_t));
+        assert (self->mmsis);
+        self->mmsi_mask = size - 1;
+        self->mmsi_bits = old ? self->mmsi_bits + 1 : 6;
+        self->mmsi_count = 0;
+        for (size_t i = 0; i < old_size; ++i)
+            if (old [i])
+                s_mmsi_insert (self, old [i]);
+        free (old);
+    }
+    s_mmsi_insert (self, mmsi + 1);
+}
+
+void
+aisnmea_filter_set_first_only (aisnmea_filter_t *self, bool first_only)
+{
+    assert (self);
+    self->first_only = first_only;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Check helpers
+
+static bool
+s_mmsi_wanted (aisnmea_filter_t *self, uint32_t mmsi)
+{
+    uint32_t key = mmsi + 1;
+    size_t slot = s_mmsi_slot (self, key);
+    while (self->mmsis [slot]) {
+        if (self->mmsis [slot] == key)
+            return true;
+        slot = (slot + 1) & self->mmsi_mask;
+    }
+    return false;
+}
+
+//  Does the tag block, from 'start' up to 'end', have a wanted source
+static bool
+s_source_wanted (aisnmea_filter_t *self, const char *start, const char *end)
+{
+    const char *cur = start;
+    while (cur < end && *cur != '*') {
+        const char *value_end = cur;
+        while (value_end < end && *value_end != ',' && *value_end != '*')
+            ++value_end;
+        if (cur [0] == 's' && cur [1] == ':') {
+            size_t size = value_end - (cur + 2);
+            if (size >= MAX_SOURCE_SIZE)
+                return false;
+            char source [MAX_SOURCE_SIZE];
+            memcpy (source, cur + 2, size);
+            source [size] = 0;
+            return zhash_lookup (self->sources, source) != NULL;
+        }
+        cur = *value_end == ',' ? value_end + 1 : value_end;
+    }
+    return false;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Check a line against the filter
+
+bool
+aisnmea_filter_check (aisnmea_filter_t *self, const char *nmea)
+{
+    assert (self);
+    assert (nmea);
+
+    const char *cur = nmea;
+    if (*cur == '\\') {
+        const char *end = strchr (cur + 1, '\\');
+        if (!end)
+            return true;
+        if (self->sources && !s_source_wanted (self, cur + 1, end))
+            return false;
+        cur = end + 1;
+    }
+    else
+    if (self->sources)
+        return false;
+
+    // Head, fragment count, fragment number, message id, channel, payload
+    const char *fields [6];
+    size_t sizes [6];
+    fields [0] = cur;
+    for (int i = 0; i < 6; ++i) {
+        const char *end = strchr (fields [i], ',');
+        if (!end)
+            return true;
+        sizes [i] = end - fields [i];
+        if (i < 5)
+            fields [i + 1] = end + 1;
+    }
+
+    if (self->head_count) {
+        size_t i;
+        for (i = 0; i < self->head_count; ++i)
+            if (strlen (self->heads [i]) == sizes [0]
+            &&  memcmp (self->heads [i], fields [0], sizes [0]) == 0)
+                break;
+        if (i == self->head_count)
+            return false;
+    }
+
+    bool first = sizes [2] == 1 && fields [2][0] == '1';
+    if (self->first_only && !first)
+        return false;
+
+    if (self->channel_test
+    && (sizes [4] != 1 || !self->channels [(byte) fields [4][0]]))
+        return false;
+
+    if (first && self->types) {
+        int64_t type = aisnmea_payload_bits (fields [5], sizes [5], 0, 6);
+        if (type < 0 || !(self->types & (1ULL << type)))
+            return false;
+    }
+    if (first && self->mmsis) {
+        int64_t mmsi = aisnmea_payload_bits (fields [5], sizes [5], 8, 30);
+        if (mmsi < 0 || !s_mmsi_wanted (self, (uint32_t) mmsi))
+            return false;
+    }
+    return true;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_filter_test (bool verbose)
+{
+    printf (" * aisnmea_filter: ");
+
+    //  @selftest
+
+    const char *type1 = "\\g:1-2-73874,n:157036,s:r003669945,c:1241544035*4A\\"
+                        "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C";
+    const char *type5 = "!AIVDM,2,1,3,A,55NBjP01mtGIL@CW;SM<D60P5Ld000000000000P0`<3557l0<50@PCP000,0*66";
+    const char *frag2 = "!AIVDM,2,2,3,A,00000000000,2*22";
+    const char *own = "!AIVDO,1,1,,,B5N4cJ`005Jrek0H@9n`DW5608EP,0*20";
+
+    // Passes everything until told otherwise, even junk
+    aisnmea_filter_t *filter = aisnmea_filter_new ();
+    assert (filter);
+    assert (aisnmea_filter_check (filter, type1));
+    assert (aisnmea_filter_check (filter, type5));
+    assert (aisnmea_filter_check (filter, frag2));
+    assert (aisnmea_filter_check (filter, own));
+    assert (aisnmea_filter_check (filter, ""));
+    assert (aisnmea_filter_check (filter, "\\s:r1*00"));
+
+    // Message types; later fragments pass as they carry no type
+    aisnmea_filter_add_type (filter, 5);
+    assert (!aisnmea_filter_check (filter, type1));
+    assert (aisnmea_filter_check (filter, type5));
+    assert (aisnmea_filter_check (filter, frag2));
+    assert (!aisnmea_filter_check (filter, own));
+    aisnmea_filter_add_type (filter, 18);
+    assert (aisnmea_filter_check (filter, own));
+
+    // Unless only first sentences are wanted
+    aisnmea_filter_set_first_only (filter, true);
+    assert (!aisnmea_filter_check (filter, frag2));
+    assert (aisnmea_filter_check (filter, type5));
+    aisnmea_filter_destroy (&filter);
+    assert (!filter);
+
+    // Channels; own-ship sentences often have none
+    filter = aisnmea_filter_new ();
+    aisnmea_filter_add_channel (filter, 'A');
+    assert (!aisnmea_filter_check (filter, type1));
+    assert (aisnmea_filter_check (filter, type5));
+    assert (!aisnmea_filter_check (filter, own));
+    aisnmea_filter_add_channel (filter, 'B');
+    assert (aisnmea_filter_check (filter, type1));
+    aisnmea_filter_destroy (&filter);
+
+    // Heads
+    filter = aisnmea_filter_new ();
+    aisnmea_filter_add_head (filter, "!AIVDO");
+    assert (!aisnmea_filter_check (filter, type1));
+    assert (aisnmea_filter_check (filter, own));
+    assert (!aisnmea_filter_check (filter, "!AIVD,1,1,,,B5N4cJ`005Jrek0H@9n`DW5608EP,0*20"));
+    aisnmea_filter_destroy (&filter);
+
+    // Sources; lines without one don't pass
+    filter = aisnmea_filter_new ();
+    aisnmea_filter_add_source (filter, "r003669945");
+    assert (aisnmea_filter_check (filter, type1));
+    assert (!aisnmea_filter_check (filter, type5));
+    assert (!aisnmea_filter_check (filter, "\\c:1241544035*5C\\!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C"));
+    assert (!aisnmea_filter_check (filter, "\\s:r003669946*00\\!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C"));
+    assert (!aisnmea_filter_check (filter, "\\s:r00366994*00\\!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C"));
+    assert (aisnmea_filter_check (filter, "\\c:1,s:r003669945*00\\!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C"));
+    aisnmea_filter_destroy (&filter);
+
+    // MMSIs, enough to make the set grow a few times
+    filter = aisnmea_filter_new ();
+    aisnmea_filter_add_mmsi (filter, 477553000);
+    assert (aisnmea_filter_check (filter, type1));
+    assert (!aisnmea_filter_check (filter, type5));
+    assert (aisnmea_filter_check (filter, frag2));
+    for (uint32_t mmsi = 1000; mmsi < 2000; ++mmsi)
+        aisnmea_filter_add_mmsi (filter, mmsi * 7919);
+    assert (aisnmea_filter_check (filter, type1));
+    assert (!aisnmea_filter_check (filter, own));
+    aisnmea_filter_add_mmsi (filter, 367078250);
+    aisnmea_filter_add_mmsi (filter, 367078250);
+    assert (aisnmea_filter_check (filter, own));
+
+    // Several tests at once must all pass
+    aisnmea_filter_add_type (filter, 1);
+    aisnmea_filter_add_channel (filter, 'B');
+    assert (aisnmea_filter_check (filter, type1));
+    assert (!aisnmea_filter_check (filter, own));
+    aisnmea_filter_destroy (&filter);
+
+    //  @end
+    printf ("OK\n");
+}
@@ -0,0 +1,592 @@
+/*  =========================================================================
+    aisnmea_grid - Spatial grid index of vessel positions
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_grid - Spatial grid index of vessel positions
+@discuss
+    The grid is a dense array of cells, rows of latitude by columns of
+    longitude, each the head of a doubly linked list of vessel records,
+    so moving a vessel between cells is O(1). Cells cost 4 bytes each:
+    1 degree cells take 259 KiB, 0.1 degree cells 26 MB. Records live in
+    a preallocated array, with removed ones kept on a free list, and an
+    open-addressed index (linear probing, backward shift on removal)
+    maps MMSIs to them.
+
+    A query walks only the cells its area touches, testing each vessel in
+    them against the exact box or circle. Radius queries bound the circle
+    with a box first, widening to every longitude where the circle takes
+    in a pole.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+//  Mean Earth radius, metres
+#define EARTH_RADIUS 6371008.8
+
+#define DEGREES(radians) ((radians) * 180.0 / M_PI)
+#define RADIANS(degrees) ((degrees) * M_PI / 180.0)
+
+#define NONE UINT32_MAX
+
+typedef struct {
+    uint32_t mmsi;
+    uint32_t cell;
+    uint32_t prev;      // records in the same cell, NONE at the ends;
+    uint32_t next;      // next is also the free list link
+    double lat;
+    double lon;
+} record_t;
+
+//  Structure of our class
+
+struct _aisnmea_grid_t {
+    double cell_size;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t *cells;        // first record in each cell
+    record_t *records;
+    size_t capacity;
+    size_t used;            // records ever handed out
+    uint32_t free_list;
+    size_t size;
+    uint64_t *index;        // (MMSI + 1) << 32 | record; 0 for empty
+    size_t mask;            // index size - 1, index size is a power of two
+    unsigned bits;          // log2 of index size
+    uint32_t *found;        // results of the last query
+    size_t found_size;
+    size_t found_max;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_grid
+
+aisnmea_grid_t *
+aisnmea_grid_new (size_t capacity, double cell_size)
+{
+    assert (capacity && capacity < NONE);
+    assert (cell_size > 0 && cell_size <= 90);
+    aisnmea_grid_t *self = (aisnmea_grid_t *) zmalloc (sizeof (aisnmea_grid_t));
+    assert (self);
+
+    self->cell_size = cell_size;
+    self->rows = (uint32_t) ceil (180 / cell_size);
+    self->cols = (uint32_t) ceil (360 / cell_size);
+    size_t cell_count = (size_t) self->rows * self->cols;
+    self->cells = (uint32_t *) malloc (cell_count * sizeof (uint32_t));
+    assert (self->cells);
+    for (size_t i = 0; i < cell_count; ++i)
+        self->cells [i] = NONE;
+
+    self->records = (record_t *) zmalloc (capacity * sizeof (record_t));
+    assert (self->records);
+    self->capacity = capacity;
+    self->free_list = NONE;
+
+    // At most half full keeps probe runs short
+    size_t index_size = 16;
+    self->bits = 4;
+    while (index_size < capacity * 2) {
+        index_size *= 2;
+        self->bits += 1;
+    }
+    self->index = (uint64_t *) zmalloc (index_size * sizeof (uint64_t));
+    assert (self->index);
+    self->mask = index_size - 1;
+
+    self->found_max = 64;
+    self->found = (uint32_t *) zmalloc (self->found_max * sizeof (uint32_t));
+    assert (self->found);
+
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_grid
+
+void
+aisnmea_grid_destroy (aisnmea_grid_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_grid_t *self = *self_p;
+        free (self->cells);
+        free (self->records);
+        free (self->index);
+        free (self->found);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Index helpers
+
+static size_t
+s_index_slot (aisnmea_grid_t *self, uint64_t key)
+{
+    return aisnmea_mmsi_slot ((uint32_t) key, self->bits);
+}
+
+//  Find vessel's index entry, or the empty one where it would go
+static uint64_t *
+s_index_find (aisnmea_grid_t *self, uint32_t mmsi)
+{
+    uint64_t key = (uint64_t) mmsi + 1;
+    for (size_t slot = s_index_slot (self, key); ; slot = (slot + 1) & self->mask) {
+        uint64_t *entry = &self->index [slot];
+        if (!*entry || *entry >> 32 == key)
+            return entry;
+    }
+}
+
+//  Empty an entry, moving later entries in its run back so lookups
+//  never stop short at the hole
+static void
+s_index_delete (aisnmea_grid_t *self, uint64_t *entry)
+{
+    size_t hole = (size_t) (entry - self->index);
+    size_t slot = hole;
+    while (true) {
+        slot = (slot + 1) & self->mask;
+        if (!self->index [slot])
+            break;
+        // Can the entry here move back into the hole, i.e. does its
+        // home slot not lie cyclically between the hole and here?
+        size_t home = s_index_slot (self, self->index [slot] >> 32);
+        if (((slot - home) & self->mask) >= ((slot - hole) & self->mask)) {
+            self->index [hole] = self->index [slot];
+            hole = slot;
+        }
+    }
+    self->index [hole] = 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Cell helpers
+
+static uint32_t
+s_row (aisnmea_grid_t *self, double lat)
+{
+    double row = floor ((lat + 90) / self->cell_size);
+    return row < 0 ? 0 : row >= self->rows ? self->rows - 1 : (uint32_t) row;
+}
+
+static uint32_t
+s_col (aisnmea_grid_t *self, double lon)
+{
+    double col = floor ((lon + 180) / self->cell_size);
+    return col < 0 ? 0 : col >= self->cols ? self->cols - 1 : (uint32_t) col;
+}
+
+static void
+s_cell_unlink (aisnmea_grid_t *self, uint32_t number)
+{
+    record_t *record = &self->records [number];
+    if (record->prev != NONE)
+        self->records [record->prev].next = record->next;
+    else
+        self->cells [record->cell] = record->next;
+    if (record->next != NONE)
+        self->records [record->next].prev = record->prev;
+}
+
+static void
+s_cell_link (aisnmea_grid_t *self, uint32_t number, uint32_t cell)
+{
+    record_t *record = &self->records [number];
+    record->cell = cell;
+    record->prev = NONE;
+    record->next = self->cells [cell];
+    if (record->next != NONE)
+        self->records [record->next].prev = number;
+    self->cells [cell] = number;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Put a vessel at a position
+
+int
+aisnmea_grid_set (aisnmea_grid_t *self, uint32_t mmsi, double lat, double lon)
+{
+    assert (self);
+    if (!(lat >= -90 && lat <= 90 && lon >= -180 && lon <= 180))
+        return -1;
+
+    uint32_t cell = s_row (self, lat) * self->cols + s_col (self, lon);
+    uint64_t *entry = s_index_find (self, mmsi);
+    uint32_t number;
+    if (*entry) {
+        number = (uint32_t) *entry;
+        if (self->records [number].cell != cell) {
+            s_cell_unlink (self, number);
+            s_cell_link (self, number, cell);
+        }
+    }
+    else {
+        if (self->free_list != NONE) {
+            number = self->free_list;
+            self->free_list = self->records [number].next;
+        }
+        else
+        if (self->used < self->capacity)
+            number = (uint32_t) self->used++;
+        else
+            return -1;
+        self->records [number].mmsi = mmsi;
+        s_cell_link (self, number, cell);
+        *entry = ((uint64_t) mmsi + 1) << 32 | number;
+        self->size += 1;
+    }
+    self->records [number].lat = lat;
+    self->records [number].lon = lon;
+    return 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Take in a message
+
+int
+aisnmea_grid_update (aisnmea_grid_t *self, const char *payload)
+{
+    assert (self);
+    assert (payload);
+
+    size_t size = strlen (payload);
+    int type = (int) aisnmea_payload_bits (payload, size, 0, 6);
+    int64_t mmsi = aisnmea_payload_bits (payload, size, 8, 30);
+
+    // Longitude and latitude offsets and widths, in 1/10000 minute
+    // except for long-range reports' 1/10 minute
+    size_t lon_at, lat_at, lon_bits = 28, lat_bits = 27;
+    double unit = 600000;
+    switch (type) {
+        case 1: case 2: case 3:
+            lon_at = 61;
+            lat_at = 89;
+            break;
+        case 18: case 19:
+            lon_at = 57;
+            lat_at = 85;
+            break;
+        case 27:
+            lon_at = 44;
+            lat_at = 62;
+            lon_bits = 18;
+            lat_bits = 17;
+            unit = 600;
+            break;
+        default:
+            return -1;
+    }
+    int64_t lon = aisnmea_payload_bits (payload, size, lon_at, lon_bits);
+    int64_t lat = aisnmea_payload_bits (payload, size, lat_at, lat_bits);
+    if (mmsi < 0 || lon < 0 || lat < 0)
+        return -1;
+    if (lon & (1LL << (lon_bits - 1)))
+        lon -= 1LL << lon_bits;
+    if (lat & (1LL << (lat_bits - 1)))
+        lat -= 1LL << lat_bits;
+
+    // 181 and 91 degrees mean not available, and are rejected by set
+    if (aisnmea_grid_set (self, (uint32_t) mmsi, lat / unit, lon / unit))
+        return -1;
+    return type;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Take a vessel out
+
+void
+aisnmea_grid_remove (aisnmea_grid_t *self, uint32_t mmsi)
+{
+    assert (self);
+    uint64_t *entry = s_index_find (self, mmsi);
+    if (!*entry)
+        return;
+    uint32_t number = (uint32_t) *entry;
+    s_cell_unlink (self, number);
+    self->records [number].next = self->free_list;
+    self->free_list = number;
+    s_index_delete (self, entry);
+    self->size -= 1;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Query helpers
+
+typedef struct {
+    double lat;             // radians
+    double lon;
+    double cos_lat;
+    double radius;          // metres
+} circle_t;
+
+static double
+s_distance (const circle_t *circle, double lat, double lon)
+{
+    // Haversine, which holds up at short distances
+    lat = RADIANS (lat);
+    double dlat = sin ((lat - circle->lat) / 2);
+    double dlon = sin ((RADIANS (lon) - circle->lon) / 2);
+    double h = dlat * dlat + circle->cos_lat * cos (lat) * dlon * dlon;
+    return 2 * EARTH_RADIUS * asin (sqrt (h < 1 ? h : 1));
+}
+
+static void
+s_found_add (aisnmea_grid_t *self, uint32_t mmsi)
+{
+    if (self->found_size == self->found_max) {
+        self->found_max *= 2;
+        self->found = (uint32_t *) realloc (self->found, self->found_max * sizeof (uint32_t));
+        assert (self->found);
+    }
+    self->found [self->found_size++] = mmsi;
+}
+
+//  Add vessels in a box that doesn't cross the 180th meridian, and if
+//  'circle' is set also within it
+static void
+s_scan (aisnmea_grid_t *self, double min_lat, double min_lon,
+        double max_lat, double max_lon, const circle_t *circle)
+{
+    uint32_t row_end = s_row (self, max_lat);
+    uint32_t col_end = s_col (self, max_lon);
+    for (uint32_t row = s_row (self, min_lat); row <= row_end; ++row) {
+        for (uint32_t col = s_col (self, min_lon); col <= col_end; ++col) {
+            uint32_t number = self->cells [row * self->cols + col];
+            while (number != NONE) {
+                record_t *record = &self->records [number];
+                if (record->lat >= min_lat && record->lat <= max_lat
+                &&  record->lon >= min_lon && record->lon <= max_lon
+                && (!circle || s_distance (circle, record->lat, record->lon) <= circle->radius))
+                    s_found_add (self, record->mmsi);
+                number = record->next;
+            }
+        }
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Find the vessels in a box
+
+size_t
+aisnmea_grid_within (aisnmea_grid_t *self, double min_lat, double min_lon,
+                     double max_lat, double max_lon)
+{
+    assert (self);
+    self->found_size = 0;
+    if (min_lat > max_lat)
+        return 0;
+    if (min_lon <= max_lon)
+        s_scan (self, min_lat, min_lon, max_lat, max_lon, NULL);
+    else {
+        s_scan (self, min_lat, min_lon, max_lat, 180, NULL);
+        s_scan (self, min_lat, -180, max_lat, max_lon, NULL);
+    }
+    return self->found_size;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Find the vessels within a radius
+
+size_t
+aisnmea_grid_near (aisnmea_grid_t *self, double lat, double lon, double radius)
+{
+    assert (self);
+    self->found_size = 0;
+    if (!(lat >= -90 && lat <= 90 && lon >= -180 && lon <= 180 && radius >= 0))
+        return 0;
+
+    circle_t circle = { RADIANS (lat), RADIANS (lon), cos (RADIANS (lat)), radius };
+    double angle = radius / EARTH_RADIUS;
+    double min_lat = lat - DEGREES (angle);
+    double max_lat = lat + DEGREES (angle);
+
+    // Over a pole, or too far out for the longitude bound: every column
+    double sin_lon = circle.cos_lat > 0 ? sin (angle) / circle.cos_lat : 2;
+    if (min_lat <= -90 || max_lat >= 90 || angle >= M_PI / 2 || sin_lon >= 1) {
+        s_scan (self, min_lat < -90 ? -90 : min_lat, -180,
+                max_lat > 90 ? 90 : max_lat, 180, &circle);
+        return self->found_size;
+    }
+    // Widest longitude difference on the circle, which is at a slightly
+    // higher latitude than the centre
+    double delta = DEGREES (asin (sin_lon));
+    double min_lon = lon - delta;
+    double max_lon = lon + delta;
+    if (min_lon < -180) {
+        s_scan (self, min_lat, min_lon + 360, max_lat, 180, &circle);
+        min_lon = -180;
+    }
+    if (max_lon > 180) {
+        s_scan (self, min_lat, -180, max_lat, max_lon - 360, &circle);
+        max_lon = 180;
+    }
+    s_scan (self, min_lat, min_lon, max_lat, max_lon, &circle);
+    return self->found_size;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Accessors
+
+uint32_t
+aisnmea_grid_found (aisnmea_grid_t *self, size_t index)
+{
+    assert (self);
+    assert (index < self->found_size);
+    return self->found [index];
+}
+
+size_t
+aisnmea_grid_size (aisnmea_grid_t *self)
+{
+    assert (self);
+    return self->size;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Selftest helper: is 'mmsi' among the vessels found
+
+static bool
+s_was_found (aisnmea_grid_t *grid, uint32_t mmsi)
+{
+    for (size_t i = 0; i < grid->found_size; ++i)
+        if (grid->found [i] == mmsi)
+            return true;
+    return false;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_grid_test (bool verbose)
+{
+    printf (" * aisnmea_grid: ");
+
+    //  @selftest
+
+    aisnmea_grid_t *grid = aisnmea_grid_new (1000, 1);
+    assert (grid);
+    assert (aisnmea_grid_size (grid) == 0);
+    assert (aisnmea_grid_within (grid, -90, -180, 90, 180) == 0);
+
+    // Position report; lat 47.582833, lon -122.345833
+    int type = aisnmea_grid_update (grid, "177KQJ5000G?tO`K>RA1wUbN0TKH");
+    assert (type == 1);
+    assert (aisnmea_grid_size (grid) == 1);
+    assert (aisnmea_grid_within (grid, 47, -123, 48, -122) == 1);
+    assert (aisnmea_grid_found (grid, 0) == 477553000);
+    assert (aisnmea_grid_within (grid, 47.5829, -123, 48, -122) == 0);
+    assert (aisnmea_grid_near (grid, 47.58, -122.35, 500) == 1);
+    assert (aisnmea_grid_near (grid, 47.58, -122.35, 200) == 0);
+
+    // Not a position report, or too short
+    assert (aisnmea_grid_update (grid, "55NBjP01mtGIL@CW;SM<D60P5Ld000000000000P0`<3557l0<50@PCP0000000000000") == -1);
+    assert (aisnmea_grid_update (grid, "177KQJ5000G?tO`") == -1);
+    assert (aisnmea_grid_size (grid) == 1);
+
+    // Moving between cells, and position not available
+    assert (aisnmea_grid_set (grid, 477553000, 10.5, 20.5) == 0);
+    assert (aisnmea_grid_within (grid, 47, -123, 48, -122) == 0);
+    assert (aisnmea_grid_within (grid, 10, 20, 11, 21) == 1);
+    assert (aisnmea_grid_set (grid, 477553000, 91, 181) == -1);
+    assert (aisnmea_grid_within (grid, 10, 20, 11, 21) == 1);
+
+    // Boxes and circles across the 180th meridian and over a pole
+    assert (aisnmea_grid_set (grid, 1, 0, 179.999) == 0);
+    assert (aisnmea_grid_set (grid, 2, 0, -179.999) == 0);
+    assert (aisnmea_grid_set (grid, 3, 89.999, 0) == 0);
+    assert (aisnmea_grid_set (grid, 4, 89.999, 180) == 0);
+    assert (aisnmea_grid_within (grid, -1, 179, 1, -179) == 2);
+    assert (s_was_found (grid, 1) && s_was_found (grid, 2));
+    assert (aisnmea_grid_near (grid, 0, 180, 1000) == 2);
+    assert (aisnmea_grid_near (grid, 0, -180, 100) == 0);
+    assert (aisnmea_grid_near (grid, 89.99, 90, 2000) == 2);
+    assert (s_was_found (grid, 3) && s_was_found (grid, 4));
+    assert (aisnmea_grid_size (grid) == 5);
+
+    // Removal keeps the rest reachable, and frees a record for reuse
+    aisnmea_grid_remove (grid, 3);
+    aisnmea_grid_remove (grid, 3);
+    assert (aisnmea_grid_size (grid) == 4);
+    assert (aisnmea_grid_near (grid, 89.99, 90, 2000) == 1);
+    assert (aisnmea_grid_found (grid, 0) == 4);
+    aisnmea_grid_destroy (&grid);
+    assert (!grid);
+
+    // Against a brute force scan, with removals to churn the index
+    grid = aisnmea_grid_new (2000, 0.5);
+    assert (grid);
+    double lats [2000], lons [2000];
+    bool present [2000];
+    uint32_t seed = 1;
+    for (uint32_t mmsi = 0; mmsi < 2000; ++mmsi) {
+        seed = seed * 1103515245 + 12345;
+        lats [mmsi] = 50 + (seed >> 8) % 1000 / 100.0;
+        seed = seed * 1103515245 + 12345;
+        lons [mmsi] = (seed >> 8) % 2000 / 100.0 - 10;
+        assert (aisnmea_grid_set (grid, mmsi * 7919, lats [mmsi], lons [mmsi]) == 0);
+        present [mmsi] = true;
+    }
+    for (uint32_t mmsi = 0; mmsi < 2000; mmsi += 3) {
+        aisnmea_grid_remove (grid, mmsi * 7919);
+        present [mmsi] = false;
+    }
+    assert (aisnmea_grid_size (grid) == 1333);
+    for (int query = 0; query < 20; ++query) {
+        double lat = 51 + query * 0.4;
+        double lon = -9 + query;
+        double radius = 20000 + query * 10000;
+        size_t count = aisnmea_grid_near (grid, lat, lon, radius);
+        circle_t circle = { RADIANS (lat), RADIANS (lon), cos (RADIANS (lat)), radius };
+        size_t expected = 0;
+        for (uint32_t mmsi = 0; mmsi < 2000; ++mmsi)
+            if (present [mmsi] && s_distance (&circle, lats [mmsi], lons [mmsi]) <= radius) {
+                assert (s_was_found (grid, mmsi * 7919));
+                ++expected;
+            }
+        assert (count == expected);
+
+        count = aisnmea_grid_within (grid, lat - 1, lon - 1, lat + 0.5, lon + 2);
+        expected = 0;
+        for (uint32_t mmsi = 0; mmsi < 2000; ++mmsi)
+            if (present [mmsi] && lats [mmsi] >= lat - 1 && lats [mmsi] <= lat + 0.5
+            &&  lons [mmsi] >= lon - 1 && lons [mmsi] <= lon + 2)
+                ++expected;
+        assert (count == expected);
+    }
+    for (uint32_t mmsi = 0; mmsi < 2000; ++mmsi)
+        if (present [mmsi])
+            assert (aisnmea_grid_set (grid, mmsi * 7919, 0, 0) == 0);
+    assert (aisnmea_grid_size (grid) == 1333);
+    assert (aisnmea_grid_within (grid, 0, 0, 0, 0) == 1333);
+
+    aisnmea_grid_destroy (&grid);
+
+    //  @end
+    printf ("OK\n");
+}
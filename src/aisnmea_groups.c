@@ -0,0 +1,470 @@
+/*  =========================================================================
+    aisnmea_groups - Reassembles tag block sentence groups and shares their tags
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_groups - Reassembles tag block sentence groups and shares their tags
+@discuss
+    Open groups sit in one array, oldest first, so expiry and eviction
+    only ever look at the front. There are seldom more than a few open at
+    once, so finding a group by ID is a short scan from the newest end.
+
+    Every line is parsed straight into a spare aisnmea, which then moves
+    on (into a group, or out to the caller) as it is; once the caller is
+    done with it, it goes back on the spare list. So in the steady state
+    there's no allocation per line beyond what aisnmea_parse () does.
+
+    Group IDs are only unique per receiver, so feeds merged from several
+    receivers should be split by source before they get here.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+//  Most sentences in a group we'll track
+#define MAX_MEMBERS 16
+
+typedef struct {
+    uint64_t id;
+    size_t total;           // sentences in the group
+    size_t received;
+    size_t next_num;        // where an untagged follower would go
+    uint64_t started;       // line count when the group opened
+    aisnmea_t *members [MAX_MEMBERS];   // by sentence number - 1
+} group_t;
+
+//  Structure of our class
+
+struct _aisnmea_groups_t {
+    aisnmea_t *parser;      // next line is parsed into this
+
+    // Open groups, oldest first
+    group_t *groups;
+    size_t group_count;
+    size_t slots;
+    size_t max_age;
+    uint64_t lines;
+
+    // Group the last line went into, if it's still open
+    bool following;
+    uint64_t following_id;
+
+    // Sentences ready to go out, from ready_head on
+    aisnmea_t **ready;
+    size_t ready_head;
+    size_t ready_count;
+    size_t ready_capacity;
+    aisnmea_t *given;       // last returned by next
+
+    aisnmea_t **spares;
+    size_t spare_count;
+    size_t spare_capacity;
+
+    uint64_t incomplete;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_groups
+
+aisnmea_groups_t *
+aisnmea_groups_new (size_t slots, size_t max_age)
+{
+    assert (slots);
+
+    aisnmea_groups_t *self = (aisnmea_groups_t *) zmalloc (sizeof (aisnmea_groups_t));
+    assert (self);
+    self->parser = aisnmea_new (NULL);
+    assert (self->parser);
+    self->groups = (group_t *) zmalloc (slots * sizeof (group_t));
+    assert (self->groups);
+    self->slots = slots;
+    self->max_age = max_age;
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_groups
+
+void
+aisnmea_groups_destroy (aisnmea_groups_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_groups_t *self = *self_p;
+        aisnmea_destroy (&self->parser);
+        for (size_t i = 0; i < self->group_count; ++i)
+            for (size_t j = 0; j < MAX_MEMBERS; ++j)
+                aisnmea_destroy (&self->groups [i].members [j]);
+        free (self->groups);
+        for (size_t i = self->ready_head; i < self->ready_count; ++i)
+            aisnmea_destroy (&self->ready [i]);
+        free (self->ready);
+        aisnmea_destroy (&self->given);
+        for (size_t i = 0; i < self->spare_count; ++i)
+            aisnmea_destroy (&self->spares [i]);
+        free (self->spares);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Sentence object pool and output queue
+
+static aisnmea_t *
+s_take_spare (aisnmea_groups_t *self)
+{
+    if (self->spare_count)
+        return self->spares [--self->spare_count];
+    aisnmea_t *msg = aisnmea_new (NULL);
+    assert (msg);
+    return msg;
+}
+
+static void
+s_give_spare (aisnmea_groups_t *self, aisnmea_t *msg)
+{
+    if (self->spare_count == self->spare_capacity) {
+        self->spare_capacity = self->spare_capacity ? self->spare_capacity * 2 : 16;
+        self->spares = (aisnmea_t **) realloc (self->spares,
+                           self->spare_capacity * sizeof (aisnmea_t *));
+        assert (self->spares);
+    }
+    self->spares [self->spare_count++] = msg;
+}
+
+static void
+s_make_ready (aisnmea_groups_t *self, aisnmea_t *msg)
+{
+    if (self->ready_count == self->ready_capacity) {
+        self->ready_capacity = self->ready_capacity ? self->ready_capacity * 2 : 16;
+        self->ready = (aisnmea_t **) realloc (self->ready,
+                          self->ready_capacity * sizeof (aisnmea_t *));
+        assert (self->ready);
+    }
+    self->ready [self->ready_count++] = msg;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Parse a "g" tag value, "<sentence>-<total>-<id>". Returns false unless
+//  it's well formed with the sentence number in range.
+
+static bool
+s_parse_group_tag (const char *tag, size_t *num_p, size_t *total_p, uint64_t *id_p)
+{
+    char *end;
+    if (!isdigit ((unsigned char) *tag))
+        return false;
+    unsigned long num = strtoul (tag, &end, 10);
+    if (*end != '-' || !isdigit ((unsigned char) end [1]))
+        return false;
+    unsigned long total = strtoul (end + 1, &end, 10);
+    if (*end != '-' || !isdigit ((unsigned char) end [1]))
+        return false;
+    unsigned long long id = strtoull (end + 1, &end, 10);
+    if (*end || num < 1 || num > total || total > MAX_MEMBERS)
+        return false;
+    *num_p = num;
+    *total_p = total;
+    *id_p = id;
+    return true;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Hand out an open group as it stands, sharing the first line's tags
+
+static void
+s_release_group (aisnmea_groups_t *self, size_t index)
+{
+    group_t *group = &self->groups [index];
+    if (group->received < group->total)
+        self->incomplete += 1;
+
+    aisnmea_t *first = NULL;
+    for (size_t i = 0; i < group->total && !first; ++i)
+        first = group->members [i];
+    zhash_t *tags = first ? aisnmea_tagblock (first) : NULL;
+
+    for (size_t i = 0; i < group->total; ++i) {
+        aisnmea_t *member = group->members [i];
+        if (!member)
+            continue;
+        if (tags && member != first) {
+            const char *value = (const char *) zhash_first (tags);
+            while (value) {
+                const char *key = zhash_cursor (tags);
+                if (!streq (key, "g") && !aisnmea_tagblockval (member, key))
+                    aisnmea_set_tagblockval (member, key, value);
+                value = (const char *) zhash_next (tags);
+            }
+        }
+        s_make_ready (self, member);
+    }
+
+    if (self->following && self->following_id == group->id)
+        self->following = false;
+    self->group_count -= 1;
+    memmove (group, group + 1, (self->group_count - index) * sizeof (group_t));
+}
+
+static group_t *
+s_find_group (aisnmea_groups_t *self, uint64_t id)
+{
+    for (size_t i = self->group_count; i > 0; --i)
+        if (self->groups [i - 1].id == id)
+            return &self->groups [i - 1];
+    return NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Take in a line
+
+int
+aisnmea_groups_push (aisnmea_groups_t *self, const char *line)
+{
+    assert (self);
+    assert (line);
+
+    self->lines += 1;
+    while (self->group_count
+       &&  self->lines - self->groups [0].started > self->max_age)
+        s_release_group (self, 0);
+
+    bool following = self->following;
+    self->following = false;
+    aisnmea_t *msg = self->parser;
+    if (aisnmea_parse (msg, line))
+        return -1;
+
+    group_t *group = NULL;
+    size_t num = 0;
+    const char *tag = aisnmea_tagblockval (msg, "g");
+    if (tag) {
+        size_t total;
+        uint64_t id;
+        if (s_parse_group_tag (tag, &num, &total, &id)) {
+            group = s_find_group (self, id);
+            if (group && (group->total != total || group->members [num - 1]))
+                group = NULL;       // doesn't fit; let it through alone
+            else
+            if (!group) {
+                if (self->group_count == self->slots)
+                    s_release_group (self, 0);
+                group = &self->groups [self->group_count++];
+                memset (group, 0, sizeof (group_t));
+                group->id = id;
+                group->total = total;
+                group->started = self->lines;
+            }
+        }
+    }
+    else
+    if (following && !aisnmea_tagblock (msg)) {
+        group = s_find_group (self, self->following_id);
+        num = group ? group->next_num : 0;
+        if (group && (num > group->total || group->members [num - 1]))
+            group = NULL;
+        if (group) {
+            char tag [64];
+            snprintf (tag, sizeof (tag), "%zu-%zu-%" PRIu64, num, group->total, group->id);
+            aisnmea_set_tagblockval (msg, "g", tag);
+        }
+    }
+
+    self->parser = s_take_spare (self);
+    if (!group) {
+        s_make_ready (self, msg);
+        return 0;
+    }
+
+    group->members [num - 1] = msg;
+    group->received += 1;
+    group->next_num = num + 1;
+    if (group->received == group->total)
+        s_release_group (self, group - self->groups);
+    else {
+        self->following = true;
+        self->following_id = group->id;
+    }
+    return 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Next sentence out
+
+aisnmea_t *
+aisnmea_groups_next (aisnmea_groups_t *self)
+{
+    assert (self);
+    if (self->given) {
+        s_give_spare (self, self->given);
+        self->given = NULL;
+    }
+    if (self->ready_head == self->ready_count) {
+        self->ready_head = self->ready_count = 0;
+        return NULL;
+    }
+    self->given = self->ready [self->ready_head++];
+    return self->given;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Give up waiting on open groups
+
+void
+aisnmea_groups_flush (aisnmea_groups_t *self)
+{
+    assert (self);
+    while (self->group_count)
+        s_release_group (self, 0);
+}
+
+uint64_t
+aisnmea_groups_incomplete (aisnmea_groups_t *self)
+{
+    assert (self);
+    return self->incomplete;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_groups_test (bool verbose)
+{
+    printf (" * aisnmea_groups: ");
+
+    //  @selftest
+
+    const char *part1 = "!AIVDM,2,1,3,B,55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53,0*3E";
+    const char *part2 = "!AIVDM,2,2,3,B,1@0000000000000,2*55";
+    const char *single = "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C";
+    char *lead = zsys_sprintf ("\\g:1-2-73874,s:r003669945,c:1241544035*34\\%s", part1);
+    char *tail = zsys_sprintf ("\\g:2-2-73874*62\\%s", part2);
+    char *other_lead = zsys_sprintf ("\\g:1-2-1234,c:1241544099*2C\\%s", part1);
+    char *other_tail = zsys_sprintf ("\\g:2-2-1234*59\\%s", part2);
+    char *lonely = zsys_sprintf ("\\g:1-3-555,c:1241544100*1D\\%s", single);
+    char *tagged = zsys_sprintf ("\\s:r2*09\\%s", single);
+    assert (lead && tail && other_lead && other_tail && lonely && tagged);
+
+    aisnmea_groups_t *groups = aisnmea_groups_new (2, 10);
+    assert (groups);
+    assert (aisnmea_groups_next (groups) == NULL);
+    assert (aisnmea_groups_push (groups, "junk") == -1);
+
+    // A tagged pair: nothing out until the second line, then both, with
+    // the first line's tags on the second
+    assert (aisnmea_groups_push (groups, lead) == 0);
+    assert (aisnmea_groups_next (groups) == NULL);
+    assert (aisnmea_groups_push (groups, tail) == 0);
+    aisnmea_t *msg = aisnmea_groups_next (groups);
+    assert (msg && aisnmea_fragnum (msg) == 1);
+    assert (aisnmea_timestamp (msg) == 1241544035);
+    msg = aisnmea_groups_next (groups);
+    assert (msg && aisnmea_fragnum (msg) == 2);
+    assert (aisnmea_timestamp (msg) == 1241544035);
+    assert (streq (aisnmea_tagblockval (msg, "s"), "r003669945"));
+    assert (streq (aisnmea_tagblockval (msg, "g"), "2-2-73874"));
+    assert (aisnmea_groups_next (groups) == NULL);
+
+    // Second line untagged, and an ungrouped line passing straight by
+    // when it isn't right after the group
+    assert (aisnmea_groups_push (groups, other_lead) == 0);
+    assert (aisnmea_groups_push (groups, part2) == 0);
+    assert (aisnmea_groups_push (groups, single) == 0);
+    msg = aisnmea_groups_next (groups);
+    assert (msg && aisnmea_fragnum (msg) == 1);
+    msg = aisnmea_groups_next (groups);
+    assert (msg && aisnmea_fragnum (msg) == 2);
+    assert (aisnmea_timestamp (msg) == 1241544099);
+    msg = aisnmea_groups_next (groups);
+    assert (msg && aisnmea_fragcount (msg) == 1 && aisnmea_tagblockval (msg, "c") == NULL);
+    assert (aisnmea_groups_next (groups) == NULL);
+
+    // Out of order members come out in order; an untagged line after a
+    // finished group goes straight through
+    assert (aisnmea_groups_push (groups, other_tail) == 0);
+    assert (aisnmea_groups_next (groups) == NULL);
+    assert (aisnmea_groups_push (groups, other_lead) == 0);
+    assert (aisnmea_groups_push (groups, part2) == 0);
+    msg = aisnmea_groups_next (groups);
+    assert (msg && aisnmea_fragnum (msg) == 1);
+    msg = aisnmea_groups_next (groups);
+    assert (msg && aisnmea_fragnum (msg) == 2 && aisnmea_timestamp (msg) == 1241544099);
+    msg = aisnmea_groups_next (groups);
+    assert (msg && aisnmea_fragnum (msg) == 2 && aisnmea_timestamp (msg) == 0);
+    assert (aisnmea_groups_next (groups) == NULL);
+    assert (aisnmea_groups_incomplete (groups) == 0);
+
+    // A group that never finishes expires after max_age lines, with the
+    // untagged line that followed it
+    assert (aisnmea_groups_push (groups, lonely) == 0);
+    assert (aisnmea_groups_push (groups, single) == 0);
+    for (int i = 0; i < 9; ++i) {
+        assert (aisnmea_groups_push (groups, tagged) == 0);
+        msg = aisnmea_groups_next (groups);
+        assert (msg && streq (aisnmea_tagblockval (msg, "s"), "r2"));
+    }
+    assert (aisnmea_groups_push (groups, tagged) == 0);
+    msg = aisnmea_groups_next (groups);
+    assert (msg && streq (aisnmea_tagblockval (msg, "g"), "1-3-555"));
+    assert (aisnmea_timestamp (msg) == 1241544100);
+    msg = aisnmea_groups_next (groups);
+    assert (msg && aisnmea_timestamp (msg) == 1241544100);
+    assert (streq (aisnmea_tagblockval (msg, "g"), "2-3-555"));
+    msg = aisnmea_groups_next (groups);
+    assert (msg && streq (aisnmea_tagblockval (msg, "s"), "r2"));
+    assert (aisnmea_groups_next (groups) == NULL);
+    assert (aisnmea_groups_incomplete (groups) == 1);
+
+    // With both slots taken, a third group pushes out the oldest
+    assert (aisnmea_groups_push (groups, lonely) == 0);
+    assert (aisnmea_groups_push (groups, lead) == 0);
+    assert (aisnmea_groups_push (groups, other_lead) == 0);
+    msg = aisnmea_groups_next (groups);
+    assert (msg && aisnmea_timestamp (msg) == 1241544100);
+    assert (aisnmea_groups_next (groups) == NULL);
+    assert (aisnmea_groups_incomplete (groups) == 2);
+
+    // Flush lets the rest out, oldest first
+    aisnmea_groups_flush (groups);
+    msg = aisnmea_groups_next (groups);
+    assert (msg && aisnmea_timestamp (msg) == 1241544035);
+    msg = aisnmea_groups_next (groups);
+    assert (msg && aisnmea_timestamp (msg) == 1241544099);
+    assert (aisnmea_groups_next (groups) == NULL);
+    assert (aisnmea_groups_incomplete (groups) == 4);
+
+    // Destroy with lines still held
+    assert (aisnmea_groups_push (groups, lead) == 0);
+    assert (aisnmea_groups_push (groups, single) == 0);
+    aisnmea_groups_destroy (&groups);
+    assert (!groups);
+
+    zstr_free (&lead);
+    zstr_free (&tail);
+    zstr_free (&other_lead);
+    zstr_free (&other_tail);
+    zstr_free (&lonely);
+    zstr_free (&tagged);
+
+    //  @end
+    printf ("OK\n");
+}
@@ -0,0 +1,385 @@
+/*  =========================================================================
+    aisnmea_hist - Log-bucketed latency histogram for timing pipeline stages
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_hist - Log-bucketed latency histogram for timing pipeline stages
+@discuss
+    Values below 32ns each get their own bucket; above that every power of
+    two is split into 16 linear sub-buckets. That bounds the relative error
+    of any reported value to 1/16, and covers the full 64-bit range in a
+    fixed 976-bucket array, so recording never allocates.
+
+    Timing every event costs two clock reads, which matters at millions of
+    lines a second; use set_sampling() to time only one event in N.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+//  Bucket layout: SUB_BITS bits of precision per power of two
+
+#define SUB_BITS     4
+#define SUB_COUNT    (1 << SUB_BITS)
+#define BUCKET_COUNT ((64 - SUB_BITS + 1) * SUB_COUNT)
+
+//  Structure of our class
+
+struct _aisnmea_hist_t {
+    char *name;
+
+    // Sampling: time one event in every 'sample_every'
+    size_t sample_every;
+    size_t sample_tick;
+
+    // Recorded values
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+    uint64_t buckets [BUCKET_COUNT];
+};
+
+
+//  --------------------------------------------------------------------------
+//  Bucket maths
+
+// Index of most significant set bit; v must be nonzero
+static int
+s_msb (uint64_t v)
+{
+#if defined (__GNUC__)
+    return 63 - __builtin_clzll (v);
+#else
+    int res = 0;
+    while (v >>= 1)
+        ++res;
+    return res;
+#endif
+}
+
+static size_t
+s_bucket_index (uint64_t v)
+{
+    if (v < SUB_COUNT)
+        return (size_t) v;
+    int msb = s_msb (v);
+    return (size_t) (msb - SUB_BITS + 1) * SUB_COUNT
+           + (size_t) ((v >> (msb - SUB_BITS)) & (SUB_COUNT - 1));
+}
+
+// Highest value that lands in bucket 'index'
+static uint64_t
+s_bucket_top (size_t index)
+{
+    if (index < SUB_COUNT)
+        return index;
+    int msb = (int) (index / SUB_COUNT) + SUB_BITS - 1;
+    uint64_t sub = index % SUB_COUNT;
+    uint64_t width = (uint64_t) 1 << (msb - SUB_BITS);
+    return ((SUB_COUNT + sub) << (msb - SUB_BITS)) + (width - 1);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_hist
+
+aisnmea_hist_t *
+aisnmea_hist_new (const char *name)
+{
+    assert (name);
+    aisnmea_hist_t *self = (aisnmea_hist_t *) zmalloc (sizeof (aisnmea_hist_t));
+    assert (self);
+
+    self->name = strdup (name);
+    assert (self->name);
+    self->sample_every = 1;
+
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_hist
+
+void
+aisnmea_hist_destroy (aisnmea_hist_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_hist_t *self = *self_p;
+        zstr_free (&self->name);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Timing
+
+void
+aisnmea_hist_set_sampling (aisnmea_hist_t *self, size_t every)
+{
+    assert (self);
+    self->sample_every = every ? every : 1;
+    self->sample_tick = 0;
+}
+
+uint64_t
+aisnmea_hist_start (aisnmea_hist_t *self)
+{
+    assert (self);
+    if (++self->sample_tick < self->sample_every)
+        return 0;
+    self->sample_tick = 0;
+    return aisnmea_hist_clock ();
+}
+
+void
+aisnmea_hist_stop (aisnmea_hist_t *self, uint64_t start)
+{
+    assert (self);
+    if (start)
+        aisnmea_hist_record (self, aisnmea_hist_clock () - start);
+}
+
+void
+aisnmea_hist_record (aisnmea_hist_t *self, uint64_t nanos)
+{
+    assert (self);
+    if (!self->count || nanos < self->min)
+        self->min = nanos;
+    if (nanos > self->max)
+        self->max = nanos;
+    self->count += 1;
+    self->sum += (double) nanos;
+    self->buckets [s_bucket_index (nanos)] += 1;
+}
+
+uint64_t
+aisnmea_hist_clock (void)
+{
+    uint64_t res;
+#if defined (__WINDOWS__)
+    res = (uint64_t) zclock_usecs () * 1000;
+#else
+    struct timespec ts;
+    int rc = clock_gettime (CLOCK_MONOTONIC, &ts);
+    assert (!rc);
+    res = (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+#endif
+    // 0 means "not sampled" to stop(), so never hand it out
+    return res ? res : 1;
+}
+
+void
+aisnmea_hist_reset (aisnmea_hist_t *self)
+{
+    assert (self);
+    self->count = 0;
+    self->min = 0;
+    self->max = 0;
+    self->sum = 0;
+    memset (self->buckets, 0, sizeof (self->buckets));
+}
+
+
+//  --------------------------------------------------------------------------
+//  Statistics
+
+const char *
+aisnmea_hist_name (aisnmea_hist_t *self)
+{
+    assert (self);
+    return self->name;
+}
+
+uint64_t
+aisnmea_hist_count (aisnmea_hist_t *self)
+{
+    assert (self);
+    return self->count;
+}
+
+uint64_t
+aisnmea_hist_min (aisnmea_hist_t *self)
+{
+    assert (self);
+    return self->min;
+}
+
+uint64_t
+aisnmea_hist_max (aisnmea_hist_t *self)
+{
+    assert (self);
+    return self->max;
+}
+
+double
+aisnmea_hist_mean (aisnmea_hist_t *self)
+{
+    assert (self);
+    return self->count ? self->sum / (double) self->count : 0;
+}
+
+uint64_t
+aisnmea_hist_percentile (aisnmea_hist_t *self, double fraction)
+{
+    assert (self);
+    if (!self->count)
+        return 0;
+    if (fraction < 0)
+        fraction = 0;
+    if (fraction > 1)
+        fraction = 1;
+
+    // Rank of the value we want, one-based
+    double exact_rank = fraction * (double) self->count;
+    uint64_t rank = (uint64_t) exact_rank;
+    if ((double) rank < exact_rank)
+        ++rank;
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += self->buckets [i];
+        if (seen >= rank) {
+            // Bucket tops can overshoot the real extreme value
+            uint64_t top = s_bucket_top (i);
+            return top < self->max ? top : self->max;
+        }
+    }
+    return self->max;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Output
+
+void
+aisnmea_hist_print_csv (aisnmea_hist_t *self, FILE *file, bool header)
+{
+    assert (self);
+    assert (file);
+    if (header)
+        fprintf (file, "\"stage\",\"count\",\"min\",\"p50\",\"p90\","
+                       "\"p99\",\"p999\",\"max\",\"mean\"\n");
+    fprintf (file, "\"%s\",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                   ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.1f\n",
+             self->name, self->count, self->min,
+             aisnmea_hist_percentile (self, 0.5),
+             aisnmea_hist_percentile (self, 0.9),
+             aisnmea_hist_percentile (self, 0.99),
+             aisnmea_hist_percentile (self, 0.999),
+             self->max, aisnmea_hist_mean (self));
+}
+
+void
+aisnmea_hist_print_json (aisnmea_hist_t *self, FILE *file)
+{
+    assert (self);
+    assert (file);
+    fprintf (file, "{\"stage\":\"%s\",\"count\":%" PRIu64 ",\"min\":%" PRIu64
+                   ",\"p50\":%" PRIu64 ",\"p90\":%" PRIu64 ",\"p99\":%" PRIu64
+                   ",\"p999\":%" PRIu64 ",\"max\":%" PRIu64 ",\"mean\":%.1f}\n",
+             self->name, self->count, self->min,
+             aisnmea_hist_percentile (self, 0.5),
+             aisnmea_hist_percentile (self, 0.9),
+             aisnmea_hist_percentile (self, 0.99),
+             aisnmea_hist_percentile (self, 0.999),
+             self->max, aisnmea_hist_mean (self));
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_hist_test (bool verbose)
+{
+    printf (" * aisnmea_hist: ");
+
+    //  @selftest
+
+    // -- bucket maths
+
+    // Every bucket's top must map back to that bucket, and the next value
+    // up must start the next bucket
+    for (size_t i = 0; i < BUCKET_COUNT - 1; ++i) {
+        assert (s_bucket_index (s_bucket_top (i)) == i);
+        assert (s_bucket_index (s_bucket_top (i) + 1) == i + 1);
+    }
+    assert (s_bucket_index (UINT64_MAX) == BUCKET_COUNT - 1);
+    assert (s_bucket_top (BUCKET_COUNT - 1) == UINT64_MAX);
+
+    // Exact below 32, then within 1/16
+    assert (s_bucket_top (s_bucket_index (31)) == 31);
+    uint64_t top = s_bucket_top (s_bucket_index (1000000));
+    assert (top >= 1000000 && top - 1000000 <= 1000000 / SUB_COUNT);
+
+    // -- recording and percentiles
+
+    aisnmea_hist_t *hist = aisnmea_hist_new ("parse");
+    assert (hist);
+    assert (streq (aisnmea_hist_name (hist), "parse"));
+    assert (aisnmea_hist_count (hist) == 0);
+    assert (aisnmea_hist_percentile (hist, 0.99) == 0);
+
+    // 1..1000 ns
+    for (uint64_t v = 1; v <= 1000; ++v)
+        aisnmea_hist_record (hist, v);
+
+    assert (aisnmea_hist_count (hist) == 1000);
+    assert (aisnmea_hist_min (hist) == 1);
+    assert (aisnmea_hist_max (hist) == 1000);
+    assert (aisnmea_hist_mean (hist) > 500.4 && aisnmea_hist_mean (hist) < 500.6);
+
+    uint64_t p50 = aisnmea_hist_percentile (hist, 0.5);
+    assert (p50 >= 500 && p50 <= 500 + 500 / SUB_COUNT);
+    uint64_t p99 = aisnmea_hist_percentile (hist, 0.99);
+    assert (p99 >= 990 && p99 <= 1000);
+    assert (aisnmea_hist_percentile (hist, 1.0) == 1000);
+    assert (aisnmea_hist_percentile (hist, 0.0) == 1);
+
+    aisnmea_hist_reset (hist);
+    assert (aisnmea_hist_count (hist) == 0);
+    assert (aisnmea_hist_max (hist) == 0);
+
+    // -- sampling
+
+    aisnmea_hist_set_sampling (hist, 4);
+    size_t timed = 0;
+    for (int i = 0; i < 100; ++i) {
+        uint64_t start = aisnmea_hist_start (hist);
+        if (start)
+            ++timed;
+        aisnmea_hist_stop (hist, start);
+    }
+    assert (timed == 25);
+    assert (aisnmea_hist_count (hist) == 25);
+
+    uint64_t c1 = aisnmea_hist_clock ();
+    uint64_t c2 = aisnmea_hist_clock ();
+    assert (c1 && c2 >= c1);
+
+    if (verbose) {
+        aisnmea_hist_print_csv (hist, stdout, true);
+        aisnmea_hist_print_json (hist, stdout);
+    }
+
+    aisnmea_hist_destroy (&hist);
+    assert (!hist);
+
+    //  @end
+    printf ("OK\n");
+}
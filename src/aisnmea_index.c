@@ -0,0 +1,361 @@
+/*  =========================================================================
+    aisnmea_index - Sparse receive-time index for seeking into NMEA archives
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_index - Sparse receive-time index for seeking into NMEA archives
+@discuss
+    The archive is cut into blocks of 'every' lines. For each block we keep
+    its starting byte offset and the latest time seen in it or any earlier
+    block. That running maximum never decreases, so seek() can binary
+    search it for the first block that could hold anything at or after the
+    requested time, however disordered the archive is within a block.
+
+    The sidecar is plain text: a header line, then one "offset time" line
+    per block.
+
+        aisnmea_index 1 <every> <archive size>
+        0 1241544035
+        48213 1241544097
+        ...
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+#define INDEX_MAGIC   "aisnmea_index"
+#define INDEX_VERSION 1
+
+typedef struct {
+    uint64_t offset;    // byte offset of the block's first line
+    uint64_t time;      // latest time up to the end of the block
+} entry_t;
+
+//  Structure of our class
+
+struct _aisnmea_index_t {
+    size_t every;
+    uint64_t file_size;
+    entry_t *entries;
+    size_t count;
+    size_t capacity;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Internal constructor and entry append
+
+static aisnmea_index_t *
+s_index_new (size_t every)
+{
+    aisnmea_index_t *self = (aisnmea_index_t *) zmalloc (sizeof (aisnmea_index_t));
+    assert (self);
+    self->every = every;
+    return self;
+}
+
+static void
+s_index_append (aisnmea_index_t *self, uint64_t offset, uint64_t time)
+{
+    if (self->count == self->capacity) {
+        self->capacity = self->capacity ? self->capacity * 2 : 256;
+        self->entries = (entry_t *) realloc (self->entries,
+                                             self->capacity * sizeof (entry_t));
+        assert (self->entries);
+    }
+    self->entries [self->count].offset = offset;
+    self->entries [self->count].time = time;
+    self->count += 1;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Build an index by scanning an archive
+
+aisnmea_index_t *
+aisnmea_index_build (const char *path, size_t every)
+{
+    assert (path);
+    assert (every);
+
+    zfile_t *file = zfile_new (NULL, path);
+    if (!file)
+        return NULL;
+    if (zfile_input (file)) {
+        zfile_destroy (&file);
+        return NULL;
+    }
+    FILE *handle = zfile_handle (file);
+    assert (handle);
+
+    aisnmea_index_t *self = s_index_new (every);
+    aisnmea_t *parser = aisnmea_new (NULL);
+    assert (parser);
+
+    uint64_t latest = 0;
+    size_t lineno = 0;
+    while (true) {
+        long offset = ftell (handle);
+        assert (offset >= 0);
+        const char *line = zfile_readln (file);
+        if (!line)
+            break;
+
+        if (lineno++ % every == 0)
+            s_index_append (self, (uint64_t) offset, latest);
+
+        // Untimed and unparseable lines just leave the running max alone
+        if (aisnmea_parse (parser, line) == 0) {
+            uint64_t time = aisnmea_timestamp (parser);
+            if (time > latest)
+                latest = time;
+        }
+        self->entries [self->count - 1].time = latest;
+    }
+    long size = ftell (handle);
+    assert (size >= 0);
+    self->file_size = (uint64_t) size;
+
+    aisnmea_destroy (&parser);
+    zfile_destroy (&file);
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Load an index sidecar
+
+aisnmea_index_t *
+aisnmea_index_load (const char *path)
+{
+    assert (path);
+    FILE *file = fopen (path, "r");
+    if (!file)
+        return NULL;
+
+    aisnmea_index_t *self = NULL;
+    char magic [32];
+    int version;
+    size_t every;
+    uint64_t file_size;
+    if (fscanf (file, "%31s %d %zu %" SCNu64, magic, &version, &every, &file_size) != 4
+    ||  !streq (magic, INDEX_MAGIC)
+    ||  version != INDEX_VERSION
+    ||  every == 0)
+        goto die;
+
+    self = s_index_new (every);
+    self->file_size = file_size;
+
+    uint64_t offset, time;
+    int rc;
+    while ((rc = fscanf (file, "%" SCNu64 " %" SCNu64, &offset, &time)) == 2) {
+        // Both columns must be sorted for seek to be right
+        if (self->count
+        && (offset <= self->entries [self->count - 1].offset
+            || time < self->entries [self->count - 1].time))
+            goto die;
+        s_index_append (self, offset, time);
+    }
+    if (rc != EOF)
+        goto die;
+
+    fclose (file);
+    return self;
+
+ die:
+    aisnmea_index_destroy (&self);
+    fclose (file);
+    return NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_index
+
+void
+aisnmea_index_destroy (aisnmea_index_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_index_t *self = *self_p;
+        free (self->entries);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Write the index sidecar
+
+int
+aisnmea_index_save (aisnmea_index_t *self, const char *path)
+{
+    assert (self);
+    assert (path);
+    FILE *file = fopen (path, "w");
+    if (!file)
+        return -1;
+
+    fprintf (file, "%s %d %zu %" PRIu64 "\n",
+             INDEX_MAGIC, INDEX_VERSION, self->every, self->file_size);
+    for (size_t i = 0; i < self->count; ++i)
+        fprintf (file, "%" PRIu64 " %" PRIu64 "\n",
+                 self->entries [i].offset, self->entries [i].time);
+
+    int rc = ferror (file) ? -1 : 0;
+    if (fclose (file))
+        rc = -1;
+    return rc;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Find where to start reading for a given time
+
+uint64_t
+aisnmea_index_seek (aisnmea_index_t *self, uint64_t time)
+{
+    assert (self);
+
+    // First entry whose running max reaches 'time'
+    size_t lo = 0;
+    size_t hi = self->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (self->entries [mid].time < time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < self->count ? self->entries [lo].offset : self->file_size;
+}
+
+size_t
+aisnmea_index_size (aisnmea_index_t *self)
+{
+    assert (self);
+    return self->count;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_index_test (bool verbose)
+{
+    printf (" * aisnmea_index: ");
+
+    //  @selftest
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw.
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    char *archive = zsys_sprintf ("%s/index.nmea", SELFTEST_DIR_RW);
+    char *sidecar = zsys_sprintf ("%s/index.nmea.idx", SELFTEST_DIR_RW);
+
+    // Roughly ordered, with untagged and junk lines mixed in; 0 means
+    // untagged. Keep line start offsets for checking seek results.
+    const uint64_t times [] = { 100, 101, 0, 103, 102, 105,
+                                104, 110, 0, 109, 120, 121, 121 };
+    const size_t line_count = sizeof (times) / sizeof (times [0]);
+    long starts [sizeof (times) / sizeof (times [0])];
+
+    FILE *out = fopen (archive, "w");
+    assert (out);
+    for (size_t i = 0; i < line_count; ++i) {
+        starts [i] = ftell (out);
+        if (times [i]) {
+            char *tb = zsys_sprintf ("c:%" PRIu64, times [i]);
+            int checksum = 0;
+            for (const char *cur = tb; *cur; ++cur)
+                checksum ^= *cur;
+            fprintf (out, "\\%s*%02X\\", tb, checksum);
+            zstr_free (&tb);
+        }
+        if (i == 8)
+            fprintf (out, "garbage\n");
+        else
+            fprintf (out, "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13\n");
+    }
+    long archive_size = ftell (out);
+    fclose (out);
+
+    assert (aisnmea_index_build ("src/selftest-rw/no_such_file", 4) == NULL);
+
+    aisnmea_index_t *index = aisnmea_index_build (archive, 3);
+    assert (index);
+    assert (aisnmea_index_size (index) == 5);
+
+    // Whatever we ask for, nothing before the offset may be that late,
+    // and the offset must be the start of the first block that is
+    for (uint64_t want = 90; want <= 130; ++want) {
+        uint64_t offset = aisnmea_index_seek (index, want);
+        size_t block_start = line_count;
+        for (size_t i = 0; i < line_count; ++i) {
+            if ((uint64_t) starts [i] < offset)
+                assert (times [i] < want);
+            else
+            if (times [i] >= want && block_start == line_count)
+                block_start = i - i % 3;
+        }
+        if (block_start == line_count)
+            assert (offset == (uint64_t) archive_size);
+        else
+            assert (offset == (uint64_t) starts [block_start]);
+        if (verbose)
+            zsys_debug ("seek %" PRIu64 " -> %" PRIu64, want, offset);
+    }
+    // The disordered 102 lives in the block starting at line 3
+    assert (aisnmea_index_seek (index, 102) == (uint64_t) starts [3]);
+    assert (aisnmea_index_seek (index, 0) == 0);
+
+    // Round trip through a sidecar
+    int rc = aisnmea_index_save (index, sidecar);
+    assert (rc == 0);
+    aisnmea_index_t *loaded = aisnmea_index_load (sidecar);
+    assert (loaded);
+    assert (aisnmea_index_size (loaded) == aisnmea_index_size (index));
+    for (uint64_t want = 90; want <= 130; ++want)
+        assert (aisnmea_index_seek (loaded, want) == aisnmea_index_seek (index, want));
+    aisnmea_index_destroy (&loaded);
+
+    // Reject things that aren't index files
+    assert (aisnmea_index_load ("src/selftest-rw/no_such_file") == NULL);
+    assert (aisnmea_index_load (archive) == NULL);
+    out = fopen (sidecar, "w");
+    assert (out);
+    fprintf (out, "aisnmea_index 1 3 100\n0 105\n50 102\n");
+    fclose (out);
+    assert (aisnmea_index_load (sidecar) == NULL);
+
+    // Empty archive: nothing to seek past
+    out = fopen (archive, "w");
+    assert (out);
+    fclose (out);
+    aisnmea_index_destroy (&index);
+    index = aisnmea_index_build (archive, 3);
+    assert (index);
+    assert (aisnmea_index_size (index) == 0);
+    assert (aisnmea_index_seek (index, 100) == 0);
+
+    aisnmea_index_destroy (&index);
+    assert (!index);
+    zsys_file_delete (archive);
+    zsys_file_delete (sidecar);
+    zstr_free (&archive);
+    zstr_free (&sidecar);
+
+    //  @end
+    printf ("OK\n");
+}
@@ -0,0 +1,356 @@
+/*  =========================================================================
+    aisnmea_merge - Time-ordered merge of several NMEA archives
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_merge - Time-ordered merge of several NMEA archives
+@discuss
+    Lines read from the inputs wait in a min-heap ordered on (time, input,
+    line number). Each input remembers the latest time it has produced
+    (its high-water mark). The top of the heap is only released once it
+    is at least 'window' seconds older than the lowest high-water mark of
+    any input still open, since no input can then produce anything older.
+    To get there we always read from the input lagging furthest behind.
+
+    So memory is bounded by the number of lines in a window's worth of
+    traffic, however big the inputs, and there are no temporary files.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+typedef struct {
+    zfile_t *file;          // NULL once exhausted
+    uint64_t last_time;     // time of the last line read
+    uint64_t high_water;    // latest time seen
+    uint64_t lines_read;
+} reader_t;
+
+typedef struct {
+    uint64_t time;
+    size_t reader;
+    uint64_t lineno;
+    char *line;
+} entry_t;
+
+//  Structure of our class
+
+struct _aisnmea_merge_t {
+    uint64_t window;
+    aisnmea_t *parser;      // for reading tagblock times
+
+    reader_t *readers;
+    size_t reader_count;
+
+    entry_t *heap;
+    size_t heap_size;
+    size_t heap_capacity;
+
+    entry_t current;        // last line handed out by next
+};
+
+
+//  --------------------------------------------------------------------------
+//  Min-heap on (time, reader, lineno)
+
+static bool
+s_entry_before (entry_t *a, entry_t *b)
+{
+    if (a->time != b->time)
+        return a->time < b->time;
+    if (a->reader != b->reader)
+        return a->reader < b->reader;
+    return a->lineno < b->lineno;
+}
+
+static void
+s_heap_push (aisnmea_merge_t *self, entry_t entry)
+{
+    if (self->heap_size == self->heap_capacity) {
+        self->heap_capacity = self->heap_capacity ? self->heap_capacity * 2 : 64;
+        self->heap = (entry_t *) realloc (self->heap,
+                                          self->heap_capacity * sizeof (entry_t));
+        assert (self->heap);
+    }
+    size_t pos = self->heap_size++;
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (!s_entry_before (&entry, &self->heap [parent]))
+            break;
+        self->heap [pos] = self->heap [parent];
+        pos = parent;
+    }
+    self->heap [pos] = entry;
+}
+
+static entry_t
+s_heap_pop (aisnmea_merge_t *self)
+{
+    assert (self->heap_size);
+    entry_t top = self->heap [0];
+    entry_t last = self->heap [--self->heap_size];
+
+    size_t pos = 0;
+    while (true) {
+        size_t child = pos * 2 + 1;
+        if (child >= self->heap_size)
+            break;
+        if (child + 1 < self->heap_size
+        &&  s_entry_before (&self->heap [child + 1], &self->heap [child]))
+            ++child;
+        if (!s_entry_before (&self->heap [child], &last))
+            break;
+        self->heap [pos] = self->heap [child];
+        pos = child;
+    }
+    if (self->heap_size)
+        self->heap [pos] = last;
+    return top;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_merge
+
+aisnmea_merge_t *
+aisnmea_merge_new (uint64_t window)
+{
+    aisnmea_merge_t *self = (aisnmea_merge_t *) zmalloc (sizeof (aisnmea_merge_t));
+    assert (self);
+
+    self->window = window;
+    self->parser = aisnmea_new (NULL);
+    assert (self->parser);
+
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_merge
+
+void
+aisnmea_merge_destroy (aisnmea_merge_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_merge_t *self = *self_p;
+
+        for (size_t i = 0; i < self->reader_count; ++i)
+            zfile_destroy (&self->readers [i].file);
+        free (self->readers);
+
+        for (size_t i = 0; i < self->heap_size; ++i)
+            free (self->heap [i].line);
+        free (self->heap);
+        free (self->current.line);
+
+        aisnmea_destroy (&self->parser);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Add an input
+
+int
+aisnmea_merge_add_file (aisnmea_merge_t *self, const char *path)
+{
+    assert (self);
+    assert (path);
+
+    zfile_t *file = zfile_new (NULL, path);
+    if (!file)
+        return -1;
+    if (zfile_input (file)) {
+        zfile_destroy (&file);
+        return -1;
+    }
+
+    self->readers = (reader_t *) realloc (self->readers,
+                        (self->reader_count + 1) * sizeof (reader_t));
+    assert (self->readers);
+    reader_t *reader = &self->readers [self->reader_count++];
+    memset (reader, 0, sizeof (reader_t));
+    reader->file = file;
+    return 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Read one line from a reader into the heap, closing it at EOF
+
+static void
+s_reader_advance (aisnmea_merge_t *self, size_t index)
+{
+    reader_t *reader = &self->readers [index];
+    const char *line = zfile_readln (reader->file);
+    if (!line) {
+        zfile_destroy (&reader->file);
+        return;
+    }
+
+    uint64_t time = 0;
+    if (aisnmea_parse (self->parser, line) == 0)
+        time = aisnmea_timestamp (self->parser);
+    if (!time)
+        time = reader->last_time;
+
+    reader->last_time = time;
+    if (time > reader->high_water)
+        reader->high_water = time;
+
+    entry_t entry = { time, index, reader->lines_read++, strdup (line) };
+    assert (entry.line);
+    s_heap_push (self, entry);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Get the next line in time order
+
+const char *
+aisnmea_merge_next (aisnmea_merge_t *self)
+{
+    assert (self);
+    zstr_free (&self->current.line);
+
+    while (true) {
+        // The open reader lagging furthest behind bounds what's safe to emit
+        reader_t *lagging = NULL;
+        size_t lagging_index = 0;
+        for (size_t i = 0; i < self->reader_count; ++i) {
+            reader_t *reader = &self->readers [i];
+            if (reader->file
+            && (!lagging || reader->high_water < lagging->high_water)) {
+                lagging = reader;
+                lagging_index = i;
+            }
+        }
+
+        if (self->heap_size
+        && (!lagging
+            || self->heap [0].time + self->window <= lagging->high_water)) {
+            self->current = s_heap_pop (self);
+            return self->current.line;
+        }
+        if (!lagging)
+            return NULL;   // inputs and heap both empty
+
+        s_reader_advance (self, lagging_index);
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Accessors
+
+uint64_t
+aisnmea_merge_timestamp (aisnmea_merge_t *self)
+{
+    assert (self);
+    return self->current.time;
+}
+
+size_t
+aisnmea_merge_source (aisnmea_merge_t *self)
+{
+    assert (self);
+    return self->current.reader;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+//  Write a file of tagged copies of the same sentence at the given times;
+//  a time of 0 writes an untagged line instead
+static char *
+s_write_fixture (const char *dir, const char *name, const uint64_t *times, size_t count)
+{
+    char *path = zsys_sprintf ("%s/%s", dir, name);
+    assert (path);
+    FILE *file = fopen (path, "w");
+    assert (file);
+    for (size_t i = 0; i < count; ++i) {
+        if (times [i]) {
+            char *tb = zsys_sprintf ("s:%s,c:%" PRIu64, name, times [i]);
+            int checksum = 0;
+            for (const char *cur = tb; *cur; ++cur)
+                checksum ^= *cur;
+            fprintf (file, "\\%s*%02X\\", tb, checksum);
+            zstr_free (&tb);
+        }
+        fprintf (file, "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13\n");
+    }
+    fclose (file);
+    return path;
+}
+
+void
+aisnmea_merge_test (bool verbose)
+{
+    printf (" * aisnmea_merge: ");
+
+    //  @selftest
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw.
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+
+    // Two receivers, one with a little local disorder and untagged lines
+    const uint64_t times_a [] = { 100, 103, 102, 0, 110, 111 };
+    const uint64_t times_b [] = { 101, 102, 104, 109, 120 };
+    char *path_a = s_write_fixture (SELFTEST_DIR_RW, "merge_a.nmea", times_a, 6);
+    char *path_b = s_write_fixture (SELFTEST_DIR_RW, "merge_b.nmea", times_b, 5);
+
+    aisnmea_merge_t *merge = aisnmea_merge_new (5);
+    assert (merge);
+    assert (aisnmea_merge_add_file (merge, path_a) == 0);
+    assert (aisnmea_merge_add_file (merge, path_b) == 0);
+    assert (aisnmea_merge_add_file (merge, "src/selftest-rw/no_such_file") == -1);
+
+    const uint64_t want_times [] = { 100, 101, 102, 102, 102, 103, 104, 109, 110, 111, 120 };
+    const size_t want_sources [] = { 0, 1, 0, 0, 1, 0, 1, 1, 0, 0, 1 };
+    size_t count = 0;
+    const char *line;
+    while ((line = aisnmea_merge_next (merge))) {
+        assert (count < 11);
+        if (verbose)
+            zsys_debug ("%" PRIu64 " %s", aisnmea_merge_timestamp (merge), line);
+        assert (aisnmea_merge_timestamp (merge) == want_times [count]);
+        assert (aisnmea_merge_source (merge) == want_sources [count]);
+        ++count;
+    }
+    assert (count == 11);
+
+    // Stays finished
+    assert (aisnmea_merge_next (merge) == NULL);
+    aisnmea_merge_destroy (&merge);
+    assert (!merge);
+
+    // Destroying part way through must not leak
+    merge = aisnmea_merge_new (5);
+    aisnmea_merge_add_file (merge, path_a);
+    aisnmea_merge_add_file (merge, path_b);
+    assert (aisnmea_merge_next (merge));
+    aisnmea_merge_destroy (&merge);
+
+    zsys_file_delete (path_a);
+    zsys_file_delete (path_b);
+    zstr_free (&path_a);
+    zstr_free (&path_b);
+
+    //  @end
+    printf ("OK\n");
+}
@@ -0,0 +1,693 @@
+/*  =========================================================================
+    aisnmea_partition - Writes lines out to files partitioned by a key
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_partition - Writes lines out to files partitioned by a key
+@discuss
+    Splitting an archive several ways used to mean reading it once per
+    way. Instead, parse each line once and pass it to a partitioner for
+    each scheme wanted.
+
+    The calling thread only ever copies lines into partition buffers.
+    A full buffer is queued for the partitioner's own writer thread, and
+    the partition carries on with a spare; at most MAX_QUEUED buffers are
+    queued or spare, so memory is one buffer per partition plus those.
+    If the writer falls behind, write waits for it. Files are opened,
+    written and closed only by the writer thread, which keeps them on an
+    LRU list and closes the least recently written one when it needs
+    another and 'max_open' are already open. A file is truncated when it
+    is first opened and appended to when reopened.
+
+    It uses pthreads and POSIX file I/O, so isn't built on Windows.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+#if !defined (__WINDOWS__)
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+//  Most buffers queued for the writer, and most spares kept
+#define MAX_QUEUED 16
+
+//  Longest partition file name we make
+#define MAX_NAME 96
+
+//  Where continuations of messages whose first sentence we haven't seen go
+#define UNKNOWN "unknown"
+
+typedef struct _partition_t partition_t;
+
+struct _partition_t {
+    char *path;
+    uint64_t lines;
+    //  Owned by the calling thread
+    char *buffer;           // NULL until written to, and after each hand-over
+    size_t used;
+    //  Owned by the writer thread
+    int fd;                 // -1 if not open
+    bool created;           // so reopening appends
+    partition_t *newer;     // LRU list of open files
+    partition_t *older;
+};
+
+typedef struct {
+    partition_t *partition;
+    char *buffer;
+    size_t size;
+} job_t;
+
+//  Structure of our class
+
+struct _aisnmea_partition_t {
+    char *directory;
+    int scheme;
+    uint32_t buckets;
+    size_t max_open;
+    size_t buffer_size;
+    zhash_t *partitions;    // partition_t by name
+    zlist_t *ordered;       // the same, in order made
+    uint64_t lines;
+
+    //  Partition of the first sentence of the message with each message
+    //  ID, and of those without one, for their later sentences
+    partition_t *pending [11];
+
+    //  Shared with the writer thread, under 'lock'
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t work;    // a job is queued, or we're stopping
+    pthread_cond_t done;    // a job is finished
+    job_t queue [MAX_QUEUED];
+    size_t head;            // next job for the writer
+    size_t queued;
+    bool busy;              // writer has a job out of the queue
+    bool stopping;
+    char *spares [MAX_QUEUED];
+    size_t spare_count;
+    int error;              // errno of the first failed write, or 0
+
+    //  Owned by the writer thread
+    partition_t *newest;
+    partition_t *oldest;
+    size_t open_count;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Writer thread: open files as needed, keeping at most max_open
+
+static void
+s_lru_unlink (aisnmea_partition_t *self, partition_t *partition)
+{
+    if (partition->newer)
+        partition->newer->older = partition->older;
+    else
+        self->newest = partition->older;
+    if (partition->older)
+        partition->older->newer = partition->newer;
+    else
+        self->oldest = partition->newer;
+    partition->newer = partition->older = NULL;
+}
+
+static void
+s_close (aisnmea_partition_t *self, partition_t *partition)
+{
+    s_lru_unlink (self, partition);
+    close (partition->fd);
+    partition->fd = -1;
+    self->open_count--;
+}
+
+//  Returns 0 or an errno
+static int
+s_write_job (aisnmea_partition_t *self, job_t *job)
+{
+    partition_t *partition = job->partition;
+    if (partition->fd == -1) {
+        while (self->open_count && self->open_count >= self->max_open)
+            s_close (self, self->oldest);
+        int flags = O_WRONLY | O_CREAT | (partition->created ? O_APPEND : O_TRUNC);
+        partition->fd = open (partition->path, flags, 0644);
+        if (partition->fd == -1)
+            return errno;
+        partition->created = true;
+        self->open_count++;
+    }
+    else
+        s_lru_unlink (self, partition);
+
+    //  Most recently written goes to the front
+    partition->older = self->newest;
+    if (self->newest)
+        self->newest->newer = partition;
+    else
+        self->oldest = partition;
+    self->newest = partition;
+
+    const char *data = job->buffer;
+    size_t left = job->size;
+    while (left) {
+        ssize_t rc = write (partition->fd, data, left);
+        if (rc == -1 && errno == EINTR)
+            continue;
+        if (rc == -1)
+            return errno;
+        data += rc;
+        left -= rc;
+    }
+    return 0;
+}
+
+static void *
+s_writer (void *args)
+{
+    aisnmea_partition_t *self = (aisnmea_partition_t *) args;
+
+    pthread_mutex_lock (&self->lock);
+    while (true) {
+        while (!self->queued && !self->stopping)
+            pthread_cond_wait (&self->work, &self->lock);
+        if (!self->queued)
+            break;
+        job_t job = self->queue [self->head];
+        self->head = (self->head + 1) % MAX_QUEUED;
+        self->queued--;
+        self->busy = true;
+        pthread_mutex_unlock (&self->lock);
+
+        int error = s_write_job (self, &job);
+
+        pthread_mutex_lock (&self->lock);
+        if (error && !self->error)
+            self->error = error;
+        if (self->spare_count < MAX_QUEUED)
+            self->spares [self->spare_count++] = job.buffer;
+        else
+            free (job.buffer);
+        self->busy = false;
+        pthread_cond_broadcast (&self->done);
+    }
+    pthread_mutex_unlock (&self->lock);
+    return NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_partition
+
+aisnmea_partition_t *
+aisnmea_partition_new (const char *directory, int scheme, uint32_t buckets)
+{
+    assert (directory);
+    assert (scheme >= AISNMEA_PARTITION_TYPE && scheme <= AISNMEA_PARTITION_HOUR);
+    assert (scheme != AISNMEA_PARTITION_MMSI || buckets > 0);
+
+    zsys_dir_create ("%s", directory);
+    struct stat stat_buf;
+    if (stat (directory, &stat_buf) || !S_ISDIR (stat_buf.st_mode))
+        return NULL;
+
+    aisnmea_partition_t *self = (aisnmea_partition_t *) zmalloc (sizeof (aisnmea_partition_t));
+    assert (self);
+    self->directory = strdup (directory);
+    assert (self->directory);
+    self->scheme = scheme;
+    self->buckets = buckets;
+    self->max_open = 64;
+    self->buffer_size = 256 * 1024;
+    self->partitions = zhash_new ();
+    assert (self->partitions);
+    self->ordered = zlist_new ();
+    assert (self->ordered);
+
+    pthread_mutex_init (&self->lock, NULL);
+    pthread_cond_init (&self->work, NULL);
+    pthread_cond_init (&self->done, NULL);
+    int rc = pthread_create (&self->writer, NULL, s_writer, self);
+    assert (rc == 0);
+
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_partition
+
+void
+aisnmea_partition_destroy (aisnmea_partition_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_partition_t *self = *self_p;
+        aisnmea_partition_flush (self);
+
+        pthread_mutex_lock (&self->lock);
+        self->stopping = true;
+        pthread_cond_signal (&self->work);
+        pthread_mutex_unlock (&self->lock);
+        pthread_join (self->writer, NULL);
+        pthread_mutex_destroy (&self->lock);
+        pthread_cond_destroy (&self->work);
+        pthread_cond_destroy (&self->done);
+
+        partition_t *partition = (partition_t *) zlist_first (self->ordered);
+        while (partition) {
+            if (partition->fd != -1)
+                close (partition->fd);
+            free (partition->buffer);
+            free (partition->path);
+            free (partition);
+            partition = (partition_t *) zlist_next (self->ordered);
+        }
+        for (size_t i = 0; i < self->spare_count; ++i)
+            free (self->spares [i]);
+        zlist_destroy (&self->ordered);
+        zhash_destroy (&self->partitions);
+        free (self->directory);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Hold at most 'max_open' files open at once
+
+void
+aisnmea_partition_set_max_open (aisnmea_partition_t *self, size_t max_open)
+{
+    assert (self);
+    assert (max_open > 0);
+    assert (!self->lines);
+    self->max_open = max_open;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Buffer up to 'size' bytes for each partition
+
+void
+aisnmea_partition_set_buffer_size (aisnmea_partition_t *self, size_t size)
+{
+    assert (self);
+    assert (size > 0);
+    assert (!self->lines);
+    self->buffer_size = size;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Queue a partition's buffer for the writer, waiting for room if need be
+
+static void
+s_hand_over (aisnmea_partition_t *self, partition_t *partition)
+{
+    if (!partition->used)
+        return;
+
+    pthread_mutex_lock (&self->lock);
+    while (self->queued == MAX_QUEUED)
+        pthread_cond_wait (&self->done, &self->lock);
+    job_t *job = &self->queue [(self->head + self->queued) % MAX_QUEUED];
+    job->partition = partition;
+    job->buffer = partition->buffer;
+    job->size = partition->used;
+    self->queued++;
+    pthread_cond_signal (&self->work);
+    pthread_mutex_unlock (&self->lock);
+
+    partition->buffer = NULL;
+    partition->used = 0;
+}
+
+//  Give a partition an empty buffer, a spare one if there is one
+static void
+s_take_buffer (aisnmea_partition_t *self, partition_t *partition)
+{
+    pthread_mutex_lock (&self->lock);
+    if (self->spare_count)
+        partition->buffer = self->spares [--self->spare_count];
+    pthread_mutex_unlock (&self->lock);
+    if (!partition->buffer) {
+        partition->buffer = (char *) malloc (self->buffer_size);
+        assert (partition->buffer);
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Work out which partition a sentence belongs in, making it if need be
+
+static partition_t *
+s_partition (aisnmea_partition_t *self, const char *name)
+{
+    partition_t *partition = (partition_t *) zhash_lookup (self->partitions, name);
+    if (!partition) {
+        partition = (partition_t *) zmalloc (sizeof (partition_t));
+        assert (partition);
+        partition->path = zsys_sprintf ("%s/%s.nmea", self->directory, name);
+        assert (partition->path);
+        partition->fd = -1;
+        zhash_insert (self->partitions, name, partition);
+        zlist_append (self->ordered, partition);
+    }
+    return partition;
+}
+
+//  Writes the partition name for a first sentence into 'name'; leaves it
+//  as UNKNOWN if the key's missing
+static void
+s_name (aisnmea_partition_t *self, aisnmea_t *msg, char *name)
+{
+    strcpy (name, UNKNOWN);
+
+    if (self->scheme == AISNMEA_PARTITION_TYPE) {
+        int type = aisnmea_aismsgtype (msg);
+        if (type >= 0)
+            snprintf (name, MAX_NAME, "type-%d", type);
+    }
+    else
+    if (self->scheme == AISNMEA_PARTITION_SOURCE) {
+        const char *source = aisnmea_tagblockval (msg, "s");
+        if (source && *source && strlen (source) < MAX_NAME - 8) {
+            // Keep to characters that are safe in file names
+            char *cur = name + sprintf (name, "source-");
+            for (; *source; ++source)
+                *cur++ = isalnum ((byte) *source) || *source == '-' || *source == '_'
+                       ? *source : '_';
+            *cur = 0;
+        }
+    }
+    else
+    if (self->scheme == AISNMEA_PARTITION_MMSI) {
+        int mmsi = aisnmea_mmsi (msg);
+        // Scale the hash down to a bucket: % with a power-of-two count
+        // would keep only its low bits, which mix nothing in
+        if (mmsi >= 0)
+            snprintf (name, MAX_NAME, "mmsi-%u",
+                      (uint32_t) (((uint64_t) aisnmea_mmsi_slot ((uint32_t) mmsi, 32)
+                                   * self->buckets) >> 32));
+    }
+    else {
+        time_t time = (time_t) aisnmea_timestamp (msg);
+        struct tm tm;
+        if (time && gmtime_r (&time, &tm))
+            strftime (name, MAX_NAME, "%Y-%m-%dT%H", &tm);
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Add 'line' to its partition
+
+int
+aisnmea_partition_write (aisnmea_partition_t *self, aisnmea_t *msg, const char *line)
+{
+    assert (self);
+    assert (line);
+
+    partition_t *partition = NULL;
+    if (msg && aisnmea_fragnum (msg) > 1) {
+        int messageid = aisnmea_messageid (msg);
+        partition_t **pending = &self->pending [messageid >= 0 && messageid <= 9 ? messageid + 1 : 0];
+        partition = *pending;
+        if (!partition)
+            partition = s_partition (self, UNKNOWN);
+        if (aisnmea_fragnum (msg) >= aisnmea_fragcount (msg))
+            *pending = NULL;
+    }
+    else {
+        char name [MAX_NAME];
+        if (msg)
+            s_name (self, msg, name);
+        else
+            strcpy (name, UNKNOWN);
+        partition = s_partition (self, name);
+        if (msg && aisnmea_fragcount (msg) > 1) {
+            int messageid = aisnmea_messageid (msg);
+            self->pending [messageid >= 0 && messageid <= 9 ? messageid + 1 : 0] = partition;
+        }
+    }
+
+    size_t length = strlen (line);
+    size_t needed = length + (length && line [length - 1] == '\n' ? 0 : 1);
+    if (partition->buffer && partition->used + needed > self->buffer_size)
+        s_hand_over (self, partition);
+    if (!partition->buffer)
+        s_take_buffer (self, partition);
+
+    if (needed > self->buffer_size) {
+        // Too long to buffer at all, so it goes out on its own
+        partition->buffer = (char *) realloc (partition->buffer, needed);
+        assert (partition->buffer);
+    }
+    memcpy (partition->buffer + partition->used, line, length);
+    if (needed > length)
+        partition->buffer [partition->used + length] = '\n';
+    partition->used += needed;
+    partition->lines++;
+    self->lines++;
+    if (partition->used >= self->buffer_size)
+        s_hand_over (self, partition);
+
+    pthread_mutex_lock (&self->lock);
+    int error = self->error;
+    pthread_mutex_unlock (&self->lock);
+    return error ? -1 : 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Write out everything buffered and wait for it
+
+int
+aisnmea_partition_flush (aisnmea_partition_t *self)
+{
+    assert (self);
+    partition_t *partition = (partition_t *) zlist_first (self->ordered);
+    while (partition) {
+        s_hand_over (self, partition);
+        partition = (partition_t *) zlist_next (self->ordered);
+    }
+
+    pthread_mutex_lock (&self->lock);
+    while (self->queued || self->busy)
+        pthread_cond_wait (&self->done, &self->lock);
+    int error = self->error;
+    pthread_mutex_unlock (&self->lock);
+    return error ? -1 : 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Number of partitions written to so far
+
+size_t
+aisnmea_partition_partitions (aisnmea_partition_t *self)
+{
+    assert (self);
+    return zlist_size (self->ordered);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Number of lines written so far
+
+uint64_t
+aisnmea_partition_lines (aisnmea_partition_t *self)
+{
+    assert (self);
+    return self->lines;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+static char *
+s_slurp (const char *directory, const char *name)
+{
+    char *path = zsys_sprintf ("%s/%s", directory, name);
+    assert (path);
+    FILE *file = fopen (path, "r");
+    zstr_free (&path);
+    if (!file)
+        return NULL;
+    char *text = (char *) zmalloc (4096);
+    assert (text);
+    size_t size = fread (text, 1, 4095, file);
+    text [size] = 0;
+    fclose (file);
+    return text;
+}
+
+//  Remove the files the test makes, and their directory
+static void
+s_remove_all (const char *directory)
+{
+    const char *names [] = {
+        "type-1", "type-5", "type-18", "unknown", "source-r1", "source-r2",
+        "2009-05-05T17", "2009-05-05T18", "mmsi-0", NULL
+    };
+    for (int i = 0; names [i]; ++i)
+        zsys_file_delete ("%s/%s.nmea", directory, names [i]);
+    zsys_dir_delete ("%s", directory);
+}
+
+void
+aisnmea_partition_test (bool verbose)
+{
+    printf (" * aisnmea_partition: ");
+
+    //  @selftest
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    zsys_dir_create (SELFTEST_DIR_RW);
+    char *directory = zsys_sprintf ("%s/partition", SELFTEST_DIR_RW);
+    assert (directory);
+    s_remove_all (directory);
+
+    // Types 1, 18, 5 (in two sentences), 1 again, then one with an empty
+    // payload, a line that didn't parse and a stray second sentence
+    const char *lines [] = {
+        "\\s:r1,c:1241544035*7A\\!AIVDM,1,1,,A,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5F",
+        "\\s:r2,c:1241547700*7B\\!AIVDO,1,1,,,B5N4cJ`005Jrek0H@9n`DW5608EP,0*20",
+        "\\s:r1,c:1241544040*78\\!AIVDM,2,1,3,B,55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53,0*3E",
+        "!AIVDM,2,2,3,B,1@0000000000000,2*55",
+        "\\s:r1,c:1241544041*79\\!AIVDM,1,1,,A,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5F\n",
+        "!AIVDM,1,1,,A,,0*26",
+        "garbage",
+        "!AIVDM,2,2,7,B,1@0000000000000,2*51",
+        NULL
+    };
+    aisnmea_t *msg = aisnmea_new (NULL);
+    assert (msg);
+
+    // Tiny buffers and one open file at a time, so every path is taken
+    aisnmea_partition_t *by_type = aisnmea_partition_new (directory, AISNMEA_PARTITION_TYPE, 0);
+    assert (by_type);
+    aisnmea_partition_set_max_open (by_type, 1);
+    aisnmea_partition_set_buffer_size (by_type, 64);
+    aisnmea_partition_t *by_source = aisnmea_partition_new (directory, AISNMEA_PARTITION_SOURCE, 0);
+    assert (by_source);
+    aisnmea_partition_t *by_hour = aisnmea_partition_new (directory, AISNMEA_PARTITION_HOUR, 0);
+    assert (by_hour);
+    aisnmea_partition_t *by_mmsi = aisnmea_partition_new (directory, AISNMEA_PARTITION_MMSI, 1);
+    assert (by_mmsi);
+
+    for (int i = 0; lines [i]; ++i) {
+        char *line = strdup (lines [i]);
+        assert (line);
+        // Strip the newline for the parser, as readers do
+        if (strchr (line, '\n'))
+            *strchr (line, '\n') = 0;
+        int rc = aisnmea_parse (msg, line);
+        assert (rc == 0 || streq (line, "garbage"));
+        assert (aisnmea_partition_write (by_type, rc ? NULL : msg, lines [i]) == 0);
+        assert (aisnmea_partition_write (by_source, rc ? NULL : msg, lines [i]) == 0);
+        assert (aisnmea_partition_write (by_hour, rc ? NULL : msg, lines [i]) == 0);
+        assert (aisnmea_partition_write (by_mmsi, rc ? NULL : msg, lines [i]) == 0);
+        free (line);
+    }
+    assert (aisnmea_partition_flush (by_type) == 0);
+    assert (aisnmea_partition_partitions (by_type) == 4);
+    assert (aisnmea_partition_lines (by_type) == 8);
+    assert (aisnmea_partition_partitions (by_source) == 3);
+    assert (aisnmea_partition_partitions (by_hour) == 3);
+    assert (aisnmea_partition_partitions (by_mmsi) == 2);
+    aisnmea_partition_destroy (&by_type);
+    assert (!by_type);
+    aisnmea_partition_destroy (&by_source);
+    aisnmea_partition_destroy (&by_hour);
+    aisnmea_partition_destroy (&by_mmsi);
+
+    char *text = s_slurp (directory, "type-1.nmea");
+    assert (text);
+    assert (streq (text,
+        "\\s:r1,c:1241544035*7A\\!AIVDM,1,1,,A,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5F\n"
+        "\\s:r1,c:1241544041*79\\!AIVDM,1,1,,A,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5F\n"));
+    free (text);
+    text = s_slurp (directory, "type-5.nmea");
+    assert (text);
+    assert (streq (text,
+        "\\s:r1,c:1241544040*78\\!AIVDM,2,1,3,B,55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53,0*3E\n"
+        "!AIVDM,2,2,3,B,1@0000000000000,2*55\n"));
+    free (text);
+    text = s_slurp (directory, "type-18.nmea");
+    assert (text && strstr (text, "B5N4cJ"));
+    free (text);
+    text = s_slurp (directory, "unknown.nmea");
+    assert (text);
+    assert (streq (text, "!AIVDM,1,1,,A,,0*26\ngarbage\n!AIVDM,2,2,7,B,1@0000000000000,2*51\n"));
+    free (text);
+
+    // Sources and hours; the second sentence of type 5 follows its first
+    text = s_slurp (directory, "source-r1.nmea");
+    assert (text && strstr (text, "2,2,3,B"));
+    free (text);
+    text = s_slurp (directory, "source-r2.nmea");
+    assert (text && strstr (text, "B5N4cJ"));
+    free (text);
+    text = s_slurp (directory, "2009-05-05T17.nmea");
+    assert (text && strstr (text, "2,2,3,B") && !strstr (text, "B5N4cJ"));
+    free (text);
+    text = s_slurp (directory, "2009-05-05T18.nmea");
+    assert (text && strstr (text, "B5N4cJ"));
+    free (text);
+    text = s_slurp (directory, "mmsi-0.nmea");
+    assert (text && strstr (text, "B5N4cJ") && strstr (text, "2,2,3,B"));
+    free (text);
+
+    // Writing again starts the files afresh
+    by_type = aisnmea_partition_new (directory, AISNMEA_PARTITION_TYPE, 0);
+    assert (by_type);
+    assert (aisnmea_parse (msg, lines [1]) == 0);
+    assert (aisnmea_partition_write (by_type, msg, lines [1]) == 0);
+    aisnmea_partition_destroy (&by_type);
+    text = s_slurp (directory, "type-18.nmea");
+    assert (text);
+    assert (streq (text, "\\s:r2,c:1241547700*7B\\!AIVDO,1,1,,,B5N4cJ`005Jrek0H@9n`DW5608EP,0*20\n"));
+    free (text);
+
+    // Write failures are reported
+    by_type = aisnmea_partition_new (directory, AISNMEA_PARTITION_TYPE, 0);
+    assert (by_type);
+    s_remove_all (directory);
+    assert (aisnmea_partition_write (by_type, msg, lines [1]) == 0);
+    assert (aisnmea_partition_flush (by_type) == -1);
+    assert (aisnmea_partition_write (by_type, msg, lines [1]) == -1);
+    aisnmea_partition_destroy (&by_type);
+
+    // A directory that can't be made
+    assert (aisnmea_partition_new ("src/selftest-ro/.gitkeep/partition",
+                                   AISNMEA_PARTITION_TYPE, 0) == NULL);
+
+    aisnmea_destroy (&msg);
+    zstr_free (&directory);
+    //  @end
+
+    printf ("OK\n");
+}
+
+#else
+//  Pthreads and POSIX file I/O only; the class is left out on Windows
+
+void
+aisnmea_partition_test (bool verbose)
+{
+    printf (" * aisnmea_partition: skipped on Windows\n");
+}
+#endif
@@ -0,0 +1,731 @@
+/*  =========================================================================
+    aisnmea_reader - Reads archives in large line-aligned chunks with many reads in flight
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_reader - Reads archives in large line-aligned chunks with many reads in flight
+@discuss
+    There are 'depth' buffers, used in turn. A free buffer is given the
+    next chunk-sized piece of the input straight away, so with io_uring
+    up to 'depth' reads are queued in the kernel while the caller works
+    on earlier chunks. Without io_uring (other platforms, older kernels,
+    or where it's blocked) each read is a plain pread () made when its
+    chunk is asked for.
+
+    Chunks come back in file order whatever order the reads finish in.
+    The partial line at the end of each chunk is held back and copied
+    into the space reserved in front of the next one, so callers only
+    ever see whole lines. A line longer than MAX_CARRY can't be held back
+    and comes out in pieces; no valid NMEA sentence is anywhere near that
+    long.
+
+    The reader is not thread safe: one thread should call next and
+    release and hand the chunks out to workers.
+
+    It uses pread () and POSIX file descriptors, so isn't built on
+    Windows.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+#if !defined (__WINDOWS__)
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#if defined (HAVE_LINUX_IO_URING_H)
+#   include <linux/io_uring.h>
+#   include <sys/syscall.h>
+#   include <sys/mman.h>
+#   if defined (__NR_io_uring_setup) && defined (__NR_io_uring_enter)
+#       define USE_IO_URING
+#   endif
+#endif
+
+//  Longest partial line carried from one chunk to the next
+#define MAX_CARRY 4096
+
+//  Life cycle of a buffer
+#define SLOT_FREE       0       // can take the next read
+#define SLOT_QUEUED     1       // has a piece of the input, not yet read
+#define SLOT_READING    2       // read in flight in the kernel
+#define SLOT_DONE       3       // read complete, waiting to be handed out
+#define SLOT_HELD       4       // handed out, waiting for release
+
+typedef struct {
+    char *buffer;           // MAX_CARRY + chunk_size + 1 bytes
+    int state;
+    size_t file;
+    uint64_t offset;        // where the piece starts in its file
+    size_t want;            // piece length
+    size_t got;             // bytes read so far
+    bool last;              // piece runs to the end of its file
+    struct iovec iov;       // what's left to read, for io_uring
+} slot_t;
+
+#if defined (USE_IO_URING)
+typedef struct {
+    int fd;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned to_submit;     // SQEs written but not yet passed to the kernel
+    size_t in_flight;
+} uring_t;
+#endif
+
+//  Structure of our class
+
+struct _aisnmea_reader_t {
+    size_t chunk_size;
+
+    // Input files, read in order
+    int *fds;
+    uint64_t *sizes;
+    size_t file_count;
+
+    // Next piece of input to hand to a buffer
+    size_t cursor_file;
+    uint64_t cursor_offset;
+
+    // Buffers, and the indexes of those given input, in input order
+    slot_t *slots;
+    size_t depth;
+    size_t *order;
+    size_t order_head;
+    size_t order_count;
+
+    char carry [MAX_CARRY];
+    size_t carry_size;
+    size_t size;            // of the chunk last handed out
+    bool failed;
+
+#if defined (USE_IO_URING)
+    uring_t *uring;
+#endif
+};
+
+
+#if defined (USE_IO_URING)
+//  --------------------------------------------------------------------------
+//  io_uring through raw system calls, so we don't need liburing. Returns
+//  NULL if the kernel won't give us a ring.
+
+static uring_t *
+s_uring_new (unsigned entries)
+{
+    struct io_uring_params params;
+    memset (&params, 0, sizeof (params));
+    int fd = (int) syscall (__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+        return NULL;
+
+    uring_t *self = (uring_t *) zmalloc (sizeof (uring_t));
+    assert (self);
+    self->fd = fd;
+    self->sq_ring = MAP_FAILED;
+    self->cq_ring = MAP_FAILED;
+    self->sqes = (struct io_uring_sqe *) MAP_FAILED;
+
+    self->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+    self->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+    self->sqes_size = params.sq_entries * sizeof (struct io_uring_sqe);
+
+    // Newer kernels map both rings in one go
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (self->cq_ring_size > self->sq_ring_size)
+            self->sq_ring_size = self->cq_ring_size;
+        self->cq_ring_size = 0;
+    }
+    self->sq_ring = mmap (NULL, self->sq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (self->sq_ring == MAP_FAILED)
+        goto die;
+    if (self->cq_ring_size) {
+        self->cq_ring = mmap (NULL, self->cq_ring_size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (self->cq_ring == MAP_FAILED)
+            goto die;
+    }
+    self->sqes = (struct io_uring_sqe *) mmap (NULL, self->sqes_size,
+                          PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd, IORING_OFF_SQES);
+    if (self->sqes == MAP_FAILED)
+        goto die;
+
+    char *sq = (char *) self->sq_ring;
+    char *cq = self->cq_ring_size ? (char *) self->cq_ring : sq;
+    self->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    self->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    self->sq_array = (unsigned *) (sq + params.sq_off.array);
+    self->cq_head = (unsigned *) (cq + params.cq_off.head);
+    self->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    self->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    self->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    return self;
+
+ die:
+    if (self->sq_ring != MAP_FAILED)
+        munmap (self->sq_ring, self->sq_ring_size);
+    if (self->cq_ring != MAP_FAILED)
+        munmap (self->cq_ring, self->cq_ring_size);
+    close (fd);
+    free (self);
+    return NULL;
+}
+
+static void
+s_uring_destroy (uring_t **self_p)
+{
+    uring_t *self = *self_p;
+    if (self) {
+        munmap (self->sqes, self->sqes_size);
+        if (self->cq_ring_size)
+            munmap (self->cq_ring, self->cq_ring_size);
+        munmap (self->sq_ring, self->sq_ring_size);
+        close (self->fd);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+//  Queue a read of what's left of a slot's piece
+
+static void
+s_uring_queue_read (uring_t *self, int fd, slot_t *slot, size_t index)
+{
+    unsigned tail = *self->sq_tail;
+    unsigned sq_index = tail & *self->sq_mask;
+    struct io_uring_sqe *sqe = &self->sqes [sq_index];
+    memset (sqe, 0, sizeof (*sqe));
+    // READV rather than READ, which only arrived in 5.6
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->off = slot->offset + slot->got;
+    sqe->addr = (uint64_t) (uintptr_t) &slot->iov;
+    sqe->len = 1;
+    sqe->user_data = index;
+    self->sq_array [sq_index] = sq_index;
+    __atomic_store_n (self->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    self->to_submit += 1;
+    self->in_flight += 1;
+}
+
+//  Pass queued reads to the kernel, waiting for at least 'wait_for' to
+//  complete. Returns -1 on error.
+
+static int
+s_uring_enter (uring_t *self, unsigned wait_for)
+{
+    while (self->to_submit || wait_for) {
+        int rc = (int) syscall (__NR_io_uring_enter, self->fd, self->to_submit,
+                                wait_for, wait_for ? IORING_ENTER_GETEVENTS : 0,
+                                NULL, 0);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        self->to_submit -= (unsigned) rc;
+        break;
+    }
+    return 0;
+}
+#endif
+
+
+//  --------------------------------------------------------------------------
+//  Account for one finished read, going again if it came up short
+
+static void
+s_completed (aisnmea_reader_t *self, size_t index, ssize_t result)
+{
+    slot_t *slot = &self->slots [index];
+    if (result < 0) {
+        self->failed = true;
+        slot->state = SLOT_DONE;
+        return;
+    }
+    slot->got += (size_t) result;
+    if (result == 0 && slot->got < slot->want) {
+        // File shrank under us; settle for what's there
+        slot->want = slot->got;
+        slot->last = true;
+    }
+    if (slot->got == slot->want)
+        slot->state = SLOT_DONE;
+#if defined (USE_IO_URING)
+    else
+    if (self->uring) {
+        slot->iov.iov_base = slot->buffer + MAX_CARRY + slot->got;
+        slot->iov.iov_len = slot->want - slot->got;
+        s_uring_queue_read (self->uring, self->fds [slot->file], slot, index);
+    }
+#endif
+}
+
+//  Take in every completion the kernel has posted
+
+#if defined (USE_IO_URING)
+static void
+s_reap (aisnmea_reader_t *self)
+{
+    uring_t *uring = self->uring;
+    unsigned head = *uring->cq_head;
+    while (head != __atomic_load_n (uring->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &uring->cqes [head & *uring->cq_mask];
+        size_t index = (size_t) cqe->user_data;
+        int result = cqe->res;
+        uring->in_flight -= 1;
+        head += 1;
+        __atomic_store_n (uring->cq_head, head, __ATOMIC_RELEASE);
+
+        if (result == -EINTR || result == -EAGAIN) {
+            slot_t *slot = &self->slots [index];
+            s_uring_queue_read (uring, self->fds [slot->file], slot, index);
+        }
+        else
+            s_completed (self, index, result < 0 ? -1 : result);
+    }
+}
+#endif
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_reader
+
+aisnmea_reader_t *
+aisnmea_reader_new (size_t chunk_size, size_t depth)
+{
+    assert (chunk_size);
+    assert (depth);
+
+    aisnmea_reader_t *self = (aisnmea_reader_t *) zmalloc (sizeof (aisnmea_reader_t));
+    assert (self);
+    self->chunk_size = chunk_size;
+    self->depth = depth;
+    self->slots = (slot_t *) zmalloc (depth * sizeof (slot_t));
+    self->order = (size_t *) zmalloc (depth * sizeof (size_t));
+    assert (self->slots && self->order);
+    for (size_t i = 0; i < depth; ++i) {
+        self->slots [i].buffer = (char *) malloc (MAX_CARRY + chunk_size + 1);
+        assert (self->slots [i].buffer);
+    }
+#if defined (USE_IO_URING)
+    self->uring = s_uring_new ((unsigned) depth);
+#endif
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_reader
+
+void
+aisnmea_reader_destroy (aisnmea_reader_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_reader_t *self = *self_p;
+#if defined (USE_IO_URING)
+        // The kernel may still be writing into our buffers
+        while (self->uring && self->uring->in_flight) {
+            if (s_uring_enter (self->uring, 1))
+                break;
+            s_reap (self);
+        }
+        s_uring_destroy (&self->uring);
+#endif
+        for (size_t i = 0; i < self->depth; ++i)
+            free (self->slots [i].buffer);
+        free (self->slots);
+        free (self->order);
+        for (size_t i = 0; i < self->file_count; ++i)
+            close (self->fds [i]);
+        free (self->fds);
+        free (self->sizes);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Queue a file
+
+int
+aisnmea_reader_add (aisnmea_reader_t *self, const char *path)
+{
+    assert (self);
+    assert (path);
+
+    int fd = open (path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat (fd, &st) || !S_ISREG (st.st_mode)) {
+        close (fd);
+        return -1;
+    }
+#if defined (POSIX_FADV_SEQUENTIAL)
+    posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    self->fds = (int *) realloc (self->fds, (self->file_count + 1) * sizeof (int));
+    self->sizes = (uint64_t *) realloc (self->sizes,
+                      (self->file_count + 1) * sizeof (uint64_t));
+    assert (self->fds && self->sizes);
+    self->fds [self->file_count] = fd;
+    self->sizes [self->file_count] = (uint64_t) st.st_size;
+    self->file_count += 1;
+    return 0;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Give every free buffer the next piece of input
+
+static void
+s_fill (aisnmea_reader_t *self)
+{
+    size_t index = 0;
+    while (true) {
+        while (self->cursor_file < self->file_count
+           &&  self->cursor_offset >= self->sizes [self->cursor_file]) {
+            self->cursor_file += 1;
+            self->cursor_offset = 0;
+        }
+        if (self->cursor_file == self->file_count)
+            break;
+        while (index < self->depth && self->slots [index].state != SLOT_FREE)
+            ++index;
+        if (index == self->depth)
+            break;
+
+        slot_t *slot = &self->slots [index];
+        uint64_t left = self->sizes [self->cursor_file] - self->cursor_offset;
+        slot->file = self->cursor_file;
+        slot->offset = self->cursor_offset;
+        slot->want = left < self->chunk_size ? (size_t) left : self->chunk_size;
+        slot->got = 0;
+        slot->last = slot->want == left;
+        slot->state = SLOT_QUEUED;
+        self->cursor_offset += slot->want;
+        self->order [(self->order_head + self->order_count) % self->depth] = index;
+        self->order_count += 1;
+
+#if defined (USE_IO_URING)
+        if (self->uring) {
+            slot->iov.iov_base = slot->buffer + MAX_CARRY;
+            slot->iov.iov_len = slot->want;
+            slot->state = SLOT_READING;
+            s_uring_queue_read (self->uring, self->fds [slot->file], slot, index);
+        }
+#endif
+    }
+#if defined (USE_IO_URING)
+    if (self->uring && s_uring_enter (self->uring, 0))
+        self->failed = true;
+#endif
+}
+
+
+//  Read a slot's piece, if not done already
+
+static void
+s_wait (aisnmea_reader_t *self, size_t index)
+{
+    slot_t *slot = &self->slots [index];
+#if defined (USE_IO_URING)
+    if (self->uring) {
+        while (slot->state == SLOT_READING && !self->failed) {
+            if (s_uring_enter (self->uring, 1)) {
+                self->failed = true;
+                break;
+            }
+            s_reap (self);
+        }
+        return;
+    }
+#endif
+    while (slot->state == SLOT_QUEUED) {
+        ssize_t result = pread (self->fds [slot->file],
+                                slot->buffer + MAX_CARRY + slot->got,
+                                slot->want - slot->got,
+                                (off_t) (slot->offset + slot->got));
+        if (result < 0 && errno == EINTR)
+            continue;
+        s_completed (self, index, result);
+        if (self->failed)
+            break;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Wait for the next chunk
+
+const char *
+aisnmea_reader_next (aisnmea_reader_t *self)
+{
+    assert (self);
+
+    while (!self->failed) {
+        s_fill (self);
+        if (!self->order_count) {
+            // The input's all read; if any is left, the caller holds
+            // every buffer, and we'd wait for ever
+            assert (self->cursor_file == self->file_count);
+            return NULL;
+        }
+        size_t index = self->order [self->order_head];
+        self->order_head = (self->order_head + 1) % self->depth;
+        self->order_count -= 1;
+        slot_t *slot = &self->slots [index];
+
+        s_wait (self, index);
+        if (self->failed)
+            break;
+
+        // Put the held-back partial line in front of the new data
+        char *chunk = slot->buffer + MAX_CARRY - self->carry_size;
+        memcpy (chunk, self->carry, self->carry_size);
+        size_t size = self->carry_size + slot->got;
+        self->carry_size = 0;
+
+        if (!slot->last) {
+            // Hold back whatever follows the last newline
+            size_t end = size;
+            while (end && chunk [end - 1] != '\n')
+                --end;
+            size_t tail = size - end;
+            if (end == 0 && size > MAX_CARRY)
+                end = size;     // overlong line; let it go in pieces
+            else
+            if (tail <= MAX_CARRY) {
+                memcpy (self->carry, chunk + end, tail);
+                self->carry_size = tail;
+                size = end;
+            }
+        }
+        if (size == 0) {
+            slot->state = SLOT_FREE;
+            continue;
+        }
+        chunk [size] = 0;
+        slot->state = SLOT_HELD;
+        self->size = size;
+        return chunk;
+    }
+    return NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Length of the last chunk
+
+size_t
+aisnmea_reader_size (aisnmea_reader_t *self)
+{
+    assert (self);
+    return self->size;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Give a chunk back
+
+void
+aisnmea_reader_release (aisnmea_reader_t *self, const char *chunk)
+{
+    assert (self);
+    assert (chunk);
+
+    for (size_t i = 0; i < self->depth; ++i) {
+        slot_t *slot = &self->slots [i];
+        if (chunk >= slot->buffer && chunk <= slot->buffer + MAX_CARRY) {
+            assert (slot->state == SLOT_HELD);
+            slot->state = SLOT_FREE;
+            return;
+        }
+    }
+    assert (false);     // not one of ours
+}
+
+
+//  --------------------------------------------------------------------------
+//  Whether a read has failed
+
+bool
+aisnmea_reader_failed (aisnmea_reader_t *self)
+{
+    assert (self);
+    return self->failed;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Which backend we're using
+
+bool
+aisnmea_reader_uring (aisnmea_reader_t *self)
+{
+    assert (self);
+#if defined (USE_IO_URING)
+    return self->uring != NULL;
+#else
+    return false;
+#endif
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_reader_test (bool verbose)
+{
+    printf (" * aisnmea_reader: ");
+
+    //  @selftest
+
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    char *first_path = zsys_sprintf ("%s/reader-1.nmea", SELFTEST_DIR_RW);
+    char *empty_path = zsys_sprintf ("%s/reader-2.nmea", SELFTEST_DIR_RW);
+    char *second_path = zsys_sprintf ("%s/reader-3.nmea", SELFTEST_DIR_RW);
+    assert (first_path && empty_path && second_path);
+    zsys_dir_create (SELFTEST_DIR_RW);
+
+    // Lines of varied length, some longer than a chunk, and a second
+    // file without a final newline
+    const char *first_text =
+        "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C\n"
+        "\\s:r003669945,c:1241544035*79\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13\n"
+        "junk\n"
+        "\n"
+        "!AIVDM,2,1,3,B,55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53,0*3E\n"
+        "!AIVDM,2,2,3,B,1@0000000000000,2*55\n";
+    const char *second_text =
+        "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C\n"
+        "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C";
+    FILE *file = fopen (first_path, "w");
+    assert (file);
+    fputs (first_text, file);
+    fclose (file);
+    file = fopen (empty_path, "w");
+    assert (file);
+    fclose (file);
+    file = fopen (second_path, "w");
+    assert (file);
+    fputs (second_text, file);
+    fclose (file);
+
+    aisnmea_reader_t *reader = aisnmea_reader_new (32, 3);
+    assert (reader);
+    assert (aisnmea_reader_next (reader) == NULL);
+    assert (aisnmea_reader_add (reader, "src/selftest-rw/no-such-file") == -1);
+    assert (aisnmea_reader_add (reader, first_path) == 0);
+    assert (aisnmea_reader_add (reader, empty_path) == 0);
+    assert (aisnmea_reader_add (reader, second_path) == 0);
+    if (verbose)
+        zsys_debug ("io_uring: %s", aisnmea_reader_uring (reader) ? "yes" : "no");
+
+    // Hold on to two chunks at a time, giving them back oldest first
+    char *expected = zsys_sprintf ("%s%s", first_text, second_text);
+    assert (expected);
+    char *seen = (char *) zmalloc (strlen (expected) + 1);
+    assert (seen);
+    size_t seen_size = 0;
+    size_t chunks = 0;
+    const char *held [2] = { NULL, NULL };
+    const char *chunk;
+    while ((chunk = aisnmea_reader_next (reader))) {
+        size_t size = aisnmea_reader_size (reader);
+        assert (size && strlen (chunk) == size);
+        assert (seen_size + size <= strlen (expected));
+        memcpy (seen + seen_size, chunk, size);
+        seen_size += size;
+        // Whole lines only, except at the very end
+        assert (chunk [size - 1] == '\n' || seen_size == strlen (expected));
+        if (held [0])
+            aisnmea_reader_release (reader, held [0]);
+        held [0] = held [1];
+        held [1] = chunk;
+        ++chunks;
+    }
+    assert (streq (seen, expected));
+    assert (chunks > 2);
+    if (held [0])
+        aisnmea_reader_release (reader, held [0]);
+    aisnmea_reader_release (reader, held [1]);
+    assert (aisnmea_reader_next (reader) == NULL);
+    assert (!aisnmea_reader_failed (reader));
+    aisnmea_reader_destroy (&reader);
+    assert (!reader);
+
+    // A read error ends the input early, and says so
+    reader = aisnmea_reader_new (32, 3);
+    assert (reader);
+    assert (aisnmea_reader_add (reader, first_path) == 0);
+    close (reader->fds [0]);
+    reader->fds [0] = open (SELFTEST_DIR_RW, O_RDONLY);
+    assert (reader->fds [0] >= 0);
+    assert (aisnmea_reader_next (reader) == NULL);
+    assert (aisnmea_reader_failed (reader));
+    aisnmea_reader_destroy (&reader);
+
+    // Big chunks: each file should come in one piece
+    reader = aisnmea_reader_new (1 << 16, 4);
+    assert (reader);
+    assert (aisnmea_reader_add (reader, first_path) == 0);
+    assert (aisnmea_reader_add (reader, second_path) == 0);
+    chunk = aisnmea_reader_next (reader);
+    assert (chunk && streq (chunk, first_text));
+    aisnmea_reader_release (reader, chunk);
+    chunk = aisnmea_reader_next (reader);
+    assert (chunk && streq (chunk, second_text));
+    // Destroy with the chunk still out is fine
+    aisnmea_reader_destroy (&reader);
+
+    free (expected);
+    free (seen);
+    zsys_file_delete (first_path);
+    zsys_file_delete (empty_path);
+    zsys_file_delete (second_path);
+    zstr_free (&first_path);
+    zstr_free (&empty_path);
+    zstr_free (&second_path);
+
+    //  @end
+    printf ("OK\n");
+}
+
+#else
+//  POSIX file I/O only; the class is left out on Windows
+
+void
+aisnmea_reader_test (bool verbose)
+{
+    printf (" * aisnmea_reader: skipped on Windows\n");
+}
+#endif
@@ -29,6 +29,25 @@ all_tests [] = {
 #ifdef AISNMEA_BUILD_DRAFT_API
 // Tests for draft public classes:
     { "aisnmea", aisnmea_test },
+    { "aisnmea_hist", aisnmea_hist_test },
+    { "aisnmea_dedup", aisnmea_dedup_test },
+    { "aisnmea_merge", aisnmea_merge_test },
+    { "aisnmea_index", aisnmea_index_test },
+    { "aisnmea_blockindex", aisnmea_blockindex_test },
+    { "aisnmea_stream", aisnmea_stream_test },
+    { "aisnmea_batch", aisnmea_batch_test },
+    { "aisnmea_udp", aisnmea_udp_test },
+    { "aisnmea_server", aisnmea_server_test },
+    { "aisnmea_reader", aisnmea_reader_test },
+    { "aisnmea_groups", aisnmea_groups_test },
+    { "aisnmea_decimate", aisnmea_decimate_test },
+    { "aisnmea_vessel", aisnmea_vessel_test },
+    { "aisnmea_vessels", aisnmea_vessels_test },
+    { "aisnmea_grid", aisnmea_grid_test },
+    { "aisnmea_filter", aisnmea_filter_test },
+    { "aisnmea_partition", aisnmea_partition_test },
+    { "aisnmea_arena", aisnmea_arena_test },
+    { "aisnmea_statics", aisnmea_statics_test },
 #endif // AISNMEA_BUILD_DRAFT_API
 #ifdef AISNMEA_BUILD_DRAFT_API
     { "private_classes", aisnmea_private_selftest },
@@ -90,7 +109,7 @@ main (int argc, char **argv)
         else
         if (streq (argv [argn], "--number")
         ||  streq (argv [argn], "-n")) {
-            puts ("1");
+            puts ("20");
             return 0;
         }
         else
@@ -98,6 +117,25 @@ main (int argc, char **argv)
         ||  streq (argv [argn], "-l")) {
             puts ("Available tests:");
             puts ("    aisnmea\t\t- draft");
+            puts ("    aisnmea_hist\t\t- draft");
+            puts ("    aisnmea_dedup\t\t- draft");
+            puts ("    aisnmea_merge\t\t- draft");
+            puts ("    aisnmea_index\t\t- draft");
+            puts ("    aisnmea_blockindex\t- draft");
+            puts ("    aisnmea_stream\t\t- draft");
+            puts ("    aisnmea_batch\t\t- draft");
+            puts ("    aisnmea_udp\t\t- draft");
+            puts ("    aisnmea_server\t\t- draft");
+            puts ("    aisnmea_reader\t\t- draft");
+            puts ("    aisnmea_groups\t\t- draft");
+            puts ("    aisnmea_decimate\t- draft");
+            puts ("    aisnmea_vessel\t\t- draft");
+            puts ("    aisnmea_vessels\t- draft");
+            puts ("    aisnmea_grid\t\t- draft");
+            puts ("    aisnmea_filter\t\t- draft");
+            puts ("    aisnmea_partition\t- draft");
+            puts ("    aisnmea_arena\t\t- draft");
+            puts ("    aisnmea_statics\t- draft");
             puts ("    private_classes\t- draft");
             return 0;
         }
@@ -0,0 +1,673 @@
+/*  =========================================================================
+    aisnmea_server - Event-driven TCP server for NMEA feeds from many receivers
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_server - Event-driven TCP server for NMEA feeds from many receivers
+@discuss
+    One thread serves every connection: all sockets are non-blocking and
+    registered with one epoll set on Linux (poll () elsewhere). Each
+    connection keeps a fixed buffer holding the start of an incomplete
+    line until the rest arrives; complete lines are checked straight out
+    of that buffer, so nothing is copied per line.
+
+    Lines longer than the buffer can't be valid NMEA; they are thrown
+    away up to their line ending and counted as errors.
+
+    Counters are kept per source address rather than per connection, so
+    they carry on across reconnects.
+
+    It uses POSIX sockets, so isn't built on Windows.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+#if !defined (__WINDOWS__)
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#if defined (__linux__)
+#   include <sys/epoll.h>
+#else
+#   include <poll.h>
+#endif
+
+//  Longest line we'll take, including any tag block
+#define MAX_LINE 4096
+
+//  Most events handled per epoll_wait ()
+#define MAX_EVENTS 256
+
+typedef struct {
+    char name [INET6_ADDRSTRLEN];
+    uint64_t connections;
+    uint64_t lines;
+    uint64_t errors;
+    uint64_t bytes;
+} source_t;
+
+typedef struct {
+    int fd;
+    size_t source;
+    bool discarding;    // inside an overlong line
+    size_t size;
+    char buf [MAX_LINE + 1];
+} conn_t;
+
+//  Structure of our class
+
+struct _aisnmea_server_t {
+    int listener;
+    int port;
+#if defined (__linux__)
+    int epoll_fd;
+#endif
+
+    aisnmea_server_line_fn *handler;
+    void *handler_arg;
+    bool fastpath;
+    aisnmea_t *parser;
+
+    // Open connections, indexed by file descriptor
+    conn_t **conns;
+    size_t conns_capacity;
+    size_t conn_count;
+
+    // Counters by address; zhash maps name to index + 1
+    source_t *sources;
+    size_t source_count;
+    zhash_t *source_index;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_server
+
+static int
+s_set_nonblocking (int fd)
+{
+    int flags = fcntl (fd, F_GETFL, 0);
+    if (flags < 0)
+        return -1;
+    return fcntl (fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+aisnmea_server_t *
+aisnmea_server_new (const char *address, int port, bool reuseport)
+{
+    assert (port >= 0 && port <= 65535);
+
+    aisnmea_server_t *self = (aisnmea_server_t *) zmalloc (sizeof (aisnmea_server_t));
+    assert (self);
+    self->listener = -1;
+#if defined (__linux__)
+    self->epoll_fd = -1;
+#endif
+    self->parser = aisnmea_new (NULL);
+    assert (self->parser);
+    self->source_index = zhash_new ();
+    assert (self->source_index);
+
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof (addr);
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons ((uint16_t) port);
+    addr.sin_addr.s_addr = htonl (INADDR_ANY);
+    if (address && inet_pton (AF_INET, address, &addr.sin_addr) != 1)
+        goto die;
+
+    self->listener = socket (AF_INET, SOCK_STREAM, 0);
+    if (self->listener < 0)
+        goto die;
+    int on = 1;
+    setsockopt (self->listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+    if (reuseport) {
+#if defined (SO_REUSEPORT)
+        if (setsockopt (self->listener, SOL_SOCKET, SO_REUSEPORT, &on, sizeof (on)))
+            goto die;
+#else
+        goto die;
+#endif
+    }
+    if (bind (self->listener, (struct sockaddr *) &addr, sizeof (addr))
+    ||  listen (self->listener, SOMAXCONN)
+    ||  s_set_nonblocking (self->listener)
+    ||  getsockname (self->listener, (struct sockaddr *) &addr, &addr_len))
+        goto die;
+    self->port = ntohs (addr.sin_port);
+
+#if defined (__linux__)
+    self->epoll_fd = epoll_create1 (0);
+    if (self->epoll_fd < 0)
+        goto die;
+    struct epoll_event event = { EPOLLIN, { .fd = self->listener } };
+    if (epoll_ctl (self->epoll_fd, EPOLL_CTL_ADD, self->listener, &event))
+        goto die;
+#endif
+
+    return self;
+
+ die:
+    aisnmea_server_destroy (&self);
+    return NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_server
+
+void
+aisnmea_server_destroy (aisnmea_server_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_server_t *self = *self_p;
+        for (size_t fd = 0; fd < self->conns_capacity; ++fd) {
+            if (self->conns [fd]) {
+                close ((int) fd);
+                free (self->conns [fd]);
+            }
+        }
+        free (self->conns);
+        if (self->listener >= 0)
+            close (self->listener);
+#if defined (__linux__)
+        if (self->epoll_fd >= 0)
+            close (self->epoll_fd);
+#endif
+        free (self->sources);
+        zhash_destroy (&self->source_index);
+        aisnmea_destroy (&self->parser);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Settings
+
+int
+aisnmea_server_port (aisnmea_server_t *self)
+{
+    assert (self);
+    return self->port;
+}
+
+void
+aisnmea_server_set_handler (aisnmea_server_t *self, aisnmea_server_line_fn *handler, void *arg)
+{
+    assert (self);
+    self->handler = handler;
+    self->handler_arg = arg;
+}
+
+void
+aisnmea_server_set_fastpath (aisnmea_server_t *self, bool fastpath)
+{
+    assert (self);
+    self->fastpath = fastpath;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Connections
+
+//  Index of the source for an address, adding it if new
+static size_t
+s_source_lookup (aisnmea_server_t *self, const char *name)
+{
+    void *item = zhash_lookup (self->source_index, name);
+    if (item)
+        return (size_t) (uintptr_t) item - 1;
+
+    self->sources = (source_t *) realloc (self->sources,
+                        (self->source_count + 1) * sizeof (source_t));
+    assert (self->sources);
+    source_t *source = &self->sources [self->source_count];
+    memset (source, 0, sizeof (source_t));
+    strncpy (source->name, name, sizeof (source->name) - 1);
+    int rc = zhash_insert (self->source_index, name,
+                           (void *) (uintptr_t) (self->source_count + 1));
+    assert (!rc);
+    return self->source_count++;
+}
+
+static void
+s_accept_all (aisnmea_server_t *self)
+{
+    while (true) {
+        struct sockaddr_in peer;
+        socklen_t peer_len = sizeof (peer);
+        int fd = accept (self->listener, (struct sockaddr *) &peer, &peer_len);
+        if (fd < 0)
+            return;   // EAGAIN once the backlog is empty
+        if (s_set_nonblocking (fd)) {
+            close (fd);
+            continue;
+        }
+
+        if ((size_t) fd >= self->conns_capacity) {
+            size_t capacity = self->conns_capacity ? self->conns_capacity : 64;
+            while (capacity <= (size_t) fd)
+                capacity *= 2;
+            self->conns = (conn_t **) realloc (self->conns, capacity * sizeof (conn_t *));
+            assert (self->conns);
+            memset (self->conns + self->conns_capacity, 0,
+                    (capacity - self->conns_capacity) * sizeof (conn_t *));
+            self->conns_capacity = capacity;
+        }
+
+#if defined (__linux__)
+        struct epoll_event event = { EPOLLIN, { .fd = fd } };
+        if (epoll_ctl (self->epoll_fd, EPOLL_CTL_ADD, fd, &event)) {
+            close (fd);
+            continue;
+        }
+#endif
+        char name [INET6_ADDRSTRLEN];
+        inet_ntop (AF_INET, &peer.sin_addr, name, sizeof (name));
+
+        conn_t *conn = (conn_t *) malloc (sizeof (conn_t));
+        assert (conn);
+        conn->fd = fd;
+        conn->source = s_source_lookup (self, name);
+        conn->discarding = false;
+        conn->size = 0;
+        self->conns [fd] = conn;
+        self->conn_count += 1;
+        self->sources [conn->source].connections += 1;
+    }
+}
+
+static void
+s_close (aisnmea_server_t *self, conn_t *conn)
+{
+#if defined (__linux__)
+    epoll_ctl (self->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+#endif
+    close (conn->fd);
+    self->conns [conn->fd] = NULL;
+    self->conn_count -= 1;
+    free (conn);
+}
+
+//  Check one complete, NUL-terminated line and pass it on if it's good
+static int
+s_handle_line (aisnmea_server_t *self, conn_t *conn, char *line, size_t size)
+{
+    if (size && line [size - 1] == '\r')
+        line [--size] = 0;
+    if (!size)
+        return 0;
+
+    source_t *source = &self->sources [conn->source];
+    bool good = self->fastpath ? aisnmea_validate (line)
+                               : aisnmea_parse (self->parser, line) == 0;
+    if (!good) {
+        source->errors += 1;
+        return 0;
+    }
+    source->lines += 1;
+    if (self->handler)
+        (self->handler) (line, conn->source, self->handler_arg);
+    return 1;
+}
+
+//  Read what's waiting on a connection. Returns lines handled.
+static int
+s_read (aisnmea_server_t *self, conn_t *conn)
+{
+    ssize_t got = recv (conn->fd, conn->buf + conn->size, MAX_LINE - conn->size, 0);
+    if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        // A clean hang-up ends any last line without its newline
+        int handled = 0;
+        if (got == 0 && conn->size && !conn->discarding) {
+            conn->buf [conn->size] = 0;
+            handled = s_handle_line (self, conn, conn->buf, conn->size);
+        }
+        s_close (self, conn);
+        return handled;
+    }
+    if (got < 0)
+        return 0;
+    self->sources [conn->source].bytes += (uint64_t) got;
+
+    int handled = 0;
+    char *start = conn->buf;
+    char *end = conn->buf + conn->size + got;
+    char *newline;
+    while ((newline = (char *) memchr (start, '\n', end - start))) {
+        *newline = 0;
+        if (conn->discarding)
+            conn->discarding = false;   // end of the overlong line
+        else
+            handled += s_handle_line (self, conn, start, newline - start);
+        start = newline + 1;
+    }
+
+    // Keep the start of any incomplete line for next time
+    conn->size = end - start;
+    if (conn->size == MAX_LINE) {
+        if (!conn->discarding)
+            self->sources [conn->source].errors += 1;
+        conn->discarding = true;
+        conn->size = 0;
+    }
+    else
+    if (conn->size && start != conn->buf)
+        memmove (conn->buf, start, conn->size);
+    if (conn->discarding)
+        conn->size = 0;
+    return handled;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Deal with whatever has happened
+
+int
+aisnmea_server_run (aisnmea_server_t *self, int timeout)
+{
+    assert (self);
+    int handled = 0;
+
+#if defined (__linux__)
+    struct epoll_event events [MAX_EVENTS];
+    int count = epoll_wait (self->epoll_fd, events, MAX_EVENTS, timeout);
+    if (count < 0)
+        return errno == EINTR ? 0 : -1;
+    for (int i = 0; i < count; ++i) {
+        int fd = events [i].data.fd;
+        if (fd == self->listener)
+            s_accept_all (self);
+        else
+        if ((size_t) fd < self->conns_capacity && self->conns [fd])
+            handled += s_read (self, self->conns [fd]);
+    }
+#else
+    size_t nfds = self->conn_count + 1;
+    struct pollfd *pfds = (struct pollfd *) malloc (nfds * sizeof (struct pollfd));
+    assert (pfds);
+    pfds [0].fd = self->listener;
+    pfds [0].events = POLLIN;
+    size_t used = 1;
+    for (size_t fd = 0; fd < self->conns_capacity; ++fd) {
+        if (self->conns [fd]) {
+            pfds [used].fd = (int) fd;
+            pfds [used].events = POLLIN;
+            ++used;
+        }
+    }
+    int count = poll (pfds, (nfds_t) used, timeout);
+    if (count < 0) {
+        free (pfds);
+        return errno == EINTR ? 0 : -1;
+    }
+    for (size_t i = 1; i < used; ++i)
+        if (pfds [i].revents)
+            handled += s_read (self, self->conns [pfds [i].fd]);
+    if (pfds [0].revents)
+        s_accept_all (self);
+    free (pfds);
+#endif
+    return handled;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Counters
+
+size_t
+aisnmea_server_connections (aisnmea_server_t *self)
+{
+    assert (self);
+    return self->conn_count;
+}
+
+size_t
+aisnmea_server_sources (aisnmea_server_t *self)
+{
+    assert (self);
+    return self->source_count;
+}
+
+const char *
+aisnmea_server_source_name (aisnmea_server_t *self, size_t source)
+{
+    assert (self);
+    assert (source < self->source_count);
+    return self->sources [source].name;
+}
+
+uint64_t
+aisnmea_server_source_lines (aisnmea_server_t *self, size_t source)
+{
+    assert (self);
+    assert (source < self->source_count);
+    return self->sources [source].lines;
+}
+
+uint64_t
+aisnmea_server_source_errors (aisnmea_server_t *self, size_t source)
+{
+    assert (self);
+    assert (source < self->source_count);
+    return self->sources [source].errors;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Add another server's per-source counters into ours
+
+void
+aisnmea_server_merge_sources (aisnmea_server_t *self, aisnmea_server_t *other)
+{
+    assert (self);
+    assert (other);
+    assert (other != self);
+    for (size_t i = 0; i < other->source_count; ++i) {
+        source_t *from = &other->sources [i];
+        source_t *into = &self->sources [s_source_lookup (self, from->name)];
+        into->connections += from->connections;
+        into->lines += from->lines;
+        into->errors += from->errors;
+        into->bytes += from->bytes;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Write the per-source counters as CSV
+
+void
+aisnmea_server_print_sources (aisnmea_server_t *self, FILE *file)
+{
+    assert (self);
+    assert (file);
+    fprintf (file, "\"source\",\"connections\",\"lines\",\"errors\",\"bytes\"\n");
+    for (size_t i = 0; i < self->source_count; ++i) {
+        source_t *source = &self->sources [i];
+        fprintf (file, "\"%s\",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+                 source->name, source->connections, source->lines,
+                 source->errors, source->bytes);
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+static void
+s_count_line (const char *line, size_t source, void *arg)
+{
+    size_t *count = (size_t *) arg;
+    assert (streq (line, "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13")
+        ||  streq (line, "!AIVDM,2,2,3,B,1@0000000000000,2*55")
+        ||  streq (line, "!AIVDM,1,1,,B,0*09"));
+    assert (source == 0);
+    *count += 1;
+}
+
+static int
+s_connect (int port)
+{
+    int fd = socket (AF_INET, SOCK_STREAM, 0);
+    assert (fd >= 0);
+    struct sockaddr_in to;
+    memset (&to, 0, sizeof (to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons ((uint16_t) port);
+    to.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    int rc = connect (fd, (struct sockaddr *) &to, sizeof (to));
+    assert (rc == 0);
+    return fd;
+}
+
+static void
+s_send (int fd, const char *data)
+{
+    ssize_t sent = send (fd, data, strlen (data), 0);
+    assert (sent == (ssize_t) strlen (data));
+}
+
+//  Run the server until it has handled 'want' lines in total
+static void
+s_run_until (aisnmea_server_t *server, size_t *count, size_t want)
+{
+    for (int i = 0; i < 100 && *count < want; ++i)
+        aisnmea_server_run (server, 50);
+    assert (*count == want);
+}
+
+void
+aisnmea_server_test (bool verbose)
+{
+    printf (" * aisnmea_server: ");
+
+    //  @selftest
+
+    assert (aisnmea_server_new ("not an address", 0, false) == NULL);
+
+    aisnmea_server_t *server = aisnmea_server_new ("127.0.0.1", 0, false);
+    assert (server);
+    int port = aisnmea_server_port (server);
+    assert (port > 0);
+    size_t count = 0;
+    aisnmea_server_set_handler (server, s_count_line, &count);
+    assert (aisnmea_server_run (server, 0) == 0);
+
+    // Two connections from the same address, lines split across sends
+    int client1 = s_connect (port);
+    int client2 = s_connect (port);
+    s_send (client1, "!AIVDM,1,1,,B,15N4cJ`005Jre");
+    s_send (client2, "!AIVDM,2,2,3,B,1@0000000000000,2*55\r\n");
+    s_run_until (server, &count, 1);
+    assert (aisnmea_server_connections (server) == 2);
+    s_send (client1, "k0H@9n`DW5608EP,0*13\r\n\r\n");
+    s_run_until (server, &count, 2);
+
+    // Bad checksums, other sentences and overlong lines are counted, and
+    // don't upset what follows
+    s_send (client1, "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*14\n"
+                     "$GPGGA,1*00\n");
+    char *overlong = (char *) malloc (MAX_LINE * 2 + 1);
+    assert (overlong);
+    memset (overlong, 'x', MAX_LINE * 2);
+    overlong [MAX_LINE * 2] = 0;
+    s_send (client2, overlong);
+    s_send (client2, "\n!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13\n");
+    free (overlong);
+    s_run_until (server, &count, 3);
+
+    assert (aisnmea_server_sources (server) == 1);
+    assert (streq (aisnmea_server_source_name (server, 0), "127.0.0.1"));
+    assert (aisnmea_server_source_lines (server, 0) == 3);
+    assert (aisnmea_server_source_errors (server, 0) == 3);
+
+    // Fast path only looks at checksums, so a sentence short of columns
+    // gets through
+    s_send (client1, "!AIVDM,1,1,,B,0*09\n");
+    aisnmea_server_run (server, 50);
+    aisnmea_server_set_fastpath (server, true);
+    s_send (client1, "!AIVDM,1,1,,B,0*09\n");
+    s_run_until (server, &count, 4);
+    assert (aisnmea_server_source_errors (server, 0) == 4);
+
+    // Hang-ups are noticed, and end a last line sent without its newline
+    s_send (client1, "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13");
+    close (client1);
+    for (int i = 0; i < 100 && aisnmea_server_connections (server) > 1; ++i)
+        aisnmea_server_run (server, 50);
+    assert (aisnmea_server_connections (server) == 1);
+    assert (count == 5);
+    assert (aisnmea_server_source_lines (server, 0) == 5);
+
+    if (verbose)
+        aisnmea_server_print_sources (server, stdout);
+
+    close (client2);
+    aisnmea_server_destroy (&server);
+    assert (!server);
+
+    // Counters from servers on different ports add up by source
+    aisnmea_server_t *west = aisnmea_server_new ("127.0.0.1", 0, false);
+    assert (west);
+    aisnmea_server_t *east = aisnmea_server_new ("127.0.0.1", 0, false);
+    assert (east);
+    count = 0;
+    aisnmea_server_set_handler (west, s_count_line, &count);
+    aisnmea_server_set_handler (east, s_count_line, &count);
+    client1 = s_connect (aisnmea_server_port (west));
+    client2 = s_connect (aisnmea_server_port (east));
+    s_send (client1, "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13\n");
+    s_send (client2, "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13\nbad\n");
+    s_run_until (west, &count, 1);
+    s_run_until (east, &count, 2);
+    for (int i = 0; i < 100 && aisnmea_server_source_errors (east, 0) < 1; ++i)
+        aisnmea_server_run (east, 50);
+    aisnmea_server_merge_sources (west, east);
+    assert (aisnmea_server_sources (west) == 1);
+    assert (aisnmea_server_source_lines (west, 0) == 2);
+    assert (aisnmea_server_source_errors (west, 0) == 1);
+    assert (aisnmea_server_source_lines (east, 0) == 1);
+    close (client1);
+    close (client2);
+    aisnmea_server_destroy (&west);
+    aisnmea_server_destroy (&east);
+
+#if defined (SO_REUSEPORT)
+    // Servers can share a port
+    aisnmea_server_t *first = aisnmea_server_new ("127.0.0.1", 0, true);
+    assert (first);
+    aisnmea_server_t *second = aisnmea_server_new ("127.0.0.1",
+                                                   aisnmea_server_port (first), true);
+    assert (second);
+    aisnmea_server_destroy (&first);
+    aisnmea_server_destroy (&second);
+#endif
+
+    //  @end
+    printf ("OK\n");
+}
+
+#else
+//  POSIX sockets only; the class is left out on Windows
+
+void
+aisnmea_server_test (bool verbose)
+{
+    printf (" * aisnmea_server: skipped on Windows\n");
+}
+#endif
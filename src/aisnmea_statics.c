@@ -0,0 +1,308 @@
+/*  =========================================================================
+    aisnmea_statics - Change detection for vessels' static and voyage messages
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_statics - Change detection for vessels' static and voyage messages
+@discuss
+    Each vessel has one slot in an open-addressed table of twice
+    'capacity' slots, holding a 64-bit FNV-1a hash of the payload for
+    each of type 5, type 24 part A and type 24 part B. Slots are never
+    removed, so a full cache turns new vessels away rather than evicting
+    anyone; forget just clears a vessel's hashes.
+
+    The hash covers the armoured payload after the message type, with the
+    two repeat indicator bits masked off, so it needs no decoding.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+//  Kinds of static message, each with a hash of its own
+#define KIND_TYPE5 0
+#define KIND_TYPE24A 1
+#define KIND_TYPE24B 2
+#define KINDS 3
+
+typedef struct {
+    uint32_t key;               // MMSI + 1, 0 for an empty slot
+    uint64_t hashes [KINDS];    // 0 when none seen
+} slot_t;
+
+//  Structure of our class
+
+struct _aisnmea_statics_t {
+    slot_t *slots;
+    size_t mask;            // slot count - 1, slot count is a power of two
+    unsigned bits;          // log2 of slot count
+    size_t capacity;
+    size_t size;
+    uint64_t unchanged;
+    uint64_t rejected;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_statics
+
+aisnmea_statics_t *
+aisnmea_statics_new (size_t capacity)
+{
+    assert (capacity && capacity < UINT32_MAX);
+    aisnmea_statics_t *self = (aisnmea_statics_t *) zmalloc (sizeof (aisnmea_statics_t));
+    assert (self);
+
+    // At most half full keeps probe runs short
+    size_t slot_count = 16;
+    self->bits = 4;
+    while (slot_count < capacity * 2) {
+        slot_count *= 2;
+        self->bits += 1;
+    }
+
+    self->slots = (slot_t *) zmalloc (slot_count * sizeof (slot_t));
+    assert (self->slots);
+    self->mask = slot_count - 1;
+    self->capacity = capacity;
+
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_statics
+
+void
+aisnmea_statics_destroy (aisnmea_statics_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_statics_t *self = *self_p;
+        free (self->slots);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Find vessel's slot, or the empty one where it would go
+
+static slot_t *
+s_slot_find (aisnmea_statics_t *self, uint32_t mmsi)
+{
+    uint32_t key = mmsi + 1;
+    size_t hash = aisnmea_mmsi_slot (key, self->bits);
+    for (size_t i = 0; ; ++i) {
+        slot_t *slot = &self->slots [(hash + i) & self->mask];
+        if (!slot->key || slot->key == key)
+            return slot;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  FNV-1a over the payload, leaving out the message type and the repeat
+//  indicator (the first character, and the top two bits of the second)
+
+static uint64_t
+s_payload_hash (const char *payload, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    hash ^= (uint64_t) (aisnmea_payload_bits (payload, size, 8, 4));
+    hash *= 1099511628211ULL;
+    const unsigned char *cur = (const unsigned char *) payload + 2;
+    const unsigned char *end = (const unsigned char *) payload + size;
+    while (cur < end) {
+        hash ^= *cur++;
+        hash *= 1099511628211ULL;
+    }
+    // Keep 0 free to mean none seen
+    return hash ? hash : 1;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Check a message
+
+int
+aisnmea_statics_check (aisnmea_statics_t *self, const char *payload)
+{
+    assert (self);
+    assert (payload);
+
+    size_t size = strlen (payload);
+    int type = (int) aisnmea_payload_bits (payload, size, 0, 6);
+    int kind;
+    // Bits needed to reach the last field, as aisnmea_vessels decodes
+    // them; anything shorter (like a type 5's first fragment alone)
+    // would be hashed without the fields that change
+    size_t needed;
+    if (type == 5) {
+        kind = KIND_TYPE5;
+        needed = 422;
+    }
+    else
+    if (type == 24) {
+        int part = (int) aisnmea_payload_bits (payload, size, 38, 2);
+        if (part == 0) {
+            kind = KIND_TYPE24A;
+            needed = 160;
+        }
+        else
+        if (part == 1) {
+            kind = KIND_TYPE24B;
+            needed = 162;
+        }
+        else
+            return -1;
+    }
+    else
+        return -1;
+    int64_t mmsi = aisnmea_payload_bits (payload, size, 8, 30);
+    if (size * 6 < needed || mmsi < 0)
+        return -1;
+
+    uint64_t hash = s_payload_hash (payload, size);
+    slot_t *slot = s_slot_find (self, (uint32_t) mmsi);
+    if (!slot->key) {
+        if (self->size == self->capacity) {
+            self->rejected += 1;
+            return 1;
+        }
+        slot->key = (uint32_t) mmsi + 1;
+        self->size += 1;
+    }
+    if (slot->hashes [kind] == hash) {
+        self->unchanged += 1;
+        return 0;
+    }
+    slot->hashes [kind] = hash;
+    return 1;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Forget what a vessel last sent
+
+void
+aisnmea_statics_forget (aisnmea_statics_t *self, uint32_t mmsi)
+{
+    assert (self);
+    slot_t *slot = s_slot_find (self, mmsi);
+    memset (slot->hashes, 0, sizeof (slot->hashes));
+}
+
+
+//  --------------------------------------------------------------------------
+//  Counts
+
+size_t
+aisnmea_statics_size (aisnmea_statics_t *self)
+{
+    assert (self);
+    return self->size;
+}
+
+uint64_t
+aisnmea_statics_unchanged (aisnmea_statics_t *self)
+{
+    assert (self);
+    return self->unchanged;
+}
+
+uint64_t
+aisnmea_statics_rejected (aisnmea_statics_t *self)
+{
+    assert (self);
+    return self->rejected;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_statics_test (bool verbose)
+{
+    printf (" * aisnmea_statics: ");
+
+    //  @selftest
+    // A type 5 from MMSI 369190000, its fragments joined; the same relayed
+    // with repeat indicator 1; and with a different destination
+    const char *type5 =
+        "55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53"
+        "1@0000000000000";
+    const char *type5_repeated =
+        "5EP5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53"
+        "1@0000000000000";
+    const char *type5_changed =
+        "55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53"
+        "1@0000000000001";
+    // Both parts of a type 24 from MMSI 271041815
+    const char *type24a = "H42O55i18tMET00000000000000";
+    const char *type24b = "H42O55lti4hhhilD3nink000?050";
+    assert (aisnmea_payload_bits (type24a, strlen (type24a), 38, 2) == 0);
+    assert (aisnmea_payload_bits (type24b, strlen (type24b), 38, 2) == 1);
+
+    aisnmea_statics_t *statics = aisnmea_statics_new (2);
+    assert (statics);
+
+    // The first of each kind is a change, and the same again isn't
+    assert (aisnmea_statics_check (statics, type5) == 1);
+    assert (aisnmea_statics_check (statics, type5) == 0);
+    assert (aisnmea_statics_check (statics, type5_repeated) == 0);
+    assert (aisnmea_statics_check (statics, type5_changed) == 1);
+    assert (aisnmea_statics_check (statics, type5_changed) == 0);
+    assert (aisnmea_statics_check (statics, type5) == 1);
+    assert (aisnmea_statics_size (statics) == 1);
+    assert (aisnmea_statics_unchanged (statics) == 3);
+
+    // Type 24 parts are kept apart
+    assert (aisnmea_statics_check (statics, type24a) == 1);
+    assert (aisnmea_statics_check (statics, type24b) == 1);
+    assert (aisnmea_statics_check (statics, type24a) == 0);
+    assert (aisnmea_statics_check (statics, type24b) == 0);
+    assert (aisnmea_statics_size (statics) == 2);
+
+    // Anything else isn't checked
+    assert (aisnmea_statics_check (statics, "15N4cJ`005Jrek0H@9n`DW5608EP") == -1);
+    assert (aisnmea_statics_check (statics, "55P5") == -1);
+    // A type 5's first fragment on its own falls short of the destination
+    assert (aisnmea_statics_check (statics,
+        "55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53") == -1);
+    assert (aisnmea_statics_check (statics, "") == -1);
+
+    // Forgetting makes the next of each kind a change again
+    aisnmea_statics_forget (statics, 271041815);
+    aisnmea_statics_forget (statics, 123456789);
+    assert (aisnmea_statics_check (statics, type24a) == 1);
+    assert (aisnmea_statics_check (statics, type24b) == 1);
+    assert (aisnmea_statics_check (statics, type5) == 0);
+
+    // New vessels past capacity are always changed, and not kept
+    char *copy = strdup (type24a);
+    assert (copy);
+    copy [3] = '6';
+    assert (aisnmea_statics_check (statics, copy) == 1);
+    assert (aisnmea_statics_check (statics, copy) == 1);
+    assert (aisnmea_statics_rejected (statics) == 2);
+    assert (aisnmea_statics_size (statics) == 2);
+    free (copy);
+    if (verbose)
+        zsys_debug ("%" PRIu64 " unchanged", aisnmea_statics_unchanged (statics));
+
+    aisnmea_statics_destroy (&statics);
+    assert (!statics);
+    //  @end
+
+    printf ("OK\n");
+}
@@ -0,0 +1,589 @@
+/*  =========================================================================
+    aisnmea_stream - Incremental AIS NMEA parser for unframed byte streams
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_stream - Incremental AIS NMEA parser for unframed byte streams
+@discuss
+    A state machine that takes one byte at a time, so it can stop at the
+    end of any buffer and carry on with the next. Fields go straight into
+    fixed-size buffers or running integers and the checksum is XORed in as
+    each byte arrives, so a sentence is done the moment its last checksum
+    digit turns up, without waiting for the line ending or copying the
+    line anywhere first.
+
+    '\', '!' and '$' can't occur inside a tag block or sentence body, so
+    any of them there starts a new sentence, throwing away (and counting)
+    anything half built; so does a line ending. Other damage, and non-AIS
+    sentences, throw away the rest of the line up to the next CR or LF,
+    start characters and all: after damage, a '\' is as likely to close a
+    tag block as to open one.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+//  Field limits; NMEA caps sentences at 82 chars, we allow some slack
+#define MAX_TAGBLOCK 256
+#define MAX_HEAD     6      // start char plus five-char address
+#define MAX_PAYLOAD  128
+#define MAX_DIGITS   9
+
+typedef enum {
+    S_IDLE,             // between sentences
+    S_SKIP,             // throwing away the rest of a line
+    S_TAGBLOCK,         // inside "\...*", before the '*'
+    S_TAGBLOCK_CS1,     // tagblock checksum digits
+    S_TAGBLOCK_CS2,
+    S_TAGBLOCK_END,     // expecting the closing '\'
+    S_SENTENCE_START,   // after a tagblock, expecting '!' or '$'
+    S_FIELD,            // inside the comma-separated body
+    S_CS1,              // sentence checksum digits
+    S_CS2
+} state_t;
+
+//  Body columns
+enum {
+    COL_HEAD, COL_FRAGCOUNT, COL_FRAGNUM, COL_MESSAGEID,
+    COL_CHANNEL, COL_PAYLOAD, COL_FILLBITS, COL_COUNT
+};
+
+//  Structure of our class
+
+struct _aisnmea_stream_t {
+    aisnmea_t *msg;         // handed to the callback
+    state_t state;
+
+    // Tagblock, if the current sentence has one
+    bool has_tagblock;
+    char tagblock [MAX_TAGBLOCK + 1];
+    size_t tagblock_len;
+    int tagblock_sum;
+
+    // Sentence body
+    int sum;                // running XOR of body bytes
+    int given_sum;          // checksum being read, tagblock or body
+    int column;
+    size_t digits;          // digits in the current numeric column
+    size_t numbers [COL_COUNT];
+    char head [MAX_HEAD + 1];
+    size_t head_len;
+    char channel;
+    size_t channel_len;
+    char payload [MAX_PAYLOAD + 1];
+    size_t payload_len;
+
+    uint64_t sentences;
+    uint64_t errors;
+    uint64_t skipped;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_stream
+
+aisnmea_stream_t *
+aisnmea_stream_new (void)
+{
+    aisnmea_stream_t *self = (aisnmea_stream_t *) zmalloc (sizeof (aisnmea_stream_t));
+    assert (self);
+
+    self->msg = aisnmea_new (NULL);
+    assert (self->msg);
+    self->state = S_IDLE;
+
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_stream
+
+void
+aisnmea_stream_destroy (aisnmea_stream_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_stream_t *self = *self_p;
+        aisnmea_destroy (&self->msg);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Helpers
+
+static int
+s_hexval (char ch)
+{
+    if ('0' <= ch && ch <= '9')
+        return ch - '0';
+    if ('A' <= ch && ch <= 'F')
+        return ch - 'A' + 10;
+    if ('a' <= ch && ch <= 'f')
+        return ch - 'a' + 10;
+    return -1;
+}
+
+static bool
+s_is_addresschar (char ch)
+{
+    return ('A' <= ch && ch <= 'Z') || ('0' <= ch && ch <= '9');
+}
+
+//  Begin a sentence body on its '!' or '$'
+static void
+s_start_body (aisnmea_stream_t *self, char ch)
+{
+    self->state = S_FIELD;
+    self->sum = 0;
+    self->column = COL_HEAD;
+    self->digits = 0;
+    memset (self->numbers, 0, sizeof (self->numbers));
+    self->head [0] = ch;
+    self->head_len = 1;
+    self->channel_len = 0;
+    self->payload_len = 0;
+}
+
+//  Handle a byte that can start something new whatever state we're in.
+//  Returns true if it did.
+static bool
+s_start (aisnmea_stream_t *self, char ch)
+{
+    if (ch == '\\') {
+        self->state = S_TAGBLOCK;
+        self->has_tagblock = true;
+        self->tagblock_len = 0;
+        self->tagblock_sum = 0;
+        return true;
+    }
+    if (ch == '!' || ch == '$') {
+        self->has_tagblock = false;
+        s_start_body (self, ch);
+        return true;
+    }
+    return false;
+}
+
+//  Throw away the sentence in progress
+static void
+s_fail (aisnmea_stream_t *self)
+{
+    self->errors += 1;
+    self->state = S_SKIP;
+}
+
+//  Throw away the sentence in progress because of a byte that has no
+//  place in it, which may itself end the line or start something new
+static void
+s_fail_at (aisnmea_stream_t *self, char ch)
+{
+    s_fail (self);
+    if (ch == '\r' || ch == '\n')
+        self->state = S_IDLE;
+    else
+        s_start (self, ch);
+}
+
+//  Close off the current column on ',' or '*'. Returns -1 if it's bad, or
+//  1 if it shows this isn't an AIS sentence.
+static int
+s_end_column (aisnmea_stream_t *self)
+{
+    switch (self->column) {
+        case COL_HEAD:
+            // Only AIS sentences are of interest; anything else is skipped
+            // rather than counted as an error
+            if (self->head_len != MAX_HEAD
+            ||  !s_is_addresschar (self->head [1])
+            ||  !s_is_addresschar (self->head [2])
+            ||  self->head [3] != 'V' || self->head [4] != 'D'
+            ||  (self->head [5] != 'M' && self->head [5] != 'O'))
+                return 1;
+            self->head [self->head_len] = 0;
+            break;
+        case COL_MESSAGEID:
+            if (!self->digits)
+                self->numbers [COL_MESSAGEID] = (size_t) -1;
+            break;
+        case COL_PAYLOAD:
+            self->payload [self->payload_len] = 0;
+            break;
+    }
+    self->column += 1;
+    self->digits = 0;
+    return 0;
+}
+
+//  Add a byte to the current column. Returns -1 if it doesn't fit, or 1
+//  if it shows this isn't an AIS sentence.
+static int
+s_add_to_column (aisnmea_stream_t *self, char ch)
+{
+    switch (self->column) {
+        case COL_HEAD:
+            if (self->head_len == MAX_HEAD)
+                return 1;
+            self->head [self->head_len++] = ch;
+            return 0;
+        case COL_CHANNEL:
+            if (self->channel_len++)
+                return -1;
+            self->channel = ch;
+            return 0;
+        case COL_PAYLOAD:
+            if (self->payload_len == MAX_PAYLOAD)
+                return -1;
+            self->payload [self->payload_len++] = ch;
+            return 0;
+        default:
+            // Numeric columns
+            if (ch < '0' || ch > '9' || self->digits == MAX_DIGITS)
+                return -1;
+            self->numbers [self->column] = self->numbers [self->column] * 10
+                                         + (size_t) (ch - '0');
+            self->digits += 1;
+            return 0;
+    }
+}
+
+//  Checksum has arrived: hand on the sentence if it's good
+static size_t
+s_finish (aisnmea_stream_t *self, aisnmea_stream_handler_fn *handler, void *arg)
+{
+    self->state = S_IDLE;
+    if (self->given_sum != self->sum) {
+        self->errors += 1;
+        return 0;
+    }
+    if (self->has_tagblock)
+        self->tagblock [self->tagblock_len] = 0;
+
+    int messageid = self->numbers [COL_MESSAGEID] == (size_t) -1
+                    ? -1 : (int) self->numbers [COL_MESSAGEID];
+    int rc = aisnmea_set_parsed (self->msg,
+                                 self->has_tagblock ? self->tagblock : NULL,
+                                 self->head,
+                                 self->numbers [COL_FRAGCOUNT],
+                                 self->numbers [COL_FRAGNUM],
+                                 messageid,
+                                 self->channel_len ? self->channel : -1,
+                                 self->payload,
+                                 self->numbers [COL_FILLBITS],
+                                 (size_t) self->sum);
+    if (rc) {
+        self->errors += 1;
+        return 0;
+    }
+    self->sentences += 1;
+    if (handler)
+        handler (self->msg, arg);
+    return 1;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Parse some more of the stream
+
+size_t
+aisnmea_stream_feed (aisnmea_stream_t *self, const char *buf, size_t len,
+                     aisnmea_stream_handler_fn *handler, void *arg)
+{
+    assert (self);
+    assert (buf || !len);
+
+    size_t handled = 0;
+    for (size_t i = 0; i < len; ++i) {
+        char ch = buf [i];
+        bool eol = ch == '\r' || ch == '\n';
+
+        switch (self->state) {
+            case S_IDLE:
+                s_start (self, ch);
+                break;
+
+            case S_SKIP:
+                if (eol)
+                    self->state = S_IDLE;
+                break;
+
+            case S_TAGBLOCK:
+                if (ch == '*')
+                    self->state = S_TAGBLOCK_CS1;
+                else
+                if (eol || ch == '\\' || ch == '!' || ch == '$'
+                ||  self->tagblock_len == MAX_TAGBLOCK)
+                    s_fail_at (self, ch);
+                else {
+                    self->tagblock [self->tagblock_len++] = ch;
+                    self->tagblock_sum ^= ch;
+                }
+                break;
+
+            case S_TAGBLOCK_CS1:
+                if (s_hexval (ch) < 0)
+                    s_fail_at (self, ch);
+                else {
+                    self->given_sum = s_hexval (ch) << 4;
+                    self->state = S_TAGBLOCK_CS2;
+                }
+                break;
+
+            case S_TAGBLOCK_CS2:
+                if (s_hexval (ch) < 0)
+                    s_fail_at (self, ch);
+                else {
+                    self->given_sum |= s_hexval (ch);
+                    if (self->given_sum == self->tagblock_sum)
+                        self->state = S_TAGBLOCK_END;
+                    else
+                        s_fail (self);
+                }
+                break;
+
+            case S_TAGBLOCK_END:
+                if (ch == '\\')
+                    self->state = S_SENTENCE_START;
+                else
+                    s_fail_at (self, ch);
+                break;
+
+            case S_SENTENCE_START:
+                if (ch == '!' || ch == '$')
+                    s_start_body (self, ch);
+                else
+                    s_fail_at (self, ch);
+                break;
+
+            case S_FIELD:
+                if (ch == ',' || ch == '*') {
+                    int rc = s_end_column (self);
+                    if (rc > 0) {
+                        self->skipped += 1;
+                        self->state = S_SKIP;
+                    }
+                    else
+                    if (rc < 0
+                    ||  (ch == ',' && self->column == COL_COUNT)
+                    ||  (ch == '*' && self->column != COL_COUNT))
+                        s_fail (self);
+                    else
+                    if (ch == '*')
+                        self->state = S_CS1;
+                    else
+                        self->sum ^= ch;
+                }
+                else
+                if (ch == '\\' || ch == '!' || ch == '$' || eol)
+                    s_fail_at (self, ch);
+                else {
+                    int rc = s_add_to_column (self, ch);
+                    if (rc > 0) {
+                        self->skipped += 1;
+                        self->state = S_SKIP;
+                    }
+                    else
+                    if (rc < 0)
+                        s_fail (self);
+                    else
+                        self->sum ^= ch;
+                }
+                break;
+
+            case S_CS1:
+                if (s_hexval (ch) < 0)
+                    s_fail_at (self, ch);
+                else {
+                    self->given_sum = s_hexval (ch) << 4;
+                    self->state = S_CS2;
+                }
+                break;
+
+            case S_CS2:
+                if (s_hexval (ch) < 0)
+                    s_fail_at (self, ch);
+                else {
+                    self->given_sum |= s_hexval (ch);
+                    handled += s_finish (self, handler, arg);
+                }
+                break;
+        }
+    }
+    return handled;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Accessors
+
+void
+aisnmea_stream_reset (aisnmea_stream_t *self)
+{
+    assert (self);
+    self->state = S_IDLE;
+}
+
+uint64_t
+aisnmea_stream_sentences (aisnmea_stream_t *self)
+{
+    assert (self);
+    return self->sentences;
+}
+
+uint64_t
+aisnmea_stream_errors (aisnmea_stream_t *self)
+{
+    assert (self);
+    return self->errors;
+}
+
+uint64_t
+aisnmea_stream_skipped (aisnmea_stream_t *self)
+{
+    assert (self);
+    return self->skipped;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+//  Test handler: compare each sentence against what aisnmea_parse makes of
+//  the matching line
+typedef struct {
+    const char **want;
+    size_t count;
+} expect_t;
+
+static void
+s_check_sentence (aisnmea_t *msg, void *arg)
+{
+    expect_t *expect = (expect_t *) arg;
+    aisnmea_t *ref = aisnmea_new (expect->want [expect->count++]);
+    assert (ref);
+
+    assert (streq (aisnmea_head (msg), aisnmea_head (ref)));
+    assert (aisnmea_fragcount (msg) == aisnmea_fragcount (ref));
+    assert (aisnmea_fragnum (msg) == aisnmea_fragnum (ref));
+    assert (aisnmea_messageid (msg) == aisnmea_messageid (ref));
+    assert (aisnmea_channel (msg) == aisnmea_channel (ref));
+    assert (streq (aisnmea_payload (msg), aisnmea_payload (ref)));
+    assert (aisnmea_fillbits (msg) == aisnmea_fillbits (ref));
+    assert (aisnmea_checksum (msg) == aisnmea_checksum (ref));
+    const char *keys [] = { "g", "n", "s", "c" };
+    for (int i = 0; i < 4; ++i) {
+        const char *got = aisnmea_tagblockval (msg, keys [i]);
+        const char *want = aisnmea_tagblockval (ref, keys [i]);
+        assert ((!got && !want) || (got && want && streq (got, want)));
+    }
+    aisnmea_destroy (&ref);
+}
+
+void
+aisnmea_stream_test (bool verbose)
+{
+    printf (" * aisnmea_stream: ");
+
+    //  @selftest
+
+    const char *good [] = {
+        "\\g:1-2-73874,n:157036,s:r003669945,c:1241544035*4A"
+        "\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13",
+        "!AIVDM,2,1,3,B,55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53,0*3E",
+        "!AIVDM,2,2,3,B,1@0000000000000,2*55",
+        "!AIVDO,1,1,,,177KQJ5000G?tO`K>RA1wUbN0TKH,0*1C",
+    };
+    const size_t good_count = sizeof (good) / sizeof (good [0]);
+
+    // The stream: good sentences interleaved with GPS, junk and damage
+    zchunk_t *input = zchunk_new (NULL, 0);
+    const char *parts [] = {
+        good [0], "\r\n",
+        "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n",
+        good [1], "\r\n",
+        "!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*14\r\n",      // bad checksum
+        "!AIVDM,2,2,3,B,1@00000",                                   // cut short...
+        good [2], "\n",                                             // ...by the next
+        "noise\r\n",
+        "\\c:1241544035*99\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13\n",
+        good [3], "\r\n",
+    };
+    for (size_t i = 0; i < sizeof (parts) / sizeof (parts [0]); ++i)
+        zchunk_extend (input, parts [i], strlen (parts [i]));
+    const char *bytes = (const char *) zchunk_data (input);
+    size_t size = zchunk_size (input);
+
+    // Whatever sizes the stream arrives in, we get the same results
+    const size_t chunk_sizes [] = { 1, 2, 3, 7, 64, 1000 };
+    for (size_t c = 0; c < sizeof (chunk_sizes) / sizeof (chunk_sizes [0]); ++c) {
+        aisnmea_stream_t *stream = aisnmea_stream_new ();
+        assert (stream);
+        expect_t expect = { good, 0 };
+        size_t handled = 0;
+        for (size_t pos = 0; pos < size; pos += chunk_sizes [c]) {
+            size_t len = size - pos < chunk_sizes [c] ? size - pos : chunk_sizes [c];
+            handled += aisnmea_stream_feed (stream, bytes + pos, len,
+                                            s_check_sentence, &expect);
+        }
+        assert (handled == good_count);
+        assert (expect.count == good_count);
+        assert (aisnmea_stream_sentences (stream) == good_count);
+        assert (aisnmea_stream_skipped (stream) == 1);
+        assert (aisnmea_stream_errors (stream) == 3);
+        if (verbose)
+            zsys_debug ("chunks of %zu: %" PRIu64 " ok, %" PRIu64 " errors",
+                        chunk_sizes [c], aisnmea_stream_sentences (stream),
+                        aisnmea_stream_errors (stream));
+        aisnmea_stream_destroy (&stream);
+        assert (!stream);
+    }
+    zchunk_destroy (&input);
+
+    // A sentence is handed on as soon as its checksum is complete
+    aisnmea_stream_t *stream = aisnmea_stream_new ();
+    const char *sentence = "!AIVDM,2,2,3,B,1@0000000000000,2*55";
+    size_t len = strlen (sentence);
+    assert (aisnmea_stream_feed (stream, sentence, len - 1, NULL, NULL) == 0);
+    assert (aisnmea_stream_feed (stream, sentence + len - 1, 1, NULL, NULL) == 1);
+
+    // Reset throws away a partial sentence
+    assert (aisnmea_stream_feed (stream, sentence, len - 1, NULL, NULL) == 0);
+    aisnmea_stream_reset (stream);
+    assert (aisnmea_stream_feed (stream, "5\r\n", 3, NULL, NULL) == 0);
+    assert (aisnmea_stream_sentences (stream) == 1);
+
+    // Overlong payloads and malformed tagblock pairs are errors
+    char *overlong = (char *) zmalloc (MAX_PAYLOAD + 64);
+    strcpy (overlong, "!AIVDM,1,1,,A,");
+    memset (overlong + strlen (overlong), '0', MAX_PAYLOAD + 1);
+    strcat (overlong, ",0*00\n");
+    aisnmea_stream_feed (stream, overlong, strlen (overlong), NULL, NULL);
+    free (overlong);
+    const char *badpairs = "\\c1241544035*66\\!AIVDM,2,2,3,B,1@0000000000000,2*55\n";
+    assert (aisnmea_stream_feed (stream, badpairs, strlen (badpairs), NULL, NULL) == 0);
+    assert (aisnmea_stream_errors (stream) == 2);
+    assert (aisnmea_stream_sentences (stream) == 1);
+
+    // A line ending, or the start of a new sentence, inside a body or tag
+    // block throws away only what came before it
+    const char *cut = "!AIVDM,1,1\n\\c:12415!AIVDM,2,2,3,B,1@0000000000000,2*55\n";
+    assert (aisnmea_stream_feed (stream, cut, strlen (cut), NULL, NULL) == 1);
+    assert (aisnmea_stream_errors (stream) == 4);
+    assert (aisnmea_stream_sentences (stream) == 2);
+
+    aisnmea_stream_destroy (&stream);
+
+    //  @end
+    printf ("OK\n");
+}
@@ -0,0 +1,296 @@
+/*  =========================================================================
+    aisnmea_udp - Batched UDP ingestion of NMEA datagrams
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_udp - Batched UDP ingestion of NMEA datagrams
+@discuss
+    The buffer ring is allocated once, 'slots' buffers of SLOT_SIZE bytes.
+    On Linux one recvmmsg () fills as many of them as there are datagrams
+    waiting; elsewhere we loop on non-blocking recvfrom () instead. Either
+    way the datagrams then go through aisnmea_batch_add (), which copies
+    them out, so the ring is free again for the next call.
+
+    It uses POSIX sockets, so isn't built on Windows.
+@end
+*/
+
+//  recvmmsg () is a GNU extension
+#if defined (__linux__) && !defined (_GNU_SOURCE)
+#   define _GNU_SOURCE
+#endif
+
+#include "aisnmea_classes.h"
+
+#if !defined (__WINDOWS__)
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+
+//  Room for a jumbo frame; NMEA datagrams are usually far smaller
+#define SLOT_SIZE 9000
+
+//  Structure of our class
+
+struct _aisnmea_udp_t {
+    int fd;
+    int port;
+
+    size_t slots;
+    char *ring;             // slots * SLOT_SIZE bytes
+#if defined (__linux__)
+    struct mmsghdr *msgs;
+    struct iovec *iovecs;
+#endif
+
+    uint64_t datagrams;
+    uint64_t truncated;
+};
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_udp
+
+aisnmea_udp_t *
+aisnmea_udp_new (const char *address, int port, size_t slots)
+{
+    assert (port >= 0 && port <= 65535);
+    assert (slots);
+
+    aisnmea_udp_t *self = (aisnmea_udp_t *) zmalloc (sizeof (aisnmea_udp_t));
+    assert (self);
+    self->fd = -1;
+    self->slots = slots;
+
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof (addr);
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons ((uint16_t) port);
+    addr.sin_addr.s_addr = htonl (INADDR_ANY);
+    if (address && inet_pton (AF_INET, address, &addr.sin_addr) != 1)
+        goto die;
+
+    self->fd = socket (AF_INET, SOCK_DGRAM, 0);
+    if (self->fd < 0)
+        goto die;
+    if (bind (self->fd, (struct sockaddr *) &addr, sizeof (addr)))
+        goto die;
+    if (getsockname (self->fd, (struct sockaddr *) &addr, &addr_len))
+        goto die;
+    self->port = ntohs (addr.sin_port);
+
+    self->ring = (char *) malloc (slots * SLOT_SIZE);
+    assert (self->ring);
+
+#if defined (__linux__)
+    // Each message header points at its own slot for good
+    self->msgs = (struct mmsghdr *) zmalloc (slots * sizeof (struct mmsghdr));
+    self->iovecs = (struct iovec *) zmalloc (slots * sizeof (struct iovec));
+    assert (self->msgs && self->iovecs);
+    for (size_t i = 0; i < slots; ++i) {
+        self->iovecs [i].iov_base = self->ring + i * SLOT_SIZE;
+        self->iovecs [i].iov_len = SLOT_SIZE;
+        self->msgs [i].msg_hdr.msg_iov = &self->iovecs [i];
+        self->msgs [i].msg_hdr.msg_iovlen = 1;
+    }
+#endif
+
+    return self;
+
+ die:
+    if (self->fd >= 0)
+        close (self->fd);
+    free (self);
+    return NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_udp
+
+void
+aisnmea_udp_destroy (aisnmea_udp_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_udp_t *self = *self_p;
+        close (self->fd);
+        free (self->ring);
+#if defined (__linux__)
+        free (self->msgs);
+        free (self->iovecs);
+#endif
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Accessors
+
+int
+aisnmea_udp_port (aisnmea_udp_t *self)
+{
+    assert (self);
+    return self->port;
+}
+
+uint64_t
+aisnmea_udp_datagrams (aisnmea_udp_t *self)
+{
+    assert (self);
+    return self->datagrams;
+}
+
+uint64_t
+aisnmea_udp_truncated (aisnmea_udp_t *self)
+{
+    assert (self);
+    return self->truncated;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Receive whatever is waiting
+
+int
+aisnmea_udp_recv (aisnmea_udp_t *self, aisnmea_batch_t *batch, int timeout)
+{
+    assert (self);
+    assert (batch);
+
+    struct pollfd pfd = { self->fd, POLLIN, 0 };
+    int rc = poll (&pfd, 1, timeout);
+    if (rc < 0)
+        return errno == EINTR ? 0 : -1;
+    if (rc == 0)
+        return 0;
+
+    int received = 0;
+#if defined (__linux__)
+    rc = recvmmsg (self->fd, self->msgs, (unsigned int) self->slots, MSG_DONTWAIT, NULL);
+    if (rc < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+    received = rc;
+    for (int i = 0; i < received; ++i) {
+        if (self->msgs [i].msg_hdr.msg_flags & MSG_TRUNC)
+            self->truncated += 1;
+        aisnmea_batch_add (batch, self->ring + i * SLOT_SIZE, self->msgs [i].msg_len);
+    }
+#else
+    while ((size_t) received < self->slots) {
+        char *slot = self->ring + received * SLOT_SIZE;
+        ssize_t size = recvfrom (self->fd, slot, SLOT_SIZE, MSG_DONTWAIT, NULL, NULL);
+        if (size < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                break;
+            return received ? received : -1;
+        }
+        // recvfrom () can't tell us about truncation without MSG_TRUNC
+        // support, so treat a full slot as truncated
+        if (size == SLOT_SIZE)
+            self->truncated += 1;
+        aisnmea_batch_add (batch, slot, (size_t) size);
+        ++received;
+    }
+#endif
+    self->datagrams += received;
+    return received;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_udp_test (bool verbose)
+{
+    printf (" * aisnmea_udp: ");
+
+    //  @selftest
+
+    assert (aisnmea_udp_new ("not an address", 0, 4) == NULL);
+
+    aisnmea_udp_t *udp = aisnmea_udp_new ("127.0.0.1", 0, 4);
+    assert (udp);
+    assert (aisnmea_udp_port (udp) > 0);
+
+    aisnmea_batch_t *batch = aisnmea_batch_new ();
+    assert (batch);
+
+    // Nothing sent yet
+    assert (aisnmea_udp_recv (udp, batch, 0) == 0);
+
+    // Loopback sender: one datagram of two lines, one of one line, one
+    // junk, and more than fit in one call
+    int sender = socket (AF_INET, SOCK_DGRAM, 0);
+    assert (sender >= 0);
+    struct sockaddr_in to;
+    memset (&to, 0, sizeof (to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons ((uint16_t) aisnmea_udp_port (udp));
+    to.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+    const char *datagrams [] = {
+        "!AIVDM,2,1,3,B,55P5TL01VIaAL@7WKO@mBplU@<PDhh000000001S;AJ::4A80?4i@E53,0*3E\r\n"
+        "!AIVDM,2,2,3,B,1@0000000000000,2*55\r\n",
+        "\\s:r003669945,c:1241544035*79\\!AIVDM,1,1,,B,15N4cJ`005Jrek0H@9n`DW5608EP,0*13",
+        "junk",
+        "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C\n",
+        "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C\n",
+        "!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C\n",
+    };
+    const size_t datagram_count = sizeof (datagrams) / sizeof (datagrams [0]);
+    for (size_t i = 0; i < datagram_count; ++i) {
+        ssize_t sent = sendto (sender, datagrams [i], strlen (datagrams [i]), 0,
+                               (struct sockaddr *) &to, sizeof (to));
+        assert (sent == (ssize_t) strlen (datagrams [i]));
+    }
+
+    // Loopback delivery is quick but not instant, so allow a few rounds
+    int calls = 0;
+    while (aisnmea_udp_datagrams (udp) < datagram_count && calls < 100) {
+        int rc = aisnmea_udp_recv (udp, batch, 1000);
+        assert (rc >= 0 && rc <= 4);
+        ++calls;
+    }
+    assert (aisnmea_udp_datagrams (udp) == datagram_count);
+    assert (calls >= 2);   // six datagrams, four slots
+    assert (aisnmea_udp_truncated (udp) == 0);
+    assert (aisnmea_batch_size (batch) == 6);
+    assert (aisnmea_batch_errors (batch) == 1);
+    assert (aisnmea_batch_fragnum (batch, 1) == 2);
+    assert (aisnmea_batch_timestamp (batch, 2) == 1241544035);
+    if (verbose)
+        zsys_debug ("%zu rows in %d calls", aisnmea_batch_size (batch), calls);
+
+    close (sender);
+    aisnmea_batch_destroy (&batch);
+    aisnmea_udp_destroy (&udp);
+    assert (!udp);
+
+    //  @end
+    printf ("OK\n");
+}
+
+#else
+//  POSIX sockets only; the class is left out on Windows
+
+void
+aisnmea_udp_test (bool verbose)
+{
+    printf (" * aisnmea_udp: skipped on Windows\n");
+}
+#endif
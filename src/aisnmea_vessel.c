@@ -0,0 +1,228 @@
+/*  =========================================================================
+    aisnmea_vessel - Snapshot of one vessel's latest state
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_vessel - Snapshot of one vessel's latest state
+@discuss
+    The structure is shared with aisnmea_vessels (see aisnmea_classes.h),
+    which keeps one per vessel and copies it out whole on lookup. Values
+    are kept as sent and only converted to proper units here.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+//  "Not available" values, as sent
+#define LAT_UNKNOWN     (91 * 600000)
+#define LON_UNKNOWN     (181 * 600000)
+#define SOG_UNKNOWN     1023
+#define COG_UNKNOWN     3600
+#define HEADING_UNKNOWN 511
+#define STATUS_UNKNOWN  15
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_vessel
+
+aisnmea_vessel_t *
+aisnmea_vessel_new (void)
+{
+    aisnmea_vessel_t *self = (aisnmea_vessel_t *) zmalloc (sizeof (aisnmea_vessel_t));
+    assert (self);
+    aisnmea_vessel_reset (self, 0);
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_vessel
+
+void
+aisnmea_vessel_destroy (aisnmea_vessel_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_vessel_t *self = *self_p;
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Set to "nothing known"
+
+void
+aisnmea_vessel_reset (aisnmea_vessel_t *self, uint32_t mmsi)
+{
+    assert (self);
+    memset (self, 0, sizeof (aisnmea_vessel_t));
+    self->mmsi = mmsi;
+    self->lat = LAT_UNKNOWN;
+    self->lon = LON_UNKNOWN;
+    self->sog = SOG_UNKNOWN;
+    self->cog = COG_UNKNOWN;
+    self->heading = HEADING_UNKNOWN;
+    self->status = STATUS_UNKNOWN;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Accessors
+
+uint32_t
+aisnmea_vessel_mmsi (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->mmsi;
+}
+
+uint64_t
+aisnmea_vessel_position_time (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->position_time;
+}
+
+double
+aisnmea_vessel_lat (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->lat / 600000.0;
+}
+
+double
+aisnmea_vessel_lon (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->lon / 600000.0;
+}
+
+double
+aisnmea_vessel_sog (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->sog == SOG_UNKNOWN ? -1 : self->sog / 10.0;
+}
+
+double
+aisnmea_vessel_cog (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->cog >= COG_UNKNOWN ? -1 : self->cog / 10.0;
+}
+
+int
+aisnmea_vessel_heading (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->heading >= 360 ? -1 : self->heading;
+}
+
+int
+aisnmea_vessel_status (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->status;
+}
+
+uint64_t
+aisnmea_vessel_static_time (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->static_time;
+}
+
+const char *
+aisnmea_vessel_name (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->name;
+}
+
+const char *
+aisnmea_vessel_callsign (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->callsign;
+}
+
+const char *
+aisnmea_vessel_destination (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->destination;
+}
+
+int
+aisnmea_vessel_shiptype (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->shiptype;
+}
+
+uint32_t
+aisnmea_vessel_imo (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->imo;
+}
+
+int
+aisnmea_vessel_length (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->length;
+}
+
+int
+aisnmea_vessel_beam (aisnmea_vessel_t *self)
+{
+    assert (self);
+    return self->beam;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_vessel_test (bool verbose)
+{
+    printf (" * aisnmea_vessel: ");
+
+    //  @selftest
+
+    aisnmea_vessel_t *vessel = aisnmea_vessel_new ();
+    assert (vessel);
+    assert (aisnmea_vessel_mmsi (vessel) == 0);
+    assert (aisnmea_vessel_position_time (vessel) == 0);
+    assert (aisnmea_vessel_lat (vessel) == 91);
+    assert (aisnmea_vessel_lon (vessel) == 181);
+    assert (aisnmea_vessel_sog (vessel) == -1);
+    assert (aisnmea_vessel_cog (vessel) == -1);
+    assert (aisnmea_vessel_heading (vessel) == -1);
+    assert (aisnmea_vessel_status (vessel) == 15);
+    assert (aisnmea_vessel_static_time (vessel) == 0);
+    assert (streq (aisnmea_vessel_name (vessel), ""));
+    assert (streq (aisnmea_vessel_callsign (vessel), ""));
+    assert (streq (aisnmea_vessel_destination (vessel), ""));
+    assert (aisnmea_vessel_shiptype (vessel) == 0);
+    assert (aisnmea_vessel_imo (vessel) == 0);
+    assert (aisnmea_vessel_length (vessel) == 0);
+    assert (aisnmea_vessel_beam (vessel) == 0);
+    aisnmea_vessel_destroy (&vessel);
+    assert (!vessel);
+
+    //  @end
+    printf ("OK\n");
+}
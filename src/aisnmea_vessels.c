@@ -0,0 +1,637 @@
+/*  =========================================================================
+    aisnmea_vessels - Latest known state of every vessel
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    aisnmea_vessels - Latest known state of every vessel
+@discuss
+    Vessels live in one flat array of records, filled in the order they
+    are first heard from and never moved or removed, so a full cache
+    turns new vessels away rather than evicting anyone. An open-addressed
+    index of twice 'capacity' 64-bit entries (MMSI + 1 in the top half,
+    record number in the bottom, 0 for empty) maps MMSIs to records; an
+    entry is published with a single release store once its record is
+    written, so readers never see a half-made vessel.
+
+    Each record is guarded by a sequence count (a seqlock): the writer
+    makes it odd, writes the record, then makes it even again, and a
+    reader copies the record out and retries if the count was odd or
+    changed meanwhile. Readers never block the writer or each other, and
+    copy a record at most twice in practice since the writer only spends
+    a few dozen stores on it. Record words are read and written with
+    relaxed atomics, so the copies that get thrown away aren't data races.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+#define VESSEL_WORDS ((sizeof (aisnmea_vessel_t) + 3) / 4)
+
+//  Atomic loads, stores and fences on 32- and 64-bit fields, with the
+//  memory order as ACQUIRE, RELEASE or RELAXED. MSVC has no __atomic
+//  builtins, so there each access is an Interlocked call instead; those
+//  are full barriers, at least as strong as any order asked for.
+#if defined (_MSC_VER)
+#   define ATOMIC_LOAD(ptr, order) \
+        (sizeof (*(ptr)) == 8 \
+            ? (uint64_t) InterlockedCompareExchange64 ((volatile LONG64 *) (ptr), 0, 0) \
+            : (uint64_t) (uint32_t) InterlockedCompareExchange ((volatile LONG *) (ptr), 0, 0))
+#   define ATOMIC_STORE(ptr, value, order) \
+        (sizeof (*(ptr)) == 8 \
+            ? (void) InterlockedExchange64 ((volatile LONG64 *) (ptr), (LONG64) (value)) \
+            : (void) InterlockedExchange ((volatile LONG *) (ptr), (LONG) (value)))
+#   define ATOMIC_FENCE(order) MemoryBarrier ()
+#else
+#   define ATOMIC_LOAD(ptr, order) __atomic_load_n ((ptr), __ATOMIC_##order)
+#   define ATOMIC_STORE(ptr, value, order) __atomic_store_n ((ptr), (value), __ATOMIC_##order)
+#   define ATOMIC_FENCE(order) __atomic_thread_fence (__ATOMIC_##order)
+#endif
+
+typedef struct {
+    uint32_t seq;                       // odd while being written
+    uint32_t words [VESSEL_WORDS];      // an aisnmea_vessel_t
+} record_t;
+
+//  Structure of our class
+
+struct _aisnmea_vessels_t {
+    uint64_t *index;
+    size_t mask;            // index size - 1, index size is a power of two
+    unsigned bits;          // log2 of index size
+    record_t *records;
+    size_t capacity;
+    size_t size;            // records in use; read by other threads
+    uint64_t rejected;      // read by other threads
+};
+
+
+//  --------------------------------------------------------------------------
+//  Create a new aisnmea_vessels
+
+aisnmea_vessels_t *
+aisnmea_vessels_new (size_t capacity)
+{
+    assert (capacity && capacity < UINT32_MAX);
+    aisnmea_vessels_t *self = (aisnmea_vessels_t *) zmalloc (sizeof (aisnmea_vessels_t));
+    assert (self);
+
+    // At most half full keeps probe runs short
+    size_t index_size = 16;
+    self->bits = 4;
+    while (index_size < capacity * 2) {
+        index_size *= 2;
+        self->bits += 1;
+    }
+
+    self->index = (uint64_t *) zmalloc (index_size * sizeof (uint64_t));
+    assert (self->index);
+    self->mask = index_size - 1;
+    self->records = (record_t *) zmalloc (capacity * sizeof (record_t));
+    assert (self->records);
+    self->capacity = capacity;
+
+    return self;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy the aisnmea_vessels
+
+void
+aisnmea_vessels_destroy (aisnmea_vessels_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        aisnmea_vessels_t *self = *self_p;
+        free (self->index);
+        free (self->records);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Copy a record's words out, or (writer only) in
+
+static void
+s_record_load (record_t *record, aisnmea_vessel_t *vessel)
+{
+    uint32_t words [VESSEL_WORDS];
+    for (size_t i = 0; i < VESSEL_WORDS; ++i)
+        words [i] = (uint32_t) ATOMIC_LOAD (&record->words [i], RELAXED);
+    memcpy (vessel, words, sizeof (aisnmea_vessel_t));
+}
+
+static void
+s_record_store (record_t *record, aisnmea_vessel_t *vessel)
+{
+    uint32_t words [VESSEL_WORDS] = { 0 };
+    memcpy (words, vessel, sizeof (aisnmea_vessel_t));
+
+    // Only this thread writes seq, so a plain read of it is fine
+    uint32_t seq = record->seq;
+    ATOMIC_STORE (&record->seq, seq + 1, RELAXED);
+    ATOMIC_FENCE (RELEASE);
+    for (size_t i = 0; i < VESSEL_WORDS; ++i)
+        ATOMIC_STORE (&record->words [i], words [i], RELAXED);
+    ATOMIC_STORE (&record->seq, seq + 2, RELEASE);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Find vessel's index entry, or the empty one where it would go
+
+static uint64_t *
+s_index_find (aisnmea_vessels_t *self, uint32_t mmsi)
+{
+    uint64_t key = (uint64_t) mmsi + 1;
+    size_t hash = aisnmea_mmsi_slot ((uint32_t) key, self->bits);
+    for (size_t i = 0; ; ++i) {
+        uint64_t *entry = &self->index [(hash + i) & self->mask];
+        uint64_t value = ATOMIC_LOAD (entry, ACQUIRE);
+        if (!value || value >> 32 == key)
+            return entry;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Decoding helpers; payload length has been checked by the caller
+
+static int64_t
+s_field (const char *payload, size_t size, size_t start, size_t width)
+{
+    int64_t value = aisnmea_payload_bits (payload, size, start, width);
+    return value < 0 ? 0 : value;
+}
+
+static int32_t
+s_signed_field (const char *payload, size_t size, size_t start, size_t width)
+{
+    int64_t value = s_field (payload, size, start, width);
+    if (value & (1LL << (width - 1)))
+        value -= 1LL << width;
+    return (int32_t) value;
+}
+
+//  Six-bit text, with the '@' padding and trailing spaces trimmed
+static void
+s_text_field (const char *payload, size_t size, size_t start, size_t chars, char *dest)
+{
+    size_t length = 0;
+    for (size_t i = 0; i < chars; ++i) {
+        int value = (int) s_field (payload, size, start + i * 6, 6);
+        char c = (char) (value < 32 ? value + 64 : value);
+        if (c == '@')
+            break;
+        dest [i] = c;
+        if (c != ' ')
+            length = i + 1;
+    }
+    dest [length] = 0;
+}
+
+//  Bow, stern, port, starboard, from 'start'
+static void
+s_dimensions (aisnmea_vessel_t *vessel, const char *payload, size_t size, size_t start)
+{
+    vessel->length = (uint16_t) (s_field (payload, size, start, 9)
+                               + s_field (payload, size, start + 9, 9));
+    vessel->beam = (uint16_t) (s_field (payload, size, start + 18, 6)
+                             + s_field (payload, size, start + 24, 6));
+}
+
+
+//  --------------------------------------------------------------------------
+//  Take in a message
+
+int
+aisnmea_vessels_update (aisnmea_vessels_t *self, const char *payload, uint64_t time)
+{
+    assert (self);
+    assert (payload);
+
+    size_t size = strlen (payload);
+    int type = (int) aisnmea_payload_bits (payload, size, 0, 6);
+    int part = -1;
+
+    // Bits needed for the fields we decode, to the end of the last
+    size_t needed;
+    switch (type) {
+        case 1: case 2: case 3:
+            needed = 137;
+            break;
+        case 5:
+            needed = 422;
+            break;
+        case 18:
+            needed = 133;
+            break;
+        case 19:
+            needed = 301;
+            break;
+        case 24:
+            part = (int) aisnmea_payload_bits (payload, size, 38, 2);
+            if (part == 0)
+                needed = 160;
+            else
+            if (part == 1)
+                needed = 162;
+            else
+                return -1;
+            break;
+        case 27:
+            needed = 94;
+            break;
+        default:
+            return -1;
+    }
+    int64_t mmsi = aisnmea_payload_bits (payload, size, 8, 30);
+    if (size * 6 < needed || mmsi < 0)
+        return -1;
+
+    uint64_t *entry = s_index_find (self, (uint32_t) mmsi);
+    record_t *record;
+    aisnmea_vessel_t vessel;
+    if (*entry) {
+        record = &self->records [*entry & 0xffffffff];
+        s_record_load (record, &vessel);
+    }
+    else {
+        if (self->size == self->capacity) {
+            ATOMIC_STORE (&self->rejected, self->rejected + 1, RELAXED);
+            return -1;
+        }
+        record = &self->records [self->size];
+        aisnmea_vessel_reset (&vessel, (uint32_t) mmsi);
+    }
+
+    switch (type) {
+        case 1: case 2: case 3:
+            vessel.position_time = time;
+            vessel.status = (uint8_t) s_field (payload, size, 38, 4);
+            vessel.sog = (uint16_t) s_field (payload, size, 50, 10);
+            vessel.lon = s_signed_field (payload, size, 61, 28);
+            vessel.lat = s_signed_field (payload, size, 89, 27);
+            vessel.cog = (uint16_t) s_field (payload, size, 116, 12);
+            vessel.heading = (uint16_t) s_field (payload, size, 128, 9);
+            break;
+        case 18: case 19:
+            // Class B has no navigational status
+            vessel.position_time = time;
+            vessel.status = 15;
+            vessel.sog = (uint16_t) s_field (payload, size, 46, 10);
+            vessel.lon = s_signed_field (payload, size, 57, 28);
+            vessel.lat = s_signed_field (payload, size, 85, 27);
+            vessel.cog = (uint16_t) s_field (payload, size, 112, 12);
+            vessel.heading = (uint16_t) s_field (payload, size, 124, 9);
+            if (type == 19) {
+                vessel.static_time = time;
+                s_text_field (payload, size, 143, 20, vessel.name);
+                vessel.shiptype = (uint8_t) s_field (payload, size, 263, 8);
+                s_dimensions (&vessel, payload, size, 271);
+            }
+            break;
+        case 27: {
+            // Long-range: coarser units, and no heading
+            vessel.position_time = time;
+            vessel.status = (uint8_t) s_field (payload, size, 40, 4);
+            vessel.lon = s_signed_field (payload, size, 44, 18) * 1000;
+            vessel.lat = s_signed_field (payload, size, 62, 17) * 1000;
+            int sog = (int) s_field (payload, size, 79, 6);
+            vessel.sog = (uint16_t) (sog == 63 ? 1023 : sog * 10);
+            int cog = (int) s_field (payload, size, 85, 9);
+            vessel.cog = (uint16_t) (cog >= 360 ? 3600 : cog * 10);
+            vessel.heading = 511;
+            break;
+        }
+        case 5:
+            vessel.static_time = time;
+            vessel.imo = (uint32_t) s_field (payload, size, 40, 30);
+            s_text_field (payload, size, 70, 7, vessel.callsign);
+            s_text_field (payload, size, 112, 20, vessel.name);
+            vessel.shiptype = (uint8_t) s_field (payload, size, 232, 8);
+            s_dimensions (&vessel, payload, size, 240);
+            s_text_field (payload, size, 302, 20, vessel.destination);
+            break;
+        case 24:
+            vessel.static_time = time;
+            if (part == 0)
+                s_text_field (payload, size, 40, 20, vessel.name);
+            else {
+                vessel.shiptype = (uint8_t) s_field (payload, size, 40, 8);
+                s_text_field (payload, size, 90, 7, vessel.callsign);
+                s_dimensions (&vessel, payload, size, 132);
+            }
+            break;
+    }
+    s_record_store (record, &vessel);
+
+    // A new vessel becomes visible only now its record is complete
+    if (!*entry) {
+        uint64_t value = ((uint64_t) mmsi + 1) << 32 | (uint64_t) self->size;
+        ATOMIC_STORE (entry, value, RELEASE);
+        ATOMIC_STORE (&self->size, self->size + 1, RELEASE);
+    }
+    return type;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Copy out what's known of a vessel
+
+bool
+aisnmea_vessels_lookup (aisnmea_vessels_t *self, uint32_t mmsi, aisnmea_vessel_t *vessel)
+{
+    assert (self);
+    assert (vessel);
+
+    uint64_t entry = ATOMIC_LOAD (s_index_find (self, mmsi), ACQUIRE);
+    if (!entry)
+        return false;
+    record_t *record = &self->records [entry & 0xffffffff];
+
+    while (true) {
+        uint32_t seq = (uint32_t) ATOMIC_LOAD (&record->seq, ACQUIRE);
+        if (seq & 1)
+            continue;
+        s_record_load (record, vessel);
+        ATOMIC_FENCE (ACQUIRE);
+        if ((uint32_t) ATOMIC_LOAD (&record->seq, RELAXED) == seq)
+            return true;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Accessors
+
+size_t
+aisnmea_vessels_size (aisnmea_vessels_t *self)
+{
+    assert (self);
+    return (size_t) ATOMIC_LOAD (&self->size, ACQUIRE);
+}
+
+uint64_t
+aisnmea_vessels_rejected (aisnmea_vessels_t *self)
+{
+    assert (self);
+    return ATOMIC_LOAD (&self->rejected, RELAXED);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Selftest helpers: write 'value' into bits at 'start', and armour the
+//  first 'count' bits as a payload
+
+static void
+s_put_bits (byte *bits, size_t start, size_t width, uint64_t value)
+{
+    for (size_t i = 0; i < width; ++i) {
+        byte mask = (byte) (0x80 >> ((start + i) & 7));
+        if (value & (1ULL << (width - 1 - i)))
+            bits [(start + i) >> 3] |= mask;
+        else
+            bits [(start + i) >> 3] &= (byte) ~mask;
+    }
+}
+
+static void
+s_put_text (byte *bits, size_t start, const char *text)
+{
+    for (; *text; ++text, start += 6)
+        s_put_bits (bits, start, 6, *text >= 64 ? *text - 64 : *text);
+}
+
+static void
+s_armour (const byte *bits, size_t count, char *payload)
+{
+    size_t chars = (count + 5) / 6;
+    for (size_t i = 0; i < chars; ++i) {
+        int value = 0;
+        for (size_t j = i * 6; j < i * 6 + 6; ++j)
+            value = value << 1 | (bits [j >> 3] >> (7 - (j & 7)) & 1);
+        payload [i] = (char) (value < 40 ? value + 48 : value + 56);
+    }
+    payload [chars] = 0;
+}
+
+#if !defined (__WINDOWS__)
+#include <pthread.h>
+
+//  Writer keeps each vessel's SOG and COG equal; readers check they
+//  never see them differ
+typedef struct {
+    aisnmea_vessels_t *vessels;
+    bool done;
+    uint64_t reads;
+} s_reader_args_t;
+
+static void *
+s_reader (void *args_)
+{
+    s_reader_args_t *args = (s_reader_args_t *) args_;
+    aisnmea_vessel_t vessel;
+    while (!__atomic_load_n (&args->done, __ATOMIC_RELAXED)) {
+        for (uint32_t mmsi = 1; mmsi <= 8; ++mmsi) {
+            if (aisnmea_vessels_lookup (args->vessels, mmsi, &vessel)) {
+                assert (vessel.mmsi == mmsi);
+                assert (vessel.sog == vessel.cog);
+                __atomic_fetch_add (&args->reads, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    return NULL;
+}
+#endif
+
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+aisnmea_vessels_test (bool verbose)
+{
+    printf (" * aisnmea_vessels: ");
+
+    //  @selftest
+
+    aisnmea_vessels_t *vessels = aisnmea_vessels_new (2);
+    assert (vessels);
+    aisnmea_vessel_t *vessel = aisnmea_vessel_new ();
+    assert (vessel);
+    assert (aisnmea_vessels_size (vessels) == 0);
+    assert (!aisnmea_vessels_lookup (vessels, 477553000, vessel));
+
+    // Class A position report
+    int type = aisnmea_vessels_update (vessels, "177KQJ5000G?tO`K>RA1wUbN0TKH", 1241544035);
+    assert (type == 1);
+    assert (aisnmea_vessels_size (vessels) == 1);
+    assert (aisnmea_vessels_lookup (vessels, 477553000, vessel));
+    assert (aisnmea_vessel_mmsi (vessel) == 477553000);
+    assert (aisnmea_vessel_position_time (vessel) == 1241544035);
+    assert (aisnmea_vessel_status (vessel) == 5);
+    assert (aisnmea_vessel_sog (vessel) == 0);
+    assert (aisnmea_vessel_lon (vessel) > -122.3459 && aisnmea_vessel_lon (vessel) < -122.3458);
+    assert (aisnmea_vessel_lat (vessel) > 47.5828 && aisnmea_vessel_lat (vessel) < 47.5829);
+    assert (aisnmea_vessel_cog (vessel) == 51);
+    assert (aisnmea_vessel_heading (vessel) == 181);
+    assert (aisnmea_vessel_static_time (vessel) == 0);
+    assert (streq (aisnmea_vessel_name (vessel), ""));
+
+    // Static and voyage data adds to what we know
+    byte bits [54];
+    char payload [80];
+    memset (bits, 0, sizeof (bits));
+    s_put_bits (bits, 0, 6, 5);
+    s_put_bits (bits, 8, 30, 477553000);
+    s_put_bits (bits, 40, 30, 9134270);
+    s_put_text (bits, 70, "3FOF8");
+    s_put_text (bits, 112, "EVER DIADEM");
+    s_put_bits (bits, 232, 8, 70);
+    s_put_bits (bits, 240, 9, 225);
+    s_put_bits (bits, 249, 9, 70);
+    s_put_bits (bits, 258, 6, 1);
+    s_put_bits (bits, 264, 6, 31);
+    s_put_text (bits, 302, "NEW YORK   ");
+    s_armour (bits, 424, payload);
+    type = aisnmea_vessels_update (vessels, payload, 1241544099);
+    assert (type == 5);
+    assert (aisnmea_vessels_size (vessels) == 1);
+    assert (aisnmea_vessels_lookup (vessels, 477553000, vessel));
+    assert (aisnmea_vessel_static_time (vessel) == 1241544099);
+    assert (aisnmea_vessel_position_time (vessel) == 1241544035);
+    assert (aisnmea_vessel_imo (vessel) == 9134270);
+    assert (streq (aisnmea_vessel_callsign (vessel), "3FOF8"));
+    assert (streq (aisnmea_vessel_name (vessel), "EVER DIADEM"));
+    assert (streq (aisnmea_vessel_destination (vessel), "NEW YORK"));
+    assert (aisnmea_vessel_shiptype (vessel) == 70);
+    assert (aisnmea_vessel_length (vessel) == 295);
+    assert (aisnmea_vessel_beam (vessel) == 32);
+    assert (aisnmea_vessel_lat (vessel) > 47.5828 && aisnmea_vessel_lat (vessel) < 47.5829);
+
+    // Too short, or not a type we keep
+    payload [40] = 0;
+    assert (aisnmea_vessels_update (vessels, payload, 1241544100) == -1);
+    assert (aisnmea_vessels_update (vessels, "4", 1241544100) == -1);
+    assert (aisnmea_vessels_update (vessels, "", 1241544100) == -1);
+
+    // Long-range report from a second vessel; position not available
+    memset (bits, 0, sizeof (bits));
+    s_put_bits (bits, 0, 6, 27);
+    s_put_bits (bits, 8, 30, 235001234);
+    s_put_bits (bits, 40, 4, 0);
+    s_put_bits (bits, 44, 18, 181 * 600);
+    s_put_bits (bits, 62, 17, 91 * 600);
+    s_put_bits (bits, 79, 6, 12);
+    s_put_bits (bits, 85, 9, 270);
+    s_armour (bits, 96, payload);
+    type = aisnmea_vessels_update (vessels, payload, 1241544200);
+    assert (type == 27);
+    assert (aisnmea_vessels_size (vessels) == 2);
+    assert (aisnmea_vessels_lookup (vessels, 235001234, vessel));
+    assert (aisnmea_vessel_lat (vessel) == 91);
+    assert (aisnmea_vessel_lon (vessel) == 181);
+    assert (aisnmea_vessel_sog (vessel) == 12);
+    assert (aisnmea_vessel_cog (vessel) == 270);
+    assert (aisnmea_vessel_heading (vessel) == -1);
+    assert (aisnmea_vessel_status (vessel) == 0);
+
+    // Class B static data, in two parts
+    memset (bits, 0, sizeof (bits));
+    s_put_bits (bits, 0, 6, 24);
+    s_put_bits (bits, 8, 30, 235001234);
+    s_put_text (bits, 40, "SEA SPRITE");
+    s_armour (bits, 160, payload);
+    assert (aisnmea_vessels_update (vessels, payload, 1241544201) == 24);
+    memset (bits, 0, sizeof (bits));
+    s_put_bits (bits, 0, 6, 24);
+    s_put_bits (bits, 8, 30, 235001234);
+    s_put_bits (bits, 38, 2, 1);
+    s_put_bits (bits, 40, 8, 37);
+    s_put_text (bits, 90, "MXYZ1");
+    s_put_bits (bits, 132, 9, 8);
+    s_put_bits (bits, 141, 9, 4);
+    s_put_bits (bits, 150, 6, 2);
+    s_put_bits (bits, 156, 6, 2);
+    s_armour (bits, 168, payload);
+    assert (aisnmea_vessels_update (vessels, payload, 1241544202) == 24);
+    assert (aisnmea_vessels_lookup (vessels, 235001234, vessel));
+    assert (streq (aisnmea_vessel_name (vessel), "SEA SPRITE"));
+    assert (streq (aisnmea_vessel_callsign (vessel), "MXYZ1"));
+    assert (aisnmea_vessel_shiptype (vessel) == 37);
+    assert (aisnmea_vessel_length (vessel) == 12);
+    assert (aisnmea_vessel_beam (vessel) == 4);
+    assert (aisnmea_vessel_static_time (vessel) == 1241544202);
+
+    // Full: a third vessel is turned away, known ones still update
+    memset (bits, 0, sizeof (bits));
+    s_put_bits (bits, 0, 6, 18);
+    s_put_bits (bits, 8, 30, 211000001);
+    s_put_bits (bits, 46, 10, 1023);
+    s_put_bits (bits, 57, 28, (uint64_t) (-600000 & 0xfffffff));
+    s_put_bits (bits, 85, 27, 30000000);
+    s_put_bits (bits, 112, 12, 3600);
+    s_put_bits (bits, 124, 9, 511);
+    s_armour (bits, 168, payload);
+    assert (aisnmea_vessels_update (vessels, payload, 1241544300) == -1);
+    assert (aisnmea_vessels_rejected (vessels) == 1);
+    assert (!aisnmea_vessels_lookup (vessels, 211000001, vessel));
+    s_put_bits (bits, 8, 30, 235001234);
+    s_armour (bits, 168, payload);
+    assert (aisnmea_vessels_update (vessels, payload, 1241544300) == 18);
+    assert (aisnmea_vessels_lookup (vessels, 235001234, vessel));
+    assert (aisnmea_vessel_lon (vessel) == -1);
+    assert (aisnmea_vessel_lat (vessel) == 50);
+    assert (aisnmea_vessel_sog (vessel) == -1);
+    assert (aisnmea_vessel_cog (vessel) == -1);
+    assert (aisnmea_vessel_heading (vessel) == -1);
+    assert (aisnmea_vessel_status (vessel) == 15);
+    assert (streq (aisnmea_vessel_name (vessel), "SEA SPRITE"));
+    aisnmea_vessels_destroy (&vessels);
+    assert (!vessels);
+
+#if !defined (__WINDOWS__)
+    // Readers never see a record the writer is part way through
+    vessels = aisnmea_vessels_new (8);
+    assert (vessels);
+    s_reader_args_t args = { vessels, false, 0 };
+    pthread_t readers [2];
+    for (int i = 0; i < 2; ++i) {
+        int rc = pthread_create (&readers [i], NULL, s_reader, &args);
+        assert (!rc);
+    }
+    memset (bits, 0, sizeof (bits));
+    s_put_bits (bits, 0, 6, 1);
+    for (uint32_t i = 0; i < 200000; ++i) {
+        s_put_bits (bits, 8, 30, i % 8 + 1);
+        s_put_bits (bits, 50, 10, i % 1000);
+        s_put_bits (bits, 116, 12, i % 1000);
+        s_armour (bits, 168, payload);
+        type = aisnmea_vessels_update (vessels, payload, i);
+        assert (type == 1);
+    }
+    __atomic_store_n (&args.done, true, __ATOMIC_RELAXED);
+    for (int i = 0; i < 2; ++i)
+        pthread_join (readers [i], NULL);
+    if (verbose)
+        zsys_debug ("%" PRIu64 " concurrent lookups", args.reads);
+    assert (aisnmea_vessels_size (vessels) == 8);
+    aisnmea_vessels_destroy (&vessels);
+#endif
+
+    aisnmea_vessel_destroy (&vessel);
+
+    //  @end
+    printf ("OK\n");
+}
@@ -15,10 +15,24 @@ messages it contained with each AIS message type
     nmea_count_aismsgtypes - Given an AIS NMEA text emits a CSV containing counts of the number of
 messages it contained with each AIS message type
 @discuss
+    By default messages are grouped by message type alone. -g groups them
+    by any combination of message type, channel, head, a tag block value
+    and a time bucket from the tag block's "c" key instead.
+
+    Lines that can't be counted don't stop the run; they're counted by
+    reason and the reasons summarised on stderr.
+
+    With -j, worker threads each count into their own table, and the
+    tables are merged once all the input has been read.
+
+    --latency times the read, parse and sink stages only. There is no
+    reassembly stage to time, since the type is read from each
+    message's first fragment and later fragments are skipped, unjoined.
 @end
 */
 
 #include "aisnmea_classes.h"
+#include <pthread.h>
 
 
 //  -- The range of AIS message types we cover (closed interval)
@@ -31,117 +45,795 @@ validtype (int msg_type) {
     return MIN_MSGTYPE <= msg_type && msg_type <= MAX_MSGTYPE;
 }
 
+//  Most grouping keys we take, and the longest group name we build
+#define MAX_KEYS 8
+#define MAX_NAME 512
+
+//  Separates the key values in a group name; can't appear in NMEA
+#define KEY_SEP '\x1f'
+
+//  Lines are handed to workers in chunks of about this size
+#define CHUNK_SIZE (1 << 20)
+#define SLOTS_PER_WORKER 4
+
 
 //  --------------------------------------------------------------------------
-//  Store for message_type counts
+//  Log message and die
 
-typedef struct MsgCounts {
-    int counts [MAX_MSGTYPE + 1];
-} MsgCounts;
+static void
+bail (const char *msg, const char *nmea)
+{
+    assert (msg);
+    if (nmea)
+        fprintf (stderr, "ERROR: %s  nmea was: %s\n", msg, nmea);
+    else
+        fprintf (stderr, "ERROR: %s\n", msg);
+    exit (1);
+}
 
-static MsgCounts
-MsgCounts_make () {
-    return (MsgCounts) {0};
+static void
+usage (void)
+{
+    puts ("USAGE:");
+    puts ("  nmea_count_aismsgtypes [-g KEYS] [-j THREADS]");
+    puts ("                         [--latency csv|json [--sample N]] [FILE...]");
+    puts ("KEYS is a comma separated list of:");
+    puts ("  type, channel, head, tag:KEY (e.g. tag:s), time:SECONDS (e.g. time:3600)");
+    exit (1);
 }
 
-// Returns 0 on success, -1 on any failure (suggest you exit() on fail)
-static int
-MsgCounts_inc (MsgCounts *self, int msg_type) {
-    if (! validtype (msg_type))
-        return -1;
 
-    self->counts [msg_type] += 1;
+//  --------------------------------------------------------------------------
+//  What we group by; shared read-only by all workers
+
+typedef enum { KEY_TYPE, KEY_CHANNEL, KEY_HEAD, KEY_TAG, KEY_TIME } KeyKind;
+
+typedef struct Key {
+    KeyKind kind;
+    char tag [16];          // for KEY_TAG
+    uint64_t bucket;        // for KEY_TIME, in seconds
+    const char *column;     // CSV header
+} Key;
+
+static Key s_keys [MAX_KEYS];
+static size_t s_key_count = 0;
+
+static void
+s_add_key (const char *spec)
+{
+    if (s_key_count == MAX_KEYS)
+        bail ("Too many grouping keys", NULL);
+    Key *key = &s_keys [s_key_count++];
+    memset (key, 0, sizeof (Key));
+
+    if (streq (spec, "type")) {
+        key->kind = KEY_TYPE;
+        key->column = "message_type";
+    }
+    else
+    if (streq (spec, "channel")) {
+        key->kind = KEY_CHANNEL;
+        key->column = "channel";
+    }
+    else
+    if (streq (spec, "head")) {
+        key->kind = KEY_HEAD;
+        key->column = "head";
+    }
+    else
+    if (strncmp (spec, "tag:", 4) == 0
+    &&  spec [4] && strlen (spec + 4) < sizeof (key->tag)) {
+        key->kind = KEY_TAG;
+        strcpy (key->tag, spec + 4);
+        key->column = key->tag;
+    }
+    else
+    if (strncmp (spec, "time:", 5) == 0) {
+        char *end;
+        key->kind = KEY_TIME;
+        key->bucket = strtoull (spec + 5, &end, 10);
+        key->column = "time";
+        if (end == spec + 5 || *end || key->bucket == 0)
+            usage ();
+    }
+    else
+        usage ();
+}
+
+
+//  --------------------------------------------------------------------------
+//  Why lines weren't counted
+
+typedef enum {
+    FAIL_EMPTY, FAIL_NOT_AIS, FAIL_UNKNOWN, FAIL_CHECKSUM, FAIL_MALFORMED,
+    FAIL_NO_PAYLOAD, FAIL_MSGTYPE, FAIL_TOO_LONG, FAIL_COUNT
+} Failure;
+
+static const char *
+s_failure_names [FAIL_COUNT] = {
+    "empty line", "not an AIS sentence", "unrecognised line", "bad checksum",
+    "malformed sentence", "empty payload", "invalid message type",
+    "group name too long"
+};
+
+//  Work out why aisnmea_parse () turned a line down
+static Failure
+s_parse_failure (const char *line)
+{
+    int kind = aisnmea_classify (line);
+    if (kind == AISNMEA_KIND_EMPTY)
+        return FAIL_EMPTY;
+    if (kind == AISNMEA_KIND_NMEA || kind == AISNMEA_KIND_PROPRIETARY)
+        return FAIL_NOT_AIS;
+    if (kind == AISNMEA_KIND_UNKNOWN)
+        return FAIL_UNKNOWN;
+    if (!aisnmea_validate (line))
+        return FAIL_CHECKSUM;
+    return FAIL_MALFORMED;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Open addressing hash table of counts by group name
+
+typedef struct Group {
+    char *name;             // NULL for an empty slot
+    uint64_t hash;
+    uint64_t count;
+} Group;
+
+typedef struct Groups {
+    Group *slots;
+    size_t capacity;        // a power of two
+    size_t size;
+} Groups;
+
+static void
+Groups_init (Groups *self)
+{
+    self->capacity = 64;
+    self->size = 0;
+    self->slots = (Group *) zmalloc (self->capacity * sizeof (Group));
+    assert (self->slots);
+}
+
+static void
+Groups_destroy (Groups *self)
+{
+    for (size_t i = 0; i < self->capacity; ++i)
+        free (self->slots [i].name);
+    free (self->slots);
+    self->slots = NULL;
+}
+
+//  FNV-1a
+static uint64_t
+s_hash (const char *name)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *name; ++name)
+        hash = (hash ^ (byte) *name) * 1099511628211ULL;
+    return hash;
+}
+
+static Group *
+s_find_slot (Group *slots, size_t capacity, const char *name, uint64_t hash)
+{
+    size_t mask = capacity - 1;
+    size_t i = (size_t) hash & mask;
+    while (slots [i].name
+       && (slots [i].hash != hash || strneq (slots [i].name, name)))
+        i = (i + 1) & mask;
+    return &slots [i];
+}
+
+static void
+Groups_grow (Groups *self)
+{
+    size_t capacity = self->capacity * 2;
+    Group *slots = (Group *) zmalloc (capacity * sizeof (Group));
+    assert (slots);
+    for (size_t i = 0; i < self->capacity; ++i) {
+        Group *group = &self->slots [i];
+        if (group->name)
+            *s_find_slot (slots, capacity, group->name, group->hash) = *group;
+    }
+    free (self->slots);
+    self->slots = slots;
+    self->capacity = capacity;
+}
+
+static void
+Groups_add (Groups *self, const char *name, uint64_t hash, uint64_t count)
+{
+    Group *group = s_find_slot (self->slots, self->capacity, name, hash);
+    if (!group->name) {
+        if ((self->size + 1) * 4 > self->capacity * 3) {
+            Groups_grow (self);
+            group = s_find_slot (self->slots, self->capacity, name, hash);
+        }
+        group->name = strdup (name);
+        assert (group->name);
+        group->hash = hash;
+        ++self->size;
+    }
+    group->count += count;
+}
+
+static void
+Groups_merge (Groups *self, Groups *other)
+{
+    for (size_t i = 0; i < other->capacity; ++i) {
+        Group *group = &other->slots [i];
+        if (group->name)
+            Groups_add (self, group->name, group->hash, group->count);
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Sorted CSV output; numeric keys sort as numbers, missing values first
+
+static bool
+s_numeric (KeyKind kind)
+{
+    return kind == KEY_TYPE || kind == KEY_TIME;
+}
+
+static int
+s_compare_groups (const void *a, const void *b)
+{
+    const char *left = (*(Group * const *) a)->name;
+    const char *right = (*(Group * const *) b)->name;
+
+    for (size_t k = 0; k < s_key_count; ++k) {
+        size_t left_len = strcspn (left, "\x1f");
+        size_t right_len = strcspn (right, "\x1f");
+        int diff;
+        if (s_numeric (s_keys [k].kind) && left_len != right_len)
+            diff = left_len < right_len ? -1 : 1;
+        else {
+            diff = memcmp (left, right, left_len < right_len ? left_len : right_len);
+            if (!diff && left_len != right_len)
+                diff = left_len < right_len ? -1 : 1;
+        }
+        if (diff)
+            return diff;
+        left += left_len + (left [left_len] ? 1 : 0);
+        right += right_len + (right [right_len] ? 1 : 0);
+    }
     return 0;
 }
 
 // Prints header row as well
 static void
-MsgCounts_print (MsgCounts *self) {
-    printf ("\"message_type\",\"count\"\n");
-    for (int i=0; i < MAX_MSGTYPE + 1; ++i) {
-        if (self->counts [i])
-            printf ("%d,%d\n", i, self->counts [i]);
+Groups_print (Groups *self)
+{
+    for (size_t k = 0; k < s_key_count; ++k)
+        printf ("\"%s\",", s_keys [k].column);
+    printf ("\"count\"\n");
+
+    Group **sorted = (Group **) zmalloc ((self->size + 1) * sizeof (Group *));
+    assert (sorted);
+    size_t count = 0;
+    for (size_t i = 0; i < self->capacity; ++i)
+        if (self->slots [i].name)
+            sorted [count++] = &self->slots [i];
+    qsort (sorted, count, sizeof (Group *), s_compare_groups);
+
+    for (size_t i = 0; i < count; ++i) {
+        const char *value = sorted [i]->name;
+        for (size_t k = 0; k < s_key_count; ++k) {
+            size_t len = strcspn (value, "\x1f");
+            if (s_numeric (s_keys [k].kind) || len == 0)
+                printf ("%.*s,", (int) len, value);
+            else
+                printf ("\"%.*s\",", (int) len, value);
+            value += len + (value [len] ? 1 : 0);
+        }
+        printf ("%" PRIu64 "\n", sorted [i]->count);
     }
+    free (sorted);
 }
-    
+
 
 //  --------------------------------------------------------------------------
-//  Log message and die
+//  Optional per-stage latency histograms, dumped to stderr on SIGUSR1
+//  and at exit
+
+typedef enum { STAGE_READ, STAGE_PARSE, STAGE_SINK, STAGE_COUNT } Stage;
+
+static const char *
+s_stage_names [STAGE_COUNT] = { "read", "parse", "sink" };
+
+typedef struct Latency {
+    bool json;  // else CSV
+    aisnmea_hist_t *stages [STAGE_COUNT];
+} Latency;
+
+static volatile sig_atomic_t s_dump_requested = 0;
 
 static void
-bail (const char *msg, const char *nmea)
+s_handle_sigusr1 (int signum) {
+    (void) signum;
+    s_dump_requested = 1;
+}
+
+static void
+Latency_print (Latency *self) {
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        if (self->json)
+            aisnmea_hist_print_json (self->stages [i], stderr);
+        else
+            aisnmea_hist_print_csv (self->stages [i], stderr, i == 0);
+    }
+    fflush (stderr);
+}
+
+
+//  --------------------------------------------------------------------------
+//  One counter per thread: a parser, its groups and failure counts
+
+typedef struct Counter {
+    aisnmea_t *parser;
+    Groups groups;
+    uint64_t failures [FAIL_COUNT];
+    uint64_t lines;
+    Latency *latency;       // NULL unless timing
+} Counter;
+
+static void
+Counter_init (Counter *self, Latency *latency)
 {
-    assert (msg);
-    if (nmea)
-        fprintf (stderr, "ERROR: %s  nmea was: %s\n", msg, nmea);
+    memset (self, 0, sizeof (Counter));
+    self->parser = aisnmea_new (NULL);
+    assert (self->parser);
+    Groups_init (&self->groups);
+    self->latency = latency;
+}
+
+static void
+Counter_destroy (Counter *self)
+{
+    aisnmea_destroy (&self->parser);
+    Groups_destroy (&self->groups);
+}
+
+//  Appends a key's value to the group name, after a separator unless it's
+//  the first; returns false if it wouldn't fit
+static bool
+s_append (char *name, size_t *len, bool first, const char *value, size_t value_len)
+{
+    if (*len + value_len + 2 > MAX_NAME)
+        return false;
+    if (!first)
+        name [(*len)++] = KEY_SEP;
+    memcpy (name + *len, value, value_len);
+    *len += value_len;
+    name [*len] = 0;
+    return true;
+}
+
+static void
+Counter_line (Counter *self, const char *line)
+{
+    Latency *latency = self->latency;
+    self->lines++;
+
+    uint64_t t_parse = latency ? aisnmea_hist_start (latency->stages [STAGE_PARSE]) : 0;
+    int rc = aisnmea_parse (self->parser, line);
+    if (latency)
+        aisnmea_hist_stop (latency->stages [STAGE_PARSE], t_parse);
+    if (rc) {
+        self->failures [s_parse_failure (line)]++;
+        return;
+    }
+
+    // We only care about first-fragnum messages
+    if (aisnmea_fragnum (self->parser) != 1)
+        return;
+
+    int mt = aisnmea_aismsgtype (self->parser);
+    if (! validtype (mt)) {
+        self->failures [*aisnmea_payload (self->parser) ? FAIL_MSGTYPE
+                                                        : FAIL_NO_PAYLOAD]++;
+        return;
+    }
+
+    uint64_t t_sink = latency ? aisnmea_hist_start (latency->stages [STAGE_SINK]) : 0;
+    char name [MAX_NAME] = "";
+    size_t len = 0;
+    bool fits = true;
+    for (size_t k = 0; k < s_key_count && fits; ++k) {
+        char number [24];
+        const char *value = number;
+        switch (s_keys [k].kind) {
+            case KEY_TYPE:
+                snprintf (number, sizeof (number), "%d", mt);
+                break;
+            case KEY_CHANNEL: {
+                char channel = aisnmea_channel (self->parser);
+                number [0] = channel == -1 ? 0 : channel;
+                number [1] = 0;
+                break;
+            }
+            case KEY_HEAD:
+                value = aisnmea_head (self->parser);
+                break;
+            case KEY_TAG:
+                value = aisnmea_tagblockval (self->parser, s_keys [k].tag);
+                break;
+            case KEY_TIME: {
+                uint64_t time = aisnmea_timestamp (self->parser);
+                number [0] = 0;
+                if (time)
+                    snprintf (number, sizeof (number), "%" PRIu64,
+                              time - time % s_keys [k].bucket);
+                break;
+            }
+        }
+        if (!value)
+            value = "";
+        // Quotes would break the CSV, and separators the group name
+        if (strchr (value, '"') || strchr (value, KEY_SEP))
+            value = "";
+        fits = s_append (name, &len, k == 0, value, strlen (value));
+    }
+    if (fits)
+        Groups_add (&self->groups, name, s_hash (name), 1);
     else
-        fprintf (stderr, "ERROR: %s\n", msg);
-    exit (1);
+        self->failures [FAIL_TOO_LONG]++;
+    if (latency)
+        aisnmea_hist_stop (latency->stages [STAGE_SINK], t_sink);
 }
 
 
 //  --------------------------------------------------------------------------
-//  main()
+//  Single threaded counting, a line at a time, timed if asked
+
+static void
+s_count_file (Counter *counter, zfile_t *file)
+{
+    Latency *latency = counter->latency;
 
-// TODO consider loosening requirement that each input message is valid NMEA
-// and has a valid AIS message type
+    // Stamps are 0 for events the samplers skip, or when not timing
+    uint64_t t_read = latency ? aisnmea_hist_start (latency->stages [STAGE_READ]) : 0;
+    const char *line = zfile_readln (file);
+    while (line) {
+        if (latency) {
+            aisnmea_hist_stop (latency->stages [STAGE_READ], t_read);
+            if (s_dump_requested) {
+                s_dump_requested = 0;
+                Latency_print (latency);
+            }
+        }
+        Counter_line (counter, line);
+        t_read = latency ? aisnmea_hist_start (latency->stages [STAGE_READ]) : 0;
+        line = zfile_readln (file);
+    }
+}
 
-int main (int argc, char *argv [])
+static void
+s_run (Counter *counter, char **paths, int path_count)
 {
-    // Accept no arguments, exit with usage message if have some
-    if (argc != 1) {
-        puts ("USAGE:");
-        puts ("  nmea_count_aismsgtypes < FILE.nmea");
-        exit (1);
+    for (int i = 0; i < (path_count ? path_count : 1); ++i) {
+        const char *path = path_count && strneq (paths [i], "-")? paths [i]: "/dev/stdin";
+        zfile_t *file = zfile_new (NULL, path);
+        if (!file || zfile_input (file))
+            bail ("Problem opening input", path);
+        s_count_file (counter, file);
+        zfile_destroy (&file);
     }
+}
 
-    MsgCounts counts = MsgCounts_make ();
 
-    aisnmea_t *parser = aisnmea_new (NULL);
-    assert (parser);
+//  --------------------------------------------------------------------------
+//  Threaded counting: the main thread reads chunks of whole lines, and
+//  workers count them into their own tables
+
+#define SLOT_FREE  0
+#define SLOT_READY 1
+#define SLOT_BUSY  2
+
+typedef struct Slot {
+    char *data;
+    size_t size;
+    size_t capacity;
+    int state;
+} Slot;
+
+typedef struct Pool {
+    Slot *slots;
+    size_t slot_count;
+    size_t ready;           // slots ready but not yet taken
+    bool done;
+    pthread_mutex_t lock;
+    pthread_cond_t work;    // a chunk is ready, or we're done
+    pthread_cond_t freed;   // a chunk has been counted
+} Pool;
+
+typedef struct Worker {
+    Pool *pool;
+    Counter counter;
+    pthread_t thread;
+} Worker;
 
-    zfile_t *stdinf = zfile_new (NULL, "/dev/stdin");
-    if (!stdinf)
-        bail ("Problem opening stdin", NULL);
-    int rc = zfile_input (stdinf);
-    if (rc)
-        bail ("Problem opening stdin", NULL);
+static void
+s_count_chunk (Counter *counter, Slot *slot)
+{
+    char *line = slot->data;
+    char *end = slot->data + slot->size;
+    while (line < end) {
+        char *stop = (char *) memchr (line, '\n', end - line);
+        if (!stop)
+            stop = end;
+        char *next = stop + 1;
+        if (stop > line && stop [-1] == '\r')
+            --stop;
+        *stop = 0;
+        Counter_line (counter, line);
+        line = next;
+    }
+}
 
-    const char *line = zfile_readln (stdinf);
-    if (!line)
-        bail ("No data provided", NULL);
+static void *
+s_worker (void *arg)
+{
+    Worker *self = (Worker *) arg;
+    Pool *pool = self->pool;
+
+    pthread_mutex_lock (&pool->lock);
+    while (true) {
+        while (!pool->ready && !pool->done)
+            pthread_cond_wait (&pool->work, &pool->lock);
+        if (!pool->ready)
+            break;
+        Slot *slot = NULL;
+        for (size_t i = 0; i < pool->slot_count && !slot; ++i)
+            if (pool->slots [i].state == SLOT_READY)
+                slot = &pool->slots [i];
+        assert (slot);
+        slot->state = SLOT_BUSY;
+        pool->ready--;
+        pthread_mutex_unlock (&pool->lock);
+
+        s_count_chunk (&self->counter, slot);
+
+        pthread_mutex_lock (&pool->lock);
+        slot->state = SLOT_FREE;
+        pthread_cond_signal (&pool->freed);
+    }
+    pthread_mutex_unlock (&pool->lock);
+    return NULL;
+}
 
-    // Actually process the lines
-    while (line) {
-        // We demand that every message in the file parses
-        int rc = aisnmea_parse (parser, line);
+//  Waits for a free slot and hands it back, holding 'carry' at its start
+static Slot *
+s_free_slot (Pool *pool, const char *carry, size_t carry_size)
+{
+    Slot *slot = NULL;
+    pthread_mutex_lock (&pool->lock);
+    while (!slot) {
+        for (size_t i = 0; i < pool->slot_count && !slot; ++i)
+            if (pool->slots [i].state == SLOT_FREE)
+                slot = &pool->slots [i];
+        if (!slot)
+            pthread_cond_wait (&pool->freed, &pool->lock);
+    }
+    pthread_mutex_unlock (&pool->lock);
+
+    if (slot->capacity < carry_size + CHUNK_SIZE) {
+        slot->capacity = carry_size + CHUNK_SIZE;
+        slot->data = (char *) realloc (slot->data, slot->capacity + 1);
+        assert (slot->data);
+    }
+    memcpy (slot->data, carry, carry_size);
+    slot->size = carry_size;
+    return slot;
+}
+
+static void
+s_hand_over (Pool *pool, Slot *slot)
+{
+    if (!slot->size)
+        return;
+    pthread_mutex_lock (&pool->lock);
+    slot->state = SLOT_READY;
+    pool->ready++;
+    pthread_cond_signal (&pool->work);
+    pthread_mutex_unlock (&pool->lock);
+}
+
+//  Reads one input into chunks, cutting them after their last newline
+static void
+s_read_input (Pool *pool, int fd, const char *path)
+{
+    char *carry = NULL;
+    size_t carry_size = 0;
+    Slot *slot = s_free_slot (pool, NULL, 0);
+
+    while (true) {
+        if (slot->size == slot->capacity) {
+            // A line longer than a chunk; give it more room
+            slot->capacity *= 2;
+            slot->data = (char *) realloc (slot->data, slot->capacity + 1);
+            assert (slot->data);
+        }
+        ssize_t got = read (fd, slot->data + slot->size, slot->capacity - slot->size);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0)
+            bail ("Problem reading input", path);
+        if (got == 0)
+            break;
+        slot->size += got;
+        if (slot->size < slot->capacity)
+            continue;
+
+        char *last = slot->data + slot->size - 1;
+        while (last >= slot->data && *last != '\n')
+            --last;
+        if (last < slot->data)
+            continue;
+        carry_size = slot->data + slot->size - (last + 1);
+        carry = (char *) realloc (carry, carry_size + 1);
+        assert (carry);
+        memcpy (carry, last + 1, carry_size);
+        slot->size -= carry_size;
+        s_hand_over (pool, slot);
+        slot = s_free_slot (pool, carry, carry_size);
+    }
+    // Whatever's left is the last line, with or without its newline
+    s_hand_over (pool, slot);
+    free (carry);
+}
+
+static void
+s_run_threaded (Counter *total, char **paths, int path_count, size_t threads)
+{
+    Pool pool;
+    memset (&pool, 0, sizeof (pool));
+    pool.slot_count = threads * SLOTS_PER_WORKER;
+    pool.slots = (Slot *) zmalloc (pool.slot_count * sizeof (Slot));
+    assert (pool.slots);
+    pthread_mutex_init (&pool.lock, NULL);
+    pthread_cond_init (&pool.work, NULL);
+    pthread_cond_init (&pool.freed, NULL);
+
+    Worker *workers = (Worker *) zmalloc (threads * sizeof (Worker));
+    assert (workers);
+    for (size_t i = 0; i < threads; ++i) {
+        workers [i].pool = &pool;
+        Counter_init (&workers [i].counter, NULL);
+        int rc = pthread_create (&workers [i].thread, NULL, s_worker, &workers [i]);
         if (rc)
-            bail ("NMEA parse failed", line);
+            bail ("Can't start worker thread", NULL);
+    }
 
-        // We only care about first-fragnum messages
-        if (aisnmea_fragnum (parser) != 1)
-            goto cont;
+    for (int i = 0; i < (path_count ? path_count : 1); ++i) {
+        bool use_stdin = !path_count || streq (paths [i], "-");
+        const char *path = use_stdin ? "stdin" : paths [i];
+        int fd = use_stdin ? STDIN_FILENO : open (path, O_RDONLY);
+        if (fd == -1)
+            bail ("Problem opening input", path);
+        s_read_input (&pool, fd, path);
+        if (!use_stdin)
+            close (fd);
+    }
 
-        int mt = aisnmea_aismsgtype (parser);
+    pthread_mutex_lock (&pool.lock);
+    pool.done = true;
+    pthread_cond_broadcast (&pool.work);
+    pthread_mutex_unlock (&pool.lock);
+
+    // Merge each worker's counts into the total
+    for (size_t i = 0; i < threads; ++i) {
+        pthread_join (workers [i].thread, NULL);
+        Counter *counter = &workers [i].counter;
+        Groups_merge (&total->groups, &counter->groups);
+        for (int f = 0; f < FAIL_COUNT; ++f)
+            total->failures [f] += counter->failures [f];
+        total->lines += counter->lines;
+        Counter_destroy (counter);
+    }
+    free (workers);
+
+    for (size_t i = 0; i < pool.slot_count; ++i)
+        free (pool.slots [i].data);
+    free (pool.slots);
+    pthread_mutex_destroy (&pool.lock);
+    pthread_cond_destroy (&pool.work);
+    pthread_cond_destroy (&pool.freed);
+}
 
-        // We demand that each message has a valid AIS type
-        if (! validtype (mt))
-            bail ("Invalid ais message type", line);
 
-        rc = MsgCounts_inc (&counts, mt);
-        if (rc) {
-            assert (0);  // this really shouldn't happen
-            bail ("Error incrementing MsgCount", NULL);  // for NDEBUG
-        }
+//  --------------------------------------------------------------------------
+//  main()
 
-    cont:
-        line = zfile_readln (stdinf);
+int main (int argc, char *argv [])
+{
+    // Latency histograms are off unless asked for
+    Latency latency = { false, { NULL } };
+    bool timing = false;
+    size_t sample_every = 1;
+    size_t threads = 1;
+
+    int argn;
+    for (argn = 1; argn < argc; ++argn) {
+        if (streq (argv [argn], "--latency") && argn + 1 < argc) {
+            const char *format = argv [++argn];
+            if (streq (format, "json"))
+                latency.json = true;
+            else
+            if (strneq (format, "csv"))
+                usage ();
+            timing = true;
+        }
+        else
+        if (streq (argv [argn], "--sample") && argn + 1 < argc)
+            sample_every = (size_t) atol (argv [++argn]);
+        else
+        if (streq (argv [argn], "-g") && argn + 1 < argc) {
+            char *copy = strdup (argv [++argn]);
+            for (char *item = strtok (copy, ","); item; item = strtok (NULL, ","))
+                s_add_key (item);
+            free (copy);
+        }
+        else
+        if (streq (argv [argn], "-j") && argn + 1 < argc)
+            threads = (size_t) atol (argv [++argn]);
+        else
+        if (argv [argn][0] == '-' && argv [argn][1])
+            usage ();
+        else
+            break;
+    }
+    // The histograms aren't shared between threads
+    if (threads < 1 || threads > 256 || (timing && threads > 1))
+        usage ();
+    if (!s_key_count)
+        s_add_key ("type");
+
+    if (timing) {
+        for (int i = 0; i < STAGE_COUNT; ++i) {
+            latency.stages [i] = aisnmea_hist_new (s_stage_names [i]);
+            assert (latency.stages [i]);
+            aisnmea_hist_set_sampling (latency.stages [i], sample_every);
+        }
+#if defined (SIGUSR1)
+        signal (SIGUSR1, s_handle_sigusr1);
+#endif
     }
 
-    zfile_destroy (&stdinf);
-    aisnmea_destroy (&parser);
+    Counter total;
+    Counter_init (&total, timing ? &latency : NULL);
+    if (threads > 1)
+        s_run_threaded (&total, argv + argn, argc - argn, threads);
+    else
+        s_run (&total, argv + argn, argc - argn);
+    if (!total.lines)
+        bail ("No data provided", NULL);
+
+    Groups_print (&total.groups);
+
+    uint64_t failed = 0;
+    for (int f = 0; f < FAIL_COUNT; ++f)
+        failed += total.failures [f];
+    if (failed) {
+        fprintf (stderr, "%" PRIu64 " of %" PRIu64 " lines not counted:\n",
+                 failed, total.lines);
+        for (int f = 0; f < FAIL_COUNT; ++f)
+            if (total.failures [f])
+                fprintf (stderr, "  %s: %" PRIu64 "\n",
+                         s_failure_names [f], total.failures [f]);
+    }
+    Counter_destroy (&total);
 
-    MsgCounts_print (&counts);
+    if (timing) {
+        Latency_print (&latency);
+        for (int i = 0; i < STAGE_COUNT; ++i)
+            aisnmea_hist_destroy (&latency.stages [i]);
+    }
 
     return 0;
 }
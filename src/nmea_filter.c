@@ -0,0 +1,658 @@
+/*  =========================================================================
+    nmea_filter - Writes out only the AIS NMEA lines matching given criteria
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    nmea_filter - Writes out only the AIS NMEA lines matching given criteria
+@discuss
+    Input is cut into chunks of whole lines: files are mapped and cut in
+    place, stdin is read into per-chunk buffers. Chunks never split a
+    multi-sentence message, so each can be filtered on its own, and later
+    sentences of a message go out only if its first one did. With -j,
+    worker threads filter chunks while the main thread reads ahead and
+    writes finished chunks out strictly in input order.
+
+    Type, channel, source and MMSI tests are an aisnmea_filter given to
+    the parser, so unwanted lines are turned away before being parsed.
+    With --from and a FILE.idx from aisnmea_index next to an input file,
+    everything before the indexed offset is skipped unread.
+@end
+*/
+
+#include "aisnmea_classes.h"
+#include <pthread.h>
+#include <sys/mman.h>
+
+//  Input goes to workers in chunks of about this size
+#define CHUNK_SIZE (4 << 20)
+
+//  Longer lines aren't NMEA, and are dropped
+#define MAX_LINE 4096
+
+//  Chunks in flight per worker, to keep workers busy while one is written
+#define SLOTS_PER_WORKER 4
+
+#define SLOT_FREE  0
+#define SLOT_READY 1
+#define SLOT_DONE  2
+
+
+//  --------------------------------------------------------------------------
+//  Log message and die
+
+static void
+bail (const char *msg, const char *arg)
+{
+    assert (msg);
+    if (arg)
+        fprintf (stderr, "ERROR: %s: %s\n", msg, arg);
+    else
+        fprintf (stderr, "ERROR: %s\n", msg);
+    exit (1);
+}
+
+static void
+usage (void)
+{
+    puts ("USAGE:");
+    puts ("  nmea_filter [-t TYPES] [-c CHANNELS] [-s SOURCES] [-m MMSI_FILE]");
+    puts ("              [--from TIME] [--to TIME] [-j THREADS] [FILE...] > OUT.nmea");
+    exit (1);
+}
+
+
+//  --------------------------------------------------------------------------
+//  What's wanted; shared read-only by all workers
+
+static aisnmea_filter_t *s_filter;
+static bool s_time_test = false;
+static uint64_t s_from = 0;
+static uint64_t s_to = UINT64_MAX;
+
+
+//  --------------------------------------------------------------------------
+//  A chunk of input lines and the lines kept from it
+
+typedef struct {
+    const char *data;       // whole lines
+    size_t size;
+    char *buffer;           // holds data when it was read rather than mapped
+    size_t buffer_max;
+    char *out;
+    size_t out_size;
+    size_t out_max;
+    int state;
+} slot_t;
+
+static void
+s_slot_output (slot_t *slot, const char *line, size_t length)
+{
+    if (slot->out_size + length + 1 > slot->out_max) {
+        slot->out_max = (slot->out_size + length + 1) * 2;
+        slot->out = (char *) realloc (slot->out, slot->out_max);
+        assert (slot->out);
+    }
+    memcpy (slot->out + slot->out_size, line, length);
+    slot->out_size += length;
+    if (!length || line [length - 1] != '\n')
+        slot->out [slot->out_size++] = '\n';
+}
+
+
+//  --------------------------------------------------------------------------
+//  Fragment count, fragment number and sequential message id of the line
+//  at 'line' (ending by 'end'), from the raw text. Message id is -1 if
+//  empty. Returns false if they can't be found.
+
+static bool
+s_fragments (const char *line, const char *end, int *count, int *num, int *mid)
+{
+    const char *cur = line;
+    if (cur < end && *cur == '\\') {
+        cur = (const char *) memchr (cur + 1, '\\', end - cur - 1);
+        if (!cur)
+            return false;
+        ++cur;
+    }
+    while (cur < end && *cur != ',' && *cur != '\n')
+        ++cur;
+
+    int values [3] = { 0, 0, -1 };
+    for (int i = 0; i < 3; ++i) {
+        if (cur == end || *cur != ',')
+            return false;
+        ++cur;
+        if (cur < end && isdigit ((byte) *cur))
+            values [i] = 0;
+        while (cur < end && isdigit ((byte) *cur))
+            values [i] = values [i] * 10 + (*cur++ - '0');
+    }
+    if (cur == end || *cur != ',')
+        return false;
+    *count = values [0];
+    *num = values [1];
+    *mid = values [2];
+    return true;
+}
+
+//  Is the line a later sentence of a multi-sentence message
+static bool
+s_is_continuation (const char *line, const char *end)
+{
+    int count, num, mid;
+    return s_fragments (line, end, &count, &num, &mid) && count > 1 && num > 1;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Filter one chunk. Later sentences of a message follow its first one
+//  within the chunk, so go out if it did; any without a first sentence
+//  before them (at the start of the input, say) can't be judged, and
+//  are dropped.
+
+static void
+s_filter_chunk (aisnmea_t *parser, slot_t *slot)
+{
+    bool wanted [11];       // by sequential message id; 10 for none
+    memset (wanted, 0, sizeof (wanted));
+    char line [MAX_LINE];
+
+    const char *cur = slot->data;
+    const char *end = slot->data + slot->size;
+    slot->out_size = 0;
+    while (cur < end) {
+        const char *eol = (const char *) memchr (cur, '\n', end - cur);
+        const char *next = eol ? eol + 1 : end;
+        size_t length = (eol ? eol : end) - cur;
+        if (length && cur [length - 1] == '\r')
+            --length;
+
+        int count, num, mid;
+        if (length < MAX_LINE && s_fragments (cur, cur + length, &count, &num, &mid)) {
+            memcpy (line, cur, length);
+            line [length] = 0;
+            int id = mid >= 0 && mid <= 9 ? mid : 10;
+            bool keep;
+            if (count > 1 && num > 1) {
+                keep = wanted [id] && aisnmea_validate (line);
+                if (num >= count)
+                    wanted [id] = false;
+            }
+            else {
+                keep = aisnmea_parse (parser, line) == 0;
+                if (keep && s_time_test) {
+                    uint64_t time = aisnmea_timestamp (parser);
+                    keep = time && time >= s_from && time < s_to;
+                }
+                if (count > 1)
+                    wanted [id] = keep;
+            }
+            if (keep)
+                s_slot_output (slot, cur, next - cur);
+        }
+        cur = next;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Input: the files named, each mapped if possible, else stdin
+
+typedef struct {
+    char **paths;
+    int path_count;
+    int path_index;         // next file to open
+    int fd;                 // -1 when between files
+    const char *map;        // whole file, if mapped
+    size_t map_size;
+    size_t offset;          // how far through map chunks have got
+    void **maps;            // all files mapped, unmapped at the end
+    size_t *map_sizes;      // once everything is written
+    size_t map_count;
+    char *carry;            // part of a message left from the last read
+    size_t carry_size;
+    bool eof;
+} input_t;
+
+static void
+s_input_open (input_t *self, const char *path)
+{
+    self->fd = path ? open (path, O_RDONLY) : STDIN_FILENO;
+    if (self->fd < 0)
+        bail ("Can't open file", path);
+    self->map = NULL;
+    self->offset = 0;
+    self->carry_size = 0;
+    self->eof = false;
+
+    struct stat st;
+    if (!path || fstat (self->fd, &st) || !S_ISREG (st.st_mode) || st.st_size == 0)
+        return;
+    void *map = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, self->fd, 0);
+    if (map == MAP_FAILED)
+        return;
+#if defined (MADV_SEQUENTIAL)
+    madvise (map, (size_t) st.st_size, MADV_SEQUENTIAL);
+#endif
+    self->map = (const char *) map;
+    self->map_size = (size_t) st.st_size;
+    self->maps = (void **) realloc (self->maps, (self->map_count + 1) * sizeof (void *));
+    self->map_sizes = (size_t *) realloc (self->map_sizes, (self->map_count + 1) * sizeof (size_t));
+    assert (self->maps && self->map_sizes);
+    self->maps [self->map_count] = map;
+    self->map_sizes [self->map_count++] = self->map_size;
+
+    // Skip straight to the time wanted if there's an index
+    if (s_time_test && s_from) {
+        char idx_path [PATH_MAX];
+        snprintf (idx_path, sizeof (idx_path), "%s.idx", path);
+        aisnmea_index_t *index = aisnmea_index_load (idx_path);
+        if (index) {
+            uint64_t offset = aisnmea_index_seek (index, s_from);
+            self->offset = offset < self->map_size ? (size_t) offset : self->map_size;
+            aisnmea_index_destroy (&index);
+        }
+    }
+}
+
+static void
+s_input_close (input_t *self)
+{
+    if (self->fd > STDIN_FILENO)
+        close (self->fd);
+    self->fd = -1;
+}
+
+//  Where to cut a mapped file into a chunk, at or after 'target': the
+//  start of a line that doesn't continue a message, or the end
+static size_t
+s_map_cut (const char *data, size_t size, size_t target)
+{
+    const char *end = data + size;
+    const char *cur = data + target;
+    while (cur < end) {
+        cur = (const char *) memchr (cur, '\n', end - cur);
+        if (!cur)
+            break;
+        ++cur;
+        if (!s_is_continuation (cur, end))
+            return cur - data;
+    }
+    return size;
+}
+
+//  Where to cut 'size' bytes read into a chunk, leaving the rest for
+//  the next: the start of the last line that doesn't continue a message
+//  and may be incomplete. Returns 0 if there's no such line.
+static size_t
+s_read_cut (const char *data, size_t size)
+{
+    const char *end = data + size;
+    const char *line = end;
+    while (line > data) {
+        // Back to the start of the line before
+        const char *start = line - 1;
+        while (start > data && start [-1] != '\n')
+            --start;
+        // A cut at the line is only fine if it's complete enough to tell
+        int count, num, mid;
+        if (start > data
+        &&  s_fragments (start, end, &count, &num, &mid)
+        &&  !(count > 1 && num > 1))
+            return start - data;
+        line = start;
+    }
+    return 0;
+}
+
+//  Fill 'slot' with the next chunk of whole lines. Returns false at the
+//  end of all input.
+static bool
+s_input_next (input_t *self, slot_t *slot)
+{
+    while (true) {
+        if (self->fd < 0) {
+            if (self->path_index >= self->path_count) {
+                if (self->path_count || self->path_index)
+                    return false;
+                self->path_index = 1;               // just stdin, once
+                s_input_open (self, NULL);
+            }
+            else {
+                const char *path = self->paths [self->path_index++];
+                s_input_open (self, streq (path, "-") ? NULL : path);
+            }
+        }
+
+        if (self->map) {
+            if (self->offset < self->map_size) {
+                size_t cut = s_map_cut (self->map, self->map_size, self->offset + CHUNK_SIZE < self->map_size
+                                                                 ? self->offset + CHUNK_SIZE
+                                                                 : self->map_size);
+                slot->data = self->map + self->offset;
+                slot->size = cut - self->offset;
+                self->offset = cut;
+                return true;
+            }
+            s_input_close (self);
+            continue;
+        }
+
+        if (self->eof && !self->carry_size) {
+            s_input_close (self);
+            continue;
+        }
+
+        // Read path: what was carried over, then as much as fits
+        if (slot->buffer_max < CHUNK_SIZE + self->carry_size) {
+            slot->buffer_max = CHUNK_SIZE + self->carry_size;
+            slot->buffer = (char *) realloc (slot->buffer, slot->buffer_max);
+            assert (slot->buffer);
+        }
+        memcpy (slot->buffer, self->carry, self->carry_size);
+        size_t size = self->carry_size;
+        size_t cut = 0;
+        // Go with what a pipe has so far, so live feeds don't wait for
+        // a whole chunk, as long as it holds a whole message
+        while (!cut) {
+            if (self->eof || size == slot->buffer_max) {
+                cut = size;     // one huge message, or junk, if not the end
+                break;
+            }
+            ssize_t rc = read (self->fd, slot->buffer + size, slot->buffer_max - size);
+            if (rc < 0 && errno == EINTR)
+                continue;
+            if (rc < 0)
+                bail ("Can't read input", strerror (errno));
+            if (rc == 0)
+                self->eof = true;
+            size += (size_t) rc;
+            if (!self->eof)
+                cut = s_read_cut (slot->buffer, size);
+        }
+        self->carry_size = size - cut;
+        if (self->carry_size) {
+            self->carry = (char *) realloc (self->carry, self->carry_size);
+            assert (self->carry);
+            memcpy (self->carry, slot->buffer + cut, self->carry_size);
+        }
+        slot->data = slot->buffer;
+        slot->size = cut;
+        if (cut)
+            return true;
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Workers take chunks in order, and the main thread writes them in order
+
+typedef struct {
+    slot_t *slots;
+    size_t slot_count;
+    size_t next_fill;       // sequence number of the next chunk read
+    size_t next_job;        // of the next chunk a worker takes
+    bool done;
+    pthread_mutex_t lock;
+    pthread_cond_t work;    // a chunk is ready, or we're done
+    pthread_cond_t finished;
+} pool_t;
+
+static void *
+s_worker (void *arg)
+{
+    pool_t *pool = (pool_t *) arg;
+    aisnmea_t *parser = aisnmea_new (NULL);
+    assert (parser);
+    aisnmea_set_filter (parser, s_filter);
+
+    pthread_mutex_lock (&pool->lock);
+    while (true) {
+        while (pool->next_job == pool->next_fill && !pool->done)
+            pthread_cond_wait (&pool->work, &pool->lock);
+        if (pool->next_job == pool->next_fill)
+            break;
+        slot_t *slot = &pool->slots [pool->next_job++ % pool->slot_count];
+        pthread_mutex_unlock (&pool->lock);
+
+        s_filter_chunk (parser, slot);
+
+        pthread_mutex_lock (&pool->lock);
+        slot->state = SLOT_DONE;
+        pthread_cond_broadcast (&pool->finished);
+    }
+    pthread_mutex_unlock (&pool->lock);
+    aisnmea_destroy (&parser);
+    return NULL;
+}
+
+static void
+s_write (slot_t *slot)
+{
+    if (slot->out_size && fwrite (slot->out, 1, slot->out_size, stdout) != slot->out_size)
+        bail ("Can't write output", strerror (errno));
+    fflush (stdout);   // keep latency down for live consumers
+}
+
+static void
+s_run_threaded (input_t *input, size_t threads)
+{
+    pool_t pool;
+    memset (&pool, 0, sizeof (pool));
+    pool.slot_count = threads * SLOTS_PER_WORKER;
+    pool.slots = (slot_t *) zmalloc (pool.slot_count * sizeof (slot_t));
+    assert (pool.slots);
+    pthread_mutex_init (&pool.lock, NULL);
+    pthread_cond_init (&pool.work, NULL);
+    pthread_cond_init (&pool.finished, NULL);
+
+    pthread_t *ids = (pthread_t *) zmalloc (threads * sizeof (pthread_t));
+    assert (ids);
+    for (size_t i = 0; i < threads; ++i) {
+        int rc = pthread_create (&ids [i], NULL, s_worker, &pool);
+        assert (!rc);
+    }
+
+    // Only this thread changes next_fill, so reads of it need no lock
+    size_t next_write = 0;
+    bool more = true;
+    while (more || next_write < pool.next_fill) {
+        // Read ahead into every free slot
+        while (more && pool.next_fill - next_write < pool.slot_count) {
+            slot_t *slot = &pool.slots [pool.next_fill % pool.slot_count];
+            more = s_input_next (input, slot);
+            if (more) {
+                pthread_mutex_lock (&pool.lock);
+                slot->state = SLOT_READY;
+                pool.next_fill += 1;
+                pthread_cond_signal (&pool.work);
+                pthread_mutex_unlock (&pool.lock);
+            }
+        }
+        if (next_write == pool.next_fill)
+            break;
+
+        // Then write out the oldest chunk once it's filtered
+        slot_t *slot = &pool.slots [next_write % pool.slot_count];
+        pthread_mutex_lock (&pool.lock);
+        while (slot->state != SLOT_DONE)
+            pthread_cond_wait (&pool.finished, &pool.lock);
+        pthread_mutex_unlock (&pool.lock);
+        s_write (slot);
+        slot->state = SLOT_FREE;
+        next_write += 1;
+    }
+
+    pthread_mutex_lock (&pool.lock);
+    pool.done = true;
+    pthread_cond_broadcast (&pool.work);
+    pthread_mutex_unlock (&pool.lock);
+    for (size_t i = 0; i < threads; ++i)
+        pthread_join (ids [i], NULL);
+
+    for (size_t i = 0; i < pool.slot_count; ++i) {
+        free (pool.slots [i].buffer);
+        free (pool.slots [i].out);
+    }
+    free (pool.slots);
+    free (ids);
+    pthread_mutex_destroy (&pool.lock);
+    pthread_cond_destroy (&pool.work);
+    pthread_cond_destroy (&pool.finished);
+}
+
+static void
+s_run (input_t *input)
+{
+    aisnmea_t *parser = aisnmea_new (NULL);
+    assert (parser);
+    aisnmea_set_filter (parser, s_filter);
+    slot_t slot;
+    memset (&slot, 0, sizeof (slot));
+    while (s_input_next (input, &slot)) {
+        s_filter_chunk (parser, &slot);
+        s_write (&slot);
+    }
+    free (slot.buffer);
+    free (slot.out);
+    aisnmea_destroy (&parser);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Argument parsing
+
+static uint64_t
+s_parse_number (const char *str, uint64_t max)
+{
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull (str, &end, 10);
+    if (errno || end == str || *end || value > max || *str == '-')
+        bail ("Bad number", str);
+    return (uint64_t) value;
+}
+
+static void
+s_add_types (const char *list)
+{
+    char *copy = strdup (list);
+    for (char *item = strtok (copy, ","); item; item = strtok (NULL, ","))
+        aisnmea_filter_add_type (s_filter, (int) s_parse_number (item, 27));
+    free (copy);
+}
+
+static void
+s_add_sources (const char *list)
+{
+    char *copy = strdup (list);
+    for (char *item = strtok (copy, ","); item; item = strtok (NULL, ","))
+        aisnmea_filter_add_source (s_filter, item);
+    free (copy);
+}
+
+//  One MMSI per line; blank lines and '#' comments are skipped
+static void
+s_add_mmsis (const char *path)
+{
+    FILE *file = fopen (path, "r");
+    if (!file)
+        bail ("Can't open MMSI file", path);
+    char line [256];
+    size_t count = 0;
+    while (fgets (line, sizeof (line), file)) {
+        char *comment = strchr (line, '#');
+        if (comment)
+            *comment = 0;
+        char *start = line;
+        while (isspace ((byte) *start))
+            ++start;
+        char *stop = start + strlen (start);
+        while (stop > start && isspace ((byte) stop [-1]))
+            *--stop = 0;
+        if (*start) {
+            aisnmea_filter_add_mmsi (s_filter, (uint32_t) s_parse_number (start, 999999999));
+            ++count;
+        }
+    }
+    fclose (file);
+    if (!count)
+        bail ("No MMSIs in file", path);
+}
+
+
+//  --------------------------------------------------------------------------
+//  main()
+
+int main (int argc, char *argv [])
+{
+    s_filter = aisnmea_filter_new ();
+    assert (s_filter);
+    size_t threads = 1;
+    input_t input;
+    memset (&input, 0, sizeof (input));
+    input.fd = -1;
+
+    int argn;
+    for (argn = 1; argn < argc; ++argn) {
+        if (argn + 1 < argc && streq (argv [argn], "-t"))
+            s_add_types (argv [++argn]);
+        else
+        if (argn + 1 < argc && streq (argv [argn], "-c")) {
+            const char *channels = argv [++argn];
+            for (; *channels; ++channels)
+                aisnmea_filter_add_channel (s_filter, *channels);
+        }
+        else
+        if (argn + 1 < argc && streq (argv [argn], "-s"))
+            s_add_sources (argv [++argn]);
+        else
+        if (argn + 1 < argc && streq (argv [argn], "-m"))
+            s_add_mmsis (argv [++argn]);
+        else
+        if (argn + 1 < argc && streq (argv [argn], "--from")) {
+            s_from = s_parse_number (argv [++argn], UINT64_MAX);
+            s_time_test = true;
+        }
+        else
+        if (argn + 1 < argc && streq (argv [argn], "--to")) {
+            s_to = s_parse_number (argv [++argn], UINT64_MAX);
+            s_time_test = true;
+        }
+        else
+        if (argn + 1 < argc && streq (argv [argn], "-j"))
+            threads = (size_t) s_parse_number (argv [++argn], 256);
+        else
+        if (argv [argn][0] == '-' && argv [argn][1])
+            usage ();
+        else
+            break;
+    }
+    if (threads < 1)
+        usage ();
+    input.paths = argv + argn;
+    input.path_count = argc - argn;
+
+    if (threads > 1)
+        s_run_threaded (&input, threads);
+    else
+        s_run (&input);
+    if (fflush (stdout))
+        bail ("Can't write output", strerror (errno));
+
+    for (size_t i = 0; i < input.map_count; ++i)
+        munmap (input.maps [i], input.map_sizes [i]);
+    free (input.maps);
+    free (input.map_sizes);
+    free (input.carry);
+    aisnmea_filter_destroy (&s_filter);
+    return 0;
+}
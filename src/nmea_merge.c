@@ -0,0 +1,80 @@
+/*  =========================================================================
+    nmea_merge - Merges several AIS NMEA files into one stream in tagblock receive-time order
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    nmea_merge - Merges several AIS NMEA files into one stream in tagblock receive-time order
+@discuss
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+
+//  --------------------------------------------------------------------------
+//  Log message and die
+
+static void
+bail (const char *msg, const char *arg)
+{
+    assert (msg);
+    if (arg)
+        fprintf (stderr, "ERROR: %s: %s\n", msg, arg);
+    else
+        fprintf (stderr, "ERROR: %s\n", msg);
+    exit (1);
+}
+
+static void
+usage (void)
+{
+    puts ("USAGE:");
+    puts ("  nmea_merge [-w WINDOW_SECS] FILE.nmea... > MERGED.nmea");
+    exit (1);
+}
+
+
+//  --------------------------------------------------------------------------
+//  main()
+
+int main (int argc, char *argv [])
+{
+    // Default tolerates a minute of disorder within each file
+    uint64_t window = 60;
+
+    int argn = 1;
+    if (argn < argc && streq (argv [argn], "-w")) {
+        if (argn + 1 >= argc)
+            usage ();
+        window = strtoull (argv [argn + 1], NULL, 10);
+        argn += 2;
+    }
+    if (argn >= argc)
+        usage ();
+
+    aisnmea_merge_t *merge = aisnmea_merge_new (window);
+    assert (merge);
+
+    for (; argn < argc; ++argn) {
+        if (aisnmea_merge_add_file (merge, argv [argn]))
+            bail ("Problem opening file", argv [argn]);
+    }
+
+    const char *line = aisnmea_merge_next (merge);
+    while (line) {
+        fputs (line, stdout);
+        putchar ('\n');
+        line = aisnmea_merge_next (merge);
+    }
+
+    aisnmea_merge_destroy (&merge);
+    return 0;
+}
@@ -0,0 +1,197 @@
+/*  =========================================================================
+    nmea_partition - Splits AIS NMEA archives into files by message type, source, MMSI or hour
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    nmea_partition - Splits AIS NMEA archives into files by message type, source, MMSI or hour
+@discuss
+    Each -k names a partitioning scheme and the directory its files go
+    in. The input is read and parsed once, however many schemes there
+    are, and each line goes to one file under each scheme. Files are read
+    with aisnmea_reader; stdin a line at a time.
+@end
+*/
+
+#include "aisnmea_classes.h"
+
+//  Most schemes at once
+#define MAX_SCHEMES 8
+
+//  Input chunk size and chunks in flight
+#define CHUNK_SIZE (4 << 20)
+#define READ_DEPTH 8
+
+
+//  --------------------------------------------------------------------------
+//  Log message and die
+
+static void
+bail (const char *msg, const char *arg)
+{
+    assert (msg);
+    if (arg)
+        fprintf (stderr, "ERROR: %s: %s\n", msg, arg);
+    else
+        fprintf (stderr, "ERROR: %s\n", msg);
+    exit (1);
+}
+
+static void
+usage (void)
+{
+    puts ("USAGE:");
+    puts ("  nmea_partition -k SCHEME=DIR [-k SCHEME=DIR...] [-n MAX_OPEN] [-b BUFFER_KB]");
+    puts ("                 [FILE...]");
+    puts ("SCHEME is one of: type, source, mmsi:BUCKETS, hour");
+    exit (1);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Partitioners, one per -k
+
+static aisnmea_partition_t *s_partitions [MAX_SCHEMES];
+static const char *s_specs [MAX_SCHEMES];
+static size_t s_partition_count = 0;
+
+static void
+s_write (aisnmea_t *parser, const char *line)
+{
+    aisnmea_t *msg = aisnmea_parse (parser, line) == 0 ? parser : NULL;
+    for (size_t i = 0; i < s_partition_count; ++i)
+        if (aisnmea_partition_write (s_partitions [i], msg, line))
+            bail ("Can't write output", s_specs [i]);
+}
+
+static void
+s_read_files (aisnmea_t *parser, char **paths, int path_count)
+{
+    aisnmea_reader_t *reader = aisnmea_reader_new (CHUNK_SIZE, READ_DEPTH);
+    assert (reader);
+    for (int i = 0; i < path_count; ++i)
+        if (aisnmea_reader_add (reader, paths [i]))
+            bail ("Can't open input", paths [i]);
+
+    char *chunk;
+    while ((chunk = (char *) aisnmea_reader_next (reader))) {
+        char *end = chunk + aisnmea_reader_size (reader);
+        char *line = chunk;
+        while (line < end) {
+            char *stop = (char *) memchr (line, '\n', end - line);
+            if (!stop)
+                stop = end;
+            char *next = stop + 1;
+            if (stop > line && stop [-1] == '\r')
+                --stop;
+            *stop = 0;
+            s_write (parser, line);
+            line = next;
+        }
+        aisnmea_reader_release (reader, chunk);
+    }
+    // Don't let a failed read pass for the end of the input
+    if (aisnmea_reader_failed (reader))
+        bail ("Can't read input", NULL);
+    aisnmea_reader_destroy (&reader);
+}
+
+static void
+s_read_stdin (aisnmea_t *parser)
+{
+    zfile_t *stdinf = zfile_new (NULL, "/dev/stdin");
+    if (!stdinf || zfile_input (stdinf))
+        bail ("Problem opening stdin", NULL);
+    const char *line;
+    while ((line = zfile_readln (stdinf)))
+        s_write (parser, line);
+    zfile_destroy (&stdinf);
+}
+
+
+//  --------------------------------------------------------------------------
+//  main()
+
+int main (int argc, char *argv [])
+{
+    size_t max_open = 0;
+    size_t buffer_size = 0;
+
+    int argn;
+    for (argn = 1; argn < argc; ++argn) {
+        if (argn + 1 < argc && streq (argv [argn], "-k")) {
+            if (s_partition_count == MAX_SCHEMES)
+                bail ("Too many schemes", NULL);
+            s_specs [s_partition_count++] = argv [++argn];
+        }
+        else
+        if (argn + 1 < argc && streq (argv [argn], "-n"))
+            max_open = (size_t) atol (argv [++argn]);
+        else
+        if (argn + 1 < argc && streq (argv [argn], "-b"))
+            buffer_size = (size_t) atol (argv [++argn]) * 1024;
+        else
+        if (argv [argn][0] == '-' && argv [argn][1])
+            usage ();
+        else
+            break;
+    }
+    if (!s_partition_count)
+        usage ();
+
+    for (size_t i = 0; i < s_partition_count; ++i) {
+        const char *directory = strchr (s_specs [i], '=');
+        if (!directory || !directory [1])
+            usage ();
+        size_t length = directory++ - s_specs [i];
+        int scheme;
+        uint32_t buckets = 0;
+        if (length == 4 && strncmp (s_specs [i], "type", 4) == 0)
+            scheme = AISNMEA_PARTITION_TYPE;
+        else
+        if (length == 6 && strncmp (s_specs [i], "source", 6) == 0)
+            scheme = AISNMEA_PARTITION_SOURCE;
+        else
+        if (length == 4 && strncmp (s_specs [i], "hour", 4) == 0)
+            scheme = AISNMEA_PARTITION_HOUR;
+        else
+        if (length > 5 && strncmp (s_specs [i], "mmsi:", 5) == 0) {
+            scheme = AISNMEA_PARTITION_MMSI;
+            buckets = (uint32_t) atol (s_specs [i] + 5);
+            if (!buckets)
+                usage ();
+        }
+        else
+            usage ();
+
+        s_partitions [i] = aisnmea_partition_new (directory, scheme, buckets);
+        if (!s_partitions [i])
+            bail ("Can't make directory", directory);
+        if (max_open)
+            aisnmea_partition_set_max_open (s_partitions [i], max_open);
+        if (buffer_size)
+            aisnmea_partition_set_buffer_size (s_partitions [i], buffer_size);
+    }
+
+    aisnmea_t *parser = aisnmea_new (NULL);
+    assert (parser);
+    if (argn < argc && !(argc - argn == 1 && streq (argv [argn], "-")))
+        s_read_files (parser, argv + argn, argc - argn);
+    else
+        s_read_stdin (parser);
+    aisnmea_destroy (&parser);
+
+    for (size_t i = 0; i < s_partition_count; ++i) {
+        if (aisnmea_partition_flush (s_partitions [i]))
+            bail ("Can't write output", s_specs [i]);
+        aisnmea_partition_destroy (&s_partitions [i]);
+    }
+    return 0;
+}
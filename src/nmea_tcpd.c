@@ -0,0 +1,197 @@
+/*  =========================================================================
+    nmea_tcpd - Receives AIS NMEA feeds over TCP from many receivers and merges them onto stdout
+
+    Copyright (c) 2017 Inkblot Software Limited.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+    =========================================================================
+*/
+
+/*
+@header
+    nmea_tcpd - Receives AIS NMEA feeds over TCP from many receivers and merges them onto stdout
+@discuss
+    Each thread runs its own aisnmea_server on the shared port, so the
+    kernel spreads incoming connections across them. Lines from all of
+    them go to stdout whole, under the stdio lock.
+
+    The per-source table written to stderr on exit sums every thread's
+    counters by source address, so a receiver that reconnects onto
+    another thread still gets one row. The tables SIGUSR1 asks for are
+    per-thread with -t, since each thread writes its own while the
+    others are still running.
+@end
+*/
+
+#include "aisnmea_classes.h"
+#include <pthread.h>
+
+//  NMEA over TCP is conventionally served on this port
+#define DEFAULT_PORT 10110
+
+//  How often (msecs) workers look for signals when idle
+#define POLL_INTERVAL 500
+
+static volatile sig_atomic_t s_interrupted = 0;
+static volatile sig_atomic_t s_dump_requests = 0;
+
+static void
+s_handle_stop (int signum) {
+    (void) signum;
+    s_interrupted = 1;
+}
+
+static void
+s_handle_sigusr1 (int signum) {
+    (void) signum;
+    s_dump_requests += 1;
+}
+
+static pthread_mutex_t s_stderr_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+//  --------------------------------------------------------------------------
+//  Log message and die
+
+static void
+bail (const char *msg, const char *arg)
+{
+    assert (msg);
+    if (arg)
+        fprintf (stderr, "ERROR: %s: %s\n", msg, arg);
+    else
+        fprintf (stderr, "ERROR: %s\n", msg);
+    exit (1);
+}
+
+static void
+usage (void)
+{
+    puts ("USAGE:");
+    puts ("  nmea_tcpd [-a ADDRESS] [-p PORT] [-t THREADS] [--fast] > MERGED.nmea");
+    exit (1);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Worker thread: one server, run until interrupted
+
+static void
+s_write_line (const char *line, size_t source, void *arg)
+{
+    (void) source;
+    (void) arg;
+    flockfile (stdout);
+    fputs (line, stdout);
+    putc ('\n', stdout);
+    funlockfile (stdout);
+}
+
+static void
+s_print_sources (aisnmea_server_t *server)
+{
+    pthread_mutex_lock (&s_stderr_lock);
+    aisnmea_server_print_sources (server, stderr);
+    fflush (stderr);
+    pthread_mutex_unlock (&s_stderr_lock);
+}
+
+static void *
+s_worker (void *arg)
+{
+    aisnmea_server_t *server = (aisnmea_server_t *) arg;
+    sig_atomic_t dumps_done = 0;
+
+    while (!s_interrupted) {
+        int rc = aisnmea_server_run (server, POLL_INTERVAL);
+        if (rc < 0)
+            break;
+        if (rc > 0)
+            fflush (stdout);   // keep latency down for live consumers
+        if (dumps_done != s_dump_requests) {
+            dumps_done = s_dump_requests;
+            s_print_sources (server);
+        }
+    }
+    return NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  main()
+
+int main (int argc, char *argv [])
+{
+    const char *address = NULL;
+    int port = DEFAULT_PORT;
+    size_t threads = 1;
+    bool fast = false;
+
+    for (int argn = 1; argn < argc; ++argn) {
+        if (streq (argv [argn], "--fast"))
+            fast = true;
+        else
+        if (argn + 1 < argc && streq (argv [argn], "-a"))
+            address = argv [++argn];
+        else
+        if (argn + 1 < argc && streq (argv [argn], "-p"))
+            port = atoi (argv [++argn]);
+        else
+        if (argn + 1 < argc && streq (argv [argn], "-t"))
+            threads = (size_t) atoi (argv [++argn]);
+        else
+            usage ();
+    }
+    if (port < 0 || port > 65535 || threads < 1)
+        usage ();
+
+    signal (SIGINT, s_handle_stop);
+    signal (SIGTERM, s_handle_stop);
+#if defined (SIGUSR1)
+    signal (SIGUSR1, s_handle_sigusr1);
+#endif
+#if defined (SIGPIPE)
+    signal (SIGPIPE, SIG_IGN);
+#endif
+
+    // Several listeners need to share the port
+    aisnmea_server_t **servers =
+        (aisnmea_server_t **) zmalloc (threads * sizeof (aisnmea_server_t *));
+    assert (servers);
+    for (size_t i = 0; i < threads; ++i) {
+        servers [i] = aisnmea_server_new (address, port, threads > 1);
+        if (!servers [i]) {
+            char port_str [16];
+            snprintf (port_str, sizeof (port_str), "%d", port);
+            bail ("Can't listen on port", port_str);
+        }
+        aisnmea_server_set_handler (servers [i], s_write_line, NULL);
+        aisnmea_server_set_fastpath (servers [i], fast);
+    }
+
+    // The main thread runs the first server itself
+    pthread_t *ids = (pthread_t *) zmalloc (threads * sizeof (pthread_t));
+    assert (ids);
+    for (size_t i = 1; i < threads; ++i) {
+        int rc = pthread_create (&ids [i], NULL, s_worker, servers [i]);
+        assert (!rc);
+    }
+    s_worker (servers [0]);
+    s_interrupted = 1;
+    for (size_t i = 1; i < threads; ++i)
+        pthread_join (ids [i], NULL);
+
+    // All threads have stopped, so one table can hold everyone's counts
+    fflush (stdout);
+    for (size_t i = 1; i < threads; ++i) {
+        aisnmea_server_merge_sources (servers [0], servers [i]);
+        aisnmea_server_destroy (&servers [i]);
+    }
+    s_print_sources (servers [0]);
+    aisnmea_server_destroy (&servers [0]);
+    free (servers);
+    free (ids);
+    return 0;
+}